@@ -0,0 +1,225 @@
+#include <cmath>
+#include <functional>
+#include <Foundation/Base/MemoryHelper.h>
+#include <Foundation/Math/PredefinedConstantValues.h>
+#include "Denoiser.h"
+
+namespace
+{
+    const int RowBlockSize = 32;
+    const int KernelRadius = 2;
+
+    // 1D B3-spline, h = [1/16, 1/4, 3/8, 1/4, 1/16]
+    const Float KernelWeights[KernelRadius + 1] = { Float(3.0 / 8.0), Float(1.0 / 4.0), Float(1.0 / 16.0) };
+    const Float AlbedoEpsilon = Float(0.001);
+}
+
+ATrousDenoiser::ATrousDenoiser(int width, int height)
+    : CanvasWidth(width)
+    , CanvasHeight(height)
+{
+    int count = CanvasWidth * CanvasHeight;
+    mAOVBuffer = new SurfaceAOV[count];
+    for (int index = 0; index < 2; index++)
+    {
+        mIllumination[index] = new Spectrum[count];
+        mVariance[index] = new Float[count];
+    }
+}
+
+ATrousDenoiser::~ATrousDenoiser()
+{
+    for (int index = 0; index < 2; index++)
+    {
+        SafeDeleteArray(mIllumination[index]);
+        SafeDeleteArray(mVariance[index]);
+    }
+    SafeDeleteArray(mAOVBuffer);
+}
+
+Task ATrousDenoiser::Denoise(const Task& Prerequister, LDRFilm& Film, unsigned char* CanvasDataPtr, int linePitch)
+{
+    const AccumulatedSpectrum* AccumulatedBufferPtr = Film.GetBackbufferPtr();
+
+    //every pass reads the whole result of its previous pass,
+    // so the row-blocks of a pass are joined before next pass starts.
+    Task Barrier = Prerequister;
+    auto ScheduleRowBlocks = [this, &Barrier](std::function<void(int, int)> RowBlockRoute)
+    {
+        std::vector<Task> RowBlockTasks;
+        for (int RowStart = 0; RowStart < CanvasHeight; RowStart += RowBlockSize)
+        {
+            int RowEnd = math::min2(RowStart + RowBlockSize, CanvasHeight);
+            Task RowBlockTask = Task::When(ThreadName::Worker,
+                [RowBlockRoute, RowStart, RowEnd](::Task&)
+                {
+                    RowBlockRoute(RowStart, RowEnd);
+                }, Barrier);
+            RowBlockTasks.push_back(RowBlockTask);
+        }
+        Barrier = Task::WhenAll(ThreadName::Worker, [](auto) {}, RowBlockTasks);
+    };
+
+    ScheduleRowBlocks([this, AccumulatedBufferPtr](int RowStart, int RowEnd)
+        {
+            Demodulate(AccumulatedBufferPtr, RowStart, RowEnd);
+        });
+
+    int Source = 0;
+    for (int Iteration = 0; Iteration < NumIterations; Iteration++)
+    {
+        const int StepSize = 1 << Iteration;
+        ScheduleRowBlocks([this, AccumulatedBufferPtr, StepSize, Source](int RowStart, int RowEnd)
+            {
+                FilterPass(AccumulatedBufferPtr, StepSize, Source, RowStart, RowEnd);
+            });
+        Source = 1 - Source;
+    }
+
+    LDRFilm* FilmPtr = &Film;
+    ScheduleRowBlocks([this, FilmPtr, Source, CanvasDataPtr, linePitch](int RowStart, int RowEnd)
+        {
+            Remodulate(*FilmPtr, Source, CanvasDataPtr, linePitch, RowStart, RowEnd);
+        });
+    return Barrier;
+}
+
+void ATrousDenoiser::Demodulate(const AccumulatedSpectrum* AccumulatedBufferPtr, int RowStart, int RowEnd)
+{
+    Spectrum* Illumination = mIllumination[0];
+    Float* Variance = mVariance[0];
+    for (int RowIndex = RowStart; RowIndex < RowEnd; RowIndex++)
+    {
+        int RowOffset = RowIndex * CanvasWidth;
+        for (int ColIndex = 0; ColIndex < CanvasWidth; ColIndex++)
+        {
+            const int PixelIndex = ColIndex + RowOffset;
+            const AccumulatedSpectrum& Pixel = AccumulatedBufferPtr[PixelIndex];
+            if (Pixel.Count == 0 || Pixel.Weight <= Float(0))
+            {
+                Illumination[PixelIndex] = Spectrum::zero();
+                Variance[PixelIndex] = Float(0);
+                continue;
+            }
+
+            const SurfaceAOV& AOV = mAOVBuffer[PixelIndex];
+            const Float InvNumSample = Float(1) / Pixel.Count;
+            const Float InvWeight = Float(1) / Pixel.Weight;
+            const Spectrum Color = Pixel.Value * InvWeight;
+            const Float MeanLuminance = Luminance(Color);
+            const Float AlbedoLuminance = math::max2(Luminance(AOV.Albedo), AlbedoEpsilon);
+
+            //variance of the mean estimator, in demodulated space.
+            const Float SampleVariance = math::max2(Float(0), Pixel.LuminanceSquare * InvWeight - math::square(MeanLuminance));
+            Variance[PixelIndex] = SampleVariance * InvNumSample / math::square(AlbedoLuminance);
+            Illumination[PixelIndex].set(
+                Color.x / math::max2(AOV.Albedo.x, AlbedoEpsilon),
+                Color.y / math::max2(AOV.Albedo.y, AlbedoEpsilon),
+                Color.z / math::max2(AOV.Albedo.z, AlbedoEpsilon));
+        }
+    }
+}
+
+void ATrousDenoiser::FilterPass(const AccumulatedSpectrum* AccumulatedBufferPtr, int StepSize, int Source, int RowStart, int RowEnd)
+{
+    const Spectrum* SourceIllumination = mIllumination[Source];
+    const Float* SourceVariance = mVariance[Source];
+    Spectrum* TargetIllumination = mIllumination[1 - Source];
+    Float* TargetVariance = mVariance[1 - Source];
+
+    for (int RowIndex = RowStart; RowIndex < RowEnd; RowIndex++)
+    {
+        int RowOffset = RowIndex * CanvasWidth;
+        for (int ColIndex = 0; ColIndex < CanvasWidth; ColIndex++)
+        {
+            const int PixelIndex = ColIndex + RowOffset;
+            const SurfaceAOV& CenterAOV = mAOVBuffer[PixelIndex];
+            if (!CenterAOV.IsOnSurface)
+            {
+                TargetIllumination[PixelIndex] = SourceIllumination[PixelIndex];
+                TargetVariance[PixelIndex] = SourceVariance[PixelIndex];
+                continue;
+            }
+
+            // unsampled center pixel is filled by its neighbours without luminance stopping.
+            const bool bCenterSampled = AccumulatedBufferPtr[PixelIndex].Count > 0;
+            const Float CenterLuminance = Luminance(SourceIllumination[PixelIndex]);
+            const Float LuminanceDenominator = SigmaLuminance * sqrt(SourceVariance[PixelIndex]) + math::SMALL_NUM<Float>;
+            const Float DepthDenominator = SigmaDepth * CenterAOV.Depth * StepSize + math::SMALL_NUM<Float>;
+
+            Spectrum SumIllumination = Spectrum::zero();
+            Float SumVariance = Float(0);
+            Float SumWeight = Float(0);
+            for (int OffsetY = -KernelRadius; OffsetY <= KernelRadius; OffsetY++)
+            {
+                const int SampleRow = RowIndex + OffsetY * StepSize;
+                if (SampleRow < 0 || SampleRow >= CanvasHeight)
+                {
+                    continue;
+                }
+
+                for (int OffsetX = -KernelRadius; OffsetX <= KernelRadius; OffsetX++)
+                {
+                    const int SampleCol = ColIndex + OffsetX * StepSize;
+                    if (SampleCol < 0 || SampleCol >= CanvasWidth)
+                    {
+                        continue;
+                    }
+
+                    const int SampleIndex = SampleCol + SampleRow * CanvasWidth;
+                    const SurfaceAOV& SampleAOV = mAOVBuffer[SampleIndex];
+                    if (!SampleAOV.IsOnSurface || AccumulatedBufferPtr[SampleIndex].Count == 0)
+                    {
+                        continue;
+                    }
+
+                    const Float WeightNormal = std::pow(math::saturate(math::dot(CenterAOV.Normal, SampleAOV.Normal)), SigmaNormal);
+                    const Float WeightDepth = std::exp(-std::abs(CenterAOV.Depth - SampleAOV.Depth) / DepthDenominator);
+                    const Float WeightLuminance = bCenterSampled
+                        ? std::exp(-std::abs(CenterLuminance - Luminance(SourceIllumination[SampleIndex])) / LuminanceDenominator)
+                        : Float(1);
+                    const Float Weight = KernelWeights[std::abs(OffsetX)] * KernelWeights[std::abs(OffsetY)]
+                        * WeightNormal * WeightDepth * WeightLuminance;
+
+                    SumIllumination += Weight * SourceIllumination[SampleIndex];
+                    SumVariance += math::square(Weight) * SourceVariance[SampleIndex];
+                    SumWeight += Weight;
+                }
+            }
+
+            if (SumWeight > Float(0))
+            {
+                TargetIllumination[PixelIndex] = SumIllumination / SumWeight;
+                TargetVariance[PixelIndex] = SumVariance / math::square(SumWeight);
+            }
+            else
+            {
+                TargetIllumination[PixelIndex] = SourceIllumination[PixelIndex];
+                TargetVariance[PixelIndex] = SourceVariance[PixelIndex];
+            }
+        }
+    }
+}
+
+void ATrousDenoiser::Remodulate(LDRFilm& Film, int Source, unsigned char* CanvasDataPtr, int linePitch, int RowStart, int RowEnd)
+{
+    const Spectrum* Illumination = mIllumination[Source];
+    for (int RowIndex = RowStart; RowIndex < RowEnd; RowIndex++)
+    {
+        int RowOffset = RowIndex * CanvasWidth;
+        for (int ColIndex = 0; ColIndex < CanvasWidth; ColIndex++)
+        {
+            const int PixelIndex = ColIndex + RowOffset;
+            const SurfaceAOV& AOV = mAOVBuffer[PixelIndex];
+
+            AccumulatedSpectrum Filtered;
+            Filtered.Value.set(
+                Illumination[PixelIndex].x * math::max2(AOV.Albedo.x, AlbedoEpsilon),
+                Illumination[PixelIndex].y * math::max2(AOV.Albedo.y, AlbedoEpsilon),
+                Illumination[PixelIndex].z * math::max2(AOV.Albedo.z, AlbedoEpsilon));
+            Filtered.Weight = Float(1);
+            Filtered.Count = 1;
+            Film.FlushTo(Filtered, RowIndex, ColIndex, CanvasDataPtr, linePitch);
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "PreInclude.h"
+#include "LDRFilm.h"
+
+struct SurfaceAOV
+{
+    Spectrum Albedo = Spectrum::one();
+    Direction Normal = Direction::unit_z();
+    Float Depth = Float(0);
+    bool IsOnSurface = false;
+};
+
+/**
+* edge-avoiding a-trous wavelet filter (SVGF-style),
+* works on the demodulated illumination of the accumulated film,
+* and stops at edges detected by normal, depth and luminance variance.
+*/
+class ATrousDenoiser
+{
+public:
+    ATrousDenoiser(int width, int height);
+    ~ATrousDenoiser();
+
+    SurfaceAOV* GetAOVBufferPtr() { return mAOVBuffer; }
+
+    /**
+    * schedule all filter passes after the prerequister,
+    * the last pass flushes the filtered result to the canvas.
+    */
+    Task Denoise(const Task& Prerequister, LDRFilm& Film, unsigned char* CanvasDataPtr, int linePitch);
+
+    const int CanvasWidth;
+    const int CanvasHeight;
+    int NumIterations = 5;
+    Float SigmaLuminance = Float(4);
+    Float SigmaNormal = Float(128);
+    Float SigmaDepth = Float(0.02);
+
+private:
+    void Demodulate(const AccumulatedSpectrum* AccumulatedBufferPtr, int RowStart, int RowEnd);
+    void FilterPass(const AccumulatedSpectrum* AccumulatedBufferPtr, int StepSize, int Source, int RowStart, int RowEnd);
+    void Remodulate(LDRFilm& Film, int Source, unsigned char* CanvasDataPtr, int linePitch, int RowStart, int RowEnd);
+
+    SurfaceAOV* mAOVBuffer = nullptr;
+    Spectrum* mIllumination[2] = { nullptr, nullptr };
+    Float* mVariance[2] = { nullptr, nullptr };
+};
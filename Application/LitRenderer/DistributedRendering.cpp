@@ -0,0 +1,506 @@
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <algorithm>
+#include <cstdio>
+#include "DistributedRendering.h"
+
+namespace
+{
+    const auto WorkerTimeout = std::chrono::seconds(30);
+    const auto ReportInterval = std::chrono::seconds(5);
+    const timeval SelectTimeout = { 0, 20 * 1000 };
+
+    //a result is read at once when it starts to arrive, a worker stalled in the middle is dropped.
+    const DWORD ReceiveTimeoutMs = 5000;
+    const char* ScalingReportPath = "tile_scaling.csv";
+
+    bool SendAll(SOCKET socket, const void* data, size_t size)
+    {
+        const char* bytes = reinterpret_cast<const char*>(data);
+        while (size > 0)
+        {
+            int sent = ::send(socket, bytes, static_cast<int>(size), 0);
+            if (sent <= 0)
+            {
+                return false;
+            }
+            bytes += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    bool ReceiveAll(SOCKET socket, void* data, size_t size)
+    {
+        char* bytes = reinterpret_cast<char*>(data);
+        while (size > 0)
+        {
+            int received = ::recv(socket, bytes, static_cast<int>(size), 0);
+            if (received <= 0)
+            {
+                return false;
+            }
+            bytes += received;
+            size -= received;
+        }
+        return true;
+    }
+
+    size_t TilePixelCount(const TileRequest& request)
+    {
+        return static_cast<size_t>(request.RowEnd - request.RowStart) * static_cast<size_t>(request.ColEnd - request.ColStart);
+    }
+
+    bool IsSameTile(const TileRequest& lhs, const TileRequest& rhs)
+    {
+        return lhs.TileIndex == rhs.TileIndex && lhs.Pass == rhs.Pass && lhs.CameraVersion == rhs.CameraVersion;
+    }
+
+    bool IsSameRegion(const TileRequest& lhs, const TileRequest& rhs)
+    {
+        return lhs.RowStart == rhs.RowStart && lhs.RowEnd == rhs.RowEnd
+            && lhs.ColStart == rhs.ColStart && lhs.ColEnd == rhs.ColEnd
+            && lhs.SamplesPerPixel == rhs.SamplesPerPixel;
+    }
+}
+
+TileCoordinator::TileCoordinator(int width, int height)
+    : mCanvasWidth(width)
+    , mCanvasHeight(height)
+    , mNumTileX((width + TileSize - 1) / TileSize)
+    , mNumTileY((height + TileSize - 1) / TileSize)
+{
+
+}
+
+TileCoordinator::~TileCoordinator()
+{
+    mQuit = true;
+    if (mNetworkThread.joinable())
+    {
+        mNetworkThread.join();
+    }
+
+    //workers quit by themselves once their connection is closed.
+    for (void* process : mWorkerProcesses)
+    {
+        if (::WaitForSingleObject(process, 1000) != WAIT_OBJECT_0)
+        {
+            ::TerminateProcess(process, 0);
+        }
+        ::CloseHandle(process);
+    }
+
+    if (mListenSocket != INVALID_SOCKET)
+    {
+        ::closesocket(mListenSocket);
+        ::WSACleanup();
+    }
+}
+
+bool TileCoordinator::Start(uint16_t port, const char* bindAddress)
+{
+    WSADATA wsaData;
+    if (::WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+    {
+        return false;
+    }
+
+    SOCKET listenSocket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listenSocket == INVALID_SOCKET)
+    {
+        ::WSACleanup();
+        return false;
+    }
+
+    //peers are not authenticated, only local workers can connect unless an address is given.
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if ((bindAddress != nullptr && ::inet_pton(AF_INET, bindAddress, &address.sin_addr) != 1)
+        || ::bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR
+        || ::listen(listenSocket, SOMAXCONN) == SOCKET_ERROR)
+    {
+        ::closesocket(listenSocket);
+        ::WSACleanup();
+        return false;
+    }
+
+    mPort = port;
+    mListenSocket = listenSocket;
+    mReportTime = std::chrono::steady_clock::now();
+    mNetworkThread = std::thread(&TileCoordinator::NetworkRoute, this);
+    return true;
+}
+
+bool TileCoordinator::SpawnLocalWorker()
+{
+    wchar_t modulePath[MAX_PATH];
+    if (::GetModuleFileNameW(NULL, modulePath, MAX_PATH) == 0)
+    {
+        return false;
+    }
+
+    wchar_t commandLine[MAX_PATH + 64];
+    swprintf_s(commandLine, L"\"%s\" -worker 127.0.0.1 %u", modulePath, static_cast<unsigned>(mPort));
+
+    STARTUPINFOW startupInfo = {};
+    startupInfo.cb = sizeof(startupInfo);
+    PROCESS_INFORMATION processInfo = {};
+    if (!::CreateProcessW(modulePath, commandLine, NULL, NULL, FALSE, CREATE_NO_WINDOW, NULL, NULL, &startupInfo, &processInfo))
+    {
+        return false;
+    }
+
+    ::CloseHandle(processInfo.hThread);
+    mWorkerProcesses.push_back(processInfo.hProcess);
+    return true;
+}
+
+void TileCoordinator::SetCamera(const Point& position, const Direction& forward, const Direction& up)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (int index = 0; index < 3; index++)
+    {
+        mCamera.CameraPosition[index] = position[index];
+        mCamera.CameraForward[index] = forward[index];
+        mCamera.CameraUp[index] = up[index];
+    }
+    mCamera.CameraVersion += 1;
+
+    //samples of last camera are useless now.
+    mPendingTiles.clear();
+    mResults.clear();
+}
+
+void TileCoordinator::SetCropWindow(const FilmRegion& cropWindow)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCropWindow = cropWindow;
+    mPendingTiles.clear();
+}
+
+void TileCoordinator::MergeResults(LDRFilm& film, unsigned char* canvasDataPtr, int linePitch, bool bFlush)
+{
+    std::vector<TileResult> results;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        results.swap(mResults);
+    }
+
+    AccumulatedSpectrum* AccumulatedBufferPtr = film.GetBackbufferPtr();
+    for (const TileResult& result : results)
+    {
+        const TileRequest& request = result.Request;
+        const CompactSpectrum* SourcePixel = result.Pixels.data();
+        for (int RowIndex = request.RowStart; RowIndex < request.RowEnd; RowIndex++)
+        {
+            for (int ColIndex = request.ColStart; ColIndex < request.ColEnd; ColIndex++, SourcePixel++)
+            {
+                AccumulatedSpectrum& CanvasPixel = AccumulatedBufferPtr[ColIndex + RowIndex * mCanvasWidth];
+                CanvasPixel.Value += Spectrum(SourcePixel->Value[0], SourcePixel->Value[1], SourcePixel->Value[2]);
+                CanvasPixel.LuminanceSquare += SourcePixel->LuminanceSquare;
+                CanvasPixel.Weight += Float(SourcePixel->Count);
+                CanvasPixel.Count += SourcePixel->Count;
+                if (bFlush && CanvasPixel.Count > 0)
+                {
+                    film.FlushTo(CanvasPixel, RowIndex, ColIndex, canvasDataPtr, linePitch);
+                }
+            }
+        }
+    }
+}
+
+bool TileCoordinator::NextRequest(TileRequest& request)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mCamera.CameraVersion == 0)
+    {
+        return false;
+    }
+
+    if (mPendingTiles.empty())
+    {
+        for (int TileIndex = 0; TileIndex < mNumTileX * mNumTileY; TileIndex++)
+        {
+            if (!IsTileCropped(TileIndex))
+            {
+                mPendingTiles.push_back(TileIndex);
+            }
+        }
+        mPass += 1;
+
+        if (mPendingTiles.empty())
+        {
+            return false;
+        }
+    }
+
+    const int TileIndex = mPendingTiles.front();
+    mPendingTiles.pop_front();
+
+    request = mCamera;
+    request.TileIndex = TileIndex;
+    request.Pass = mPass;
+    request.SamplesPerPixel = SamplesPerPixel;
+    request.RowStart = (TileIndex / mNumTileX) * TileSize;
+    request.RowEnd = math::min2(request.RowStart + TileSize, mCanvasHeight);
+    request.ColStart = (TileIndex % mNumTileX) * TileSize;
+    request.ColEnd = math::min2(request.ColStart + TileSize, mCanvasWidth);
+    return true;
+}
+
+bool TileCoordinator::IsTileCropped(int tileIndex) const
+{
+    if (mCropWindow.IsEmpty())
+    {
+        return false;
+    }
+
+    const int RowStart = (tileIndex / mNumTileX) * TileSize;
+    const int ColStart = (tileIndex % mNumTileX) * TileSize;
+    return !mCropWindow.Overlaps(RowStart, RowStart + TileSize, ColStart, ColStart + TileSize);
+}
+
+void TileCoordinator::DropConnection(Connection& connection)
+{
+    ::closesocket(connection.Socket);
+    connection.Socket = INVALID_SOCKET;
+
+    //hand out unfinished tiles again, before anything else.
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const TileRequest& request : connection.InFlight)
+    {
+        if (request.CameraVersion == mCamera.CameraVersion)
+        {
+            mPendingTiles.push_front(request.TileIndex);
+        }
+    }
+    connection.InFlight.clear();
+}
+
+void TileCoordinator::ReportScaling()
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (now - mReportTime < ReportInterval)
+    {
+        return;
+    }
+
+    const uint64_t NumPixelSamples = mTotalPixelSamples;
+    const Float Seconds = std::chrono::duration<Float>(now - mReportTime).count();
+    const Float Throughput = (NumPixelSamples - mReportPixelSamples) / Seconds;
+    const int NumWorkers = static_cast<int>(mConnections.size());
+    mReportTime = now;
+    mReportPixelSamples = NumPixelSamples;
+    if (NumWorkers == 0)
+    {
+        return;
+    }
+
+    //efficiency against the throughput measured with a single worker.
+    if (NumWorkers == 1)
+    {
+        mSingleWorkerThroughput = Throughput;
+    }
+
+    char message[256];
+    if (mSingleWorkerThroughput > Float(0))
+    {
+        const Float Efficiency = Throughput / (NumWorkers * mSingleWorkerThroughput);
+        sprintf_s(message, "[TileCoordinator] workers: %d, throughput: %.2f Msamples/s, scaling efficiency: %.1f%%\n",
+            NumWorkers, Throughput * 1e-6, Efficiency * 100.0);
+    }
+    else
+    {
+        sprintf_s(message, "[TileCoordinator] workers: %d, throughput: %.2f Msamples/s\n",
+            NumWorkers, Throughput * 1e-6);
+    }
+    ::OutputDebugStringA(message);
+
+    //kept on disk, so scaling of a session can be compared afterwards.
+    FILE* f = nullptr;
+    if (fopen_s(&f, ScalingReportPath, "ab") == 0 && f != nullptr)
+    {
+        fprintf(f, "%d,%.4f,%.4f\n", NumWorkers, Throughput * 1e-6,
+            mSingleWorkerThroughput > Float(0) ? Throughput / (NumWorkers * mSingleWorkerThroughput) : Float(0));
+        fclose(f);
+    }
+}
+
+void TileCoordinator::NetworkRoute()
+{
+    while (!mQuit)
+    {
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(mListenSocket, &readSet);
+        for (const Connection& connection : mConnections)
+        {
+            FD_SET(connection.Socket, &readSet);
+        }
+
+        timeval timeout = SelectTimeout;
+        if (::select(0, &readSet, nullptr, nullptr, &timeout) == SOCKET_ERROR)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            continue;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (FD_ISSET(mListenSocket, &readSet))
+        {
+            SOCKET socket = ::accept(mListenSocket, nullptr, nullptr);
+            if (socket != INVALID_SOCKET)
+            {
+                BOOL noDelay = TRUE;
+                ::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+                ::setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&ReceiveTimeoutMs), sizeof(ReceiveTimeoutMs));
+
+                Connection connection;
+                connection.Socket = socket;
+                connection.LastResponse = now;
+                mConnections.push_back(connection);
+            }
+        }
+
+        for (Connection& connection : mConnections)
+        {
+            if (FD_ISSET(connection.Socket, &readSet))
+            {
+                TileResult result;
+                bool succeeded = ReceiveAll(connection.Socket, &result.Request, sizeof(TileRequest))
+                    && result.Request.Magic == TileRequest::RequestMagic;
+
+                auto it = connection.InFlight.begin();
+                while (succeeded && it != connection.InFlight.end() && !IsSameTile(*it, result.Request))
+                {
+                    ++it;
+                }
+                succeeded = succeeded && it != connection.InFlight.end() && IsSameRegion(*it, result.Request);
+
+                //region and size always come from what was sent, never from the peer.
+                if (succeeded)
+                {
+                    result.Request = *it;
+                    result.Pixels.resize(TilePixelCount(result.Request));
+                    succeeded = ReceiveAll(connection.Socket, result.Pixels.data(), result.Pixels.size() * sizeof(CompactSpectrum));
+                }
+
+                if (!succeeded)
+                {
+                    DropConnection(connection);
+                    continue;
+                }
+
+                connection.InFlight.erase(it);
+                connection.LastResponse = now;
+                mTotalPixelSamples += result.Pixels.size() * result.Request.SamplesPerPixel;
+
+                std::lock_guard<std::mutex> lock(mMutex);
+                if (result.Request.CameraVersion == mCamera.CameraVersion)
+                {
+                    mResults.push_back(std::move(result));
+                }
+            }
+            else if (!connection.InFlight.empty() && now - connection.LastResponse > WorkerTimeout)
+            {
+                DropConnection(connection);
+            }
+        }
+
+        mConnections.erase(std::remove_if(mConnections.begin(), mConnections.end(),
+            [](const Connection& connection) { return connection.Socket == INVALID_SOCKET; }),
+            mConnections.end());
+
+        //keep every worker busy, a worker gets a new tile as soon as it returns one.
+        for (Connection& connection : mConnections)
+        {
+            TileRequest request;
+            while (static_cast<int>(connection.InFlight.size()) < MaxTilesInFlight && NextRequest(request))
+            {
+                if (!SendAll(connection.Socket, &request, sizeof(TileRequest)))
+                {
+                    DropConnection(connection);
+                    break;
+                }
+                connection.InFlight.push_back(request);
+            }
+        }
+
+        mConnections.erase(std::remove_if(mConnections.begin(), mConnections.end(),
+            [](const Connection& connection) { return connection.Socket == INVALID_SOCKET; }),
+            mConnections.end());
+
+        ReportScaling();
+    }
+
+    for (Connection& connection : mConnections)
+    {
+        ::closesocket(connection.Socket);
+    }
+    mConnections.clear();
+}
+
+TileWorkerConnection::~TileWorkerConnection()
+{
+    if (mSocket != INVALID_SOCKET)
+    {
+        ::closesocket(mSocket);
+    }
+
+    if (mStarted)
+    {
+        ::WSACleanup();
+    }
+}
+
+bool TileWorkerConnection::Connect(const char* host, uint16_t port)
+{
+    WSADATA wsaData;
+    mStarted = ::WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+    if (!mStarted)
+    {
+        return false;
+    }
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (::inet_pton(AF_INET, host, &address.sin_addr) != 1)
+    {
+        return false;
+    }
+
+    SOCKET socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (socket == INVALID_SOCKET)
+    {
+        return false;
+    }
+
+    if (::connect(socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR)
+    {
+        ::closesocket(socket);
+        return false;
+    }
+
+    BOOL noDelay = TRUE;
+    ::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+    mSocket = socket;
+    return true;
+}
+
+bool TileWorkerConnection::Receive(TileRequest& request)
+{
+    return ReceiveAll(mSocket, &request, sizeof(TileRequest))
+        && request.Magic == TileRequest::RequestMagic;
+}
+
+bool TileWorkerConnection::Send(const TileRequest& request, const std::vector<CompactSpectrum>& pixels)
+{
+    return SendAll(mSocket, &request, sizeof(TileRequest))
+        && SendAll(mSocket, pixels.data(), pixels.size() * sizeof(CompactSpectrum));
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "PreInclude.h"
+#include "LDRFilm.h"
+
+/**
+* wire format between coordinator and tile workers,
+* both ends are the same executable, so plain structs are sent as they are.
+*/
+struct TileRequest
+{
+    static const uint32_t RequestMagic = 0x51524C54; // "TLRQ"
+
+    uint32_t Magic = RequestMagic;
+    int32_t TileIndex = 0;
+    int32_t Pass = 0;
+    uint32_t CameraVersion = 0;
+    int32_t RowStart = 0;
+    int32_t RowEnd = 0;
+    int32_t ColStart = 0;
+    int32_t ColEnd = 0;
+    int32_t SamplesPerPixel = 1;
+    Float CameraPosition[3] = { 0 };
+    Float CameraForward[3] = { 0 };
+    Float CameraUp[3] = { 0 };
+};
+
+//accumulated samples of a pixel, narrowed to float for transfer.
+struct CompactSpectrum
+{
+    float Value[3];
+    float LuminanceSquare;
+    uint32_t Count;
+};
+
+struct TileResult
+{
+    TileRequest Request;
+    std::vector<CompactSpectrum> Pixels;
+};
+
+/**
+* hands tiles to worker processes one by one and gathers their samples,
+* fast workers simply ask for more tiles, tiles of a lost worker are handed out again.
+* all sockets are served by one network thread.
+*/
+class TileCoordinator
+{
+public:
+    static const int TileSize = 64;
+    static const int SamplesPerPixel = 4;
+    static const int MaxTilesInFlight = 2;
+
+    TileCoordinator(int width, int height);
+    ~TileCoordinator();
+
+    //listens on loopback, unless an address to bind is given.
+    bool Start(uint16_t port, const char* bindAddress = nullptr);
+    bool SpawnLocalWorker();
+    void SetCamera(const Point& position, const Direction& forward, const Direction& up);
+
+    //only tiles overlapping the crop window are handed out, empty window for whole canvas.
+    void SetCropWindow(const FilmRegion& cropWindow);
+
+    //merge finished tiles into film, must be called while no sample task is running.
+    void MergeResults(LDRFilm& film, unsigned char* canvasDataPtr, int linePitch, bool bFlush);
+
+private:
+    struct Connection
+    {
+        uintptr_t Socket = ~uintptr_t(0);
+        std::vector<TileRequest> InFlight;
+        std::chrono::steady_clock::time_point LastResponse;
+    };
+
+    void NetworkRoute();
+    bool NextRequest(TileRequest& request);
+    bool IsTileCropped(int tileIndex) const;
+    void DropConnection(Connection& connection);
+    void ReportScaling();
+
+    const int mCanvasWidth;
+    const int mCanvasHeight;
+    const int mNumTileX;
+    const int mNumTileY;
+    uint16_t mPort = 0;
+    uintptr_t mListenSocket = ~uintptr_t(0);
+    std::thread mNetworkThread;
+    std::atomic<bool> mQuit = false;
+
+    std::mutex mMutex;
+    TileRequest mCamera;
+    std::deque<int> mPendingTiles;
+    FilmRegion mCropWindow;
+    int mPass = 0;
+    std::vector<TileResult> mResults;
+
+    std::vector<Connection> mConnections;
+    std::vector<void*> mWorkerProcesses;
+    std::chrono::steady_clock::time_point mReportTime;
+    uint64_t mTotalPixelSamples = 0;
+    uint64_t mReportPixelSamples = 0;
+    Float mSingleWorkerThroughput = Float(0);
+};
+
+/**
+* worker side of the connection, blocking calls only.
+*/
+class TileWorkerConnection
+{
+public:
+    ~TileWorkerConnection();
+    bool Connect(const char* host, uint16_t port);
+    bool Receive(TileRequest& request);
+    bool Send(const TileRequest& request, const std::vector<CompactSpectrum>& pixels);
+
+private:
+    uintptr_t mSocket = ~uintptr_t(0);
+    bool mStarted = false;
+};
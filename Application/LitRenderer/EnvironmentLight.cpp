@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cmath>
+#include <Foundation/Math/PredefinedConstantValues.h>
+#include "EnvironmentLight.h"
+#include "Material.h"
+#include "Texture.h"
+
+namespace
+{
+    const int RowBlockSize = 32;
+}
+
+void Distribution2D::Build(const std::vector<Float>& weights, int width, int height)
+{
+    mWidth = width;
+    mHeight = height;
+    mWeights = weights;
+    mConditionalCdf.resize((width + 1) * height);
+    mRowIntegral.resize(height);
+    mMarginalCdf.resize(height + 1);
+
+    //rows are independent, prefix sums of row-blocks run on workers.
+    std::vector<Task> RowBlockTasks;
+    for (int RowStart = 0; RowStart < height; RowStart += RowBlockSize)
+    {
+        const int RowEnd = math::min2(RowStart + RowBlockSize, height);
+        Task RowBlockTask = Task::Start(ThreadName::Worker, [this, RowStart, RowEnd](auto)
+            {
+                for (int RowIndex = RowStart; RowIndex < RowEnd; RowIndex++)
+                {
+                    const Float* RowWeights = &mWeights[RowIndex * mWidth];
+                    Float* Cdf = &mConditionalCdf[RowIndex * (mWidth + 1)];
+                    Cdf[0] = Float(0);
+                    for (int ColIndex = 0; ColIndex < mWidth; ColIndex++)
+                    {
+                        Cdf[ColIndex + 1] = Cdf[ColIndex] + RowWeights[ColIndex] / mWidth;
+                    }
+
+                    const Float Integral = Cdf[mWidth];
+                    mRowIntegral[RowIndex] = Integral;
+                    for (int ColIndex = 1; ColIndex <= mWidth; ColIndex++)
+                    {
+                        Cdf[ColIndex] = (Integral > Float(0)) ? Cdf[ColIndex] / Integral : Float(ColIndex) / mWidth;
+                    }
+                }
+            });
+        RowBlockTasks.push_back(RowBlockTask);
+    }
+
+    for (auto& Task : RowBlockTasks)
+    {
+        Task.SpinWait();
+    }
+
+    mMarginalCdf[0] = Float(0);
+    for (int RowIndex = 0; RowIndex < height; RowIndex++)
+    {
+        mMarginalCdf[RowIndex + 1] = mMarginalCdf[RowIndex] + mRowIntegral[RowIndex] / height;
+    }
+
+    mIntegral = mMarginalCdf[height];
+    for (int RowIndex = 1; RowIndex <= height; RowIndex++)
+    {
+        mMarginalCdf[RowIndex] = (mIntegral > Float(0)) ? mMarginalCdf[RowIndex] / mIntegral : Float(RowIndex) / height;
+    }
+}
+
+int Distribution2D::SampleCdf(const Float* cdf, int count, Float u)
+{
+    //last segment whose start is not greater than u.
+    const Float* it = std::upper_bound(cdf, cdf + count + 1, u);
+    return math::clamp(static_cast<int>(it - cdf) - 1, 0, count - 1);
+}
+
+math::vector2<Float> Distribution2D::Sample(Float u1, Float u2, Float& pdf) const
+{
+    const int RowIndex = SampleCdf(mMarginalCdf.data(), mHeight, u2);
+    const Float* Cdf = &mConditionalCdf[RowIndex * (mWidth + 1)];
+    const int ColIndex = SampleCdf(Cdf, mWidth, u1);
+
+    const Float RowSpan = mMarginalCdf[RowIndex + 1] - mMarginalCdf[RowIndex];
+    const Float ColSpan = Cdf[ColIndex + 1] - Cdf[ColIndex];
+    const Float dv = (RowSpan > Float(0)) ? (u2 - mMarginalCdf[RowIndex]) / RowSpan : Float(0.5);
+    const Float du = (ColSpan > Float(0)) ? (u1 - Cdf[ColIndex]) / ColSpan : Float(0.5);
+
+    pdf = mWeights[RowIndex * mWidth + ColIndex] / mIntegral;
+    return math::vector2<Float>((ColIndex + du) / mWidth, (RowIndex + dv) / mHeight);
+}
+
+Float Distribution2D::Pdf(Float u, Float v) const
+{
+    const int ColIndex = math::clamp(math::floor2<int>(u * mWidth), 0, mWidth - 1);
+    const int RowIndex = math::clamp(math::floor2<int>(v * mHeight), 0, mHeight - 1);
+    return mWeights[RowIndex * mWidth + ColIndex] / mIntegral;
+}
+
+bool EnvironmentLight::LoadFromFile(const std::string& path)
+{
+    std::vector<Spectrum> pixels;
+    int width = 0, height = 0;
+    if (!LoadPortableFloatMap(path, pixels, width, height))
+    {
+        return false;
+    }
+
+    Initialize(std::move(pixels), width, height);
+    return true;
+}
+
+void EnvironmentLight::Initialize(std::vector<Spectrum>&& pixels, int width, int height)
+{
+    mWidth = width;
+    mHeight = height;
+    mPixels = std::move(pixels);
+
+    //equirectangular rows are squeezed near the poles, weight by sin(theta).
+    std::vector<Float> weights(width * height);
+    for (int RowIndex = 0; RowIndex < height; RowIndex++)
+    {
+        const Float SinTheta = std::sin(math::PI<Float> * (RowIndex + Float(0.5)) / height);
+        for (int ColIndex = 0; ColIndex < width; ColIndex++)
+        {
+            const int PixelIndex = RowIndex * width + ColIndex;
+            weights[PixelIndex] = math::max2(Float(0), Luminance(mPixels[PixelIndex])) * SinTheta;
+        }
+    }
+    mDistribution.Build(weights, width, height);
+}
+
+math::vector2<Float> EnvironmentLight::DirectionToUV(const Direction& direction) const
+{
+    const Float theta = std::acos(math::clamp(direction.y, Float(-1), Float(1)));
+    Float phi = std::atan2(direction.z, direction.x);
+    if (phi < Float(0))
+    {
+        phi += math::TWO_PI<Float>;
+    }
+    return math::vector2<Float>(phi / math::TWO_PI<Float>, theta / math::PI<Float>);
+}
+
+Spectrum EnvironmentLight::Le(const Direction& direction) const
+{
+    if (mPixels.empty())
+    {
+        return Spectrum::zero();
+    }
+
+    const math::vector2<Float> uv = DirectionToUV(direction);
+    const int ColIndex = math::clamp(math::floor2<int>(uv.x * mWidth), 0, mWidth - 1);
+    const int RowIndex = math::clamp(math::floor2<int>(uv.y * mHeight), 0, mHeight - 1);
+    return Intensity * mPixels[RowIndex * mWidth + ColIndex];
+}
+
+Direction EnvironmentLight::Sample(Float u1, Float u2, Float& pdf) const
+{
+    pdf = Float(0);
+    if (!mDistribution.IsValid())
+    {
+        return Direction::unit_y();
+    }
+
+    Float pdfUV;
+    const math::vector2<Float> uv = mDistribution.Sample(u1, u2, pdfUV);
+    const Float theta = uv.y * math::PI<Float>;
+    const Radian phi(uv.x * math::TWO_PI<Float>);
+    const Float sinTheta = std::sin(theta);
+    if (sinTheta <= Float(0))
+    {
+        return Direction::unit_y();
+    }
+
+    //pdf(w) = pdf(u,v) / (2 * Pi^2 * sin(theta))
+    pdf = pdfUV / (Float(2) * math::square(math::PI<Float>) * sinTheta);
+    return Direction(sinTheta * math::cos(phi), std::cos(theta), sinTheta * math::sin(phi));
+}
+
+Float EnvironmentLight::Pdf(const Direction& direction) const
+{
+    if (!mDistribution.IsValid())
+    {
+        return Float(0);
+    }
+
+    const Float sinTheta = sqrt(math::max2(Float(0), Float(1) - math::square(direction.y)));
+    if (sinTheta <= Float(0))
+    {
+        return Float(0);
+    }
+
+    const math::vector2<Float> uv = DirectionToUV(direction);
+    return mDistribution.Pdf(uv.x, uv.y) / (Float(2) * math::square(math::PI<Float>) * sinTheta);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "PreInclude.h"
+
+/**
+* piecewise-constant distribution over [0,1)^2,
+* conditional cdf of every row is built on workers, then the marginal cdf of rows.
+*/
+class Distribution2D
+{
+public:
+    void Build(const std::vector<Float>& weights, int width, int height);
+    bool IsValid() const { return mIntegral > Float(0); }
+
+    //returns continuous (u, v), pdf is with respect to the unit square.
+    math::vector2<Float> Sample(Float u1, Float u2, Float& pdf) const;
+    Float Pdf(Float u, Float v) const;
+
+private:
+    static int SampleCdf(const Float* cdf, int count, Float u);
+
+    int mWidth = 0;
+    int mHeight = 0;
+    Float mIntegral = Float(0);
+    std::vector<Float> mWeights;
+    std::vector<Float> mConditionalCdf;     // (width + 1) per row
+    std::vector<Float> mRowIntegral;
+    std::vector<Float> mMarginalCdf;        // height + 1
+};
+
+/**
+* hdr environment lighting from an equirectangular float image,
+* +y is the zenith, importance sampled by luminance * sin(theta).
+*/
+class EnvironmentLight
+{
+public:
+    // portable float map (.pfm), rgb only.
+    bool LoadFromFile(const std::string& path);
+    void Initialize(std::vector<Spectrum>&& pixels, int width, int height);
+
+    Spectrum Le(const Direction& direction) const;
+    Direction Sample(Float u1, Float u2, Float& pdf) const;
+    Float Pdf(const Direction& direction) const;
+
+    Float Intensity = Float(1);
+
+private:
+    math::vector2<Float> DirectionToUV(const Direction& direction) const;
+
+    int mWidth = 0;
+    int mHeight = 0;
+    std::vector<Spectrum> mPixels;
+    Distribution2D mDistribution;
+};
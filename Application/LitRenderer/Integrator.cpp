@@ -1,11 +1,61 @@
 #include <assert.h>
 #include "Integrator.h"
+#include "PathGuide.h"
+#include "RenderStatistics.h"
+
+namespace
+{
+    bool HasMirrorLobe(const Material& material)
+    {
+        for (uint32_t index = 0; index < material.GetLobeCount(); index++)
+        {
+            if ((material.GetLobeByIndex(index).BSDFMask & BSDFMask::MirrorMask) != 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //spread of a ray cone after one bounce off the lobe.
+    Float LobeSpread(const BSDFLobe& lobe)
+    {
+        return ((lobe.BSDFMask & BSDFMask::DiffuseMask) != 0) ? Float(1) : lobe.Roughness;
+    }
+
+    //a guided direction did not come from any one lobe, so it spreads as much as the widest of them.
+    Float WidestLobeSpread(const Material& material)
+    {
+        Float spread = Float(0);
+        for (uint32_t index = 0; index < material.GetLobeCount(); index++)
+        {
+            spread = math::max2(spread, LobeSpread(material.GetLobeByIndex(index)));
+        }
+        return spread;
+    }
+}
+
+void PathIntegrator::Seed(uint64_t seed, uint32_t sequence)
+{
+    uint32_t stream = sequence << 8;
+    TerminateSampler.seed(seed, stream++);
+    for (stream_random<Float>& sampler : mUniformSamplers)
+    {
+        sampler.seed(seed, stream++);
+    }
+    for (stream_random<Float>& sampler : mGuidingSamplers)
+    {
+        sampler.seed(seed, stream++);
+    }
+}
 
 Spectrum PathIntegrator::EvaluateLi(Scene& scene, const Ray& cameraRay, const SurfaceIntersection& recordP1)
 {
+    RENDER_STAT_INCREMENT(Paths);
     if (!recordP1)
     {
-        const Spectrum BackgroundColor = Spectrum::zero();
+        const EnvironmentLight* environmentLight = scene.GetEnvironmentLight();
+        const Spectrum BackgroundColor = (environmentLight != nullptr) ? environmentLight->Le(cameraRay.direction()) : Spectrum::zero();
         return BackgroundColor;
     }
 
@@ -26,6 +76,11 @@ Spectrum PathIntegrator::EvaluateLi(Scene& scene, const Ray& cameraRay, const Su
     // First hit, on P1
     SurfaceIntersection hitRecord = recordP1;
 
+    //ray cone stands in for ray differentials: its width grows with distance,
+    // and every bounce widens its spread by the roughness of the sampled lobe.
+    Float coneWidth = Float(0);
+    Float coneSpread = mPixelSpreadAngle;
+
     struct MISRecord
     {
         bool IsValid(LightSource* light) const
@@ -40,12 +95,25 @@ Spectrum PathIntegrator::EvaluateLi(Scene& scene, const Ray& cameraRay, const Su
         }
 
         Float Weight_BSDF = Float(0);
+        Float Pdf_BSDF = Float(0);
         LightSource* Light = nullptr;
         bool IsMirrorReflection = false;
     } lastMISRecord;
 
+    //path vertices waiting for the incident radiance of their sampled direction.
+    struct GuidingVertex
+    {
+        Point Position;
+        Direction Wi;
+        Spectrum Beta;
+        Spectrum Lo;
+        Float Pdf;
+    } guidingVertices[MaxBounces];
+    unsigned int numGuidingVertices = 0;
+
     for (int bounce = 0; hitRecord && bounce < MaxBounces && !math::near_zero(beta); ++bounce)
     {
+        RENDER_STAT_INCREMENT(PathVertices);
         const SceneObject& surface = *hitRecord.Object;
         if (surface.LightSource != nullptr)
         {
@@ -76,27 +144,76 @@ Spectrum PathIntegrator::EvaluateLi(Scene& scene, const Ray& cameraRay, const Su
 
         //Multiple Importance Sampling
         {
-            const std::unique_ptr<Material>& material = surface.Material;
-            const BSDF& bsdf = *material->GetRandomBSDFComponent(u[0]);
             const Float biasedDistance = math::max2<Float>(hitRecord.Distance, Float(0));
             const Point Pi = viewRay.calc_offset(biasedDistance);
+            coneWidth += coneSpread * biasedDistance;
+
+            const Material* material = surface.Material.get();
+            Material texturedMaterial;
+            if (material->HasAlbedoTexture())
+            {
+                //footprint is stretched on grazing angles.
+                const Float cosine = math::max2(std::abs(math::dot(N, viewRay.direction())), Float(0.1));
+                texturedMaterial = material->ModulateAlbedo(scene.SampleTexture(material->GetAlbedoTexture(), surface, Pi, coneWidth / cosine, mPreview));
+                material = &texturedMaterial;
+            }
+
+            const BSDFLobe& lobe = material->GetRandomLobe(u[0]);
             const Direction Wo = uvw.world_2_local(-viewRay.direction());
 
-            lastMISRecord.IsMirrorReflection = (bsdf.BSDFMask& BSDFMask::MirrorMask) != 0;
+            lastMISRecord.IsMirrorReflection = (lobe.BSDFMask& BSDFMask::MirrorMask) != 0;
             lastMISRecord.Light = nullptr;
 
+            //one-sample MIS between bsdf and the learned distribution,
+            // guided pdf is mixed into every bsdf pdf at this vertex.
+            const bool bGuiding = mPathGuide != nullptr && !HasMirrorLobe(*material) && mPathGuide->IsTrained(Pi);
+            const Float guidingProbability = bGuiding ? mPathGuide->GuidingProbability : Float(0);
+            auto MixGuidingPdf = [&](const Direction& worldWi, Float pdf_bsdf)
+            {
+                return bGuiding
+                    ? math::lerp(pdf_bsdf, mPathGuide->Pdf(Pi, N, worldWi), guidingProbability)
+                    : pdf_bsdf;
+            };
+
             //Sampling Direct Illumination
             if (!lastMISRecord.IsMirrorReflection)
             {
                 SceneObject* lightSource = scene.UniformSampleLightSource(u[0]);
-                if (lightSource != nullptr && lightSource != hitRecord.Object)
+                const EnvironmentLight* environmentLight = scene.GetEnvironmentLight();
+                if (lightSource == nullptr && environmentLight != nullptr)
                 {
-                    const Point Pi_1 = lightSource->SampleRandomPoint(u);
+                    RENDER_STAT_INCREMENT(LightSamples);
+                    Float pdf_environment;
+                    const Direction worldWi = environmentLight->Sample(u[1], u[2], pdf_environment);
+                    const Direction Wi = uvw.world_2_local(worldWi);
+                    const Float NdotL = CosTheta(Wi);
+                    if (pdf_environment > Float(0) && NdotL > Float(0))
+                    {
+                        //visible only if nothing blocks the whole ray.
+                        const Ray lightRay(Pi, worldWi);
+                        if (!scene.DetectIntersecting(lightRay, nullptr, math::SMALL_NUM<Float>))
+                        {
+                            RENDER_STAT_INCREMENT(LightSampleHits);
+                            const Float pdf_light = scene.SampleEnvironmentPdf(worldWi);
+                            Spectrum f; Float pdf_bsdf;
+                            material->Evaluate(Wo, Wi, f, pdf_bsdf);
+                            pdf_bsdf = MixGuidingPdf(worldWi, pdf_bsdf);
+                            const Float weight_mis = PowerHeuristic(pdf_light, pdf_bsdf);
+                            const Spectrum Le = environmentLight->Le(worldWi);
+                            Lo += (weight_mis * NdotL / pdf_light) * (beta * f * Le);
+                        }
+                    }
+                }
+                else if (lightSource != nullptr && lightSource != hitRecord.Object)
+                {
+                    RENDER_STAT_INCREMENT(LightSamples);
+                    const Point Pi_1 = lightSource->SampleRandomPoint(Pi, u);
                     const Ray lightRay(Pi, Pi_1);
 
                     SurfaceIntersection recordPi_1 = scene.DetectIntersecting(lightRay, nullptr, math::SMALL_NUM<Float>);
                     if (recordPi_1.Object == lightSource)
                     {
+                        RENDER_STAT_INCREMENT(LightSampleHits);
                         const Direction& N_light = recordPi_1.SurfaceNormal;
                         const Direction& Wi = uvw.world_2_local(lightRay.direction());
                         const Direction Wi_light = -lightRay.direction();
@@ -107,9 +224,10 @@ Spectrum PathIntegrator::EvaluateLi(Scene& scene, const Ray& cameraRay, const Su
                         {
                             const Float pdf_light = scene.SampleLightPdf(lightRay);
                             assert(pdf_light > Float(0));
-                            const Float pdf_bsdf = material->SamplePdf(Wo, Wi);
+                            Spectrum f; Float pdf_bsdf;
+                            material->Evaluate(Wo, Wi, f, pdf_bsdf);
+                            pdf_bsdf = MixGuidingPdf(lightRay.direction(), pdf_bsdf);
                             const Float weight_mis = PowerHeuristic(pdf_light, pdf_bsdf);
-                            const Spectrum f = material->SampleF(Wo, Wi);
                             const Spectrum& Le = lightSource->LightSource->Le();
                             //                      f * cos(Wi)
                             // beta * mis_weight * -------------
@@ -121,9 +239,13 @@ Spectrum PathIntegrator::EvaluateLi(Scene& scene, const Ray& cameraRay, const Su
                 }
             }
 
-            //Sampling BSDF
+            //Sampling BSDF, or the guiding distribution,
+            // guided directions always lie above the surface so they never end the path.
             {
-                const Direction Wi = bsdf.SampleWi(u, Wo);
+                const bool bGuidedSample = bGuiding && mGuidingSamplers[0].value() < guidingProbability;
+                const Direction Wi = bGuidedSample
+                    ? uvw.world_2_local(mPathGuide->Sample(Pi, N, mGuidingSamplers[1].value(), mGuidingSamplers[2].value(), mGuidingSamplers[3].value()))
+                    : lobe.SampleWi(u, Wo);
                 const Float NdotL = CosTheta(Wi);
                 if (NdotL <= Float(0))
                 {
@@ -134,10 +256,23 @@ Spectrum PathIntegrator::EvaluateLi(Scene& scene, const Ray& cameraRay, const Su
                 viewRay.set_direction(uvw.local_2_world(Wi));
 
                 const Float pdf_light = scene.SampleLightPdf(viewRay);
-                const Float pdf_bsdf = material->SamplePdf(Wo, Wi);
+                Spectrum f; Float pdf_bsdf;
+                material->Evaluate(Wo, Wi, f, pdf_bsdf);
+                pdf_bsdf = MixGuidingPdf(viewRay.direction(), pdf_bsdf);
+                if (pdf_bsdf <= Float(0))
+                {
+                    break;
+                }
+
                 lastMISRecord.Weight_BSDF = (lastMISRecord.IsMirrorReflection) ? Float(1) : PowerHeuristic(pdf_bsdf, pdf_light);
-                const Spectrum f = material->SampleF(Wo, Wi);
+                coneSpread += bGuidedSample ? WidestLobeSpread(*material) : LobeSpread(lobe);
+                lastMISRecord.Pdf_BSDF = pdf_bsdf;
                 beta *= (NdotL / pdf_bsdf) * f;
+
+                if (mPathGuide != nullptr)
+                {
+                    guidingVertices[numGuidingVertices++] = { Pi, viewRay.direction(), beta, Lo, pdf_bsdf };
+                }
             }
         }
 
@@ -147,6 +282,7 @@ Spectrum PathIntegrator::EvaluateLi(Scene& scene, const Ray& cameraRay, const Su
             rrContinueProbability *= 0.95f;
             if (CheckRussiaRoulette(rrContinueProbability))
             {
+                RENDER_STAT_INCREMENT(RussianRouletteTerminations);
                 break;
             }
             beta /= rrContinueProbability;
@@ -154,6 +290,32 @@ Spectrum PathIntegrator::EvaluateLi(Scene& scene, const Ray& cameraRay, const Su
 
         // Find next path ends with Pi+1
         hitRecord = scene.DetectIntersecting(viewRay, nullptr, math::SMALL_NUM<Float>);
+
+        // Escaped, the environment is hit.
+        if (!hitRecord)
+        {
+            const EnvironmentLight* environmentLight = scene.GetEnvironmentLight();
+            if (environmentLight != nullptr)
+            {
+                const Float weight_mis = (lastMISRecord.IsMirrorReflection)
+                    ? Float(1)
+                    : PowerHeuristic(lastMISRecord.Pdf_BSDF, scene.SampleEnvironmentPdf(viewRay.direction()));
+                Lo += weight_mis * beta * environmentLight->Le(viewRay.direction());
+            }
+        }
+    }
+
+    //Training: radiance gathered after a vertex, divided by its throughput,
+    // is the incident radiance along its sampled direction.
+    for (unsigned int index = 0; index < numGuidingVertices; index++)
+    {
+        const GuidingVertex& vertex = guidingVertices[index];
+        const Float betaLuminance = Luminance(vertex.Beta);
+        if (betaLuminance > Float(0))
+        {
+            const Float Li = Luminance(Lo - vertex.Lo) / betaLuminance;
+            mPathGuide->Splat(vertex.Position, vertex.Wi, Li / vertex.Pdf);
+        }
     }
 
     return Lo;
@@ -194,10 +356,10 @@ Spectrum DebugIntegrator::EvaluateLi(Scene& scene, const Ray& cameraRay, const S
         {
             const Float biasedDistance = math::max2<Float>(hitRecord.Distance, Float(0));
             const Point P_i = viewRay.calc_offset(biasedDistance);
-            const BSDF& bsdf = *material->GetRandomBSDFComponent(u[0]);
+            const BSDFLobe& lobe = material->GetRandomLobe(u[0]);
             const Direction Wo = uvw.world_2_local(-viewRay.direction());
 
-            const Direction Wi = bsdf.SampleWi(u, Wo);
+            const Direction Wi = lobe.SampleWi(u, Wo);
             const Float NdotL = math::dot(N, Wi);
 
             return Spectrum(-NdotL);
@@ -253,15 +415,15 @@ Spectrum MISDebugIntegrator::EvaluateLi(Scene& scene, const Ray& cameraRay, cons
             const Direction Wo = uvw.world_2_local(-viewRay.direction());
 
             const std::unique_ptr<Material>& material = surface.Material;
-            const BSDF& bsdf = *material->GetRandomBSDFComponent(u[0]);
-            const bool bIsMirrorReflection = (bsdf.BSDFMask & BSDFMask::MirrorMask) != 0;
+            const BSDFLobe& lobe = material->GetRandomLobe(u[0]);
+            const bool bIsMirrorReflection = (lobe.BSDFMask & BSDFMask::MirrorMask) != 0;
 
             if (!bIsMirrorReflection)
             {
                 SceneObject* lightSource = scene.UniformSampleLightSource(u[0]);
                 if (lightSource != nullptr)
                 {
-                    Point P_i_1 = lightSource->SampleRandomPoint(u);
+                    Point P_i_1 = lightSource->SampleRandomPoint(P_i, u);
                     Ray lightRay(P_i, P_i_1);
                     const Direction Wi_light = -lightRay.direction();
                     const Direction Wi = uvw.world_2_local(lightRay.direction());
@@ -287,7 +449,7 @@ Spectrum MISDebugIntegrator::EvaluateLi(Scene& scene, const Ray& cameraRay, cons
             }
 
             {
-                const Direction Wi = bsdf.SampleWi(u, Wo);
+                const Direction Wi = lobe.SampleWi(u, Wo);
                 const Float NdotL = math::dot(N, Wi);
                 if (NdotL > Float(0))
                 {
@@ -2,18 +2,35 @@
 #include "PreInclude.h"
 #include "LitRenderer.h"
 
+class PathGuide;
+
 
 struct Integrator
 {
     virtual ~Integrator() { };
+    virtual void Seed(uint64_t seed, uint32_t sequence = 0) { }
     virtual Spectrum EvaluateLi(Scene& scene, const Ray& cameraRay, const SurfaceIntersection& recordP1) = 0;
+
+    //angle between camera rays of neighbouring pixels, texture footprints grow with it.
+    void SetPixelSpreadAngle(Float angle) { mPixelSpreadAngle = angle; }
+
+    //previews do not wait for texture tiles, their results are thrown away.
+    void SetPreview(bool preview) { mPreview = preview; }
+
+protected:
+    Float mPixelSpreadAngle = Float(0);
+    bool mPreview = false;
 };
 
 class PathIntegrator : public Integrator
 {
-    random<Float> TerminateSampler;
-    random<Float> mUniformSamplers[3];
+    stream_random<Float> TerminateSampler;
+    stream_random<Float> mUniformSamplers[3];
+    stream_random<Float> mGuidingSamplers[4];
+    PathGuide* mPathGuide = nullptr;
 public:
+    PathIntegrator(PathGuide* pathGuide = nullptr) : mPathGuide(pathGuide) { }
+    virtual void Seed(uint64_t seed, uint32_t sequence = 0) override;
     virtual Spectrum EvaluateLi(Scene& scene, const Ray& cameraRay, const SurfaceIntersection& recordP1) override;
 };
 
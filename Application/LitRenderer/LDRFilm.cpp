@@ -1,6 +1,9 @@
 #include "LDRFilm.h"
+#include <cmath>
 #include <Foundation/Base/MemoryHelper.h>
+#include <Foundation/Math/FastMath.h>
 
+//fast_pow is 3.1e-5 of an 8-bit step away from pow over [0, 1.25], see srgb_encode_fast_pow of MathBenchmark.
 template<typename value_type>
 value_type LinearToGamma22Corrected(value_type value)
 {
@@ -18,11 +21,11 @@ value_type LinearToGamma22Corrected(value_type value)
     }
     else if (value < value_type(1.0))
     {
-        return value_type(1.055) * pow(value, Inv2_4) - value_type(0.055);
+        return value_type(1.055) * math::fast_pow(value, Inv2_4) - value_type(0.055);
     }
     else
     {
-        return pow(value, InvDisplayGamma);
+        return math::fast_pow(value, InvDisplayGamma);
     }
 }
 
@@ -49,6 +52,8 @@ void LDRFilm::Clear()
         {
             int pixelIndex = colIndex + rowIndex * CanvasWidth;
             mBackbuffer[pixelIndex].Value.set(Float(0.0), Float(0.0), Float(0.0));
+            mBackbuffer[pixelIndex].LuminanceSquare = Float(0.0);
+            mBackbuffer[pixelIndex].Weight = Float(0.0);
             mBackbuffer[pixelIndex].Count = 0;
         }
     }
@@ -57,10 +62,141 @@ void LDRFilm::Clear()
 void LDRFilm::FlushTo(const AccumulatedSpectrum& Spectrum, uint32_t Row, uint32_t Column, unsigned char* CanvasDataPtr, int linePitch)
 {
     uint32_t CanvasOffset = Row * linePitch + Column * 3;
-    Float InvNumSample = Float(1) / Spectrum.Count;
+    //negative lobes of a filter may leave no positive weight.
+    Float InvNumSample = Spectrum.Weight > Float(0) ? Float(1) / Spectrum.Weight : Float(0);
     for (int SpectrumComponentIndex = 2; SpectrumComponentIndex >= 0; SpectrumComponentIndex--)
     {
         Float sRGB = LinearToGamma22Corrected(Spectrum.Value[SpectrumComponentIndex] * InvNumSample);
         CanvasDataPtr[CanvasOffset++] = math::floor2<unsigned char>(math::saturate(sRGB) * Float(256.0) - Float(0.0001));
     }
 }
+
+namespace
+{
+    Float Gaussian(Float x, Float alpha)
+    {
+        return std::exp(-alpha * x * x);
+    }
+
+    //B = C = 1/3, as recommended by Mitchell and Netravali.
+    Float Mitchell(Float x)
+    {
+        const Float B = Float(1) / Float(3);
+        const Float C = Float(1) / Float(3);
+        x = std::abs(x);
+        if (x < Float(1))
+        {
+            return ((12 - 9 * B - 6 * C) * x * x * x + (-18 + 12 * B + 6 * C) * x * x + (6 - 2 * B)) / Float(6);
+        }
+        else if (x < Float(2))
+        {
+            return ((-B - 6 * C) * x * x * x + (6 * B + 30 * C) * x * x + (-12 * B - 48 * C) * x + (8 * B + 24 * C)) / Float(6);
+        }
+        return Float(0);
+    }
+}
+
+ReconstructionFilter::ReconstructionFilter(FilterType type)
+    : mType(type)
+{
+    const Float GaussianAlpha = Float(2);
+    switch (mType)
+    {
+    case FilterType::Gaussian: mRadius = Float(1.5); break;
+    case FilterType::Mitchell: mRadius = Float(2); break;
+    default: mRadius = Float(0.5); break;
+    }
+    mInvRadius = Float(1) / mRadius;
+
+    for (int index = 0; index < TableSize; index++)
+    {
+        const Float x = (index + Float(0.5)) * mRadius / TableSize;
+        switch (mType)
+        {
+        case FilterType::Gaussian:
+            //shifted down, so the kernel reaches zero at radius.
+            mTable[index] = math::max2(Float(0), Gaussian(x, GaussianAlpha) - Gaussian(mRadius, GaussianAlpha));
+            break;
+        case FilterType::Mitchell:
+            mTable[index] = Mitchell(x);
+            break;
+        default:
+            mTable[index] = Float(1);
+            break;
+        }
+    }
+}
+
+Float ReconstructionFilter::Lookup(Float offset) const
+{
+    const int index = static_cast<int>(std::abs(offset) * mInvRadius * TableSize);
+    return index < TableSize ? mTable[index] : Float(0);
+}
+
+void FilmTile::Reset(const FilmRegion& tileRegion, int apron)
+{
+    mBounds.RowStart = tileRegion.RowStart - apron;
+    mBounds.RowEnd = tileRegion.RowEnd + apron;
+    mBounds.ColStart = tileRegion.ColStart - apron;
+    mBounds.ColEnd = tileRegion.ColEnd + apron;
+    mWidth = mBounds.ColEnd - mBounds.ColStart;
+    mPixels.assign(mWidth * (mBounds.RowEnd - mBounds.RowStart), AccumulatedSpectrum());
+}
+
+void FilmTile::AddSample(const ReconstructionFilter& filter, Float filmX, Float filmY, const Spectrum& L)
+{
+    //pixel centers are at half integers.
+    const Float Radius = filter.GetRadius();
+    const Float CenterX = filmX - Float(0.5);
+    const Float CenterY = filmY - Float(0.5);
+    const int ColStart = math::max2(static_cast<int>(std::ceil(CenterX - Radius)), mBounds.ColStart);
+    const int ColEnd = math::min2(static_cast<int>(std::floor(CenterX + Radius)) + 1, mBounds.ColEnd);
+    const int RowStart = math::max2(static_cast<int>(std::ceil(CenterY - Radius)), mBounds.RowStart);
+    const int RowEnd = math::min2(static_cast<int>(std::floor(CenterY + Radius)) + 1, mBounds.RowEnd);
+
+    const Float LuminanceSquare = math::square(Luminance(L));
+    for (int RowIndex = RowStart; RowIndex < RowEnd; RowIndex++)
+    {
+        AccumulatedSpectrum* RowPixels = mPixels.data() + (RowIndex - mBounds.RowStart) * mWidth;
+        for (int ColIndex = ColStart; ColIndex < ColEnd; ColIndex++)
+        {
+            const Float Weight = filter.Evaluate(ColIndex - CenterX, RowIndex - CenterY);
+            if (Weight != Float(0))
+            {
+                AccumulatedSpectrum& Pixel = RowPixels[ColIndex - mBounds.ColStart];
+                Pixel.Value += L * Weight;
+                Pixel.LuminanceSquare += LuminanceSquare * Weight;
+                Pixel.Weight += Weight;
+            }
+        }
+    }
+
+    const int SampleRow = static_cast<int>(std::floor(filmY));
+    const int SampleCol = static_cast<int>(std::floor(filmX));
+    if (mBounds.Overlaps(SampleRow, SampleRow + 1, SampleCol, SampleCol + 1))
+    {
+        mPixels[(SampleRow - mBounds.RowStart) * mWidth + SampleCol - mBounds.ColStart].Count += 1;
+    }
+}
+
+void FilmTile::MergeRows(AccumulatedSpectrum* filmPixels, int canvasWidth, int canvasHeight, int rowStart, int rowEnd) const
+{
+    rowStart = math::max2(math::max2(rowStart, mBounds.RowStart), 0);
+    rowEnd = math::min2(math::min2(rowEnd, mBounds.RowEnd), canvasHeight);
+    const int ColStart = math::max2(mBounds.ColStart, 0);
+    const int ColEnd = math::min2(mBounds.ColEnd, canvasWidth);
+    for (int RowIndex = rowStart; RowIndex < rowEnd; RowIndex++)
+    {
+        const AccumulatedSpectrum* SourcePixels = mPixels.data() + (RowIndex - mBounds.RowStart) * mWidth;
+        AccumulatedSpectrum* FilmRowPixels = filmPixels + RowIndex * canvasWidth;
+        for (int ColIndex = ColStart; ColIndex < ColEnd; ColIndex++)
+        {
+            const AccumulatedSpectrum& Source = SourcePixels[ColIndex - mBounds.ColStart];
+            AccumulatedSpectrum& Target = FilmRowPixels[ColIndex];
+            Target.Value += Source.Value;
+            Target.LuminanceSquare += Source.LuminanceSquare;
+            Target.Weight += Source.Weight;
+            Target.Count += Source.Count;
+        }
+    }
+}
@@ -1,13 +1,76 @@
 #pragma once
 
+#include <vector>
 #include <Foundation/Math/Vector.h>
 #include "Material.h"
 
+//value and luminance square are weighted sums, count is the number of samples taken inside the pixel.
 struct AccumulatedSpectrum
 {
     Spectrum Value = Spectrum::zero();
+    Float LuminanceSquare = Float(0);
+    Float Weight = Float(0);
     uint32_t Count = 0;
 };
+
+//pixel rectangle of film, [start, end), an empty region means nothing is selected.
+struct FilmRegion
+{
+    int RowStart = 0, RowEnd = 0;
+    int ColStart = 0, ColEnd = 0;
+
+    bool IsEmpty() const { return RowStart >= RowEnd || ColStart >= ColEnd; }
+    bool Overlaps(int rowStart, int rowEnd, int colStart, int colEnd) const
+    {
+        return rowStart < RowEnd && RowStart < rowEnd && colStart < ColEnd && ColStart < colEnd;
+    }
+};
+
+enum class FilterType { Box, Gaussian, Mitchell };
+
+/**
+* separable pixel reconstruction filter,
+* 1d kernel is tabulated over [0, radius] once, weight of a sample is the product of two lookups.
+*/
+class ReconstructionFilter
+{
+public:
+    static const int TableSize = 64;
+
+    ReconstructionFilter(FilterType type = FilterType::Box);
+    FilterType GetType() const { return mType; }
+    Float GetRadius() const { return mRadius; }
+    Float Evaluate(Float offsetX, Float offsetY) const { return Lookup(offsetX) * Lookup(offsetY); }
+
+private:
+    Float Lookup(Float offset) const;
+
+    FilterType mType;
+    Float mRadius;
+    Float mInvRadius;
+    Float mTable[TableSize];
+};
+
+/**
+* private accumulation buffer of a tile, extended by an apron of filter radius,
+* so samples near tile border can be splatted without touching other tiles.
+*/
+class FilmTile
+{
+public:
+    void Reset(const FilmRegion& tileRegion, int apron);
+    void AddSample(const ReconstructionFilter& filter, Float filmX, Float filmY, const Spectrum& L);
+
+    //add rows [rowStart, rowEnd) of the tile to film, parts out of canvas are dropped.
+    void MergeRows(AccumulatedSpectrum* filmPixels, int canvasWidth, int canvasHeight, int rowStart, int rowEnd) const;
+    const FilmRegion& GetBounds() const { return mBounds; }
+
+private:
+    FilmRegion mBounds;
+    int mWidth = 0;
+    std::vector<AccumulatedSpectrum> mPixels;
+};
+
 class LDRFilm
 {
 public:
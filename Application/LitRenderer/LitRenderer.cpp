@@ -1,4 +1,9 @@
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdio>
 #include <Foundation/Base/MemoryHelper.h>
 #include <Foundation/Math/PredefinedConstantValues.h>
 #include "LitRenderer.h"
@@ -8,6 +13,11 @@
 static const int BlockSize = 64;
 namespace
 {
+    const char* CheckpointPath = "LitRenderer.checkpoint";
+    const uint16_t TileCoordinatorPort = 27182;
+#ifdef ENABLE_RENDER_STATISTICS
+    const char* StatisticsPath = "RenderStatistics.jsonl";
+#endif
     const bool DEBUG = false;
     const bool DEBUGScene = DEBUG || false;
     class SimpleScene : public Scene
@@ -101,6 +111,14 @@ namespace
                 wallBottom->SetExtends(SceneExtendZ, SceneExtendX);
                 wallBottom->SetRotation(math::make_rotation_z_axis<Float>(90_degd));
                 wallBottom->Material = Material::CreateMatte(Green);
+
+                //optional image on floor, multiplied onto albedo.
+                const int FloorTexture = LoadTexture("Floor.pfm");
+                if (FloorTexture >= 0)
+                {
+                    wallBottom->Material = Material::CreateMatte(Gray);
+                    wallBottom->Material->SetAlbedoTexture(FloorTexture);
+                }
             }
 
             {
@@ -219,16 +237,20 @@ LitRenderer::LitRenderer(unsigned char* canvasDataPtr, int canvasWidth, int canv
     : mCanvasLinePitch(canvasLinePitch)
     , mSystemCanvasDataPtr(canvasDataPtr)
     , mFilm(canvasWidth, canvasHeight)
+    , mDenoiser(canvasWidth, canvasHeight)
     , mCamera(50_degd)
     , mScene(std::make_unique<SimpleScene>())
 {
     mCamera.Position.set(0, 0, -130);
     mScene->Create(Float(canvasWidth) / Float(canvasHeight));
+    mScene->LoadEnvironmentLight("Environment.pfm");
     mCameraRaySamples = new Sample[canvasWidth * canvasHeight];
 }
 
 LitRenderer::~LitRenderer()
 {
+    mCheckpointTask.SpinWait();
+    ReportTextureStatistics();
     SafeDeleteArray(mCameraRaySamples);
 }
 
@@ -237,10 +259,15 @@ void LitRenderer::InitialSceneTransforms()
     mScene->UpdateWorldTransform();
 }
 
-void LitRenderer::GenerateCameraRays()
+Float LitRenderer::GetPixelSpreadAngle() const
+{
+    //pixel height seen from camera, canvas is cameraZ away.
+    return Float(2) * mCamera.HalfVerticalFovTangent / mFilm.CanvasHeight;
+}
+
+Ray LitRenderer::MakeCameraRay(Float CanvasX, Float CanvasY) const
 {
     const Float PixelSize = Float(1);
-    const Float HalfPixelSize = PixelSize * Float(0.5);
     Float HalfWidth = mFilm.CanvasWidth * Float(0.5) * PixelSize;
     Float HalfHeight = mFilm.CanvasHeight * Float(0.5) * PixelSize;
     //     <---> (half height)
@@ -250,16 +277,23 @@ void LitRenderer::GenerateCameraRays()
     //  .  |/
     // (z) .      tan(half_fov) = halfHeight / cameraZ.
     Float CameraZ = HalfHeight / mCamera.HalfVerticalFovTangent;
-    auto CanvasPositionToRay = [this, CameraZ](Float x, Float y) -> math::vector3<Float>
-    {
-        //vector3<float>(x,y,0) - camera.position;
-        //  x = x - 0;
-        //  y = y - 0;
-        //  z = 0 - camera.position.z
-        return math::vector3<Float>(x * mCamera.Left + y * mCamera.Up + CameraZ * mCamera.Forward + mCamera.Position);
-    };
+    Float x = CanvasX * PixelSize - HalfWidth;
+    Float y = CanvasY * PixelSize - HalfHeight;
+
+    //vector3<float>(x,y,0) - camera.position;
+    //  x = x - 0;
+    //  y = y - 0;
+    //  z = 0 - camera.position.z
+    Ray CameraRay;
+    CameraRay.set_origin(mCamera.Position);
+    CameraRay.set_direction(math::vector3<Float>(x * mCamera.Left + y * mCamera.Up + CameraZ * mCamera.Forward + mCamera.Position));
+    return CameraRay;
+}
 
+void LitRenderer::GenerateCameraRays()
+{
 
+    SurfaceAOV* AOVBufferPtr = mDenoiser.GetAOVBufferPtr();
     std::vector<Task> GenerateSampleTasks;
     const int NumBlockX = (mFilm.CanvasWidth + BlockSize - 1) / BlockSize;
     const int NumBlockY = (mFilm.CanvasHeight + BlockSize - 1) / BlockSize;
@@ -268,7 +302,7 @@ void LitRenderer::GenerateCameraRays()
         for (int BlockIndexH = 0; BlockIndexH < NumBlockX; BlockIndexH += 1)
         {
             Task GenerateSampleTask = Task::Start(ThreadName::Worker,
-                [this, PixelSize, HalfPixelSize, HalfHeight, HalfWidth, BlockIndexV, BlockIndexH, CanvasPositionToRay](::Task&)
+                [this, BlockIndexV, BlockIndexH, AOVBufferPtr](::Task&)
                 {
 
                     random<Float> RandomGeneratorPickingPixel;
@@ -282,16 +316,24 @@ void LitRenderer::GenerateCameraRays()
                         int RowOffset = RowIndex * mFilm.CanvasWidth;
                         for (int ColIndex = ColStart; ColIndex < ColEnd; ColIndex++)
                         {
-                            const Float pixelCenterX = ColIndex * PixelSize + HalfPixelSize - HalfWidth;
-                            const Float pixelCenterY = RowIndex * PixelSize + HalfPixelSize - HalfHeight;
-
                             Sample& Sample = mCameraRaySamples[ColIndex + RowOffset];
                             Sample.PixelRow = RowIndex;
                             Sample.PixelCol = ColIndex;
-                            Sample.Ray.set_origin(mCamera.Position);
-                            Sample.Ray.set_direction(CanvasPositionToRay(pixelCenterX, pixelCenterY));
+                            Sample.Ray = MakeCameraRay(ColIndex + Float(0.5), RowIndex + Float(0.5));
 
                             Sample.RecordP1 = mScene->DetectIntersecting(Sample.Ray, nullptr, math::SMALL_NUM<Float>);
+
+                            SurfaceAOV& AOV = AOVBufferPtr[ColIndex + RowOffset];
+                            AOV.IsOnSurface = Sample.RecordP1;
+                            if (AOV.IsOnSurface)
+                            {
+                                const SceneObject* Object = Sample.RecordP1.Object;
+                                AOV.Normal = Sample.RecordP1.SurfaceNormal;
+                                AOV.Depth = Sample.RecordP1.Distance;
+                                AOV.Albedo = (Object->Material != nullptr && Object->Material->IsValid())
+                                    ? Object->Material->GetAlbedo()
+                                    : Spectrum::one();
+                            }
                         }
                     }
 
@@ -311,18 +353,62 @@ void LitRenderer::Initialize()
 {
     InitialSceneTransforms();
     mCamera.PositionBak = mCamera.Position;
+    ResumeFromCheckpoint();
 }
 
 bool LitRenderer::GenerateImageProgressive()
 {
     if (ResolveSampleTask.IsCompleted())
     {
+        mFrameAllocator.begin_frame();
+#ifdef ENABLE_RENDER_STATISTICS
+        ExportStatistics();
+#endif
+        if (mPassWorkUnits > 0)
+        {
+            //smoothed, a single slow pass should not drop the budget at once.
+            const Float PassCost = std::chrono::duration<Float>(mPassEndTime - mPassStartTime).count() / mPassWorkUnits;
+            mWorkUnitCost = (mWorkUnitCost > Float(0)) ? math::lerp(mWorkUnitCost, PassCost, Float(0.25)) : PassCost;
+        }
+
+        //a moving camera restarts from the coarsest preview,
+        // each following pass refines it until full resolution is reached.
         if (mCameraDirty)
         {
+            ReportTextureStatistics();
+            mCameraDirty = false;
+            mSamplesPerPixel = Float(0);
+            if (mTileCoordinator != nullptr)
+            {
+                mTileCoordinator->SetCamera(mCamera.Position, mCamera.Forward, mCamera.Up);
+            }
+            mPreviewLevel = MaxPreviewLevel;
+            ResolvePreview(mPreviewLevel);
+            return true;
+        }
+
+        if (mPreviewLevel > 0)
+        {
+            mPreviewLevel -= 1;
+            if (mPreviewLevel > 0)
+            {
+                ResolvePreview(mPreviewLevel);
+                return true;
+            }
+
             Frame = 0;
+            mCheckpointFrame = 0;
             mFilm.Clear();
             GenerateCameraRays();
-            mCameraDirty = false;
+        }
+        else if (Frame - mCheckpointFrame >= CheckpointInterval)
+        {
+            ScheduleCheckpoint();
+        }
+
+        if (mTileCoordinator != nullptr)
+        {
+            mTileCoordinator->MergeResults(mFilm, mSystemCanvasDataPtr, mCanvasLinePitch, !mDenoiserEnabled);
         }
         ResolveSamples();
         return true;
@@ -363,60 +449,567 @@ void LitRenderer::RotateCamera(const Radian& Yaw, const Radian& Pitch)
     mCameraDirty = true;
 }
 
+void LitRenderer::ToggleDenoiser()
+{
+    mDenoiserEnabled = !mDenoiserEnabled;
+}
+
+void LitRenderer::TogglePathGuiding()
+{
+    mPathGuidingEnabled = !mPathGuidingEnabled;
+}
+
+void LitRenderer::ToggleFrameBudget()
+{
+    mFrameBudgetEnabled = !mFrameBudgetEnabled;
+}
+
+void LitRenderer::SetCropWindow(int colStart, int rowStart, int colEnd, int rowEnd)
+{
+    mCropWindow.RowStart = math::clamp(rowStart, 0, mFilm.CanvasHeight);
+    mCropWindow.RowEnd = math::clamp(rowEnd, 0, mFilm.CanvasHeight);
+    mCropWindow.ColStart = math::clamp(colStart, 0, mFilm.CanvasWidth);
+    mCropWindow.ColEnd = math::clamp(colEnd, 0, mFilm.CanvasWidth);
+    if (mTileCoordinator != nullptr)
+    {
+        mTileCoordinator->SetCropWindow(mCropWindow);
+    }
+    mCameraDirty = true;
+}
+
+void LitRenderer::SetPriorityRegion(int centerCol, int centerRow)
+{
+    //samples accumulated so far stay valid, region only changes the order and rate.
+    const int HalfSize = PriorityRegionSize / 2;
+    mPriorityRegion.RowStart = math::clamp(centerRow - HalfSize, 0, mFilm.CanvasHeight);
+    mPriorityRegion.RowEnd = math::clamp(centerRow + HalfSize, 0, mFilm.CanvasHeight);
+    mPriorityRegion.ColStart = math::clamp(centerCol - HalfSize, 0, mFilm.CanvasWidth);
+    mPriorityRegion.ColEnd = math::clamp(centerCol + HalfSize, 0, mFilm.CanvasWidth);
+}
+
+void LitRenderer::ClearPriorityRegion()
+{
+    mPriorityRegion = FilmRegion();
+}
+
+bool LitRenderer::GetProgress(Float& samplesPerPixel, Float& progress, Float& etaSeconds) const
+{
+    samplesPerPixel = mSamplesPerPixel;
+    progress = math::saturate(mSamplesPerPixel / ProgressTargetSampleCount);
+    if (mWorkUnitCost <= Float(0))
+    {
+        etaSeconds = Float(0);
+        return false;
+    }
+
+    //four work units for one sample per pixel.
+    etaSeconds = math::max2(Float(0), ProgressTargetSampleCount - mSamplesPerPixel) * Float(4) * mWorkUnitCost;
+    return true;
+}
+
+void LitRenderer::AddLocalTileWorker()
+{
+    if (mTileCoordinator == nullptr)
+    {
+        std::unique_ptr<TileCoordinator> Coordinator = std::make_unique<TileCoordinator>(mFilm.CanvasWidth, mFilm.CanvasHeight);
+        if (!Coordinator->Start(TileCoordinatorPort))
+        {
+            return;
+        }
+        Coordinator->SetCamera(mCamera.Position, mCamera.Forward, mCamera.Up);
+        Coordinator->SetCropWindow(mCropWindow);
+        mTileCoordinator = std::move(Coordinator);
+    }
+    mTileCoordinator->SpawnLocalWorker();
+}
+
+int LitRenderer::RunAsTileWorker(const char* host, uint16_t port)
+{
+    TileWorkerConnection Connection;
+    if (!Connection.Connect(host, port))
+    {
+        return 1;
+    }
+
+    InitialSceneTransforms();
+
+    TileRequest Request;
+    std::vector<CompactSpectrum> Pixels;
+    while (Connection.Receive(Request))
+    {
+        RenderTile(Request, Pixels);
+        if (!Connection.Send(Request, Pixels))
+        {
+            break;
+        }
+    }
+    return 0;
+}
+
+void LitRenderer::RenderTile(const TileRequest& request, std::vector<CompactSpectrum>& outPixels)
+{
+    if (request.CameraVersion != mTileCameraVersion)
+    {
+        mCamera.Position.set(request.CameraPosition[0], request.CameraPosition[1], request.CameraPosition[2]);
+        mCamera.Forward = Direction(request.CameraForward[0], request.CameraForward[1], request.CameraForward[2]);
+        mCamera.Up = Direction(request.CameraUp[0], request.CameraUp[1], request.CameraUp[2]);
+        mCamera.Left = math::cross(mCamera.Up, mCamera.Forward);
+        GenerateCameraRays();
+        mTileCameraVersion = request.CameraVersion;
+    }
+
+    const int TileWidth = request.ColEnd - request.ColStart;
+    outPixels.resize(TileWidth * (request.RowEnd - request.RowStart));
+
+    const Sample* Samples = mCameraRaySamples;
+    CompactSpectrum* OutPixelsPtr = outPixels.data();
+    const uint64_t TileSeed = (static_cast<uint64_t>(request.Pass) << 32) | (static_cast<uint64_t>(request.TileIndex) * TileCoordinator::TileSize);
+    std::vector<Task> RowTasks;
+    for (int RowIndex = request.RowStart; RowIndex < request.RowEnd; RowIndex++)
+    {
+        Task RowTask = Task::Start(ThreadName::Worker,
+            [this, &request, Samples, OutPixelsPtr, TileWidth, RowIndex, Seed = TileSeed + RowIndex - request.RowStart](::Task&)
+            {
+                //remote samples use another sequence, never repeat the streams of local frames.
+                PathIntegrator pathIntegrator;
+                pathIntegrator.Seed(Seed, 1);
+                pathIntegrator.SetPixelSpreadAngle(GetPixelSpreadAngle());
+
+                int RowOffset = RowIndex * mFilm.CanvasWidth;
+                CompactSpectrum* OutRowPtr = OutPixelsPtr + (RowIndex - request.RowStart) * TileWidth;
+                for (int ColIndex = request.ColStart; ColIndex < request.ColEnd; ColIndex++)
+                {
+                    const Sample& Sample = Samples[ColIndex + RowOffset];
+                    Spectrum Value = Spectrum::zero();
+                    Float LuminanceSquare = Float(0);
+                    for (int SampleIndex = 0; SampleIndex < request.SamplesPerPixel; SampleIndex++)
+                    {
+                        const Spectrum Li = pathIntegrator.EvaluateLi(*mScene, Sample.Ray, Sample.RecordP1);
+                        Value += Li;
+                        LuminanceSquare += math::square(Luminance(Li));
+                    }
+
+                    CompactSpectrum& OutPixel = OutRowPtr[ColIndex - request.ColStart];
+                    OutPixel.Value[0] = static_cast<float>(Value.x);
+                    OutPixel.Value[1] = static_cast<float>(Value.y);
+                    OutPixel.Value[2] = static_cast<float>(Value.z);
+                    OutPixel.LuminanceSquare = static_cast<float>(LuminanceSquare);
+                    OutPixel.Count = request.SamplesPerPixel;
+                }
+            });
+        RowTasks.push_back(RowTask);
+    }
+
+    for (auto& Task : RowTasks)
+    {
+        Task.SpinWait();
+    }
+}
+
+#ifdef ENABLE_RENDER_STATISTICS
+void LitRenderer::ExportStatistics()
+{
+    //one json object per line, appended on disk thread.
+    std::string Line = RenderStatistics::CollectFrame().ToJson(Frame) + "\n";
+    Task::Start(ThreadName::DiskIO, [Line](auto)
+        {
+            FILE* f = nullptr;
+            if (fopen_s(&f, StatisticsPath, "ab") == 0 && f != nullptr)
+            {
+                fwrite(Line.data(), 1, Line.size(), f);
+                fclose(f);
+            }
+        });
+}
+#endif
+
+void LitRenderer::ReportTextureStatistics()
+{
+    //one line per render, a render ends when camera moves.
+    const TextureCache::Statistics Statistics = mScene->CollectTextureStatistics();
+    if (Statistics.Lookups == 0)
+    {
+        return;
+    }
+
+    char message[256];
+    sprintf_s(message, "[TextureCache] tile lookups: %llu, hit rate: %.2f%%, high-water mark: %.1f MB\n",
+        static_cast<unsigned long long>(Statistics.Lookups), Statistics.HitRate() * 100.0, Statistics.HighWaterBytes / (1024.0 * 1024.0));
+    ::OutputDebugStringA(message);
+}
+
+void LitRenderer::ScheduleCheckpoint()
+{
+    //skip this one if last checkpoint is still writing.
+    if (!mCheckpointTask.IsCompleted())
+    {
+        return;
+    }
+
+    //copied between frames, workers never wait for the disk.
+    mCheckpoint.Capture(mFilm.GetBackbufferPtr(), mFilm.CanvasWidth, mFilm.CanvasHeight, Frame);
+    RenderCheckpoint::Header& Info = mCheckpoint.Info;
+    for (int index = 0; index < 3; index++)
+    {
+        Info.CameraPosition[index] = mCamera.Position[index];
+        Info.CameraForward[index] = mCamera.Forward[index];
+        Info.CameraUp[index] = mCamera.Up[index];
+    }
+    Info.SceneHash = mScene->CalculateContentHash();
+    Info.SamplesPerPixel = mSamplesPerPixel;
+    mCheckpointFrame = Frame;
+
+    RenderCheckpoint* CheckpointPtr = &mCheckpoint;
+    mCheckpointTask = Task::Start(ThreadName::DiskIO, [CheckpointPtr](auto)
+        {
+            CheckpointPtr->Save(CheckpointPath);
+        });
+}
+
+bool LitRenderer::ResumeFromCheckpoint()
+{
+    if (!mCheckpoint.Load(CheckpointPath, mFilm.CanvasWidth, mFilm.CanvasHeight, mScene->CalculateContentHash()))
+    {
+        return false;
+    }
+
+    const RenderCheckpoint::Header& Info = mCheckpoint.Info;
+    mCamera.Position.set(Info.CameraPosition[0], Info.CameraPosition[1], Info.CameraPosition[2]);
+    mCamera.Forward = Direction(Info.CameraForward[0], Info.CameraForward[1], Info.CameraForward[2]);
+    mCamera.Up = Direction(Info.CameraUp[0], Info.CameraUp[1], Info.CameraUp[2]);
+    mCamera.Left = math::cross(mCamera.Up, mCamera.Forward);
+
+    std::copy(mCheckpoint.Pixels.begin(), mCheckpoint.Pixels.end(), mFilm.GetBackbufferPtr());
+    Frame = Info.Frame;
+    mCheckpointFrame = Frame;
+    mSamplesPerPixel = Info.SamplesPerPixel;
+
+    GenerateCameraRays();
+    mCameraDirty = false;
+    return true;
+}
+
 void LitRenderer::ResolveSamples()
 {
     const Sample* Samples = mCameraRaySamples;
     AccumulatedSpectrum* AccumulatedBufferPtr = mFilm.GetBackbufferPtr();
 
-    std::vector<Task> PixelIntegrationTasks;
+    FrameTaskList PixelIntegrationTasks(mFrameAllocator);
 
     if (MaxSampleCount > 0 && (Frame / 4) >= MaxSampleCount)
     {
+        mPassWorkUnits = 0;
         return;
     }
 
-    const int RenderBlockSize = 2;
-    const int NumBlockX = (mFilm.CanvasWidth + RenderBlockSize - 1) / RenderBlockSize;
-    const int NumBlockY = (mFilm.CanvasHeight + RenderBlockSize - 1) / RenderBlockSize;
-    for (int BlockIndexY = (Frame++ + 1) / 2 % 2; BlockIndexY < NumBlockY; BlockIndexY += 2)
+    const bool bDenoise = mDenoiserEnabled;
+    const bool bPathGuiding = mPathGuidingEnabled;
+    if (bPathGuiding)
     {
-        for (int BlockIndexX = Frame % 2; BlockIndexX < NumBlockX; BlockIndexX += 2)
+        //training goes on during the whole session,
+        // distribution is rebuilt when training samples doubled.
+        if ((mPathGuidingFrame & (mPathGuidingFrame - 1)) == 0)
         {
-            Task EvaluateLiTask = Task::Start(ThreadName::Worker,
-                [this, BlockSize = RenderBlockSize, MaxSampleCount = MaxSampleCount, BlockIndexY, BlockIndexX, AccumulatedBufferPtr, Samples](::Task&)
-                {
-                    PathIntegrator pathIntegrator;
-                    DebugIntegrator debugIntegrator;
-                    Integrator& IntegratorRef = DEBUG ? (Integrator&)debugIntegrator : (Integrator&)pathIntegrator;
+            mPathGuide.Refresh();
+        }
+        mPathGuidingFrame++;
+    }
 
-                    int RowStart = BlockIndexY * BlockSize;
-                    int RowEnd = math::min2(RowStart + BlockSize, mFilm.CanvasHeight);
-                    int ColStart = BlockIndexX * BlockSize;
-                    int ColEnd = math::min2(ColStart + BlockSize, mFilm.CanvasWidth);
-                    for (int RowIndex = RowStart; RowIndex < RowEnd; RowIndex++)
+    //in budget mode, issue as many work units as the measured cost allows:
+    // the other quarters first, then more samples per pixel.
+    int WorkUnits = 1;
+    if (mFrameBudgetEnabled && mWorkUnitCost > Float(0))
+    {
+        const Float TargetFrameTime = TargetFrameTimeMs * Float(0.001);
+        WorkUnits = math::clamp(math::floor2<int>(TargetFrameTime / mWorkUnitCost), 1, MaxPassWorkUnits);
+    }
+
+    if (mFilmFilter.GetType() != FilterType::Box)
+    {
+        //filtered samples are jittered inside pixel and spread to neighbours,
+        // so every pass covers the whole canvas.
+        const int SamplesPerPixel = math::max2(WorkUnits / 4, 1);
+        mPassWorkUnits = SamplesPerPixel * 4;
+        mSamplesPerPixel += Float(SamplesPerPixel);
+        mPassStartTime = std::chrono::steady_clock::now();
+        PixelIntegrationTasks = ResolveFilteredSamples(SamplesPerPixel, bDenoise, bPathGuiding);
+    }
+    else
+    {
+        const int RenderBlockSize = 2;
+        const int NumBlockX = (mFilm.CanvasWidth + RenderBlockSize - 1) / RenderBlockSize;
+        const int NumBlockY = (mFilm.CanvasHeight + RenderBlockSize - 1) / RenderBlockSize;
+
+        const int NumSubsets = math::min2(WorkUnits, 4);
+        const int SamplesPerPixel = math::max2(WorkUnits / 4, 1);
+        mPassWorkUnits = NumSubsets * SamplesPerPixel;
+        mSamplesPerPixel += Float(mPassWorkUnits) * Float(0.25);
+        mPassStartTime = std::chrono::steady_clock::now();
+
+        for (int SubsetIndex = 0; SubsetIndex < NumSubsets; SubsetIndex++)
+        {
+            //frame in the high word, block in the low one, so no two frames share a stream.
+            // a resumed render continues the same sequence only if the passes keep their work units,
+            // frame budgets size passes by time and break the mapping.
+            const uint64_t FrameSeed = static_cast<uint64_t>(Frame) << 32;
+            for (int BlockIndexY = (Frame++ + 1) / 2 % 2; BlockIndexY < NumBlockY; BlockIndexY += 2)
+            {
+                for (int BlockIndexX = Frame % 2; BlockIndexX < NumBlockX; BlockIndexX += 2)
+                {
+                    const int BlockRowStart = BlockIndexY * RenderBlockSize;
+                    const int BlockColStart = BlockIndexX * RenderBlockSize;
+                    if (!mCropWindow.IsEmpty() && !mCropWindow.Overlaps(BlockRowStart, BlockRowStart + RenderBlockSize, BlockColStart, BlockColStart + RenderBlockSize))
                     {
-                        int RowOffset = RowIndex * mFilm.CanvasWidth;
-                        for (int ColIndex = ColStart; ColIndex < ColEnd; ColIndex++)
-                        {
-                            const Sample& Sample = Samples[ColIndex + RowOffset];
-                            AccumulatedSpectrum& CanvasPixel = AccumulatedBufferPtr[ColIndex + RowOffset];
+                        continue;
+                    }
 
-                            const bool bGenerateMore = MaxSampleCount <= 0 || MaxSampleCount > (int)CanvasPixel.Count;
-                            if (bGenerateMore)
+                    const bool bPriorityBlock = mPriorityRegion.Overlaps(BlockRowStart, BlockRowStart + RenderBlockSize, BlockColStart, BlockColStart + RenderBlockSize);
+                    const int BlockSamplesPerPixel = bPriorityBlock ? SamplesPerPixel * PrioritySampleScale : SamplesPerPixel;
+                    Task EvaluateLiTask = Task::Start(ThreadName::Worker,
+                        [this, BlockSize = RenderBlockSize, MaxSampleCount = MaxSampleCount, BlockIndexY, BlockIndexX, AccumulatedBufferPtr, Samples, bDenoise, bPathGuiding, SamplesPerPixel = BlockSamplesPerPixel, Seed = FrameSeed + BlockIndexY * NumBlockX + BlockIndexX](::Task&)
+                        {
+                            PathIntegrator pathIntegrator(bPathGuiding ? &mPathGuide : nullptr);
+                            DebugIntegrator debugIntegrator;
+                            Integrator& IntegratorRef = DEBUG ? (Integrator&)debugIntegrator : (Integrator&)pathIntegrator;
+                            IntegratorRef.Seed(Seed);
+                            IntegratorRef.SetPixelSpreadAngle(GetPixelSpreadAngle());
+
+                            int RowStart = BlockIndexY * BlockSize;
+                            int RowEnd = math::min2(RowStart + BlockSize, mFilm.CanvasHeight);
+                            int ColStart = BlockIndexX * BlockSize;
+                            int ColEnd = math::min2(ColStart + BlockSize, mFilm.CanvasWidth);
+                            for (int RowIndex = RowStart; RowIndex < RowEnd; RowIndex++)
                             {
-                                CanvasPixel.Value += IntegratorRef.EvaluateLi(*mScene, Sample.Ray, Sample.RecordP1);
-                                CanvasPixel.Count += 1;
+                                int RowOffset = RowIndex * mFilm.CanvasWidth;
+                                for (int ColIndex = ColStart; ColIndex < ColEnd; ColIndex++)
+                                {
+                                    const Sample& Sample = Samples[ColIndex + RowOffset];
+                                    AccumulatedSpectrum& CanvasPixel = AccumulatedBufferPtr[ColIndex + RowOffset];
+
+                                    for (int SampleIndex = 0; SampleIndex < SamplesPerPixel; SampleIndex++)
+                                    {
+                                        const bool bGenerateMore = MaxSampleCount <= 0 || MaxSampleCount > (int)CanvasPixel.Count;
+                                        if (!bGenerateMore)
+                                        {
+                                            break;
+                                        }
+
+                                        const Spectrum Li = IntegratorRef.EvaluateLi(*mScene, Sample.Ray, Sample.RecordP1);
+                                        CanvasPixel.Value += Li;
+                                        CanvasPixel.LuminanceSquare += math::square(Luminance(Li));
+                                        CanvasPixel.Weight += Float(1);
+                                        CanvasPixel.Count += 1;
+                                    }
+
+                                    //denoiser will flush the whole film after all blocks resolved.
+                                    if (!bDenoise && CanvasPixel.Count > 0)
+                                    {
+                                        mFilm.FlushTo(CanvasPixel, RowIndex, ColIndex, this->mSystemCanvasDataPtr, mCanvasLinePitch);
+                                    }
+                                }
+                            }
+                        }, bPriorityBlock ? TaskPriority::High : TaskPriority::Normal);
+                    PixelIntegrationTasks.push_back(EvaluateLiTask);
+                }
+            }
+        }
+    }
+
+    //a small crop window may leave a subset without any block.
+    ResolveSampleTask = PixelIntegrationTasks.empty()
+        ? Task::Start(ThreadName::Worker, [](auto) {})
+        : Task::WhenAll(ThreadName::Worker, [](auto) {}, PixelIntegrationTasks);
+    if (bDenoise)
+    {
+        ResolveSampleTask = mDenoiser.Denoise(ResolveSampleTask, mFilm, mSystemCanvasDataPtr, mCanvasLinePitch);
+    }
+
+    ResolveSampleTask = Task::When(ThreadName::Worker, [this](auto)
+        {
+            mPassEndTime = std::chrono::steady_clock::now();
+        }, ResolveSampleTask);
+}
+
+FrameTaskList LitRenderer::ResolveFilteredSamples(int SamplesPerPixel, bool bDenoise, bool bPathGuiding)
+{
+    const int NumTileX = (mFilm.CanvasWidth + FilmTileSize - 1) / FilmTileSize;
+    const int NumTileY = (mFilm.CanvasHeight + FilmTileSize - 1) / FilmTileSize;
+    const int Apron = static_cast<int>(std::ceil(mFilmFilter.GetRadius()));
+
+    //tiles are kept until merged, released with the last task referencing them.
+    std::shared_ptr<std::vector<FilmTile>> Tiles = std::make_shared<std::vector<FilmTile>>(NumTileX * NumTileY);
+    std::vector<FrameTaskList> TileRowTasks(NumTileY, FrameTaskList(mFrameAllocator));
+
+    //one sample per pixel counts as four frames, same as box passes.
+    const uint64_t FrameSeed = static_cast<uint64_t>(Frame) << 32;
+    Frame += SamplesPerPixel * 4;
 
-                                mFilm.FlushTo(CanvasPixel, RowIndex, ColIndex, this->mSystemCanvasDataPtr, mCanvasLinePitch);
+    for (int TileIndexY = 0; TileIndexY < NumTileY; TileIndexY++)
+    {
+        for (int TileIndexX = 0; TileIndexX < NumTileX; TileIndexX++)
+        {
+            FilmRegion TileRegion;
+            TileRegion.RowStart = TileIndexY * FilmTileSize;
+            TileRegion.RowEnd = math::min2(TileRegion.RowStart + FilmTileSize, mFilm.CanvasHeight);
+            TileRegion.ColStart = TileIndexX * FilmTileSize;
+            TileRegion.ColEnd = math::min2(TileRegion.ColStart + FilmTileSize, mFilm.CanvasWidth);
+            if (!mCropWindow.IsEmpty() && !mCropWindow.Overlaps(TileRegion.RowStart, TileRegion.RowEnd, TileRegion.ColStart, TileRegion.ColEnd))
+            {
+                continue;
+            }
+
+            const int TileIndex = TileIndexX + TileIndexY * NumTileX;
+            const bool bPriorityTile = mPriorityRegion.Overlaps(TileRegion.RowStart, TileRegion.RowEnd, TileRegion.ColStart, TileRegion.ColEnd);
+            Task RenderTileTask = Task::Start(ThreadName::Worker,
+                [this, Tiles, TileIndex, TileRegion, Apron, bPathGuiding, SamplesPerPixel = bPriorityTile ? SamplesPerPixel * PrioritySampleScale : SamplesPerPixel, Seed = FrameSeed + TileIndex](::Task&)
+                {
+                    PathIntegrator pathIntegrator(bPathGuiding ? &mPathGuide : nullptr);
+                    pathIntegrator.Seed(Seed);
+                    pathIntegrator.SetPixelSpreadAngle(GetPixelSpreadAngle());
+
+                    //sequence 3 is for pixel jitter, apart from integrator streams.
+                    stream_random<Float> PixelJitter;
+                    PixelJitter.seed(Seed, 3u << 8);
+
+                    FilmTile& Tile = (*Tiles)[TileIndex];
+                    Tile.Reset(TileRegion, Apron);
+                    for (int RowIndex = TileRegion.RowStart; RowIndex < TileRegion.RowEnd; RowIndex++)
+                    {
+                        for (int ColIndex = TileRegion.ColStart; ColIndex < TileRegion.ColEnd; ColIndex++)
+                        {
+                            for (int SampleIndex = 0; SampleIndex < SamplesPerPixel; SampleIndex++)
+                            {
+                                const Float FilmX = ColIndex + PixelJitter();
+                                const Float FilmY = RowIndex + PixelJitter();
+                                const Ray CameraRay = MakeCameraRay(FilmX, FilmY);
+                                const SurfaceIntersection RecordP1 = mScene->DetectIntersecting(CameraRay, nullptr, math::SMALL_NUM<Float>);
+                                Tile.AddSample(mFilmFilter, FilmX, FilmY, pathIntegrator.EvaluateLi(*mScene, CameraRay, RecordP1));
                             }
                         }
                     }
-                });
-            PixelIntegrationTasks.push_back(EvaluateLiTask);
+                }, bPriorityTile ? TaskPriority::High : TaskPriority::Normal);
+            TileRowTasks[TileIndexY].push_back(RenderTileTask);
+        }
+    }
+
+    //aprons never exceed a tile, rows of film only receive samples of tiles in neighbouring rows.
+    // merging them in fixed tile order keeps the sum independent of scheduling, and free of atomics.
+    FrameTaskList MergeTasks(mFrameAllocator);
+    for (int TileIndexY = 0; TileIndexY < NumTileY; TileIndexY++)
+    {
+        const int NeighbourStart = math::max2(TileIndexY - 1, 0);
+        const int NeighbourEnd = math::min2(TileIndexY + 2, NumTileY);
+        FrameTaskList NeighbourTasks(mFrameAllocator);
+        for (int NeighbourIndex = NeighbourStart; NeighbourIndex < NeighbourEnd; NeighbourIndex++)
+        {
+            NeighbourTasks.insert(NeighbourTasks.end(), TileRowTasks[NeighbourIndex].begin(), TileRowTasks[NeighbourIndex].end());
+        }
+        if (NeighbourTasks.empty())
+        {
+            continue;
         }
+
+        Task MergeTask = Task::WhenAll(ThreadName::Worker,
+            [this, Tiles, NumTileX, NeighbourStart, NeighbourEnd, bDenoise, RowStart = TileIndexY * FilmTileSize, RowEnd = math::min2((TileIndexY + 1) * FilmTileSize, mFilm.CanvasHeight)](::Task&)
+            {
+                AccumulatedSpectrum* AccumulatedBufferPtr = mFilm.GetBackbufferPtr();
+                for (int TileIndex = NeighbourStart * NumTileX; TileIndex < NeighbourEnd * NumTileX; TileIndex++)
+                {
+                    (*Tiles)[TileIndex].MergeRows(AccumulatedBufferPtr, mFilm.CanvasWidth, mFilm.CanvasHeight, RowStart, RowEnd);
+                }
+
+                //denoiser will flush the whole film after all tiles merged.
+                if (bDenoise)
+                {
+                    return;
+                }
+                for (int RowIndex = RowStart; RowIndex < RowEnd; RowIndex++)
+                {
+                    int RowOffset = RowIndex * mFilm.CanvasWidth;
+                    for (int ColIndex = 0; ColIndex < mFilm.CanvasWidth; ColIndex++)
+                    {
+                        const AccumulatedSpectrum& CanvasPixel = AccumulatedBufferPtr[ColIndex + RowOffset];
+                        if (CanvasPixel.Weight > Float(0))
+                        {
+                            mFilm.FlushTo(CanvasPixel, RowIndex, ColIndex, this->mSystemCanvasDataPtr, mCanvasLinePitch);
+                        }
+                    }
+                }
+            }, NeighbourTasks);
+        MergeTasks.push_back(MergeTask);
+    }
+    return MergeTasks;
+}
+
+void LitRenderer::ToggleReconstructionFilter()
+{
+    //box, gaussian, mitchell, and box again.
+    switch (mFilmFilter.GetType())
+    {
+    case FilterType::Box: mFilmFilter = ReconstructionFilter(FilterType::Gaussian); break;
+    case FilterType::Gaussian: mFilmFilter = ReconstructionFilter(FilterType::Mitchell); break;
+    default: mFilmFilter = ReconstructionFilter(FilterType::Box); break;
     }
+    mCameraDirty = true;
+}
+
+void LitRenderer::ResolvePreview(int Level)
+{
+    //one path per Stride x Stride pixels, traced from the center of the block,
+    // film is untouched, the result goes to canvas directly.
+    const int Stride = 1 << Level;
+    const int NumPreviewX = (mFilm.CanvasWidth + Stride - 1) / Stride;
+    const int NumPreviewY = (mFilm.CanvasHeight + Stride - 1) / Stride;
+    const int PreviewRowsPerTask = 4;
+
+    mPassWorkUnits = 0;
+    FrameTaskList PreviewTasks(mFrameAllocator);
+    for (int PreviewRowStart = 0; PreviewRowStart < NumPreviewY; PreviewRowStart += PreviewRowsPerTask)
+    {
+        Task PreviewTask = Task::Start(ThreadName::Worker,
+            [this, Stride, NumPreviewX, CropWindow = mCropWindow, PreviewRowStart, PreviewRowEnd = math::min2(PreviewRowStart + PreviewRowsPerTask, NumPreviewY), Seed = static_cast<uint64_t>(Level * NumPreviewY + PreviewRowStart)](::Task&)
+            {
+                //previews use their own sequence, never repeat the streams of accumulated frames.
+                PathIntegrator pathIntegrator;
+                pathIntegrator.Seed(Seed, 2);
+                pathIntegrator.SetPixelSpreadAngle(GetPixelSpreadAngle() * Stride);
+                pathIntegrator.SetPreview(true);
 
-    ResolveSampleTask = Task::WhenAll(ThreadName::Worker, [](auto) {}, PixelIntegrationTasks);
+                for (int PreviewRow = PreviewRowStart; PreviewRow < PreviewRowEnd; PreviewRow++)
+                {
+                    int RowStart = PreviewRow * Stride;
+                    int RowEnd = math::min2(RowStart + Stride, mFilm.CanvasHeight);
+                    for (int PreviewCol = 0; PreviewCol < NumPreviewX; PreviewCol++)
+                    {
+                        int ColStart = PreviewCol * Stride;
+                        int ColEnd = math::min2(ColStart + Stride, mFilm.CanvasWidth);
+                        if (!CropWindow.IsEmpty() && !CropWindow.Overlaps(RowStart, RowEnd, ColStart, ColEnd))
+                        {
+                            continue;
+                        }
+
+                        const Ray CameraRay = MakeCameraRay((ColStart + ColEnd) * Float(0.5), (RowStart + RowEnd) * Float(0.5));
+                        const SurfaceIntersection RecordP1 = mScene->DetectIntersecting(CameraRay, nullptr, math::SMALL_NUM<Float>);
+
+                        AccumulatedSpectrum PreviewPixel;
+                        PreviewPixel.Value = pathIntegrator.EvaluateLi(*mScene, CameraRay, RecordP1);
+                        PreviewPixel.Weight = Float(1);
+                        PreviewPixel.Count = 1;
+
+                        //nearest upsampling, finer level will overwrite it.
+                        for (int RowIndex = RowStart; RowIndex < RowEnd; RowIndex++)
+                        {
+                            for (int ColIndex = ColStart; ColIndex < ColEnd; ColIndex++)
+                            {
+                                mFilm.FlushTo(PreviewPixel, RowIndex, ColIndex, this->mSystemCanvasDataPtr, mCanvasLinePitch);
+                            }
+                        }
+                    }
+                }
+            });
+        PreviewTasks.push_back(PreviewTask);
+    }
+    ResolveSampleTask = Task::WhenAll(ThreadName::Worker, [](auto) {}, PreviewTasks);
 }
 
 SimpleBackCamera::SimpleBackCamera(Degree verticalFov)
@@ -1,10 +1,17 @@
 #pragma once
 #pragma once
+#include <chrono>
 #include <memory>
 #include <vector>
+#include <Foundation/Base/AllocatorHelper.h>
 #include "PreInclude.h"
 #include "LDRFilm.h"
+#include "Denoiser.h"
+#include "DistributedRendering.h"
 #include "Material.h"
+#include "PathGuide.h"
+#include "RenderCheckpoint.h"
+#include "RenderStatistics.h"
 #include "Scene.h"
 
 
@@ -27,6 +34,9 @@ public:
     const Float HalfVerticalFovTangent;
 };
 
+//task lists of a pass, they live in frame memory and are gone two passes later.
+using FrameTaskList = std::vector<Task, base::std_allocator_adaptor<Task, base::frame_linear_allocator>>;
+
 class LitRenderer
 {
 public:
@@ -39,14 +49,49 @@ public:
     void ResetCamera();
     void MoveCamera(const math::vector3<Float>& Offset);
     void RotateCamera(const Radian& Yaw, const Radian& Pitch);
+    void ToggleDenoiser();
+    void TogglePathGuiding();
+    void AddLocalTileWorker();
+    void ToggleFrameBudget();
+    void ToggleReconstructionFilter();
+    void SetCropWindow(int colStart, int rowStart, int colEnd, int rowEnd);
+    void SetPriorityRegion(int centerCol, int centerRow);
+    void ClearPriorityRegion();
+    bool GetProgress(Float& samplesPerPixel, Float& progress, Float& etaSeconds) const;
+    int RunAsTileWorker(const char* host, uint16_t port);
 
 private:
     void InitialSceneTransforms();
+    Float GetPixelSpreadAngle() const;
+    Ray MakeCameraRay(Float CanvasX, Float CanvasY) const;
     void GenerateCameraRays();
     void ResolveSamples();
+    void ResolvePreview(int Level);
+    FrameTaskList ResolveFilteredSamples(int SamplesPerPixel, bool bDenoise, bool bPathGuiding);
+    void ReportTextureStatistics();
+    void ScheduleCheckpoint();
+    bool ResumeFromCheckpoint();
+    void RenderTile(const TileRequest& request, std::vector<CompactSpectrum>& outPixels);
+#ifdef ENABLE_RENDER_STATISTICS
+    void ExportStatistics();
+#endif
 
     static const int MaxLightRaySampleCount = -1;
     static const int MaxSampleCount = MaxLightRaySampleCount;
+    static const int CheckpointInterval = 64;
+    static const int TargetFrameTimeMs = 33;
+    static const int MaxPassWorkUnits = 64;
+    static const int ProgressTargetSampleCount = 1024;
+
+    //preview level N traces one path per 2^N x 2^N pixels: 1/16, then 1/4 of full resolution.
+    static const int MaxPreviewLevel = 2;
+
+    //blocks inside priority region are scheduled first, with more samples each pass.
+    static const int PriorityRegionSize = 128;
+    static const int PrioritySampleScale = 4;
+
+    //tiles of filtered passes, each owns a private film buffer with apron.
+    static const int FilmTileSize = 32;
 
     struct Sample
     {
@@ -58,10 +103,34 @@ private:
     const int mCanvasLinePitch;
     unsigned char* mSystemCanvasDataPtr;
     LDRFilm mFilm;
+    ReconstructionFilter mFilmFilter;
+    ATrousDenoiser mDenoiser;
+    PathGuide mPathGuide;
     SimpleBackCamera mCamera;
     std::unique_ptr<Scene> mScene;
     Sample* mCameraRaySamples;
     int Frame = 0;
     bool mCameraDirty = true;
+    int mPreviewLevel = 0;
+    bool mDenoiserEnabled = false;
+    bool mPathGuidingEnabled = false;
+    int mPathGuidingFrame = 0;
     Task ResolveSampleTask;
+    base::frame_linear_allocator mFrameAllocator;
+    RenderCheckpoint mCheckpoint;
+    int mCheckpointFrame = 0;
+    Task mCheckpointTask;
+    std::unique_ptr<TileCoordinator> mTileCoordinator;
+
+    //a work unit is a quarter of the pixels with one sample each.
+    bool mFrameBudgetEnabled = false;
+    int mPassWorkUnits = 0;
+    Float mWorkUnitCost = Float(0);
+    Float mSamplesPerPixel = Float(0);
+    std::chrono::steady_clock::time_point mPassStartTime;
+    std::chrono::steady_clock::time_point mPassEndTime;
+    uint32_t mTileCameraVersion = 0;
+
+    FilmRegion mCropWindow;
+    FilmRegion mPriorityRegion;
 };
@@ -1,4 +1,6 @@
+#include <cassert>
 #include <tuple>
+#include <Foundation/Math/FastMath.h>
 #include "Material.h"
 #include "LitRenderer.h"
 
@@ -141,9 +143,8 @@ Direction GenerateHemisphereDirection(const Float uTheta, const Float uPhi, cons
 {
     Float cosTheta = Float(1) - Float(2) * uTheta;
     Float sinTheta = sqrt(Float(1) - cosTheta * cosTheta);
-    Radian phi(math::TWO_PI<Float> *uPhi);
-    Float cosPhi = math::cos(phi);
-    Float sinPhi = math::sin(phi);
+    Float sinPhi, cosPhi;
+    math::fast_sincos(math::TWO_PI<Float> * uPhi, sinPhi, cosPhi);
 
     Float x = sinTheta * cosPhi;
     Float y = sinTheta * sinPhi;
@@ -160,9 +161,8 @@ Direction GenerateUniformHemisphereDirection(const Float uTheta, const Float uPh
     // => f_theta = 1-cos_theta   --> cos_theta(x) = 1-x = x'
     Float cosTheta = uTheta; //replace 1-e to e'
     Float sinTheta = sqrt(Float(1) - cosTheta * cosTheta);
-    Radian phi(math::TWO_PI<Float> *uPhi);
-    Float cosPhi = math::cos(phi);
-    Float sinPhi = math::sin(phi);
+    Float sinPhi, cosPhi;
+    math::fast_sincos(math::TWO_PI<Float> * uPhi, sinPhi, cosPhi);
 
     Float x = sinTheta * cosPhi;
     Float y = sinTheta * sinPhi;
@@ -184,7 +184,7 @@ Direction SampleGGXVNDF(
     Direction T1 = V.z < Float(0.99999)
         ? math::cross(V, Direction::unit_z())
         : Direction::unit_x();
-    Direction T2 = math::cross(V, T1);
+    Direction T2 = math::cross(T1, V);
 
     // sample point with polar coordinates (r, phi)
     Float a = Float(1) / (Float(1) + V.z);
@@ -276,9 +276,8 @@ Direction GenerateCosineWeightedHemisphereDirection(const Float uTheta, const Fl
     Float cosTheta_sqr = uTheta; //replace 1-e to e'
     Float cosTheta = sqrt(cosTheta_sqr);
     Float sinTheta = sqrt(Float(1) - cosTheta_sqr);
-    Radian phi(Float(2) * math::PI<Float> *uPhi);
-    Float cosPhi = math::cos(phi);
-    Float sinPhi = math::sin(phi);
+    Float sinPhi, cosPhi;
+    math::fast_sincos(math::TWO_PI<Float> * uPhi, sinPhi, cosPhi);
 
     Float x = sinTheta * cosPhi;
     Float y = sinTheta * sinPhi;
@@ -286,83 +285,6 @@ Direction GenerateCosineWeightedHemisphereDirection(const Float uTheta, const Fl
     return Direction(x, y, z);
 }
 
-DistributionGGX::DistributionGGX(Float roughness)
-    : Roughness(roughness)
-    , Alpha(math::power<2>(roughness))
-    , AlphaSquare(math::power<4>(roughness))
-{
-}
-
-Direction DistributionGGX::SampleWh(const Direction& Wo, Float u1, Float u2) const
-{
-    const Direction Wh = SampleGGXVNDF(Wo, Alpha, Alpha, u1, u2);
-    return Wh;
-}
-
-Float DistributionGGX::D(Float NdotH) const
-{
-    return DistributionGTR2(AlphaSquare, NdotH);
-}
-
-Float DistributionGGX::G(Float NdotH, Float HdotV, Float HdotL) const
-{
-    Float G1 = ShadowingGGX(AlphaSquare, HdotV, NdotH);
-    Float G2 = ShadowingGGX(AlphaSquare, HdotL, NdotH);
-    return math::min2(G1, G2);
-}
-
-Float DistributionGGX::pdf(const Direction& Wo, const Direction& Wi) const
-{
-    const Direction H = Wi + Wo;
-    const Float NdotH = Ndot(H);
-    const Float D = this->D(NdotH);
-    return D * NdotH;
-}
-
-
-
-bool Lambertian::SampleFCosOverPdf(Float u[3], const Direction& Wo, BSDFSample& oBSDFSample) const
-{
-    //  f * cos(theta)     rho * cos(theta)        Pi
-    // ---------------- = ----------------- * ------------ = rho
-    //      pdf                 Pi             cos(theta)
-    const Direction Wi = GenerateCosineWeightedHemisphereDirection(u[1], u[2]);
-    const Float NdotL = Ndot(Wi);
-    oBSDFSample.Wi = Wi;
-    oBSDFSample.F = Albedo;
-    oBSDFSample.CosineWi = NdotL;
-    oBSDFSample.SampleMask = BSDFMask::DiffuseMask;
-    return NdotL > Float(0);
-}
-
-Direction Lambertian::SampleWi(Float u[3], const Direction& Wo) const
-{
-    return GenerateCosineWeightedHemisphereDirection(u[1], u[2]);
-}
-
-Spectrum Lambertian::f(const Direction& Wo, const Direction& Wi) const
-{
-    return Albedo * math::InvPI<Float>;
-}
-
-Float Lambertian::pdf(const Direction& Wo, const Direction& Wi) const
-{
-    Float NdotL = Ndot(Wi);
-    return math::saturate(NdotL) * math::InvPI<Float>;
-}
-
-
-
-OrenNayar::OrenNayar(const Spectrum& albedo, Radian sigma)
-    : BSDF("Oren-Nayer", BSDFMask::DiffuseMask)
-    , Albedo(albedo)
-    , Sigma(sigma)
-    , SigmaSquare(math::square(sigma.value))
-{
-    A = Float(1) - Float(0.5) * SigmaSquare.value / (SigmaSquare.value + Float(0.33));
-    B = Float(0.45) * SigmaSquare.value / (SigmaSquare.value + Float(0.09));
-}
-
 std::tuple<Float, Float> CalculateFactorAndCosineWi(const Direction& Wi, const Direction& Wo, const Float A, const Float B)
 {
     const Float CosineWi = Ndot(Wi);
@@ -388,393 +310,436 @@ std::tuple<Float, Float> CalculateFactorAndCosineWi(const Direction& Wi, const D
     return { factor, CosineWi };
 }
 
-bool OrenNayar::SampleFCosOverPdf(Float u[3], const Direction& Wo, BSDFSample& oBSDFSample) const
+Float SmithG1GGX(Float AlphaSquare, Float NdotV)
+{
+    return ShadowingGGX(AlphaSquare, NdotV, NdotV);
+}
+
+Float GGXSpecularPdf(Float AlphaSquare, const ShadingGeometry& geometry)
 {
-    //  f * cos(theta)                           rho                     Pi
-    // ---------------- = factor * cosine(Wi) * ----- * cos(theta) * ------------ = factor * cosine(Wi) * rho
-    //      pdf                                   Pi                  cos(theta) 
-    // *  Float NdotL = Ndot(Wi);
+    if (geometry.NdotV <= Float(0) || geometry.HdotV <= Float(0))
+    {
+        return Float(0);
+    }
 
-    const Direction Wi = GenerateCosineWeightedHemisphereDirection(u[1], u[2]);
-    Float factor, NdotL;
-    std::tie(factor, NdotL) = CalculateFactorAndCosineWi(Wi, Wo, A, B);
-    oBSDFSample.Wi = Wi;
-    oBSDFSample.F = f(Wo, Wi);
-    oBSDFSample.CosineWi = NdotL;
-    oBSDFSample.SampleMask = BSDFMask::DiffuseMask;
-    return NdotL > Float(0);
+    // Wh is sampled from visible normals (SampleGGXVNDF), so
+    //           G1(V) * HdotV * D
+    // pdf(H) = -------------------
+    //                 NdotV
+    // reflecting H into Wi brings the jacobian 1 / (4 * HdotV):
+    //           G1(V) * D
+    // pdf(L) = -----------
+    //           4 * NdotV
+    const Float D = DistributionGTR2(AlphaSquare, geometry.NdotH);
+    const Float G1 = SmithG1GGX(AlphaSquare, geometry.NdotV);
+    return G1 * D * Float(0.25) / geometry.NdotV;
 }
 
-Direction OrenNayar::SampleWi(Float u[3], const Direction& Wo) const
+Spectrum AshikhminAndShirleySpecularF(Float AlphaSquare, const Spectrum& Rs, const ShadingGeometry& geometry)
 {
-    return  GenerateCosineWeightedHemisphereDirection(u[1], u[2]);
+    const Float D = DistributionGTR2(AlphaSquare, geometry.NdotH);
+    const Spectrum Fresnel = FresnelSchlick(geometry.HdotL, Rs);
+    //         D * F
+    //-------------------------------
+    // 4 * HdotL * max(NdotL, NdotV)
+    return (D * Fresnel * Float(0.25)) / (geometry.HdotL * math::max2(geometry.NdotL, geometry.NdotV)) * Spectrum::one();
 }
 
-Spectrum OrenNayar::f(const Direction& Wo, const Direction& Wi) const
+Direction SampleGGXReflection(Float Alpha, Float u[3], const Direction& Wo)
 {
-    Float factor, CosineWi;
-    std::tie(factor, CosineWi) = CalculateFactorAndCosineWi(Wi, Wo, A, B);
-    return (factor * CosineWi * math::InvPI<Float>) * Albedo;
+    const Direction H = SampleGGXVNDF(Wo, Alpha, Alpha, u[1], u[2]);
+    return math::reflection(Wo, H);
 }
 
-Float OrenNayar::pdf(const Direction& Wo, const Direction& Wi) const
+uint32_t MicrofacetMask(Float roughness)
 {
-    Float NdotL = Ndot(Wi);
-    return math::saturate(NdotL) * math::InvPI<Float>;
+    return math::near_zero(roughness)
+        ? (BSDFMask::MirrorMask | BSDFMask::SpecularMask)
+        : BSDFMask::SpecularMask;
 }
 
-TorranceSparrow::TorranceSparrow(std::unique_ptr<DistributionFunction>&& distrib, const Spectrum& Rs)
-    : BSDF("Torrance-Sparrow"
-        , (distrib->IsNearMirrorReflection()
-            ? (BSDFMask::MirrorMask | BSDFMask::SpecularMask)
-            : BSDFMask::SpecularMask))
-    , Distribution(std::move(distrib))
-    , Rs(Rs)
+ShadingGeometry::ShadingGeometry(const Direction& Wo, const Direction& Wi)
+    : Wo(Wo), Wi(Wi)
+    , H(Wo + Wi)
+    , IsHalfVectorValid(!math::near_zero(H))
+    , NdotL(Ndot(Wi))
+    , NdotV(Ndot(Wo))
+    , NdotH(Ndot(H))
+    , HdotV(math::dot(H, Wo))
+    , HdotL(math::dot(H, Wi))
 {
+}
 
+BSDFLobe BSDFLobe::Lambertian(const Spectrum& albedo)
+{
+    BSDFLobe lobe;
+    lobe.Type = BSDFLobeType::Lambertian;
+    lobe.BSDFMask = BSDFMask::DiffuseMask;
+    lobe.Rd = albedo;
+    return lobe;
 }
 
-bool TorranceSparrow::SampleFCosOverPdf(Float u[3], const Direction& Wo, BSDFSample& oBSDFSample) const
+BSDFLobe BSDFLobe::OrenNayar(const Spectrum& albedo, Radian sigma)
 {
-    // f * cos(theta)        D * F * G                      4 * HdotV     F * G * HdotV
-    //--------------- = ------------------- * cos(theta) * ----------- = ---------------
-    //     pdf           4 * NdotV * NdotL                  D * NdotH     NdotV * NdotH
-    //
-    // Note that cos(theta) = NdotL
-    //           Distribution::Pdf  = D * cos(theta),
-    //           Distribution::Pdf' = D * G1 * HdotV / NdotV, this will be special due to sampling visible area.
-    const Direction H = Distribution->SampleWh(Wo, u[1], u[2]);
-    const Direction Wi = math::reflection(Wo, H);
-    const Float NdotL = Ndot(Wi);
-    oBSDFSample.Wi = Wi;
-    oBSDFSample.F = (f(Wo, Wi) * NdotL / pdf(Wo, Wi));
-    oBSDFSample.CosineWi = NdotL;
-    oBSDFSample.SampleMask = (Distribution->IsNearMirrorReflection()
-        ? BSDFMask::SpecularMask | BSDFMask::MirrorMask
-        : BSDFMask::SpecularMask);
-    return NdotL > 0;
+    BSDFLobe lobe;
+    lobe.Type = BSDFLobeType::OrenNayar;
+    lobe.BSDFMask = BSDFMask::DiffuseMask;
+    lobe.Rd = albedo;
+
+    const Float SigmaSquare = math::square(sigma.value);
+    lobe.A = Float(1) - Float(0.5) * SigmaSquare / (SigmaSquare + Float(0.33));
+    lobe.B = Float(0.45) * SigmaSquare / (SigmaSquare + Float(0.09));
+    return lobe;
 }
 
-Direction TorranceSparrow::SampleWi(Float u[3], const Direction& Wo) const
+BSDFLobe BSDFLobe::TorranceSparrow(Float roughness, const Spectrum& Rs)
 {
-    const Direction H = Distribution->SampleWh(Wo, u[1], u[2]);
-    const Direction Wi = math::reflection(Wo, H);
-    return Wi;
+    BSDFLobe lobe;
+    lobe.Type = BSDFLobeType::TorranceSparrow;
+    lobe.BSDFMask = MicrofacetMask(roughness);
+    lobe.Rs = Rs;
+    lobe.Roughness = roughness;
+    lobe.Alpha = math::power<2>(roughness);
+    lobe.AlphaSquare = math::power<4>(roughness);
+    return lobe;
 }
 
-Spectrum TorranceSparrow::f(const Direction& Wo, const Direction& Wi) const
+BSDFLobe BSDFLobe::AshikhminAndShirley(Float roughness, const Spectrum& Rd, const Spectrum& Rs)
 {
-    const Float NdotL = math::saturate(Ndot(Wi));
-    const Float NdotV = math::saturate(Ndot(Wo));
-    if (NdotL > Float(0) && NdotV > Float(0))
-    {
-        const Direction H = Wo + Wi;
-        const Float NdotH = math::saturate(Ndot(H));
-        const Float HdotV = math::saturate(math::dot(H, Wo));
-        const Float HdotL = math::saturate(math::dot(H, Wi));
-        const Float D = Distribution->D(NdotH);
-        const Float G = Distribution->G(NdotH, HdotL, HdotV);
-        const Spectrum F = FresnelSchlick(HdotL, Rs);
-        const Spectrum f = Float(0.25) * D * F * G / (NdotV * NdotL);
-        return f;
-    }
-    else
-    {
-        return Spectrum::zero();
-    }
+    BSDFLobe lobe = TorranceSparrow(roughness, Rs);
+    lobe.Type = BSDFLobeType::AshikhminAndShirley;
+    lobe.BSDFMask |= BSDFMask::DiffuseMask;
+    lobe.Rd = Rd;
+    lobe.DiffuseWeight = (Float(28) * math::InvPI<Float> / Float(23)) * (Rd * (Spectrum::one() - Rs));
+    return lobe;
 }
 
-Float TorranceSparrow::pdf(const Direction& Wo, const Direction& Wi) const
+BSDFLobe BSDFLobe::AshikhminAndShirleyDiffuse(const Spectrum& Rd, const Spectrum& Rs)
 {
-    //copy from Pbrt, same with UE4.
-    // D * NdotH
-    //-----------
-    // 4 * HdotV
-    const Direction H = Wo + Wi;
-    const Float HdotV = math::dot(H, Wo);
-    const Float pdf = Distribution->pdf(Wo, Wi);
-    return pdf * Float(0.25) / HdotV;
+    BSDFLobe lobe;
+    lobe.Type = BSDFLobeType::AshikhminAndShirleyDiffuse;
+    lobe.BSDFMask = BSDFMask::DiffuseMask;
+    lobe.Rd = Rd;
+    lobe.DiffuseWeight = (Float(28) / Float(23) * math::InvPI<Float>) * (Rd * (Spectrum::one() - Rs));
+    return lobe;
 }
 
-AshikhminAndShirley::AshikhminAndShirley(std::unique_ptr<DistributionFunction>&& distrib, const Spectrum& Rd, const Spectrum& Rs)
-    : BSDF("Ashikhmin-Shirley"
-        , (distrib->IsNearMirrorReflection()
-            ? (BSDFMask::MirrorMask | BSDFMask::SpecularMask | BSDFMask::DiffuseMask)
-            : BSDFMask::SpecularMask | BSDFMask::DiffuseMask))
-    , Distribution(std::move(distrib)), Rd(Rd), Rs(Rs)
-    , DiffuseWeight((Float(28)* math::InvPI<Float> / Float(23))* (Rd* (Spectrum::one() - Rs)))
+BSDFLobe BSDFLobe::AshikhminAndShirleySpecular(Float roughness, const Spectrum& Rs)
 {
+    BSDFLobe lobe = TorranceSparrow(roughness, Rs);
+    lobe.Type = BSDFLobeType::AshikhminAndShirleySpecular;
+    return lobe;
 }
 
-bool AshikhminAndShirley::SampleFCosOverPdf(Float u[3], const Direction& Wo, BSDFSample& oBSDFSample) const
+Direction BSDFLobe::SampleWi(Float u[3], const Direction& Wo) const
 {
-    Direction Wi;
-    if (u[0] < Float(0.5))
-    {
-        //sample diffuse
-        Wi = GenerateCosineWeightedHemisphereDirection(u[1], u[2]);
-        oBSDFSample.SampleMask = BSDFMask::DiffuseMask;
-    }
-    else
+    switch (Type)
     {
-        //sample specular
-        const Direction H = Distribution->SampleWh(Wo, u[1], u[2]);
-        Wi = math::reflection(Wo, H);
-        oBSDFSample.SampleMask = (Distribution->IsNearMirrorReflection()
-            ? BSDFMask::SpecularMask | BSDFMask::MirrorMask
-            : BSDFMask::SpecularMask);
-    }
+    case BSDFLobeType::Lambertian:
+    case BSDFLobeType::OrenNayar:
+    case BSDFLobeType::AshikhminAndShirleyDiffuse:
+        return GenerateCosineWeightedHemisphereDirection(u[1], u[2]);
+
+    case BSDFLobeType::TorranceSparrow:
+    case BSDFLobeType::AshikhminAndShirleySpecular:
+        return SampleGGXReflection(Alpha, u, Wo);
 
-    const Float NdotL = Ndot(Wi);
-    oBSDFSample.Wi = Wi;
-    oBSDFSample.F = f(Wo, Wi) * NdotL / pdf(Wo, Wi);
-    oBSDFSample.CosineWi = NdotL;
-    return NdotL > Float(0);
+    case BSDFLobeType::AshikhminAndShirley:
+        return (u[0] < Float(0.5))
+            ? GenerateCosineWeightedHemisphereDirection(u[1], u[2])
+            : SampleGGXReflection(Alpha, u, Wo);
+    }
+    return Direction::unit_z();
 }
 
-Direction AshikhminAndShirley::SampleWi(Float u[3], const Direction& Wo) const
+//one lobe of a type known at compile time, no dispatch is left inside.
+template<BSDFLobeType Type>
+Spectrum EvaluateLobeF(const BSDFLobe& lobe, const ShadingGeometry& geometry)
 {
-    Direction Wi;
-    if (u[0] < Float(0.5))
+    if constexpr (Type == BSDFLobeType::Lambertian)
     {
-        //sample diffuse
-        return GenerateCosineWeightedHemisphereDirection(u[1], u[2]);
+        return lobe.Rd * math::InvPI<Float>;
     }
-    else
+    else if constexpr (Type == BSDFLobeType::OrenNayar)
     {
-        //sample specular
-        const Direction H = Distribution->SampleWh(Wo, u[1], u[2]);
-        return math::reflection(Wo, H);
+        Float factor, CosineWi;
+        std::tie(factor, CosineWi) = CalculateFactorAndCosineWi(geometry.Wi, geometry.Wo, lobe.A, lobe.B);
+        return (factor * CosineWi * math::InvPI<Float>) * lobe.Rd;
     }
-}
-
-Spectrum AshikhminAndShirley::f(const Direction& Wo, const Direction& Wi) const
-{
-    const Direction H = Wo + Wi;
-    if (math::near_zero(H))
+    else if constexpr (Type == BSDFLobeType::TorranceSparrow)
     {
+        const Float NdotL = math::saturate(geometry.NdotL);
+        const Float NdotV = math::saturate(geometry.NdotV);
+        if (NdotL > Float(0) && NdotV > Float(0))
+        {
+            const Float NdotH = math::saturate(geometry.NdotH);
+            const Float HdotV = math::saturate(geometry.HdotV);
+            const Float HdotL = math::saturate(geometry.HdotL);
+            const Float D = DistributionGTR2(lobe.AlphaSquare, NdotH);
+            const Float G = math::min2(ShadowingGGX(lobe.AlphaSquare, HdotL, NdotH), ShadowingGGX(lobe.AlphaSquare, HdotV, NdotH));
+            const Spectrum F = FresnelSchlick(HdotL, lobe.Rs);
+            return Float(0.25) * D * F * G / (NdotV * NdotL);
+        }
         return Spectrum::zero();
     }
-    const Float HdotL = math::dot(H, Wi);
-    const Float NdotL = Ndot(Wi);
-    const Float NdotV = Ndot(Wo);
-    const Float NdotH = Ndot(H);
-    const Float D = Distribution->D(NdotH);
-    const Spectrum Fresnel = FresnelSchlick(HdotL, Rs);
-
-    //  28 
-    //------- * Rd * (1-Rs) * (1 - pow5(1 - 0.5 * NdotL)) * (1 - pow5(1 - 0.5 * NdotV))
-    // 23*Pi
-    Spectrum Diffuse = DiffuseWeight
-        * (Float(1) - math::power<5>(Float(1) - Float(0.5) * NdotL))
-        * (Float(1) - math::power<5>(Float(1) - Float(0.5) * NdotV));
-
-    //         D * F
-    //-------------------------------
-    // 4 * HdotL * max(NdotL, NdotV)
-    Spectrum SpecularMask = (D * Fresnel * Float(0.25)) / (HdotL * math::max2(NdotL, NdotV)) * Spectrum::one();
-
-    return Diffuse + SpecularMask;
-}
+    else if constexpr (Type == BSDFLobeType::AshikhminAndShirley)
+    {
+        if (!geometry.IsHalfVectorValid)
+        {
+            return Spectrum::zero();
+        }
 
-Float AshikhminAndShirley::pdf(const Direction& Wo, const Direction& Wi) const
-{
-    const Direction H = Wo + Wi;
-    if (math::near_zero(H))
+        //  28
+        //------- * Rd * (1-Rs) * (1 - pow5(1 - 0.5 * NdotL)) * (1 - pow5(1 - 0.5 * NdotV))
+        // 23*Pi
+        Spectrum Diffuse = lobe.DiffuseWeight
+            * (Float(1) - math::power<5>(Float(1) - Float(0.5) * geometry.NdotL))
+            * (Float(1) - math::power<5>(Float(1) - Float(0.5) * geometry.NdotV));
+        return Diffuse + AshikhminAndShirleySpecularF(lobe.AlphaSquare, lobe.Rs, geometry);
+    }
+    else if constexpr (Type == BSDFLobeType::AshikhminAndShirleyDiffuse)
     {
-        return Float(0);
+        // 28*Rd
+        //------- * (1-Rs) *(1 - pow5(1 - 0.5 * NdotL)) * (1 - pow5(1 - 0.5 * NdotV))
+        // 23*Pi
+        return Spectrum::one() * (lobe.Rd
+            * (Float(1) - math::power<5>(Float(1) - Float(0.5) * geometry.NdotL))
+            * (Float(1) - math::power<5>(Float(1) - Float(0.5) * geometry.NdotV)));
+    }
+    else
+    {
+        static_assert(Type == BSDFLobeType::AshikhminAndShirleySpecular, "unknown lobe type.");
+        return geometry.IsHalfVectorValid
+            ? AshikhminAndShirleySpecularF(lobe.AlphaSquare, lobe.Rs, geometry)
+            : Spectrum::zero();
     }
-
-    Float NdotH = Ndot(H);
-    Float NdotL = Ndot(Wi);
-    Float HdotV = math::dot(H, Wo);
-    Float D = Distribution->D(NdotH);
-    //copy from Pbrt, same with UE4.
-    // D * NdotH
-    //-----------
-    // 4 * HdotV
-    Float SpecularPdf = D * NdotH * Float(0.25) / HdotV;
-    Float DiffusePdf = math::saturate(NdotL) * math::InvPI<Float>;
-
-    return Float(0.5) * (SpecularPdf + DiffusePdf);
 }
 
-AshikhminAndShirleyDiffuse::AshikhminAndShirleyDiffuse(const Spectrum& Rd, const Spectrum& Rs)
-    : BSDF("Ashikhmin-Shirley Diffuse", BSDFMask::DiffuseMask), Rd(Rd)
-    , DiffuseWeight((Float(28) / Float(23) * math::InvPI<Float>)* (Rd* (Spectrum::one() - Rs)))
+template<BSDFLobeType Type>
+Float EvaluateLobePdf(const BSDFLobe& lobe, const ShadingGeometry& geometry)
 {
+    if constexpr (Type == BSDFLobeType::Lambertian || Type == BSDFLobeType::OrenNayar || Type == BSDFLobeType::AshikhminAndShirleyDiffuse)
+    {
+        return math::saturate(geometry.NdotL) * math::InvPI<Float>;
+    }
+    else if constexpr (Type == BSDFLobeType::TorranceSparrow)
+    {
+        return GGXSpecularPdf(lobe.AlphaSquare, geometry);
+    }
+    else if constexpr (Type == BSDFLobeType::AshikhminAndShirley)
+    {
+        if (!geometry.IsHalfVectorValid)
+        {
+            return Float(0);
+        }
+        return Float(0.5) * (GGXSpecularPdf(lobe.AlphaSquare, geometry) + math::saturate(geometry.NdotL) * math::InvPI<Float>);
+    }
+    else
+    {
+        static_assert(Type == BSDFLobeType::AshikhminAndShirleySpecular, "unknown lobe type.");
+        return geometry.IsHalfVectorValid ? GGXSpecularPdf(lobe.AlphaSquare, geometry) : Float(0);
+    }
 }
 
-bool AshikhminAndShirleyDiffuse::SampleFCosOverPdf(Float u[3], const Direction& Wo, BSDFSample& oBSDFSample) const
+/**
+* all lobes of a material in one unrolled pass, Types lists the lobe types in order.
+* sums are taken in the same order as the per-lobe loop, results are bit-identical.
+*/
+template<BSDFLobeType... Types>
+void EvaluateLobes(const BSDFLobe* lobes, const Float* selectionPdf, const ShadingGeometry& geometry, Spectrum& f, Float& pdf)
 {
-    const Direction Wi = GenerateCosineWeightedHemisphereDirection(u[1], u[2]);
-    const Float NdotL = Ndot(Wi);
-    oBSDFSample.Wi = Wi;
-    oBSDFSample.F = f(Wo, Wi) * NdotL / pdf(Wo, Wi);
-    oBSDFSample.CosineWi = NdotL;
-    oBSDFSample.SampleMask = BSDFMask::DiffuseMask;
-    return NdotL > Float(0);
+    uint32_t index = 0;
+    ((f += lobes[index].Weight * EvaluateLobeF<Types>(lobes[index], geometry),
+        pdf += selectionPdf[index] * EvaluateLobePdf<Types>(lobes[index], geometry),
+        index++), ...);
 }
 
-
-Direction AshikhminAndShirleyDiffuse::SampleWi(Float u[3], const Direction& Wo) const
+//key of a lobe combination, one byte per lobe, zero for no lobe.
+constexpr uint32_t LobeCombination(BSDFLobeType first)
 {
-    return GenerateCosineWeightedHemisphereDirection(u[1], u[2]);
+    return static_cast<uint32_t>(first) + 1;
 }
 
-
-Spectrum AshikhminAndShirleyDiffuse::f(const Direction& Wo, const Direction& Wi) const
+constexpr uint32_t LobeCombination(BSDFLobeType first, BSDFLobeType second)
 {
-    const Float NdotL = Ndot(Wi);
-    const Float NdotV = Ndot(Wo);
-
-    // 28*Rd 
-    //------- * (1-Rs) *(1 - pow5(1 - 0.5 * NdotL)) * (1 - pow5(1 - 0.5 * NdotV))
-    // 23*Pi
-    Spectrum Diffse = Spectrum::one() * (Rd
-        * (Float(1) - math::power<5>(Float(1) - Float(0.5) * NdotL))
-        * (Float(1) - math::power<5>(Float(1) - Float(0.5) * NdotV)));
-    return Diffse;
+    return LobeCombination(first) | (LobeCombination(second) << 8);
 }
 
-Float AshikhminAndShirleyDiffuse::pdf(const Direction& Wo, const Direction& Wi) const
+Spectrum BSDFLobe::f(const ShadingGeometry& geometry) const
 {
-    Float NdotL = Ndot(Wi);
-    return math::saturate(NdotL) * math::InvPI<Float>;
+    switch (Type)
+    {
+    case BSDFLobeType::Lambertian: return EvaluateLobeF<BSDFLobeType::Lambertian>(*this, geometry);
+    case BSDFLobeType::OrenNayar: return EvaluateLobeF<BSDFLobeType::OrenNayar>(*this, geometry);
+    case BSDFLobeType::TorranceSparrow: return EvaluateLobeF<BSDFLobeType::TorranceSparrow>(*this, geometry);
+    case BSDFLobeType::AshikhminAndShirley: return EvaluateLobeF<BSDFLobeType::AshikhminAndShirley>(*this, geometry);
+    case BSDFLobeType::AshikhminAndShirleyDiffuse: return EvaluateLobeF<BSDFLobeType::AshikhminAndShirleyDiffuse>(*this, geometry);
+    case BSDFLobeType::AshikhminAndShirleySpecular: return EvaluateLobeF<BSDFLobeType::AshikhminAndShirleySpecular>(*this, geometry);
+    }
+    return Spectrum::zero();
 }
 
-AshikhminAndShirleySpecular::AshikhminAndShirleySpecular(std::unique_ptr<DistributionFunction>&& distrib, const Spectrum& Rs)
-    : BSDF("Ashikhmin-Shirley Specular"
-        , (distrib->IsNearMirrorReflection()
-            ? (BSDFMask::MirrorMask | BSDFMask::SpecularMask)
-            : BSDFMask::SpecularMask))
-    , Distribution(std::move(distrib)), Rs(Rs)
+Float BSDFLobe::pdf(const ShadingGeometry& geometry) const
 {
+    switch (Type)
+    {
+    case BSDFLobeType::Lambertian: return EvaluateLobePdf<BSDFLobeType::Lambertian>(*this, geometry);
+    case BSDFLobeType::OrenNayar: return EvaluateLobePdf<BSDFLobeType::OrenNayar>(*this, geometry);
+    case BSDFLobeType::TorranceSparrow: return EvaluateLobePdf<BSDFLobeType::TorranceSparrow>(*this, geometry);
+    case BSDFLobeType::AshikhminAndShirley: return EvaluateLobePdf<BSDFLobeType::AshikhminAndShirley>(*this, geometry);
+    case BSDFLobeType::AshikhminAndShirleyDiffuse: return EvaluateLobePdf<BSDFLobeType::AshikhminAndShirleyDiffuse>(*this, geometry);
+    case BSDFLobeType::AshikhminAndShirleySpecular: return EvaluateLobePdf<BSDFLobeType::AshikhminAndShirleySpecular>(*this, geometry);
+    }
+    return Float(0);
 }
 
-bool AshikhminAndShirleySpecular::SampleFCosOverPdf(Float u[3], const Direction& Wo, BSDFSample& oBSDFSample) const
+Spectrum BSDFLobe::Reflectance() const
 {
-    const Direction H = Distribution->SampleWh(Wo, u[1], u[2]);
-    const Direction Wi = math::reflection(Wo, H);
-
-    const Float NdotL = Ndot(Wi);
-    oBSDFSample.Wi = Wi;
-    oBSDFSample.F = f(Wo, Wi) * NdotL / pdf(Wo, Wi);
-    oBSDFSample.CosineWi = NdotL;
-    oBSDFSample.SampleMask = (Distribution->IsNearMirrorReflection()
-        ? BSDFMask::SpecularMask | BSDFMask::MirrorMask
-        : BSDFMask::SpecularMask);
-    return NdotL > Float(0);
+    switch (Type)
+    {
+    case BSDFLobeType::Lambertian:
+    case BSDFLobeType::OrenNayar:
+    case BSDFLobeType::AshikhminAndShirleyDiffuse:
+        return Rd;
+    case BSDFLobeType::AshikhminAndShirley:
+        return Rd * (Spectrum::one() - Rs) + Rs;
+    case BSDFLobeType::TorranceSparrow:
+    case BSDFLobeType::AshikhminAndShirleySpecular:
+        return Rs;
+    }
+    return Spectrum::one();
 }
 
 
-Direction AshikhminAndShirleySpecular::SampleWi(Float u[3], const Direction& Wo) const
+void Material::AddBSDFLobe(const BSDFLobe& lobe)
 {
-    const Direction H = Distribution->SampleWh(Wo, u[1], u[2]);
-    const Direction Wi = math::reflection(Wo, H);
-    return Wi;
+    assert(mLobeCount < MaxLobeCount);
+    mBSDFMask |= lobe.BSDFMask;
+    mLobeCombination |= LobeCombination(lobe.Type) << (8 * mLobeCount);
+    mLobes[mLobeCount++] = lobe;
+    UpdateLobeSelectionPdf();
 }
 
-Spectrum AshikhminAndShirleySpecular::f(const Direction& Wo, const Direction& Wi) const
+void Material::UpdateLobeSelectionPdf()
 {
-    const Direction H = Wo + Wi;
-    if (math::near_zero(H))
+    //select lobes proportional to their estimated albedo,
+    // so low-energy lobes wont waste samples.
+    Float TotalAlbedo = Float(0);
+    for (uint32_t index = 0; index < mLobeCount; index++)
     {
-        return Spectrum::zero();
+        const BSDFLobe& lobe = mLobes[index];
+        mLobeSelectionPdf[index] = math::max2(lobe.Weight * Luminance(lobe.Reflectance()), Float(0));
+        TotalAlbedo += mLobeSelectionPdf[index];
     }
-    const Float HdotL = math::dot(H, Wi);
-    const Float NdotL = Ndot(Wi);
-    const Float NdotV = Ndot(Wo);
-    const Float NdotH = Ndot(H);
-    const Float D = Distribution->D(NdotH);
-    const Spectrum Fresnel = FresnelSchlick(HdotL, Rs);
-    //         D * F
-    //-------------------------------
-    // 4 * HdotL * max(NdotL, NdotV)
-    Spectrum f = (D * Fresnel * Float(0.25)) / (HdotL * math::max2(NdotL, NdotV)) * Spectrum::one();
-    return f;
-}
 
-Float AshikhminAndShirleySpecular::pdf(const Direction& Wo, const Direction& Wi) const
-{
-    const Direction H = Wo + Wi;
-    if (math::near_zero(H))
+    for (uint32_t index = 0; index < mLobeCount; index++)
     {
-        return Float(0);
+        mLobeSelectionPdf[index] = (TotalAlbedo > Float(0))
+            ? mLobeSelectionPdf[index] / TotalAlbedo
+            : Float(1) / static_cast<Float>(mLobeCount);
     }
-    const Float HdotV = math::dot(H, Wo);
-    const Float pdf = Distribution->pdf(Wo, Wi);
-    return pdf * Float(0.25) / HdotV;
-}
-
-
-void Material::AddBSDFComponent(std::unique_ptr<BSDF> component)
-{
-    mBSDFMask |= component->BSDFMask;
-    mBSDFComponents.emplace_back(std::move(component));
 }
 
-const std::unique_ptr<BSDF>& Material::GetBSDFComponentByMask(uint32_t mask) const
+const BSDFLobe& Material::GetRandomLobe(Float u) const
 {
-    static std::unique_ptr<BSDF> dummy = nullptr;
-    for (const auto& comp : mBSDFComponents)
+    Float Cdf = Float(0);
+    for (uint32_t index = 0; index + 1 < mLobeCount; index++)
     {
-        if (comp->BSDFMask & mask)
+        Cdf += mLobeSelectionPdf[index];
+        if (u < Cdf)
         {
-            return comp;
+            return GetLobeByIndex(index);
         }
     }
-    return dummy;
+    return GetLobeByIndex(mLobeCount - 1);
 }
 
-const std::unique_ptr<BSDF>& Material::GetRandomBSDFComponent(Float u) const
+void Material::Evaluate(const Direction& Wo, const Direction& Wi, Spectrum& f, Float& pdf) const
 {
-    uint32_t length = (uint32_t)mBSDFComponents.size();
-    uint32_t index = math::min2<uint32_t>(math::floor2<uint32_t>(u * length), length - 1);
-    return GetBSDFComponentByIndex(index);
-}
+    const ShadingGeometry geometry(Wo, Wi);
+    f = Spectrum::zero();
+    pdf = Float(0);
 
-Spectrum Material::SampleF(const Direction& Wo, const Direction& Wi) const
-{
-    Spectrum f = Spectrum::zero();
-    for (auto& bsdf : mBSDFComponents)
+    //combinations made by the factories are unrolled at compile time,
+    // any other goes through per-lobe dispatch.
+    switch (mLobeCombination)
     {
-        f += bsdf->Weight * bsdf->f(Wo, Wi);
+    case LobeCombination(BSDFLobeType::Lambertian):
+        EvaluateLobes<BSDFLobeType::Lambertian>(mLobes, mLobeSelectionPdf, geometry, f, pdf);
+        return;
+    case LobeCombination(BSDFLobeType::OrenNayar):
+        EvaluateLobes<BSDFLobeType::OrenNayar>(mLobes, mLobeSelectionPdf, geometry, f, pdf);
+        return;
+    case LobeCombination(BSDFLobeType::TorranceSparrow):
+        EvaluateLobes<BSDFLobeType::TorranceSparrow>(mLobes, mLobeSelectionPdf, geometry, f, pdf);
+        return;
+    case LobeCombination(BSDFLobeType::Lambertian, BSDFLobeType::TorranceSparrow):
+        EvaluateLobes<BSDFLobeType::Lambertian, BSDFLobeType::TorranceSparrow>(mLobes, mLobeSelectionPdf, geometry, f, pdf);
+        return;
+    case LobeCombination(BSDFLobeType::AshikhminAndShirleyDiffuse, BSDFLobeType::AshikhminAndShirleySpecular):
+        EvaluateLobes<BSDFLobeType::AshikhminAndShirleyDiffuse, BSDFLobeType::AshikhminAndShirleySpecular>(mLobes, mLobeSelectionPdf, geometry, f, pdf);
+        return;
     }
-    return f;
-}
 
-Float Material::SamplePdf(const Direction& Wo, const Direction& Wi) const {
-    Float pdf = 0;
-    size_t Num = mBSDFComponents.size();
-    for (auto& bsdf : mBSDFComponents)
+    for (uint32_t index = 0; index < mLobeCount; index++)
     {
-        pdf += bsdf->pdf(Wo, Wi);
+        const BSDFLobe& lobe = mLobes[index];
+        f += lobe.Weight * lobe.f(geometry);
+        pdf += mLobeSelectionPdf[index] * lobe.pdf(geometry);
     }
-    return pdf / static_cast<Float>(Num);
 }
 
+Spectrum Material::SampleF(const Direction& Wo, const Direction& Wi) const
+{
+    Spectrum f; Float pdf;
+    Evaluate(Wo, Wi, f, pdf);
+    return f;
+}
 
+Float Material::SamplePdf(const Direction& Wo, const Direction& Wi) const
+{
+    Spectrum f; Float pdf;
+    Evaluate(Wo, Wi, f, pdf);
+    return pdf;
+}
 
+Spectrum Material::GetAlbedo() const
+{
+    Spectrum albedo = Spectrum::zero();
+    for (uint32_t index = 0; index < mLobeCount; index++)
+    {
+        albedo += mLobes[index].Weight * mLobes[index].Reflectance();
+    }
+    return math::min_comp_wise(albedo, Spectrum::one());
+}
 
+Material Material::ModulateAlbedo(const Spectrum& scale) const
+{
+    Material result = *this;
+    for (uint32_t index = 0; index < result.mLobeCount; index++)
+    {
+        BSDFLobe& lobe = result.mLobes[index];
+        if ((lobe.BSDFMask & BSDFMask::DiffuseMask) != 0)
+        {
+            lobe.Rd *= scale;
+            lobe.DiffuseWeight *= scale;
+        }
+    }
+    result.UpdateLobeSelectionPdf();
+    return result;
+}
 
 std::unique_ptr<Material> Material::CreateMatte(const Spectrum& albedo)
 {
     std::unique_ptr<Material> material = std::make_unique<Material>();
-    std::unique_ptr<Lambertian> compLambertian = std::make_unique<Lambertian>(albedo);
-
-    material->AddBSDFComponent(std::move(compLambertian));
-
+    material->AddBSDFLobe(BSDFLobe::Lambertian(albedo));
     return material;
 }
 
 std::unique_ptr<Material> Material::CreateMatte(const Spectrum& albedo, Radian sigma)
 {
     std::unique_ptr<Material> material = std::make_unique<Material>();
-    std::unique_ptr<OrenNayar> compLambertian = std::make_unique<OrenNayar>(albedo, sigma);
-
-    material->AddBSDFComponent(std::move(compLambertian));
-
+    material->AddBSDFLobe(BSDFLobe::OrenNayar(albedo, sigma));
     return material;
 }
 
@@ -782,30 +747,19 @@ std::unique_ptr<Material> Material::CreateMatte(const Spectrum& albedo, Radian s
 std::unique_ptr<Material> Material::CreatePlastic(const Spectrum& albedo, Float roughness, const Spectrum& Rs)
 {
     std::unique_ptr<Material> material = std::make_unique<Material>();
-    std::unique_ptr<DistributionGGX> distribGGX = std::make_unique<DistributionGGX>(roughness);
-    std::unique_ptr<Lambertian> compLambertian = std::make_unique<Lambertian>(albedo);
-    std::unique_ptr<Mircofacet> compSpecular = std::make_unique<Mircofacet>(std::move(distribGGX), Rs);
-
-    material->AddBSDFComponent(std::move(compLambertian));
-    material->AddBSDFComponent(std::move(compSpecular));
-
+    material->AddBSDFLobe(BSDFLobe::Lambertian(albedo));
+    material->AddBSDFLobe(BSDFLobe::TorranceSparrow(roughness, Rs));
     return material;
 }
 
 std::unique_ptr<Material> Material::CreateAshikhminAndShirley(Float roughness, const Spectrum& Rd, const Spectrum& Rs)
 {
-
     std::unique_ptr<Material> material = std::make_unique<Material>();
-    std::unique_ptr<DistributionGGX> distribGGX = std::make_unique<DistributionGGX>(roughness);
-
-    //std::unique_ptr<AshikhminAndShirley> compGGX = std::make_unique<AshikhminAndShirley>(std::move(distribGGX), Rd, Rs);
-    //material->AddBSDFComponent(std::move(compGGX));
 
-    std::unique_ptr<AshikhminAndShirleyDiffuse> compDiffuse = std::make_unique<AshikhminAndShirleyDiffuse>(Rd, Rs);
-    std::unique_ptr<AshikhminAndShirleySpecular> compSpecular = std::make_unique<AshikhminAndShirleySpecular>(std::move(distribGGX), Rs);
-    material->AddBSDFComponent(std::move(compDiffuse));
-    material->AddBSDFComponent(std::move(compSpecular));
+    //material->AddBSDFLobe(BSDFLobe::AshikhminAndShirley(roughness, Rd, Rs));
 
+    material->AddBSDFLobe(BSDFLobe::AshikhminAndShirleyDiffuse(Rd, Rs));
+    material->AddBSDFLobe(BSDFLobe::AshikhminAndShirleySpecular(roughness, Rs));
     return material;
 }
 
@@ -813,10 +767,6 @@ std::unique_ptr<Material> Material::CreateAshikhminAndShirley(Float roughness, c
 std::unique_ptr<Material> Material::CreateMicrofacetGGX_Debug(Float roughness, const Spectrum& Rs)
 {
     std::unique_ptr<Material> material = std::make_unique<Material>();
-    std::unique_ptr<DistributionGGX> distribGGX = std::make_unique<DistributionGGX>(roughness);
-    std::unique_ptr<Mircofacet> compGGX = std::make_unique<Mircofacet>(std::move(distribGGX), Rs);
-
-    material->AddBSDFComponent(std::move(compGGX));
-
+    material->AddBSDFLobe(BSDFLobe::TorranceSparrow(roughness, Rs));
     return material;
 }
@@ -14,6 +14,14 @@ struct random
     static T value() { return instance()(); }
     static T range(T range_value) { return instance()(range_value); }
 
+    //deterministic stream, used to reproduce a progressive render.
+    void seed(uint32_t seed, uint32_t stream)
+    {
+        std::seed_seq sequence{ seed, stream };
+        generator.seed(sequence);
+        distribution.reset();
+    }
+
 private:
     T _value() { return distribution(generator); }
     T _range(T range_value) { return _value() * T(2) * range_value - range_value; }
@@ -23,10 +31,57 @@ private:
     std::uniform_real_distribution<Float> distribution;
 };
 
+/**
+* pcg32 generator, one of 2^63 streams selected by the increment.
+* 16 bytes and no system entropy, so it is cheap to keep per task and reseed per block,
+* value() reads this instance, unlike random<T>::value() which reads the shared one.
+*/
+template<typename T>
+struct stream_random
+{
+    T operator()() { return value(); }
+
+    //53 bits of two outputs, uniform in [0, 1).
+    T value()
+    {
+        const uint64_t high = next();
+        const uint64_t low = next();
+        return static_cast<T>(((high << 21) ^ low) & ((uint64_t(1) << 53) - 1)) * T(1.0 / 9007199254740992.0);
+    }
+
+    //the whole 64-bit seed enters the state, callers may pack frame and block into it.
+    void seed(uint64_t seed, uint32_t stream)
+    {
+        state = 0;
+        increment = (static_cast<uint64_t>(stream) << 1) | 1u;
+        next();
+        state += seed;
+        next();
+    }
+
+private:
+    uint32_t next()
+    {
+        const uint64_t previous = state;
+        state = previous * 6364136223846793005ull + increment;
+        const uint32_t xorshifted = static_cast<uint32_t>(((previous >> 18) ^ previous) >> 27);
+        const uint32_t rotation = static_cast<uint32_t>(previous >> 59);
+        return (xorshifted >> rotation) | (xorshifted << ((32 - rotation) & 31));
+    }
+
+    uint64_t state = 0x853c49e6748fea9bull;
+    uint64_t increment = 0xda3e39cb94b95bdbull;
+};
+
 
 Float BalanceHeuristic(Float pdfA, Float pdfB);
 Float PowerHeuristic(Float pdfA, Float pdfB);
 
+inline Float Luminance(const Spectrum& value)
+{
+    return math::dot(value, Spectrum(Float(0.2126), Float(0.7152), Float(0.0722)));
+}
+
 enum BSDFMask : uint32_t
 {
     None = 0,
@@ -35,36 +90,6 @@ enum BSDFMask : uint32_t
     MirrorMask = 1 << 15
 };
 
-struct BSDFSample
-{
-    Direction Wi = Direction::unit_y();
-    Spectrum F = Spectrum::zero();
-    Float CosineWi = Float(0);
-    uint32_t SampleMask = BSDFMask::None;
-};
-
-struct DistributionFunction
-{
-    virtual ~DistributionFunction() = default;
-    virtual bool IsNearMirrorReflection() const = 0;
-    virtual Direction SampleWh(const Direction& Wo, Float u1, Float u2) const = 0;
-    virtual Float D(Float NdotH) const = 0;
-    virtual Float G(Float NdotH, Float HdotV, Float HdotL) const = 0;
-    virtual Float pdf(const Direction& Wo, const Direction& Wi)const = 0;
-};
-
-struct DistributionGGX : DistributionFunction
-{
-    Float Roughness;
-    Float Alpha, AlphaSquare;
-    DistributionGGX(Float roughness = Float(0.5));
-    virtual bool IsNearMirrorReflection() const override { return math::near_zero(Roughness); }
-    virtual Direction SampleWh(const Direction& Wo, Float u1, Float u2) const override;
-    virtual Float D(Float NdotH) const override;
-    virtual Float G(Float NdotH, Float HdotV, Float HdotL) const override;
-    virtual Float pdf(const Direction& Wo, const Direction& Wi) const override;
-};
-
 struct RefractionIndexSetting
 {
     //https://refractiveindex.info/?shelf=3d&book=metals&page=gold
@@ -100,22 +125,72 @@ namespace SpecularColor
     static Spectrum Platinum() { return     Spectrum(0.679, 0.642, 0.588); }
 };
 
-struct BSDF
+enum class BSDFLobeType : uint32_t
 {
-    const std::string DebugName;
-    const uint32_t BSDFMask;
+    Lambertian,
+    OrenNayar,
+    TorranceSparrow,
+    AshikhminAndShirley,
+    AshikhminAndShirleyDiffuse,
+    AshikhminAndShirleySpecular,
+};
+
+/**
+* terms shared by all lobes of a material,
+* calculated once for each (Wo, Wi) pair.
+*/
+struct ShadingGeometry
+{
+    ShadingGeometry(const Direction& Wo, const Direction& Wi);
+    const Direction& Wo;
+    const Direction& Wi;
+    const Direction H;
+    const bool IsHalfVectorValid;
+    const Float NdotL, NdotV, NdotH;
+    const Float HdotV, HdotL;
+};
+
+/**
+* flat tagged bsdf lobe, dispatched by Type instead of virtual call.
+* parameters unused by the lobe type keep their default values.
+*/
+struct BSDFLobe
+{
+    static BSDFLobe Lambertian(const Spectrum& albedo);
+    static BSDFLobe OrenNayar(const Spectrum& albedo, Radian sigma);
+    static BSDFLobe TorranceSparrow(Float roughness, const Spectrum& Rs);
+    static BSDFLobe AshikhminAndShirley(Float roughness, const Spectrum& Rd, const Spectrum& Rs);
+    static BSDFLobe AshikhminAndShirleyDiffuse(const Spectrum& Rd, const Spectrum& Rs);
+    static BSDFLobe AshikhminAndShirleySpecular(Float roughness, const Spectrum& Rs);
+
+    BSDFLobeType Type = BSDFLobeType::Lambertian;
+    uint32_t BSDFMask = BSDFMask::DiffuseMask;
     Float Weight = Float(1);
 
-    BSDF(const std::string& debugName, uint32_t mask) : DebugName(debugName), BSDFMask(mask) { }
-    virtual ~BSDF() { }
-    virtual bool SampleFCosOverPdf(Float u[3], const Direction& Wo, BSDFSample& oBSDFSample) const = 0;
-    virtual Direction SampleWi(Float u[3],  const Direction& Wo) const = 0;
-    virtual Spectrum f(const Direction& Wo, const Direction& Wi) const { return Spectrum::zero(); }
-    virtual Float pdf(const Direction& Wo, const Direction& Wi) const { return Float(1); }
+    // Albedo of diffuse lobes, Rd of ashikhmin-shirley.
+    Spectrum Rd = Spectrum::one();
+    Spectrum Rs = Spectrum::one();
+    Spectrum DiffuseWeight = Spectrum::zero();
+
+    // GGX distribution.
+    Float Roughness = Float(0);
+    Float Alpha = Float(0);
+    Float AlphaSquare = Float(0);
+
+    // Oren-Nayar.
+    Float A = Float(1);
+    Float B = Float(0);
+
+    bool IsNearMirrorReflection() const { return math::near_zero(Roughness); }
+    Direction SampleWi(Float u[3], const Direction& Wo) const;
+    Spectrum f(const ShadingGeometry& geometry) const;
+    Float pdf(const ShadingGeometry& geometry) const;
+    Spectrum Reflectance() const;
 };
 
 struct Material
 {
+    static const uint32_t MaxLobeCount = 2;
     static std::unique_ptr<Material> CreateMatte(const Spectrum& albedo = Spectrum::one());
     static std::unique_ptr<Material> CreateMatte(const Spectrum& albedo, Radian sigma);
     static std::unique_ptr<Material> CreatePlastic(const Spectrum& albedo, Float roughness, const Spectrum& Rs = Spectrum::one());
@@ -123,100 +198,38 @@ struct Material
     static std::unique_ptr<Material> CreateMicrofacetGGX_Debug(Float roughness, const Spectrum& Rs);
 
     Material() = default;
-    void AddBSDFComponent(std::unique_ptr<BSDF> component);
-    bool IsValid() const { return mBSDFComponents.size() > 0; }
-    const std::unique_ptr<BSDF>& GetBSDFComponentByIndex(uint32_t index) const { return mBSDFComponents[index]; }
-    const std::unique_ptr<BSDF>& GetBSDFComponentByMask(uint32_t mask) const;
-    const std::unique_ptr<BSDF>& GetRandomBSDFComponent(Float u) const;
+    void AddBSDFLobe(const BSDFLobe& lobe);
+    bool IsValid() const { return mLobeCount > 0; }
+    uint32_t GetLobeCount() const { return mLobeCount; }
+    const BSDFLobe& GetLobeByIndex(uint32_t index) const { return mLobes[index]; }
+    Float GetLobeSelectionPdf(uint32_t index) const { return mLobeSelectionPdf[index]; }
+    const BSDFLobe& GetRandomLobe(Float u) const;
+
+    /**
+    * evaluate f and pdf of all lobes in a single pass,
+    * pdf is the one-sample mixture of lobe pdfs weighted by their selection probability.
+    */
+    void Evaluate(const Direction& Wo, const Direction& Wi, Spectrum& f, Float& pdf) const;
     Spectrum SampleF(const Direction& Wo, const Direction& Wi) const;
     Float SamplePdf(const Direction& Wo, const Direction& Wi) const;
+    Spectrum GetAlbedo() const;
+
+    //texture multiplied onto diffuse albedo, -1 for none.
+    void SetAlbedoTexture(int texture) { mAlbedoTexture = texture; }
+    int GetAlbedoTexture() const { return mAlbedoTexture; }
+    bool HasAlbedoTexture() const { return mAlbedoTexture >= 0; }
+    Material ModulateAlbedo(const Spectrum& scale) const;
 
 private:
-    std::vector<std::unique_ptr<BSDF>> mBSDFComponents;
+    void UpdateLobeSelectionPdf();
+    BSDFLobe mLobes[MaxLobeCount];
+    Float mLobeSelectionPdf[MaxLobeCount] = { Float(0) };
+    uint32_t mLobeCount = 0;
+    uint32_t mLobeCombination = 0;
     uint32_t mBSDFMask = 0;
+    int mAlbedoTexture = -1;
 };
 
-struct Lambertian : public BSDF
-{
-    Spectrum Albedo = Spectrum::one();
-
-    Lambertian() : BSDF("Lambertian", BSDFMask::DiffuseMask) { }
-    Lambertian(const Spectrum& albedo) : BSDF("Lambertian", BSDFMask::DiffuseMask), Albedo(albedo) { }
-    virtual bool SampleFCosOverPdf(Float u[3], const Direction& Wo, BSDFSample& oBSDFSample) const override;
-    virtual Direction SampleWi(Float u[3],  const Direction& Wo) const override;
-    virtual Spectrum f(const Direction& Wo, const Direction& Wi) const override;
-    virtual Float pdf(const Direction& Wo, const Direction& Wi) const override;
-};
-
-struct OrenNayar : public BSDF
-{
-    Spectrum Albedo = Spectrum::one();
-    Radian Sigma = 0_degd;
-    Radian SigmaSquare = 0_degd;
-    Float A = Float(1);
-    Float B = Float(0);
-
-    OrenNayar() : BSDF("Oren-Nayer", BSDFMask::DiffuseMask) { };
-    OrenNayar(const Spectrum& albedo, Radian sigma = 0_degd);
-    virtual bool SampleFCosOverPdf(Float u[3], const Direction& Wo, BSDFSample& oBSDFSample) const override;
-    virtual Direction SampleWi(Float u[3],  const Direction& Wo) const override;
-    virtual Spectrum f(const Direction& Wo, const Direction& Wi) const override;
-    virtual Float pdf(const Direction& Wo, const Direction& Wi) const override;
-};
-
-struct TorranceSparrow : public BSDF
-{
-    std::unique_ptr<DistributionFunction> Distribution;
-    Spectrum Rs;
-
-    TorranceSparrow(std::unique_ptr<DistributionFunction>&& distrib, const Spectrum& Rs);
-    virtual bool SampleFCosOverPdf(Float u[3], const Direction& Wo, BSDFSample& oBSDFSample) const override;
-    virtual Direction SampleWi(Float u[3],  const Direction& Wo) const override;
-    virtual Spectrum f(const Direction& Wo, const Direction& Wi) const override;
-    virtual Float pdf(const Direction& Wo, const Direction& Wi) const override;
-};
-
-struct AshikhminAndShirley : public BSDF
-{
-    std::unique_ptr<DistributionFunction> Distribution;
-    Spectrum Rd = Spectrum::one();
-    Spectrum Rs = Spectrum::one();
-    Spectrum OneMinusRs = Spectrum::zero();
-    Spectrum DiffuseWeight = (Float(28) / Float(23) * math::InvPI<Float>) * Spectrum::one();
-
-    AshikhminAndShirley(std::unique_ptr<DistributionFunction>&& distrib, const Spectrum& Rd, const Spectrum& Rs);
-    virtual bool SampleFCosOverPdf(Float u[3], const Direction& Wo, BSDFSample& oBSDFSample) const override;
-    virtual Direction SampleWi(Float u[3],  const Direction& Wo) const override;
-    virtual Spectrum f(const Direction& Wo, const Direction& Wi) const override;
-    virtual Float pdf(const Direction& Wo, const Direction& Wi) const override;
-};
-
-struct AshikhminAndShirleyDiffuse : public BSDF
-{
-    Spectrum Rd = Spectrum::one();
-    Spectrum DiffuseWeight = (Float(28) / Float(23) * math::InvPI<Float>) * Spectrum::one();
-
-    AshikhminAndShirleyDiffuse(const Spectrum& Rd, const Spectrum& Rs);
-    virtual bool SampleFCosOverPdf(Float u[3], const Direction& Wo, BSDFSample& oBSDFSample) const override;
-    virtual Direction SampleWi(Float u[3],  const Direction& Wo) const override;
-    virtual Spectrum f(const Direction& Wo, const Direction& Wi) const override;
-    virtual Float pdf(const Direction& Wo, const Direction& Wi) const override;
-};
-
-struct AshikhminAndShirleySpecular : public BSDF
-{
-    std::unique_ptr<DistributionFunction> Distribution;
-    Spectrum Rs = Spectrum::one();
-
-    AshikhminAndShirleySpecular(std::unique_ptr<DistributionFunction>&& distrib, const Spectrum& Rs);
-    virtual bool SampleFCosOverPdf(Float u[3], const Direction& Wo, BSDFSample& oBSDFSample) const override;
-    virtual Direction SampleWi(Float u[3],  const Direction& Wo) const override;
-    virtual Spectrum f(const Direction& Wo, const Direction& Wi) const override;
-    virtual Float pdf(const Direction& Wo, const Direction& Wi) const override;
-};
-
-using Mircofacet = TorranceSparrow;
-
 
 inline Float CosTheta(const Direction& w) { return w.z; }
 inline Float Cos2Theta(const Direction& w) { return w.z * w.z; }
@@ -0,0 +1,167 @@
+#include <cmath>
+#include <Foundation/Math/PredefinedConstantValues.h>
+#include "PathGuide.h"
+
+namespace
+{
+    // keep a part of uniform distribution,
+    // so that directions never seen in training still can be sampled.
+    const Float UniformMixture = Float(0.1);
+
+    void AtomicAdd(std::atomic<float>& target, float value)
+    {
+        float expected = target.load(std::memory_order_relaxed);
+        while (!target.compare_exchange_weak(expected, expected + value, std::memory_order_relaxed));
+    }
+
+    //mirror about the tangent plane, maps the lower hemisphere onto the upper one.
+    Direction MirrorDirection(const Direction& direction, const Direction& normal)
+    {
+        return direction - Float(2) * math::dot(direction, normal) * normal;
+    }
+}
+
+PathGuide::PathGuide(Float cellSize)
+    : mInvCellSize(Float(1) / cellSize)
+    , mTrainingCells(new TrainingCell[SpatialCellCount])
+    , mSamplingCells(SpatialCellCount)
+{
+    Reset();
+}
+
+uint32_t PathGuide::CellIndex(const Point& position) const
+{
+    const int32_t x = math::floor2<int32_t>(std::floor(position.x * mInvCellSize));
+    const int32_t y = math::floor2<int32_t>(std::floor(position.y * mInvCellSize));
+    const int32_t z = math::floor2<int32_t>(std::floor(position.z * mInvCellSize));
+    const uint32_t hash = (uint32_t(x) * 73856093u) ^ (uint32_t(y) * 19349663u) ^ (uint32_t(z) * 83492791u);
+    return hash % SpatialCellCount;
+}
+
+int PathGuide::DirectionToBin(const Direction& direction)
+{
+    // equal-area mapping: cos(theta) and phi are both uniform.
+    const Float cosTheta = math::clamp(direction.z, Float(-1), Float(1));
+    Float phi = std::atan2(direction.y, direction.x);
+    if (phi < Float(0))
+    {
+        phi += math::TWO_PI<Float>;
+    }
+
+    const int thetaIndex = math::min2(math::floor2<int>((cosTheta + Float(1)) * Float(0.5) * DirectionalBinsTheta), DirectionalBinsTheta - 1);
+    const int phiIndex = math::min2(math::floor2<int>(phi / math::TWO_PI<Float> * DirectionalBinsPhi), DirectionalBinsPhi - 1);
+    return thetaIndex * DirectionalBinsPhi + phiIndex;
+}
+
+bool PathGuide::IsTrained(const Point& position) const
+{
+    return mSamplingCells[CellIndex(position)].IsValid;
+}
+
+Direction PathGuide::Sample(const Point& position, const Direction& normal, Float u1, Float u2, Float u3) const
+{
+    const SamplingCell& cell = mSamplingCells[CellIndex(position)];
+
+    int bin = DirectionalBinCount - 1;
+    for (int index = 0; index < DirectionalBinCount; index++)
+    {
+        if (u1 < cell.Cdf[index])
+        {
+            bin = index;
+            break;
+        }
+    }
+
+    const int thetaIndex = bin / DirectionalBinsPhi;
+    const int phiIndex = bin % DirectionalBinsPhi;
+    const Float cosTheta = Float(-1) + Float(2) * (thetaIndex + u2) / DirectionalBinsTheta;
+    const Float sinTheta = sqrt(math::max2(Float(0), Float(1) - cosTheta * cosTheta));
+    const Radian phi(math::TWO_PI<Float> * (phiIndex + u3) / DirectionalBinsPhi);
+    const Direction direction(sinTheta * math::cos(phi), sinTheta * math::sin(phi), cosTheta);
+    return math::dot(direction, normal) < Float(0) ? MirrorDirection(direction, normal) : direction;
+}
+
+Float PathGuide::Pdf(const Point& position, const Direction& normal, const Direction& direction) const
+{
+    //a direction above the surface is reached directly or through its mirror.
+    if (math::dot(direction, normal) <= Float(0))
+    {
+        return Float(0);
+    }
+
+    const SamplingCell& cell = mSamplingCells[CellIndex(position)];
+    return SphericalPdf(cell, direction) + SphericalPdf(cell, MirrorDirection(direction, normal));
+}
+
+Float PathGuide::SphericalPdf(const SamplingCell& cell, const Direction& direction) const
+{
+    //every bin covers the same solid angle 4*Pi / N.
+    const Float InvBinSolidAngle = DirectionalBinCount / (Float(4) * math::PI<Float>);
+    return cell.IsValid
+        ? cell.Pdf[DirectionToBin(direction)] * InvBinSolidAngle
+        : InvBinSolidAngle / DirectionalBinCount;
+}
+
+void PathGuide::Splat(const Point& position, const Direction& direction, Float radiance)
+{
+    if (!(radiance > Float(0)) || !std::isfinite(radiance))
+    {
+        return;
+    }
+
+    TrainingCell& cell = mTrainingCells[CellIndex(position)];
+    AtomicAdd(cell.Bins[DirectionToBin(direction)], static_cast<float>(radiance));
+    cell.NumSamples.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PathGuide::Refresh()
+{
+    const Float UniformPdf = Float(1) / DirectionalBinCount;
+    for (int cellIndex = 0; cellIndex < SpatialCellCount; cellIndex++)
+    {
+        const TrainingCell& training = mTrainingCells[cellIndex];
+        SamplingCell& sampling = mSamplingCells[cellIndex];
+        if (training.NumSamples.load(std::memory_order_relaxed) < MinTrainingSamples)
+        {
+            sampling.IsValid = false;
+            continue;
+        }
+
+        Float total = Float(0);
+        for (int bin = 0; bin < DirectionalBinCount; bin++)
+        {
+            total += training.Bins[bin].load(std::memory_order_relaxed);
+        }
+
+        if (total <= Float(0))
+        {
+            sampling.IsValid = false;
+            continue;
+        }
+
+        Float cdf = Float(0);
+        for (int bin = 0; bin < DirectionalBinCount; bin++)
+        {
+            const Float learned = training.Bins[bin].load(std::memory_order_relaxed) / total;
+            sampling.Pdf[bin] = math::lerp(learned, UniformPdf, UniformMixture);
+            cdf += sampling.Pdf[bin];
+            sampling.Cdf[bin] = cdf;
+        }
+        sampling.Cdf[DirectionalBinCount - 1] = Float(1);
+        sampling.IsValid = true;
+    }
+}
+
+void PathGuide::Reset()
+{
+    for (int cellIndex = 0; cellIndex < SpatialCellCount; cellIndex++)
+    {
+        TrainingCell& training = mTrainingCells[cellIndex];
+        for (int bin = 0; bin < DirectionalBinCount; bin++)
+        {
+            training.Bins[bin].store(0.0f, std::memory_order_relaxed);
+        }
+        training.NumSamples.store(0, std::memory_order_relaxed);
+        mSamplingCells[cellIndex].IsValid = false;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "PreInclude.h"
+
+/**
+* spatial-directional radiance cache used to guide path sampling.
+* space is hashed into uniform cells, every cell keeps a histogram of incident radiance
+* over the equal-area cylindrical mapping of the sphere.
+* training splats are lock-free, so workers can train concurrently,
+* sampling only reads the distribution built by the last Refresh().
+* directions are sampled in the hemisphere above a surface normal,
+* the part of a cell's histogram below the surface is mirrored up so no sample is wasted.
+*/
+class PathGuide
+{
+public:
+    static const int DirectionalBinsTheta = 8;
+    static const int DirectionalBinsPhi = 16;
+    static const int DirectionalBinCount = DirectionalBinsTheta * DirectionalBinsPhi;
+    static const int SpatialCellCount = 4096;
+    static const uint32_t MinTrainingSamples = 64;
+
+    PathGuide(Float cellSize = Float(8));
+
+    bool IsTrained(const Point& position) const;
+    Direction Sample(const Point& position, const Direction& normal, Float u1, Float u2, Float u3) const;
+    Float Pdf(const Point& position, const Direction& normal, const Direction& direction) const;
+    void Splat(const Point& position, const Direction& direction, Float radiance);
+
+    /**
+    * rebuild sampling distribution from training data,
+    * must not be called while workers are sampling.
+    */
+    void Refresh();
+    void Reset();
+
+    Float GuidingProbability = Float(0.5);
+
+private:
+    struct TrainingCell
+    {
+        std::atomic<float> Bins[DirectionalBinCount];
+        std::atomic<uint32_t> NumSamples;
+    };
+
+    struct SamplingCell
+    {
+        bool IsValid = false;
+        Float Pdf[DirectionalBinCount];
+        Float Cdf[DirectionalBinCount];
+    };
+
+    uint32_t CellIndex(const Point& position) const;
+    Float SphericalPdf(const SamplingCell& cell, const Direction& direction) const;
+    static int DirectionToBin(const Direction& direction);
+
+    const Float mInvCellSize;
+    std::unique_ptr<TrainingCell[]> mTrainingCells;
+    std::vector<SamplingCell> mSamplingCells;
+};
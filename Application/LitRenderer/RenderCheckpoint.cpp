@@ -0,0 +1,129 @@
+#include <atomic>
+#include <cstdio>
+#include <Foundation/Base/CompressionHelper.h>
+#include <Foundation/Base/MappedFileHelper.h>
+#include <Foundation/Base/MemoryHelper.h>
+#include "RenderCheckpoint.h"
+
+namespace
+{
+    //blocks are independent, every worker takes a few of them.
+    bool DecompressPixels(const uint8_t* data, uint64_t size, std::vector<AccumulatedSpectrum>& pixels)
+    {
+        const base::compressed_archive_read Blocks(data, size);
+        if (!Blocks.is_valid() || Blocks.raw_size() != pixels.size() * sizeof(AccumulatedSpectrum))
+        {
+            return false;
+        }
+
+        //block i is written at i * block_size(), only the last one may be short.
+        for (uint32_t BlockIndex = 0; BlockIndex < Blocks.num_blocks(); BlockIndex++)
+        {
+            const bool IsLast = BlockIndex + 1 == Blocks.num_blocks();
+            if (IsLast ? Blocks.block_raw_size(BlockIndex) > Blocks.block_size() : Blocks.block_raw_size(BlockIndex) != Blocks.block_size())
+            {
+                return false;
+            }
+        }
+
+        const uint32_t BlocksPerTask = 4;
+        uint8_t* Destination = reinterpret_cast<uint8_t*>(pixels.data());
+        std::atomic<bool> Failed = false;
+        std::vector<Task> DecompressTasks;
+        for (uint32_t First = 0; First < Blocks.num_blocks(); First += BlocksPerTask)
+        {
+            const uint32_t Last = math::min2(First + BlocksPerTask, Blocks.num_blocks());
+            DecompressTasks.push_back(Task::Start(ThreadName::Worker, [&Blocks, &Failed, Destination, First, Last](Task&)
+                {
+                    for (uint32_t BlockIndex = First; BlockIndex < Last; BlockIndex++)
+                    {
+                        if (!Blocks.decompress_block(BlockIndex, Destination + static_cast<uint64_t>(BlockIndex) * Blocks.block_size()))
+                        {
+                            Failed = true;
+                        }
+                    }
+                }));
+        }
+        for (Task& DecompressTask : DecompressTasks)
+        {
+            DecompressTask.SpinWait();
+        }
+        return !Failed;
+    }
+}
+
+void RenderCheckpoint::Capture(const AccumulatedSpectrum* pixels, int width, int height, int frame)
+{
+    Info.Width = width;
+    Info.Height = height;
+    Info.Frame = frame;
+    Pixels.assign(pixels, pixels + width * height);
+}
+
+bool RenderCheckpoint::Save(const std::string& path) const
+{
+    //compressed in memory first, the file is written in one go.
+    base::memory_archive_write Compressed(static_cast<uint32_t>(Pixels.size() * sizeof(AccumulatedSpectrum) / 2 + 4096));
+    {
+        base::compressed_archive_write Blocks(Compressed);
+        Blocks.serialize(const_cast<AccumulatedSpectrum*>(Pixels.data()), static_cast<uint32_t>(Pixels.size() * sizeof(AccumulatedSpectrum)));
+        Blocks.finish();
+    }
+
+    //write aside and replace, a crash while saving keeps the last checkpoint.
+    const std::string tempPath = path + ".tmp";
+    FILE* f = nullptr;
+    if (fopen_s(&f, tempPath.c_str(), "wb") != 0 || f == nullptr)
+    {
+        return false;
+    }
+
+    bool succeeded = fwrite(&Info, sizeof(Header), 1, f) == 1
+        && fwrite(Compressed.data(), 1, Compressed.written_size(), f) == Compressed.written_size();
+    succeeded = (fclose(f) == 0) && succeeded;
+    if (!succeeded)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    std::remove(path.c_str());
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+bool RenderCheckpoint::Load(const std::string& path, int expectedWidth, int expectedHeight, uint64_t expectedSceneHash)
+{
+    base::mapped_file_archive_read* f = base::create_archive_mapped_file_read(path);
+    if (f == nullptr)
+    {
+        return false;
+    }
+
+    Header header;
+    bool succeeded = f->size() >= sizeof(Header);
+    if (succeeded)
+    {
+        *f << header;
+        succeeded = header.Magic == FileMagic
+            && header.Version == FileVersion
+            && header.PixelSize == sizeof(AccumulatedSpectrum)
+            && header.Width == expectedWidth && header.Height == expectedHeight
+            && header.Width > 0 && header.Height > 0
+            && header.SceneHash == expectedSceneHash;
+    }
+
+    std::vector<AccumulatedSpectrum> pixels;
+    if (succeeded)
+    {
+        pixels.resize(static_cast<size_t>(header.Width) * static_cast<size_t>(header.Height));
+        succeeded = DecompressPixels(f->data() + sizeof(Header), f->size() - sizeof(Header), pixels);
+    }
+    f->destroy();
+
+    if (succeeded)
+    {
+        Info = header;
+        Pixels = std::move(pixels);
+    }
+    return succeeded;
+}
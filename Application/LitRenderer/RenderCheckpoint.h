@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "PreInclude.h"
+#include "LDRFilm.h"
+
+/**
+* snapshot of the progressive accumulation,
+* fixed-size header followed by pixels in independently compressed blocks,
+* the file is mapped and blocks are decompressed on workers in parallel.
+* random streams are derived from frame index, it is the only rng state to keep.
+* progress of another scene is never resumed, the header keeps the hash of scene content.
+*/
+struct RenderCheckpoint
+{
+    static const uint32_t FileMagic = 0x4B43524C; // "LRCK"
+    static const uint32_t FileVersion = 4;
+
+    struct Header
+    {
+        uint32_t Magic = FileMagic;
+        uint32_t Version = FileVersion;
+        int32_t Width = 0;
+        int32_t Height = 0;
+        int32_t Frame = 0;
+        uint32_t PixelSize = sizeof(AccumulatedSpectrum);
+        Float CameraPosition[3] = { 0 };
+        Float CameraForward[3] = { 0 };
+        Float CameraUp[3] = { 0 };
+        uint64_t SceneHash = 0;
+        Float SamplesPerPixel = Float(0);
+    };
+
+    void Capture(const AccumulatedSpectrum* pixels, int width, int height, int frame);
+    bool Save(const std::string& path) const;
+    //fails unless the stored canvas matches the expected size and scene.
+    bool Load(const std::string& path, int expectedWidth, int expectedHeight, uint64_t expectedSceneHash);
+
+    Header Info;
+    std::vector<AccumulatedSpectrum> Pixels;
+};
@@ -0,0 +1,95 @@
+#include "RenderStatistics.h"
+
+#ifdef ENABLE_RENDER_STATISTICS
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    std::mutex sRegistryMutex;
+    std::vector<RenderStatistics::ThreadCounters*> sRegistry;
+
+    //counters of exited threads.
+    uint64_t sRetiredValues[RenderStatistics::NumCounters] = { 0 };
+
+    const char* CounterNames[RenderStatistics::NumCounters] =
+    {
+        "paths",
+        "path_vertices",
+        "russian_roulette_terminations",
+        "light_samples",
+        "light_sample_hits",
+        "rays",
+        "intersection_tests",
+    };
+
+    double Ratio(uint64_t numerator, uint64_t denominator)
+    {
+        return denominator > 0 ? double(numerator) / double(denominator) : 0.0;
+    }
+}
+
+thread_local RenderStatistics::ThreadCounters RenderStatistics::sThreadCounters;
+
+RenderStatistics::ThreadCounters::ThreadCounters()
+{
+    std::lock_guard<std::mutex> lock(sRegistryMutex);
+    sRegistry.push_back(this);
+}
+
+RenderStatistics::ThreadCounters::~ThreadCounters()
+{
+    std::lock_guard<std::mutex> lock(sRegistryMutex);
+    for (int index = 0; index < NumCounters; index++)
+    {
+        sRetiredValues[index] += Values[index];
+    }
+    sRegistry.erase(std::remove(sRegistry.begin(), sRegistry.end(), this), sRegistry.end());
+}
+
+RenderStatistics RenderStatistics::CollectFrame()
+{
+    RenderStatistics result;
+    std::lock_guard<std::mutex> lock(sRegistryMutex);
+    for (int index = 0; index < NumCounters; index++)
+    {
+        result.Values[index] = sRetiredValues[index];
+        sRetiredValues[index] = 0;
+    }
+
+    for (ThreadCounters* counters : sRegistry)
+    {
+        for (int index = 0; index < NumCounters; index++)
+        {
+            result.Values[index] += counters->Values[index];
+            counters->Values[index] = 0;
+        }
+    }
+    return result;
+}
+
+std::string RenderStatistics::ToJson(int frame) const
+{
+    auto Value = [this](RenderCounter counter) { return Values[static_cast<int>(counter)]; };
+
+    char buffer[256];
+    std::string json = "{";
+    snprintf(buffer, sizeof(buffer), "\"frame\":%d", frame);
+    json += buffer;
+    for (int index = 0; index < NumCounters; index++)
+    {
+        snprintf(buffer, sizeof(buffer), ",\"%s\":%llu", CounterNames[index], static_cast<unsigned long long>(Values[index]));
+        json += buffer;
+    }
+
+    snprintf(buffer, sizeof(buffer), ",\"intersection_tests_per_ray\":%.3f,\"average_path_length\":%.3f,\"light_sample_hit_rate\":%.3f}",
+        Ratio(Value(RenderCounter::IntersectionTests), Value(RenderCounter::Rays)),
+        Ratio(Value(RenderCounter::PathVertices), Value(RenderCounter::Paths)),
+        Ratio(Value(RenderCounter::LightSampleHits), Value(RenderCounter::LightSamples)));
+    json += buffer;
+    return json;
+}
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+//#define ENABLE_RENDER_STATISTICS
+
+enum class RenderCounter
+{
+    Paths,
+    PathVertices,
+    RussianRouletteTerminations,
+    LightSamples,
+    LightSampleHits,
+    Rays,
+    IntersectionTests,
+    Count
+};
+
+#ifdef ENABLE_RENDER_STATISTICS
+
+/**
+* counters are kept per thread without any synchronization,
+* and summed up between frames, when no sample task is running.
+*/
+struct RenderStatistics
+{
+    static const int NumCounters = static_cast<int>(RenderCounter::Count);
+
+    struct ThreadCounters
+    {
+        ThreadCounters();
+        ~ThreadCounters();
+        uint64_t Values[NumCounters] = { 0 };
+    };
+
+    static void Add(RenderCounter counter, uint64_t value) { sThreadCounters.Values[static_cast<int>(counter)] += value; }
+
+    //sum and reset counters of all threads.
+    static RenderStatistics CollectFrame();
+    std::string ToJson(int frame) const;
+
+    uint64_t Values[NumCounters] = { 0 };
+
+private:
+    static thread_local ThreadCounters sThreadCounters;
+};
+
+#define RENDER_STAT_ADD(counter, value) RenderStatistics::Add(RenderCounter::counter, value)
+
+#else
+
+#define RENDER_STAT_ADD(counter, value) ((void)0)
+
+#endif
+
+#define RENDER_STAT_INCREMENT(counter) RENDER_STAT_ADD(counter, 1)
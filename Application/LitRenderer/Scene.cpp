@@ -1,32 +1,31 @@
 #include "Scene.h"
+#include "RenderStatistics.h"
 #include <Foundation/Base/MemoryHelper.h>
 
 void Transform::UpdateWorldTransform()
 {
-    TransformMatrix = math::matrix4x4<Float>::tr(Translate, Rotation);
-    TransformMatrix3x3 = math::convert_to_matrix3x3(TransformMatrix);
-    TransformMatrix3x3T = math::transposed(TransformMatrix3x3);
-    TransformMatrix3x3InverseT = math::inversed(TransformMatrix3x3T);
+    LocalToWorld = math::affine3x4<Float>::tr(Translate, Rotation);
+    WorldToLocal = math::inversed_rigid(LocalToWorld);
 }
 
 Direction Transform::InverseTransformNormal(const Direction& direction) const
 {
-    return math::transform(TransformMatrix3x3T, direction);
+    return math::transform_vector_transposed(LocalToWorld, direction);
 }
 
 Direction Transform::TransformNormal(const Direction& direction) const
 {
-    return math::transform(TransformMatrix3x3InverseT, direction);
+    return math::transform_vector_transposed(WorldToLocal, direction);
 }
 
 Direction Transform::TransformDirection(const Direction& direction) const
 {
-    return math::transform(TransformMatrix3x3, direction);
+    return math::transform_vector(LocalToWorld, direction);
 }
 
 Point Transform::TransformPoint(const Point& Point) const
 {
-    return math::transform(TransformMatrix, Point);
+    return math::transform_point(LocalToWorld, Point);
 }
 
 void SceneObject::UpdateWorldTransform()
@@ -44,51 +43,177 @@ Direction SceneObject::LocalToWorldNormal(const Direction& direction) const
     return WorldTransform.TransformNormal(direction);
 }
 
+namespace
+{
+    Direction MakePerpendicularTangent(const Direction& n)
+    {
+        return math::cross(n, std::abs(n.x) > Float(0.9) ? Direction::unit_y() : Direction::unit_x());
+    }
+
+    //calculate pdf(w) = pdf(x') * dist_sqr / cos_theta'
+    // pdf(x') = 1 / area = > pdf(w) = dist_sqr / (area * cos_theta')
+    Float AreaToSolidAnglePdf(Float area, const Direction& N, bool dualface, const SurfaceIntersection& hr, const Ray& ray)
+    {
+        const Direction Wo = -ray.direction();
+        Float cosThetaPrime = math::dot(N, Wo);
+
+        if (cosThetaPrime < -math::SMALL_NUM<Float> && dualface)
+        {
+            cosThetaPrime = -cosThetaPrime;
+        }
+
+        if (cosThetaPrime <= math::SMALL_NUM<Float>)
+        {
+            return Float(0);
+        }
+
+        return math::square(hr.Distance) / (area * cosThetaPrime);
+    }
+
+    //fnv-1a over the bytes of a value.
+    template<typename T>
+    uint64_t HashValue(uint64_t hash, const T& value)
+    {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+        for (size_t index = 0; index < sizeof(T); index++)
+        {
+            hash = (hash ^ bytes[index]) * 1099511628211ull;
+        }
+        return hash;
+    }
+}
+
+uint64_t SceneObject::HashContent(uint64_t hash) const
+{
+    hash = HashValue(hash, WorldTransform.Translate);
+    hash = HashValue(hash, WorldTransform.Rotation);
+    hash = HashValue(hash, IsDualface());
+    if (Material != nullptr)
+    {
+        for (uint32_t index = 0; index < Material->GetLobeCount(); index++)
+        {
+            const BSDFLobe& lobe = Material->GetLobeByIndex(index);
+            hash = HashValue(hash, lobe.Type);
+            hash = HashValue(hash, lobe.Weight);
+            hash = HashValue(hash, lobe.Rd);
+            hash = HashValue(hash, lobe.Rs);
+            hash = HashValue(hash, lobe.DiffuseWeight);
+            hash = HashValue(hash, lobe.Roughness);
+            hash = HashValue(hash, lobe.A);
+            hash = HashValue(hash, lobe.B);
+        }
+        hash = HashValue(hash, Material->GetAlbedoTexture());
+    }
+    if (LightSource != nullptr)
+    {
+        hash = HashValue(hash, LightSource->Le());
+    }
+    return hash;
+}
+
+uint64_t SceneSphere::HashContent(uint64_t hash) const
+{
+    return HashValue(SceneObject::HashContent(hash), mSphere);
+}
+
+uint64_t SceneRect::HashContent(uint64_t hash) const
+{
+    return HashValue(SceneObject::HashContent(hash), Rect);
+}
+
+uint64_t SceneDisk::HashContent(uint64_t hash) const
+{
+    return HashValue(SceneObject::HashContent(hash), Disk);
+}
+
+uint64_t SceneCube::HashContent(uint64_t hash) const
+{
+    return HashValue(SceneObject::HashContent(hash), Cube);
+}
+
 void SceneSphere::UpdateWorldTransform()
 {
     SceneObject::UpdateWorldTransform();
     mWorldCenter = WorldTransform.TransformPoint(mSphere.center());
 }
 
-Point SceneRect::SampleRandomPoint(Float epsilon[3]) const
+Point SceneSphere::SampleRandomPoint(const Point& referencePoint, Float epsilon[3]) const
 {
-    Float e1 = (Float(2) * epsilon[1] - Float(1)) * Rect.width();
-    Float e2 = (Float(2) * epsilon[2] - Float(1)) * Rect.height();
+    const math::vector3<Float> ToCenter = mWorldCenter - referencePoint;
+    const Float DistanceSquare = math::magnitude_sqr(ToCenter);
+    const Float RadiusSquare = mSphere.radius_sqr();
 
-    Direction Bitangent = math::cross(mWorldNormal, mWorldTangent);
-    return Point(mWorldPosition + e1 * mWorldTangent + e2 * Bitangent);
+    //reference point is inside the sphere, sample the whole surface uniformly.
+    if (DistanceSquare <= RadiusSquare)
+    {
+        Float cosTheta = Float(1) - Float(2) * epsilon[1];
+        Float sinTheta = sqrt(math::max2(Float(0), Float(1) - cosTheta * cosTheta));
+        Radian phi(math::TWO_PI<Float> * epsilon[2]);
+        Direction N(sinTheta * math::cos(phi), sinTheta * math::sin(phi), cosTheta);
+        return Point(mWorldCenter + mSphere.radius() * N);
+    }
+
+    //sample the cone subtended by the sphere uniformly.
+    // pdf(w) = 1 / (2 * Pi * (1 - cos_theta_max))
+    const Float Distance = sqrt(DistanceSquare);
+    const Float SinThetaMaxSquare = RadiusSquare / DistanceSquare;
+    const Float CosThetaMax = sqrt(math::max2(Float(0), Float(1) - SinThetaMaxSquare));
+    const Float CosTheta = (Float(1) - epsilon[1]) + epsilon[1] * CosThetaMax;
+    const Float SinThetaSquare = math::max2(Float(0), Float(1) - CosTheta * CosTheta);
+    const Float SinTheta = sqrt(SinThetaSquare);
+    const Radian Phi(math::TWO_PI<Float> * epsilon[2]);
+
+    const Direction W = ToCenter;
+    const UVW uvw(W, MakePerpendicularTangent(W));
+    const Direction Wi = uvw.local_2_world(SinTheta * math::cos(Phi), SinTheta * math::sin(Phi), CosTheta);
+
+    //distance to the near intersection along Wi.
+    const Float T = Distance * CosTheta - sqrt(math::max2(Float(0), RadiusSquare - DistanceSquare * SinThetaSquare));
+    return Point(referencePoint + T * Wi);
 }
 
-Float SceneRect::SamplePdf(const SurfaceIntersection& hr, const Ray& ray) const
+Float SceneSphere::SamplePdf(const SurfaceIntersection& hr, const Ray& ray) const
 {
     if (hr.Object != this)
     {
         return Float(0);
     }
 
-    //calculate pdf(w) = pdf(x') * dist_sqr / cos_theta'
-    // pdf(x') = 1 / area = > pdf(w) = dist_sqr / (area * cos_theta')
-    const Direction Wo = -ray.direction();
-    const Direction& N = this->mWorldNormal;
-    Float cosThetaPrime = math::dot(N, Wo);
-
-    if (cosThetaPrime < -math::SMALL_NUM<Float> && IsDualface())
+    const Float DistanceSquare = math::magnitude_sqr(mWorldCenter - ray.origin());
+    const Float RadiusSquare = mSphere.radius_sqr();
+    if (DistanceSquare <= RadiusSquare)
     {
-        cosThetaPrime = -cosThetaPrime;
+        const Float area = Float(4) * math::PI<Float> * RadiusSquare;
+        return AreaToSolidAnglePdf(area, hr.SurfaceNormal, false, hr, ray);
     }
 
-    if (cosThetaPrime <= math::SMALL_NUM<Float>)
+    const Float CosThetaMax = sqrt(math::max2(Float(0), Float(1) - RadiusSquare / DistanceSquare));
+    return Float(1) / (math::TWO_PI<Float> * (Float(1) - CosThetaMax));
+}
+
+Point SceneRect::SampleRandomPoint(const Point& referencePoint, Float epsilon[3]) const
+{
+    Float e1 = (Float(2) * epsilon[1] - Float(1)) * Rect.width();
+    Float e2 = (Float(2) * epsilon[2] - Float(1)) * Rect.height();
+
+    Direction Bitangent = math::cross(mWorldNormal, mWorldTangent);
+    return Point(mWorldPosition + e1 * mWorldTangent + e2 * Bitangent);
+}
+
+Float SceneRect::SamplePdf(const SurfaceIntersection& hr, const Ray& ray) const
+{
+    if (hr.Object != this)
     {
         return Float(0);
     }
 
     Float area = Float(4) * Rect.width() * Rect.height();
-    return math::square(hr.Distance) / (area * cosThetaPrime);
-
+    return AreaToSolidAnglePdf(area, this->mWorldNormal, IsDualface(), hr, ray);
 }
 
 SurfaceIntersection SceneSphere::IntersectWithRay(const Ray& ray, Float error) const
 {
+    RENDER_STAT_INCREMENT(IntersectionTests);
     Float t0, t1;
     bool isOnSurface = true;
     math::intersection result = math::intersect_sphere(ray, mWorldCenter, mSphere.radius_sqr(), error, t0, t1);
@@ -121,6 +246,21 @@ SurfaceIntersection SceneSphere::IntersectWithRay(const Ray& ray, Float error) c
         (isOnSurface ? surfaceTangent : -surfaceTangent), t0);
 }
 
+math::vector2<Float> SceneSphere::GetTextureCoordinate(const Point& position) const
+{
+    //latitude-longitude in local space, +y is the pole.
+    const Direction localNormal = WorldToLocalNormal(position - mWorldCenter);
+    const Float u = std::atan2(localNormal.z, localNormal.x) * math::InvPI<Float> * Float(0.5) + Float(0.5);
+    const Float v = std::acos(math::clamp(localNormal.y, Float(-1), Float(1))) * math::InvPI<Float>;
+    return math::vector2<Float>(u, v);
+}
+
+Float SceneSphere::GetTextureScale() const
+{
+    //v spans half of a great circle.
+    return math::InvPI<Float> / mSphere.radius();
+}
+
 void SceneRect::UpdateWorldTransform()
 {
     SceneObject::UpdateWorldTransform();
@@ -132,6 +272,7 @@ void SceneRect::UpdateWorldTransform()
 
 SurfaceIntersection SceneRect::IntersectWithRay(const Ray& ray, Float error) const
 {
+    RENDER_STAT_INCREMENT(IntersectionTests);
     Float t;
     bool isOnSurface = true;
     math::intersection result = math::intersect_rect(ray, mWorldPosition, mWorldNormal, mWorldTangent, Rect.extends(), mDualFace, error, t);
@@ -148,16 +289,53 @@ SurfaceIntersection SceneRect::IntersectWithRay(const Ray& ray, Float error) con
     }
 }
 
+math::vector2<Float> SceneRect::GetTextureCoordinate(const Point& position) const
+{
+    //extends are half sizes, texture covers the whole rect once.
+    const math::vector3<Float> offset = position - mWorldPosition;
+    const Direction bitangent = math::cross(mWorldNormal, mWorldTangent);
+    const Float u = math::dot(offset, mWorldTangent) / Rect.extends().x * Float(0.5) + Float(0.5);
+    const Float v = math::dot(offset, bitangent) / Rect.extends().y * Float(0.5) + Float(0.5);
+    return math::vector2<Float>(u, v);
+}
+
+Float SceneRect::GetTextureScale() const
+{
+    return Float(0.5) / math::min2(Rect.extends().x, Rect.extends().y);
+}
+
 void SceneDisk::UpdateWorldTransform()
 {
     SceneObject::UpdateWorldTransform();
 
     mWorldPosition = WorldTransform.TransformPoint(Disk.position());
     mWorldNormal = WorldTransform.TransformNormal(Disk.normal()); // no scale so there...
+    mWorldTangent = MakePerpendicularTangent(mWorldNormal);
+}
+
+Point SceneDisk::SampleRandomPoint(const Point& referencePoint, Float epsilon[3]) const
+{
+    //uniform area sampling, pdf(x') = 1 / (Pi * r^2)
+    const Float r = Disk.radius() * sqrt(epsilon[1]);
+    const Radian phi(math::TWO_PI<Float> * epsilon[2]);
+    const Direction Bitangent = math::cross(mWorldNormal, mWorldTangent);
+    return Point(mWorldPosition + (r * math::cos(phi)) * mWorldTangent + (r * math::sin(phi)) * Bitangent);
+}
+
+Float SceneDisk::SamplePdf(const SurfaceIntersection& hr, const Ray& ray) const
+{
+    if (hr.Object != this)
+    {
+        return Float(0);
+    }
+
+    Float area = math::PI<Float> * math::square(Disk.radius());
+    return AreaToSolidAnglePdf(area, this->mWorldNormal, IsDualface(), hr, ray);
 }
 
 SurfaceIntersection SceneDisk::IntersectWithRay(const Ray& ray, Float error) const
 {
+    RENDER_STAT_INCREMENT(IntersectionTests);
     Float t;
     bool isOnSurface = true;
     math::intersection result = math::intersect_disk(ray, mWorldPosition, mWorldNormal, Disk.radius(), mDualFace, error, t);
@@ -186,6 +364,7 @@ void SceneCube::UpdateWorldTransform()
 
 SurfaceIntersection SceneCube::IntersectWithRay(const Ray& ray, Float error) const
 {
+    RENDER_STAT_INCREMENT(IntersectionTests);
     Float t0, t1;
     bool front = true;
 
@@ -240,6 +419,7 @@ void Scene::UpdateWorldTransform()
 
 SurfaceIntersection Scene::DetectIntersecting(const Ray& ray, const SceneObject* excludeObject, Float epsilon)
 {
+    RENDER_STAT_INCREMENT(Rays);
     SurfaceIntersection result;
     for (const SceneObject* obj : mSceneObjects)
     {
@@ -275,13 +455,68 @@ void Scene::FindAllLights()
     }
 }
 
+bool Scene::LoadEnvironmentLight(const std::string& path)
+{
+    std::unique_ptr<EnvironmentLight> environmentLight = std::make_unique<EnvironmentLight>();
+    if (environmentLight->LoadFromFile(path))
+    {
+        mEnvironmentLight = std::move(environmentLight);
+        return true;
+    }
+    return false;
+}
+
+int Scene::LoadTexture(const std::string& sourcePath)
+{
+    const std::string tiledPath = sourcePath + ".tiles";
+    int texture = mTextureCache.Open(tiledPath);
+    if (texture < 0 && TiledTextureFile::Build(sourcePath, tiledPath))
+    {
+        texture = mTextureCache.Open(tiledPath);
+    }
+    return texture;
+}
+
+Spectrum Scene::SampleTexture(int texture, const SceneObject& object, const Point& position, Float footprint, bool bPreview)
+{
+    const math::vector2<Float> uv = object.GetTextureCoordinate(position);
+    return mTextureCache.Sample(texture, uv.x, uv.y, footprint * object.GetTextureScale(), bPreview);
+}
+
+Float Scene::SampleEnvironmentPdf(const Direction& direction) const
+{
+    return (mEnvironmentLight != nullptr)
+        ? mEnvironmentLight->Pdf(direction) / Float(GetLightSelectionCount())
+        : Float(0);
+}
+
+uint64_t Scene::CalculateContentHash() const
+{
+    uint64_t hash = HashValue(14695981039346656037ull, mSceneObjects.size());
+    for (const SceneObject* object : mSceneObjects)
+    {
+        hash = object->HashContent(hash);
+    }
+
+    //environment map is only known by its radiance, probed along the axes.
+    if (mEnvironmentLight != nullptr)
+    {
+        const Direction Axes[] = { Direction::unit_x(), -Direction::unit_x(), Direction::unit_y(), -Direction::unit_y(), Direction::unit_z(), -Direction::unit_z() };
+        for (const Direction& axis : Axes)
+        {
+            hash = HashValue(hash, mEnvironmentLight->Le(axis));
+        }
+    }
+    return hash;
+}
+
 SceneObject* Scene::UniformSampleLightSource(Float u)
 {
-    if (mSceneLights.size() > 0)
+    if (GetLightSelectionCount() > 0)
     {
-        uint32_t length = (uint32_t)mSceneLights.size();
+        uint32_t length = (uint32_t)GetLightSelectionCount();
         uint32_t index = math::min2<uint32_t>(math::floor2<uint32_t>(u * length), length - 1);
-        return mSceneLights[index];
+        return index < mSceneLights.size() ? mSceneLights[index] : nullptr;
     }
     else
     {
@@ -303,6 +538,6 @@ Float Scene::SampleLightPdf(const Ray& ray)
     }
 
     return (result.Object != nullptr)
-        ? result.Object->SamplePdf(result, ray) / Float(mSceneLights.size())
+        ? result.Object->SamplePdf(result, ray) / Float(GetLightSelectionCount())
         : Float(0);
 }
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include <Foundation/Math/Matrix.h>
 #include <Foundation/Math/Geometry.h>
 #include "Material.h"
+#include "EnvironmentLight.h"
+#include "Texture.h"
 
 struct SceneObject;
 
@@ -35,8 +37,8 @@ struct Transform
     math::vector3<Float> Translate = math::vector3<Float>::zero();
     math::quaternion<Float> Rotation = math::quaternion<Float>::identity();
 private:
-    math::matrix4x4<Float> TransformMatrix = math::matrix4x4<Float>::identity();
-    math::matrix3x3<Float> TransformMatrix3x3, TransformMatrix3x3T, TransformMatrix3x3InverseT;
+    math::affine3x4<Float> LocalToWorld = math::affine3x4<Float>::identity();
+    math::affine3x4<Float> WorldToLocal = math::affine3x4<Float>::identity();
 };
 
 
@@ -59,9 +61,16 @@ struct SceneObject
     void SetRotation(const math::quaternion<Float>& q) { WorldTransform.Rotation = q; }
     Direction WorldToLocalNormal(const Direction& direction) const;
     Direction LocalToWorldNormal(const Direction& direction) const;
-    virtual Point SampleRandomPoint(Float epsilon[3]) const { return Point::zero(); }
+    virtual Point SampleRandomPoint(const Point& referencePoint, Float epsilon[3]) const { return Point::zero(); }
     virtual Float SamplePdf(const SurfaceIntersection& hr, const Ray& ray) const { return Float(0); }
     virtual bool IsDualface() const { return false; }
+
+    //texture coordinate of a surface point, and how many uv units a world unit covers.
+    virtual math::vector2<Float> GetTextureCoordinate(const Point& position) const { return math::vector2<Float>::zero(); }
+    virtual Float GetTextureScale() const { return Float(0); }
+
+    //folds everything that changes the rendered image into hash.
+    virtual uint64_t HashContent(uint64_t hash) const;
     Transform WorldTransform;
     std::unique_ptr<Material> Material;
     std::unique_ptr<LightSource> LightSource = nullptr;
@@ -74,6 +83,11 @@ struct SceneSphere : SceneObject
     virtual void UpdateWorldTransform() override;
     virtual SurfaceIntersection IntersectWithRay(const Ray& ray, Float error) const override;
     void SetRadius(Float radius) { mSphere.set_radius(radius); }
+    virtual Point SampleRandomPoint(const Point& referencePoint, Float epsilon[3]) const override;
+    virtual Float SamplePdf(const SurfaceIntersection& hr, const Ray& ray) const override;
+    virtual math::vector2<Float> GetTextureCoordinate(const Point& position) const override;
+    virtual Float GetTextureScale() const override;
+    virtual uint64_t HashContent(uint64_t hash) const override;
 private:
     math::sphere<Float> mSphere;
     Point mWorldCenter;
@@ -89,9 +103,12 @@ struct SceneRect : SceneObject
     virtual SurfaceIntersection IntersectWithRay(const Ray& ray, Float error) const override;
     void SetExtends(Float x, Float y) { Rect.set_extends(x, y); }
     void SetDualFace(bool dual) { mDualFace = dual; }
-    virtual Point SampleRandomPoint(Float epsilon[3]) const override;
+    virtual Point SampleRandomPoint(const Point& referencePoint, Float epsilon[3]) const override;
     virtual Float SamplePdf(const SurfaceIntersection& hr, const Ray& ray) const override;
     virtual bool IsDualface() const override { return mDualFace; }
+    virtual math::vector2<Float> GetTextureCoordinate(const Point& position) const override;
+    virtual Float GetTextureScale() const override;
+    virtual uint64_t HashContent(uint64_t hash) const override;
 private:
     bool mDualFace = false;
     math::rect<Float> Rect;
@@ -107,12 +124,16 @@ struct SceneDisk : SceneObject
     virtual SurfaceIntersection IntersectWithRay(const Ray& ray, Float error) const override;
     void SetRadius(Float r) { Disk.set_radius(r); }
     void SetDualFace(bool dual) { mDualFace = dual; }
+    virtual Point SampleRandomPoint(const Point& referencePoint, Float epsilon[3]) const override;
+    virtual Float SamplePdf(const SurfaceIntersection& hr, const Ray& ray) const override;
     virtual bool IsDualface() const override { return mDualFace; }
+    virtual uint64_t HashContent(uint64_t hash) const override;
 private:
     bool mDualFace = false;
     math::disk<Float> Disk;
     Point mWorldPosition;
     Direction mWorldNormal;
+    Direction mWorldTangent;
 };
 
 struct SceneCube : SceneObject
@@ -121,6 +142,7 @@ struct SceneCube : SceneObject
     virtual void UpdateWorldTransform() override;
     virtual SurfaceIntersection IntersectWithRay(const Ray& ray, Float error) const override;
     void SetExtends(Float x, Float y, Float z) { Cube.set_extends(x, y, z); }
+    virtual uint64_t HashContent(uint64_t hash) const override;
 private:
     math::cube<Float> Cube;
     Point mWorldPosition;
@@ -132,6 +154,9 @@ private:
 class Scene
 {
 public:
+    static const size_t TextureCacheBudget = size_t(256) << 20;
+
+    Scene() : mTextureCache(TextureCacheBudget) { }
     virtual ~Scene();
     void UpdateWorldTransform();
     SurfaceIntersection DetectIntersecting(const Ray& ray, const SceneObject* excludeObject, Float epsilon);
@@ -139,11 +164,27 @@ public:
     int GetLightCount() const { return (int)mSceneLights.size(); }
     SceneObject* GetLightSourceByIndex(int index) { return mSceneLights[index]; }
     Float SampleLightPdf(const Ray& ray);
+    bool LoadEnvironmentLight(const std::string& path);
+    const EnvironmentLight* GetEnvironmentLight() const { return mEnvironmentLight.get(); }
+    Float SampleEnvironmentPdf(const Direction& direction) const;
+
+    //same for two scenes that render the same image, keys saved progress.
+    uint64_t CalculateContentHash() const;
+
+    //tiled copy is built next to the source image on first use, returns -1 on failure.
+    int LoadTexture(const std::string& sourcePath);
+    Spectrum SampleTexture(int texture, const SceneObject& object, const Point& position, Float footprint, bool bPreview);
+    TextureCache::Statistics CollectTextureStatistics() { return mTextureCache.CollectStatistics(); }
 
+    //environment light takes one slot in light selection,
+    // nullptr is returned when it is picked.
     SceneObject* UniformSampleLightSource(Float u);
 private:
     virtual void CreateScene(Float aspect, std::vector<SceneObject*>& OutSceneObjects) = 0;
     void FindAllLights();
+    int GetLightSelectionCount() const { return GetLightCount() + (mEnvironmentLight != nullptr ? 1 : 0); }
     std::vector<SceneObject*> mSceneObjects;
     std::vector<SceneObject*> mSceneLights;
+    std::unique_ptr<EnvironmentLight> mEnvironmentLight;
+    TextureCache mTextureCache;
 };
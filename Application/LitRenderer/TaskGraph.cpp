@@ -3,6 +3,7 @@
 #include <chrono>
 #include <thread>
 #include <Foundation/Base/MemoryHelper.h>
+#include <Foundation/Base/AllocatorHelper.h>
 
 #ifdef WIN32
 #include <Windows.h>
@@ -139,26 +140,27 @@ namespace
 }
 #endif
 
-static LockedQueue<TaskGraphNode*> GlobalTaskPool;
+using TaskGraphNodePool = base::fixed_size_pool<sizeof(TaskGraphNode), alignof(TaskGraphNode)>;
 
-void ReleaseGlobalTaskPool()
+void* TaskGraphNode::operator new(size_t Size)
 {
-    TaskGraphNode* Task = nullptr;
-    while (GlobalTaskPool.Dequeue(Task))
-    {
-        delete Task;
-    }
+    assert(Size == sizeof(TaskGraphNode));
+    return TaskGraphNodePool::allocate();
+}
+
+void TaskGraphNode::operator delete(void* Pointer)
+{
+    TaskGraphNodePool::deallocate(Pointer);
 }
 
 
-void Task::StartSystem(uint32_t NumWorker)
+void Task::StartSystem(uint32_t NumWorker, bool bPinThreads)
 {
-    TaskScheduler::Instance().Start(NumWorker);
+    TaskScheduler::Instance().Start(NumWorker, bPinThreads);
 }
 void Task::StopSystem()
 {
     TaskScheduler::Instance().Stop();
-    ReleaseGlobalTaskPool();
 
 #ifdef ENABLE_PROFILING
     OutputProfilingDatas();
@@ -170,6 +172,11 @@ Task Task::Start(ThreadName Thread, std::function<Task::Route> Route)
     return WhenAllImpl(Thread, Route, nullptr, 0);
 }
 
+Task Task::Start(ThreadName Thread, std::function<Task::Route> Route, TaskPriority Priority)
+{
+    return WhenAllImpl(Thread, Route, nullptr, 0, Priority);
+}
+
 Task Task::When(ThreadName Thread, std::function<Task::Route> Route, const Task& Prerequister)
 {
     TaskGraphNode* PrerequisterNode = Prerequister.mTask;
@@ -182,7 +189,7 @@ Task Task::WhenAll(ThreadName Thread, std::function<Task::Route> Route, const st
     if (numPrerequisters > 0)
     {
 
-        std::vector<TaskGraphNode*> PrerequisterNodes;
+        base::small_vector<TaskGraphNode*, 16> PrerequisterNodes;
         PrerequisterNodes.reserve(numPrerequisters);
         for (const Task& task : Prerequisters)
         {
@@ -201,7 +208,7 @@ Task Task::WhenAll(ThreadName Thread, std::function<Task::Route> Route, const Ta
 {
     if (numPrerequisters > 0)
     {
-        std::vector<TaskGraphNode*> PrerequisterNodes;
+        base::small_vector<TaskGraphNode*, 16> PrerequisterNodes;
         PrerequisterNodes.reserve(numPrerequisters);
         for (uint32_t index = 0; index < numPrerequisters; index += 1)
         {
@@ -216,12 +223,12 @@ Task Task::WhenAll(ThreadName Thread, std::function<Task::Route> Route, const Ta
     }
 }
 
-Task Task::WhenAllImpl(ThreadName Thread, std::function<Task::Route> Route, TaskGraphNode** Prerequistes, uint32_t numPrerequisters)
+Task Task::WhenAllImpl(ThreadName Thread, std::function<Task::Route> Route, TaskGraphNode** Prerequistes, uint32_t numPrerequisters, TaskPriority Priority)
 {
     //In case the task node not be recycled before we create task wrapper.
     // start() will create task node with 2 reference count.
     // we need to remove the reference.
-    Task Task(TaskGraphNode::StartTask(Thread, std::move(Route), Prerequistes, numPrerequisters));
+    Task Task(TaskGraphNode::StartTask(Thread, std::move(Route), Prerequistes, numPrerequisters, Priority));
     Task.mTask->Release();
     return Task;
 }
@@ -306,7 +313,6 @@ Task& Task::operator=(const Task& task)
 
 Task::Task(TaskGraphNode* pTask) : mTask(pTask)
 {
-    assert(!mTask->IsRecycled());
     mTask->AddReference();
 }
 
@@ -357,27 +363,11 @@ TaskGraphNode* TaskGraphNode::StartTask(ThreadName Thread, std::function<Task::R
     token.BeginTimeStamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - sStartTimeStamp).count();
 #endif
 
-    TaskGraphNode* Task = nullptr;
-    if (GlobalTaskPool.Dequeue(Task))
-    {
-        Task->mThreadName = Thread;
-        Task->mPriority = Priority;
-        Task->mTaskRoute = std::move(Route);
-        Task->mReferenceCount.store(2, std::memory_order_release);
-        Task->mCompleted.store(false, std::memory_order_release);
-        Task->mRecycled.store(false, std::memory_order_release);
-        Task->mAntecedentDependencyCount.store(1, std::memory_order_release);
-        Task->mDontCompleteUntil.store(false, std::memory_order_release);
-        Task->mDontCompleteUntilEmptyTask = nullptr;
-    }
-    else
-    {
-        Task = new TaskGraphNode(Thread, std::move(Route), Priority);
+    TaskGraphNode* Task = new TaskGraphNode(Thread, std::move(Route), Priority);
 #ifdef ENABLE_PROFILING
-        Task->mResUID = sResourceUIDGenerator.fetch_add(1, std::memory_order_acquire);
-        token.ResUID = newTask->mResUID;
+    Task->mResUID = sResourceUIDGenerator.fetch_add(1, std::memory_order_acquire);
+    token.ResUID = newTask->mResUID;
 #endif
-    }
 
 #ifdef ENABLE_PROFILING
     Task->mTaskID = sTaskIDGenerator.fetch_add(1, std::memory_order_acquire);
@@ -402,19 +392,9 @@ TaskGraphNode* TaskGraphNode::StartTask(ThreadName Thread, std::function<Task::R
 
 void TaskGraphNode::FreeAndRecycleTask(TaskGraphNode* Task)
 {
-    assert
-    (
-        !Task->mRecycled.load(std::memory_order_acquire) &&
-        Task->mReferenceCount.load(std::memory_order_acquire) == 0
-    );
-
-    const bool bRecycledOldValue = Task->mRecycled.exchange(true, std::memory_order_release);
-    const bool bIsNotRecycledYet = !bRecycledOldValue;
-    if (bIsNotRecycledYet)
-    {
-        assert(Task->IsCompleted());
-        GlobalTaskPool.Enqueue(Task);
-    }
+    //freeing twice is caught by the node pool in debug builds.
+    assert(Task->mReferenceCount.load(std::memory_order_acquire) == 0 && Task->IsCompleted());
+    delete Task;
 }
 
 TaskGraphNode* TaskGraphNode::Then(ThreadName Thread, std::function<Task::Route>&& Route, TaskPriority Priority)
@@ -518,11 +498,6 @@ bool TaskGraphNode::IsCompleted() const
     return mCompleted.load(std::memory_order_acquire);
 }
 
-bool TaskGraphNode::IsRecycled() const
-{
-    return mRecycled.load(std::memory_order_acquire);
-}
-
 bool TaskGraphNode::IsAvailable() const
 {
     return mAntecedentDependencyCount.load(std::memory_order_acquire) == 0;
@@ -538,7 +513,7 @@ TaskGraphNode::TaskGraphNode(ThreadName Thread, std::function<Task::Route>&& Rou
 
 void TaskGraphNode::NotifySubsequents()
 {
-    std::vector<TaskGraphNode*> LocalSubsequents;
+    SubsequentList LocalSubsequents;
     {
         std::lock_guard<std::mutex> guard(mSubseuquentsMutex);
         LocalSubsequents.swap(mSubsequents);
@@ -549,7 +524,6 @@ void TaskGraphNode::NotifySubsequents()
         assert
         (
             !subsequent->IsCompleted()
-            && !subsequent->IsRecycled()
             && (!subsequent->IsAvailable()
                 || subsequent->mDontCompleteUntil.load(std::memory_order_acquire))
         );
@@ -560,7 +534,9 @@ void TaskGraphNode::NotifySubsequents()
 
 bool TaskGraphNode::AddSubsequent(TaskGraphNode* pNextTask)
 {
-    std::vector<TaskGraphNode*> CheckedTasks;
+    //the search never adds subsequents, so one scratch list per thread is enough.
+    thread_local std::vector<TaskGraphNode*> CheckedTasks;
+    CheckedTasks.clear();
     if (this != pNextTask && !pNextTask->RecursiveSearchSubsequents(CheckedTasks, this))
     {
         if (!IsCompleted())
@@ -591,7 +567,7 @@ void TaskGraphNode::ScheduleMe()
     }
     else
     {
-        assert(!IsCompleted() && !IsRecycled() && !IsAvailable());
+        assert(!IsCompleted() && !IsAvailable());
 
         if (mAntecedentDependencyCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
         {
@@ -619,7 +595,7 @@ void TaskScheduler::ScheduleTask(TaskGraphNode* task)
     }
 }
 
-void TaskScheduler::Start(uint32_t InNumWorkers)
+void TaskScheduler::Start(uint32_t InNumWorkers, bool bPinThreads)
 {
 #ifdef	ENABLE_PROFILING
     sStartTimeStamp = std::chrono::steady_clock::now();
@@ -631,14 +607,20 @@ void TaskScheduler::Start(uint32_t InNumWorkers)
         WorkerThreads[Index] = std::thread(&TaskScheduler::TaskThreadRoute, this, &WorkerThreadTaskQueue, ThreadName::Worker, Index);
 
 #ifdef WIN32
-        SetThreadAffinityMask(WorkerThreads[Index].native_handle(), (DWORD_PTR)(0x4 << (Index * 2)));
+        if (bPinThreads)
+        {
+            SetThreadAffinityMask(WorkerThreads[Index].native_handle(), (DWORD_PTR)(0x4 << (Index * 2)));
+        }
 #endif
     }
 
     DiskIO = std::thread(&TaskScheduler::TaskThreadRoute, this, &DiskIOThreadTaskQueue, ThreadName::DiskIO, 0);
 
 #ifdef WIN32
-    SetThreadAffinityMask(DiskIO.native_handle(), (DWORD_PTR)0x2);
+    if (bPinThreads)
+    {
+        SetThreadAffinityMask(DiskIO.native_handle(), (DWORD_PTR)0x2);
+    }
 #endif
 }
 
@@ -6,6 +6,7 @@
 #include <vector>
 #include <queue>
 #include <memory>
+#include <Foundation/Base/ContainerHelper.h>
 
 //#define ENABLE_PROFILING
 
@@ -32,12 +33,19 @@ struct Task
 {
     typedef void(Route)(Task&);
 
-    static void StartSystem(uint32_t NumWorker = 4);
+    //pinned workers share fixed cores, processes running side by side should not pin.
+    static void StartSystem(uint32_t NumWorker = 4, bool bPinThreads = true);
     static void StopSystem();
     static Task Start(ThreadName Thread, std::function<Task::Route> Route);
+    static Task Start(ThreadName Thread, std::function<Task::Route> Route, TaskPriority Priority);
     static Task When(ThreadName Thread, std::function<Task::Route> Route, const Task& Prerequisters);
     static Task WhenAll(ThreadName Thread, std::function<Task::Route> Route, const std::vector<Task>& Prerequisters);
     static Task WhenAll(ThreadName Thread, std::function<Task::Route> Route, const Task* Prerequisters, unsigned int numPrerequisters);
+    template<typename Allocator>
+    static Task WhenAll(ThreadName Thread, std::function<Task::Route> Route, const std::vector<Task, Allocator>& Prerequisters)
+    {
+        return WhenAll(Thread, std::move(Route), Prerequisters.data(), (unsigned int)Prerequisters.size());
+    }
     Task Then(ThreadName Thread, std::function<Task::Route>&& route);
     bool DontCompleteUntil(Task task);
     bool IsCompleted() const;
@@ -52,7 +60,7 @@ struct Task
 
 private:
     friend class TaskGraphNode;
-    static Task WhenAllImpl(ThreadName Thread, std::function<Task::Route> Route, TaskGraphNode** Prerequisters, uint32_t numPrerequisters);
+    static Task WhenAllImpl(ThreadName Thread, std::function<Task::Route> Route, TaskGraphNode** Prerequisters, uint32_t numPrerequisters, TaskPriority Priority = TaskPriority::Normal);
     Task(TaskGraphNode* pTask);
     void ReleaseRef();
 
@@ -97,7 +105,6 @@ class TaskGraphNode
     void AddReference();
     void Release();
     bool IsCompleted() const;
-    bool IsRecycled() const;
     bool IsAvailable() const;
 
 private: //internal-use-purpose.
@@ -107,6 +114,10 @@ private: //internal-use-purpose.
     TaskGraphNode(ThreadName Thread, std::function<Task::Route>&& Route, TaskPriority Priority);
     void NotifySubsequents();
 
+    //nodes are created and recycled on every thread, they come from a thread-local pool instead of the global heap.
+    static void* operator new(size_t Size);
+    static void operator delete(void* Pointer);
+
     /**
     * function didnt detected the state of pNextTask
     * make sure the task is not completed.
@@ -124,7 +135,6 @@ private: //internal-use-purpose.
     ThreadName mThreadName = ThreadName::Worker;
     TaskPriority mPriority = TaskPriority::Normal;
     std::atomic<bool> mCompleted = false;
-    std::atomic<bool> mRecycled = false;
     std::atomic<bool> mDontCompleteUntil = false;
     std::atomic<int> mAntecedentDependencyCount = 1;
     std::atomic<int> mReferenceCount = 2;
@@ -140,8 +150,10 @@ private: //internal-use-purpose.
     *	* DontCompleteUntil() - AddSubsequents.
     *	* AddSubsequents, detect the resursive refs.
     */
+    //most tasks have one or two subsequents, they stay inside the node.
+    using SubsequentList = base::small_vector<TaskGraphNode*, 4>;
     std::mutex mSubseuquentsMutex;
-    std::vector<TaskGraphNode*> mSubsequents;
+    SubsequentList mSubsequents;
 
 #ifdef ENABLE_PROFILING
 private:
@@ -159,7 +171,7 @@ private://internal use.
     friend class TaskGraphNode;
     friend struct Task;
     void ScheduleTask(TaskGraphNode* task);
-    void Start(uint32_t NumWorkers);
+    void Start(uint32_t NumWorkers, bool bPinThreads);
     void Stop();
 
 private:
@@ -0,0 +1,441 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include "Texture.h"
+
+namespace
+{
+    //texel offsets within a level are computed in int.
+    const int MaxImageSize = 16384;
+
+    int WrapCoordinate(int value, int size)
+    {
+        value %= size;
+        return value < 0 ? value + size : value;
+    }
+
+    int LevelSize(int size, int level)
+    {
+        return math::max2(size >> level, 1);
+    }
+
+    int NumTiles(int size)
+    {
+        return (size + TiledTextureFile::TileSize - 1) / TiledTextureFile::TileSize;
+    }
+
+    const Float* TexelAt(const std::vector<Float>& level, int width, int height, int x, int y)
+    {
+        return &level[(WrapCoordinate(y, height) * width + WrapCoordinate(x, width)) * 3];
+    }
+}
+
+bool LoadPortableFloatMap(const std::string& path, std::vector<Spectrum>& outPixels, int& outWidth, int& outHeight)
+{
+    FILE* f = nullptr;
+    if (fopen_s(&f, path.c_str(), "rb") != 0 || f == nullptr)
+    {
+        return false;
+    }
+
+    char magic[3] = { 0 };
+    int width = 0, height = 0;
+    float scale = 0;
+    bool succeeded = fscanf_s(f, "%2s %d %d %f", magic, (unsigned)sizeof(magic), &width, &height, &scale) == 4
+        && magic[0] == 'P' && magic[1] == 'F'
+        && width > 0 && height > 0
+        && width <= MaxImageSize && height <= MaxImageSize;
+
+    //single whitespace between header and data.
+    succeeded = succeeded && fgetc(f) != EOF;
+
+    std::vector<float> data;
+    if (succeeded)
+    {
+        data.resize(static_cast<size_t>(width) * static_cast<size_t>(height) * 3);
+        succeeded = fread(data.data(), sizeof(float), data.size(), f) == data.size();
+    }
+    fclose(f);
+
+    if (!succeeded)
+    {
+        return false;
+    }
+
+    //negative scale means little-endian data.
+    if (scale > 0)
+    {
+        for (float& value : data)
+        {
+            uint8_t* bytes = reinterpret_cast<uint8_t*>(&value);
+            std::swap(bytes[0], bytes[3]);
+            std::swap(bytes[1], bytes[2]);
+        }
+    }
+
+    //pfm stores rows from bottom to top.
+    outPixels.resize(static_cast<size_t>(width) * static_cast<size_t>(height));
+    for (int RowIndex = 0; RowIndex < height; RowIndex++)
+    {
+        const float* SourceRow = &data[static_cast<size_t>(height - 1 - RowIndex) * width * 3];
+        for (int ColIndex = 0; ColIndex < width; ColIndex++)
+        {
+            outPixels[static_cast<size_t>(RowIndex) * width + ColIndex].set(SourceRow[ColIndex * 3 + 0], SourceRow[ColIndex * 3 + 1], SourceRow[ColIndex * 3 + 2]);
+        }
+    }
+    outWidth = width;
+    outHeight = height;
+    return true;
+}
+
+bool TiledTextureFile::Build(const std::string& sourcePath, const std::string& tiledPath)
+{
+    std::vector<Spectrum> pixels;
+    Header Info;
+    if (!LoadPortableFloatMap(sourcePath, pixels, Info.Width, Info.Height))
+    {
+        return false;
+    }
+
+    Info.NumLevels = 1;
+    while (LevelSize(Info.Width, Info.NumLevels - 1) > 1 || LevelSize(Info.Height, Info.NumLevels - 1) > 1)
+    {
+        Info.NumLevels += 1;
+    }
+
+    //written to a temporary file first, an interrupted build never leaves a broken texture.
+    const std::string temporaryPath = tiledPath + ".tmp";
+    FILE* f = nullptr;
+    if (fopen_s(&f, temporaryPath.c_str(), "wb") != 0 || f == nullptr)
+    {
+        return false;
+    }
+
+    bool succeeded = fwrite(&Info, sizeof(Info), 1, f) == 1;
+
+    std::vector<Float> level(pixels.size() * 3);
+    for (size_t index = 0; index < pixels.size(); index++)
+    {
+        level[index * 3 + 0] = pixels[index].x;
+        level[index * 3 + 1] = pixels[index].y;
+        level[index * 3 + 2] = pixels[index].z;
+    }
+    pixels.clear();
+
+    std::vector<float> tile(TileStride * TileStride * 3);
+    for (int LevelIndex = 0; succeeded && LevelIndex < Info.NumLevels; LevelIndex++)
+    {
+        const int Width = LevelSize(Info.Width, LevelIndex);
+        const int Height = LevelSize(Info.Height, LevelIndex);
+        if (LevelIndex > 0)
+        {
+            //2x2 box filter of the finer level, odd sizes repeat the last texel.
+            const int FinerWidth = LevelSize(Info.Width, LevelIndex - 1);
+            const int FinerHeight = LevelSize(Info.Height, LevelIndex - 1);
+            std::vector<Float> coarser(Width * Height * 3);
+            for (int y = 0; y < Height; y++)
+            {
+                for (int x = 0; x < Width; x++)
+                {
+                    const int x0 = math::min2(x * 2, FinerWidth - 1), x1 = math::min2(x * 2 + 1, FinerWidth - 1);
+                    const int y0 = math::min2(y * 2, FinerHeight - 1), y1 = math::min2(y * 2 + 1, FinerHeight - 1);
+                    for (int channel = 0; channel < 3; channel++)
+                    {
+                        coarser[(y * Width + x) * 3 + channel] = Float(0.25) * (
+                            level[(y0 * FinerWidth + x0) * 3 + channel] + level[(y0 * FinerWidth + x1) * 3 + channel] +
+                            level[(y1 * FinerWidth + x0) * 3 + channel] + level[(y1 * FinerWidth + x1) * 3 + channel]);
+                    }
+                }
+            }
+            level.swap(coarser);
+        }
+
+        for (int TileY = 0; succeeded && TileY < NumTiles(Height); TileY++)
+        {
+            for (int TileX = 0; succeeded && TileX < NumTiles(Width); TileX++)
+            {
+                for (int y = 0; y < TileStride; y++)
+                {
+                    for (int x = 0; x < TileStride; x++)
+                    {
+                        const Float* Texel = TexelAt(level, Width, Height, TileX * TileSize + x, TileY * TileSize + y);
+                        float* Target = &tile[(y * TileStride + x) * 3];
+                        Target[0] = static_cast<float>(Texel[0]);
+                        Target[1] = static_cast<float>(Texel[1]);
+                        Target[2] = static_cast<float>(Texel[2]);
+                    }
+                }
+                succeeded = fwrite(tile.data(), sizeof(float), tile.size(), f) == tile.size();
+            }
+        }
+    }
+
+    succeeded = (fclose(f) == 0) && succeeded;
+    if (!succeeded)
+    {
+        remove(temporaryPath.c_str());
+        return false;
+    }
+
+    remove(tiledPath.c_str());
+    return rename(temporaryPath.c_str(), tiledPath.c_str()) == 0;
+}
+
+TextureCache::TextureCache(size_t budgetBytes)
+    : mBudgetBytes(budgetBytes)
+{
+
+}
+
+TextureCache::~TextureCache()
+{
+    //disk thread may still hold this.
+    while (mNumLoadsInFlight.load(std::memory_order_acquire) > 0)
+    {
+        std::this_thread::yield();
+    }
+
+    for (Texture& texture : mTextures)
+    {
+        texture.File->destroy();
+    }
+}
+
+int TextureCache::Open(const std::string& tiledPath)
+{
+    base::mapped_file_archive_read* f = base::create_archive_mapped_file_read(tiledPath);
+    if (f == nullptr)
+    {
+        return -1;
+    }
+
+    TiledTextureFile::Header Info;
+    const bool HeaderFits = f->size() >= sizeof(Info);
+    if (HeaderFits)
+    {
+        *f << Info;
+    }
+    const bool succeeded = HeaderFits
+        && Info.Magic == TiledTextureFile::FileMagic
+        && Info.Version == TiledTextureFile::FileVersion
+        && Info.Width > 0 && Info.Height > 0
+        && Info.NumLevels > 0;
+    if (!succeeded)
+    {
+        f->destroy();
+        return -1;
+    }
+
+    //tiles are looked up all over the file.
+    f->set_access_hint(base::access_hint::random);
+
+    Texture texture;
+    texture.File = f;
+    uint64_t FirstTile = 0;
+    for (int LevelIndex = 0; LevelIndex < Info.NumLevels; LevelIndex++)
+    {
+        TextureLevel level;
+        level.Width = LevelSize(Info.Width, LevelIndex);
+        level.Height = LevelSize(Info.Height, LevelIndex);
+        level.NumTileX = NumTiles(level.Width);
+        level.NumTileY = NumTiles(level.Height);
+        level.FirstTile = FirstTile;
+        FirstTile += static_cast<uint64_t>(level.NumTileX) * level.NumTileY;
+        texture.Levels.push_back(level);
+    }
+
+    const int TextureIndex = static_cast<int>(mTextures.size());
+    mTextures.push_back(texture);
+
+    //coarse levels are always there to fall back to.
+    for (int LevelIndex = 0; LevelIndex < Info.NumLevels; LevelIndex++)
+    {
+        const TextureLevel& level = mTextures[TextureIndex].Levels[LevelIndex];
+        if (level.NumTileX * level.NumTileY == 1)
+        {
+            std::shared_ptr<const Tile> tile = ReadTile(TextureIndex, LevelIndex, 0, 0);
+            if (tile == nullptr)
+            {
+                return -1;
+            }
+            std::lock_guard<std::mutex> lock(mMutex);
+            InsertTile(MakeKey(TextureIndex, LevelIndex, 0, 0), tile, true);
+        }
+    }
+    return TextureIndex;
+}
+
+Spectrum TextureCache::Sample(int texture, Float u, Float v, Float footprint, bool bPreview)
+{
+    const std::vector<TextureLevel>& Levels = mTextures[texture].Levels;
+    const int NumLevels = static_cast<int>(Levels.size());
+    const Float TexelFootprint = footprint * math::max2(Levels[0].Width, Levels[0].Height);
+    const Float Lod = math::clamp(std::log2(math::max2(TexelFootprint, Float(1))), Float(0), Float(NumLevels - 1));
+
+    const int FinerLevel = static_cast<int>(Lod);
+    const int CoarserLevel = math::min2(FinerLevel + 1, NumLevels - 1);
+    Spectrum Finer, Coarser;
+    if (!Bilinear(texture, FinerLevel, u, v, bPreview, Finer) || !Bilinear(texture, CoarserLevel, u, v, bPreview, Coarser))
+    {
+        return Spectrum::one();
+    }
+    return math::lerp(Finer, Coarser, Lod - FinerLevel);
+}
+
+TextureCache::Statistics TextureCache::CollectStatistics()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    Statistics result = mStatistics;
+    mStatistics = Statistics();
+    mStatistics.HighWaterBytes = mResidentBytes;
+    return result;
+}
+
+uint64_t TextureCache::MakeKey(int texture, int level, int tileX, int tileY)
+{
+    return (static_cast<uint64_t>(texture) << 48)
+        | (static_cast<uint64_t>(level) << 40)
+        | (static_cast<uint64_t>(tileY) << 20)
+        | static_cast<uint64_t>(tileX);
+}
+
+std::shared_ptr<const TextureCache::Tile> TextureCache::ReadTile(int texture, int level, int tileX, int tileY)
+{
+    const Texture& Source = mTextures[texture];
+    const TextureLevel& Level = Source.Levels[level];
+    const uint64_t TileIndex = Level.FirstTile + static_cast<uint64_t>(tileY) * Level.NumTileX + tileX;
+    const uint64_t Offset = sizeof(TiledTextureFile::Header) + TileIndex * TiledTextureFile::TileBytes;
+    if (Offset + TiledTextureFile::TileBytes > Source.File->size())
+    {
+        return nullptr;
+    }
+
+    //straight from the mapping, so disk thread and open do not share a file position.
+    std::shared_ptr<Tile> tile = std::make_shared<Tile>();
+    tile->Texels.resize(TiledTextureFile::TileBytes / sizeof(float));
+    std::memcpy(tile->Texels.data(), Source.File->data() + Offset, TiledTextureFile::TileBytes);
+    return tile;
+}
+
+std::shared_ptr<const TextureCache::Tile> TextureCache::FindTile(int texture, int level, int tileX, int tileY, bool bWaitForLoad)
+{
+    const uint64_t Key = MakeKey(texture, level, tileX, tileY);
+    std::unique_lock<std::mutex> lock(mMutex);
+    mStatistics.Lookups += 1;
+
+    auto it = mTiles.find(Key);
+    if (it != mTiles.end())
+    {
+        mStatistics.Hits += 1;
+        CacheEntry& Entry = it->second;
+        if (!Entry.Pinned)
+        {
+            mRecentlyUsed.splice(mRecentlyUsed.begin(), mRecentlyUsed, Entry.Position);
+        }
+        return Entry.Tile;
+    }
+
+    //read on this thread, the disk thread may be far behind.
+    if (bWaitForLoad)
+    {
+        lock.unlock();
+        std::shared_ptr<const Tile> tile = ReadTile(texture, level, tileX, tileY);
+        if (tile != nullptr)
+        {
+            lock.lock();
+            InsertTile(Key, tile, false);
+        }
+        return tile;
+    }
+
+    if (mPendingLoads.insert(Key).second)
+    {
+        mNumLoadsInFlight.fetch_add(1, std::memory_order_acq_rel);
+        Task::Start(ThreadName::DiskIO, [this, Key, texture, level, tileX, tileY](auto)
+            {
+                std::shared_ptr<const Tile> tile = ReadTile(texture, level, tileX, tileY);
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    mPendingLoads.erase(Key);
+                    if (tile != nullptr)
+                    {
+                        InsertTile(Key, tile, false);
+                    }
+                }
+                mNumLoadsInFlight.fetch_sub(1, std::memory_order_acq_rel);
+            });
+    }
+    return nullptr;
+}
+
+void TextureCache::InsertTile(uint64_t key, std::shared_ptr<const Tile> tile, bool pinned)
+{
+    //budget is a hard limit, a tile that does not fit is dropped,
+    // readers are holding their own references to evicted tiles.
+    if (mTiles.find(key) != mTiles.end())
+    {
+        return;
+    }
+
+    const size_t TileBytes = TiledTextureFile::TileBytes;
+    while (!pinned && mResidentBytes + TileBytes > mBudgetBytes && !mRecentlyUsed.empty())
+    {
+        mTiles.erase(mRecentlyUsed.back());
+        mRecentlyUsed.pop_back();
+        mResidentBytes -= TileBytes;
+    }
+    if (!pinned && mResidentBytes + TileBytes > mBudgetBytes)
+    {
+        return;
+    }
+
+    CacheEntry& Entry = mTiles[key];
+    Entry.Tile = std::move(tile);
+    Entry.Pinned = pinned;
+    if (!pinned)
+    {
+        mRecentlyUsed.push_front(key);
+        Entry.Position = mRecentlyUsed.begin();
+    }
+    mResidentBytes += TileBytes;
+    mStatistics.HighWaterBytes = math::max2(mStatistics.HighWaterBytes, mResidentBytes);
+}
+
+bool TextureCache::Bilinear(int texture, int level, Float u, Float v, bool bPreview, Spectrum& outValue)
+{
+    const std::vector<TextureLevel>& Levels = mTextures[texture].Levels;
+    for (int LevelIndex = level; LevelIndex < static_cast<int>(Levels.size()); LevelIndex++)
+    {
+        const TextureLevel& Level = Levels[LevelIndex];
+        const Float x = u * Level.Width - Float(0.5);
+        const Float y = v * Level.Height - Float(0.5);
+        const Float FloorX = std::floor(x);
+        const Float FloorY = std::floor(y);
+        const int x0 = WrapCoordinate(static_cast<int>(FloorX), Level.Width);
+        const int y0 = WrapCoordinate(static_cast<int>(FloorY), Level.Height);
+        const int TileX = x0 / TiledTextureFile::TileSize;
+        const int TileY = y0 / TiledTextureFile::TileSize;
+
+        std::shared_ptr<const Tile> tile = FindTile(texture, LevelIndex, TileX, TileY, !bPreview);
+        if (tile == nullptr)
+        {
+            continue;
+        }
+
+        const float* Texel = &tile->Texels[((y0 - TileY * TiledTextureFile::TileSize) * TiledTextureFile::TileStride + (x0 - TileX * TiledTextureFile::TileSize)) * 3];
+        const float* Right = Texel + 3;
+        const float* Below = Texel + TiledTextureFile::TileStride * 3;
+        const float* BelowRight = Below + 3;
+        const Float fx = x - FloorX;
+        const Float fy = y - FloorY;
+        for (int channel = 0; channel < 3; channel++)
+        {
+            const Float Top = math::lerp<Float>(Texel[channel], Right[channel], fx);
+            const Float Bottom = math::lerp<Float>(Below[channel], BelowRight[channel], fx);
+            outValue[channel] = math::lerp(Top, Bottom, fy);
+        }
+        return true;
+    }
+    return false;
+}
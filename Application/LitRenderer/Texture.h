@@ -0,0 +1,116 @@
+#pragma once
+#include <atomic>
+#include <cstdio>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <Foundation/Base/MappedFileHelper.h>
+#include "PreInclude.h"
+
+// portable float map (.pfm), rgb only, rows are returned from top to bottom.
+bool LoadPortableFloatMap(const std::string& path, std::vector<Spectrum>& outPixels, int& outWidth, int& outHeight);
+
+/**
+* mip-mapped texture on disk, every level is split into fixed-size tiles,
+* a tile keeps one more column and row of its neighbours, so bilinear lookups never cross tiles.
+*/
+struct TiledTextureFile
+{
+    static const uint32_t FileMagic = 0x5854524C; // "LRTX"
+    static const uint32_t FileVersion = 1;
+    static const int TileSize = 64;
+    static const int TileStride = TileSize + 1;
+    static const size_t TileBytes = TileStride * TileStride * 3 * sizeof(float);
+
+    struct Header
+    {
+        uint32_t Magic = FileMagic;
+        uint32_t Version = FileVersion;
+        int32_t Width = 0;
+        int32_t Height = 0;
+        int32_t NumLevels = 0;
+        int32_t Reserved = 0;
+    };
+
+    static bool Build(const std::string& sourcePath, const std::string& tiledPath);
+};
+
+/**
+* tiles of all opened textures share one memory budget, least recently used tiles are evicted first.
+* for previews missing tiles are read on disk thread and a coarser level stands in until they arrive,
+* other lookups read missing tiles on the spot, so accumulated passes always see the same texels,
+* the single-tile levels are loaded when a texture is opened and never evicted.
+* files are memory-mapped, only the pages of tiles that are looked up are read from disk.
+*/
+class TextureCache
+{
+public:
+    struct Statistics
+    {
+        uint64_t Lookups = 0;
+        uint64_t Hits = 0;
+        size_t HighWaterBytes = 0;
+        Float HitRate() const { return Lookups > 0 ? Float(Hits) / Float(Lookups) : Float(1); }
+    };
+
+    explicit TextureCache(size_t budgetBytes);
+    ~TextureCache();
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    //returns texture id, -1 when file is not a tiled texture.
+    int Open(const std::string& tiledPath);
+
+    //trilinear, footprint is the width covered by the lookup in uv space.
+    Spectrum Sample(int texture, Float u, Float v, Float footprint, bool bPreview);
+
+    //statistics since last call, high-water mark restarts from current usage.
+    Statistics CollectStatistics();
+
+private:
+    struct Tile
+    {
+        std::vector<float> Texels;
+    };
+
+    struct TextureLevel
+    {
+        int Width = 0, Height = 0;
+        int NumTileX = 0, NumTileY = 0;
+        uint64_t FirstTile = 0;
+    };
+
+    struct Texture
+    {
+        base::mapped_file_archive_read* File = nullptr;
+        std::vector<TextureLevel> Levels;
+    };
+
+    struct CacheEntry
+    {
+        std::shared_ptr<const Tile> Tile;
+        bool Pinned = false;
+        std::list<uint64_t>::iterator Position;
+    };
+
+    static uint64_t MakeKey(int texture, int level, int tileX, int tileY);
+    std::shared_ptr<const Tile> ReadTile(int texture, int level, int tileX, int tileY);
+    std::shared_ptr<const Tile> FindTile(int texture, int level, int tileX, int tileY, bool bWaitForLoad);
+    void InsertTile(uint64_t key, std::shared_ptr<const Tile> tile, bool pinned);
+    bool Bilinear(int texture, int level, Float u, Float v, bool bPreview, Spectrum& outValue);
+
+    const size_t mBudgetBytes;
+    std::vector<Texture> mTextures;
+
+    std::mutex mMutex;
+    std::unordered_map<uint64_t, CacheEntry> mTiles;
+    std::list<uint64_t> mRecentlyUsed;      // front is the most recent one
+    std::unordered_set<uint64_t> mPendingLoads;
+    std::atomic<int> mNumLoadsInFlight = 0;
+    size_t mResidentBytes = 0;
+    Statistics mStatistics;
+};
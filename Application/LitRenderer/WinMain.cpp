@@ -28,10 +28,36 @@ LitRenderer* Renderer = nullptr;
 BOOL WindowRefresh = false;
 INT32 StartDragX = 0;
 INT32 StartDragY = 0;
+RECT CropWindow = { 0, 0, 0, 0 };
 ATOM MyRegisterClass(HINSTANCE hInstance);
 BOOL InitInstance(HINSTANCE, int);
 void CenterWindow(HWND, int, int);
 bool Initialize(HWND);
+void UpdateWindowTitle(HWND);
+void UpdateWindowTitle(HWND hWnd)
+{
+    static DWORD LastUpdateTime = 0;
+    DWORD currentTime = ::GetTickCount();
+    if (currentTime - LastUpdateTime < 250)
+    {
+        return;
+    }
+    LastUpdateTime = currentTime;
+
+    Float samplesPerPixel, progress, etaSeconds;
+    wchar_t title[256];
+    if (Renderer->GetProgress(samplesPerPixel, progress, etaSeconds))
+    {
+        swprintf_s(title, L"%s - %.1f spp (%.1f%%), ETA %.0fs", AppWindowName, samplesPerPixel, progress * 100.0, etaSeconds);
+    }
+    else
+    {
+        swprintf_s(title, L"%s - %.1f spp", AppWindowName, samplesPerPixel);
+    }
+    ::SetWindowTextW(hWnd, title);
+}
+
+int RunTileWorker(const wchar_t* host, unsigned int port);
 
 void Uninitialize(HWND)
 {
@@ -53,7 +79,17 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
     _In_ int		nCmdShow)
 {
     UNREFERENCED_PARAMETER(hPrevInstance);
-    UNREFERENCED_PARAMETER(lpCmdLine);
+
+    //headless tile worker, spawned by coordinator: -worker <host> <port>
+    wchar_t workerHost[64];
+    unsigned int workerPort = 0;
+    if (swscanf_s(lpCmdLine, L"-worker %63s %u", workerHost, (unsigned)_countof(workerHost), &workerPort) == 2)
+    {
+        return RunTileWorker(workerHost, workerPort);
+    }
+
+    //render only a part of canvas: -crop <left> <top> <right> <bottom>
+    swscanf_s(lpCmdLine, L"-crop %ld %ld %ld %ld", &CropWindow.left, &CropWindow.top, &CropWindow.right, &CropWindow.bottom);
 
     MyRegisterClass(hInstance);
     if (!InitInstance(hInstance, nCmdShow) || !Initialize(hWindow))
@@ -86,6 +122,7 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
             if (Renderer->GenerateImageProgressive())
             {
                 WindowRefresh = false;
+                UpdateWindowTitle(hWindow);
             }
         }
 
@@ -177,6 +214,24 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
             case 'R':
                 Renderer->ResetCamera();
                 break;
+            case 'F':
+                Renderer->ToggleDenoiser();
+                break;
+            case 'G':
+                Renderer->TogglePathGuiding();
+                break;
+            case 'N':
+                Renderer->AddLocalTileWorker();
+                break;
+            case 'B':
+                Renderer->ToggleFrameBudget();
+                break;
+            case 'K':
+                Renderer->ToggleReconstructionFilter();
+                break;
+            case 'P':
+                Renderer->ClearPriorityRegion();
+                break;
             }
         }
     }
@@ -202,6 +257,13 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
     case WM_LBUTTONUP:
         ReleaseCapture();
         break;
+    case WM_RBUTTONDOWN:
+        if (Renderer)
+        {
+            //canvas rows go bottom-up.
+            Renderer->SetPriorityRegion(GET_X_LPARAM(lParam), BitmapCanvasHeight - 1 - GET_Y_LPARAM(lParam));
+        }
+        break;
     case WM_MOUSEMOVE:
     {
         bool bIsMousePressL = (DWORD)wParam & MK_LBUTTON;
@@ -295,7 +357,29 @@ bool Initialize(HWND hWindow)
     ::ReleaseDC(hWindow, hdcWindowDC);
 
     Renderer = new LitRenderer(canvasDIBDataPtr, BitmapCanvasWidth, BitmapCanvasHeight, BitmapCanvasLinePitch);
+    if (!::IsRectEmpty(&CropWindow))
+    {
+        Renderer->SetCropWindow(CropWindow.left, BitmapCanvasHeight - CropWindow.bottom, CropWindow.right, BitmapCanvasHeight - CropWindow.top);
+    }
     Renderer->Initialize();
     Renderer->GenerateImageProgressive();
     return true;
 }
+
+int RunTileWorker(const wchar_t* host, unsigned int port)
+{
+    char hostAnsi[64];
+    size_t convertedCount = 0;
+    wcstombs_s(&convertedCount, hostAnsi, host, _TRUNCATE);
+
+    //workers run beside the coordinator on the same machine, let the os spread them.
+    Task::StartSystem(20, false);
+    int exitCode = 0;
+    {
+        std::vector<unsigned char> canvas(BitmapCanvasLinePitch * BitmapCanvasHeight);
+        LitRenderer workerRenderer(canvas.data(), BitmapCanvasWidth, BitmapCanvasHeight, BitmapCanvasLinePitch);
+        exitCode = workerRenderer.RunAsTileWorker(hostAnsi, static_cast<uint16_t>(port));
+    }
+    Task::StopSystem();
+    return exitCode;
+}
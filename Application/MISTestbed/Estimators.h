@@ -0,0 +1,267 @@
+#pragma once
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include <Application/LitRenderer/TaskGraph.h>
+
+/**
+* monte carlo estimators of a 1d integral, for checking sampling strategies offline.
+* an estimator is a callable (trial, sampleCount) -> estimate,
+* samples are drawn and evaluated in fixed-size batches, so the inner loops can be vectorized.
+*/
+namespace testbed
+{
+    using Float = double;
+    const int BatchSize = 8;
+
+    enum class MISHeuristic { Balance, Power };
+
+    inline Float MISWeight(MISHeuristic heuristic, Float pdfA, Float pdfB)
+    {
+        if (heuristic == MISHeuristic::Power)
+        {
+            pdfA *= pdfA;
+            pdfB *= pdfB;
+        }
+        return (pdfA + pdfB) > Float(0) ? pdfA / (pdfA + pdfB) : Float(0);
+    }
+
+    //independent stream of every trial, results do not depend on which worker runs it.
+    struct TrialRandom
+    {
+        TrialRandom(uint32_t trial, uint32_t stream)
+        {
+            std::seed_seq sequence{ trial, stream };
+            generator.seed(sequence);
+        }
+
+        void Fill(Float(&u)[BatchSize])
+        {
+            for (int index = 0; index < BatchSize; index++)
+            {
+                u[index] = distribution(generator);
+            }
+        }
+
+        Float operator()() { return distribution(generator); }
+
+    private:
+        std::mt19937 generator;
+        std::uniform_real_distribution<Float> distribution{ Float(0), Float(1) };
+    };
+
+    //base-2 radical inverse, the van der corput sequence.
+    inline Float RadicalInverse2(uint32_t index)
+    {
+        index = (index << 16) | (index >> 16);
+        index = ((index & 0x00ff00ffu) << 8) | ((index & 0xff00ff00u) >> 8);
+        index = ((index & 0x0f0f0f0fu) << 4) | ((index & 0xf0f0f0f0u) >> 4);
+        index = ((index & 0x33333333u) << 2) | ((index & 0xccccccccu) >> 2);
+        index = ((index & 0x55555555u) << 1) | ((index & 0xaaaaaaaau) >> 1);
+        return Float(index) * Float(2.3283064365386963e-10);
+    }
+
+    //sample count is rounded up to whole batches.
+    inline int NumBatches(int sampleCount)
+    {
+        return (sampleCount + BatchSize - 1) / BatchSize;
+    }
+
+    template<typename Function>
+    auto MakeUniformEstimator(Function f, Float lower, Float upper)
+    {
+        return [=](uint32_t trial, int sampleCount)
+        {
+            TrialRandom random(trial, 0);
+            const Float range = upper - lower;
+            const int numBatches = NumBatches(sampleCount);
+            Float sum = Float(0);
+            for (int batch = 0; batch < numBatches; batch++)
+            {
+                Float u[BatchSize];
+                random.Fill(u);
+                for (int index = 0; index < BatchSize; index++)
+                {
+                    sum += f(lower + u[index] * range);
+                }
+            }
+            return sum * range / (numBatches * BatchSize);
+        };
+    }
+
+    template<typename Function, typename Pdf, typename Sample>
+    auto MakeImportanceEstimator(Function f, Pdf pdf, Sample sample)
+    {
+        return [=](uint32_t trial, int sampleCount)
+        {
+            TrialRandom random(trial, 1);
+            const int numBatches = NumBatches(sampleCount);
+            Float sum = Float(0);
+            for (int batch = 0; batch < numBatches; batch++)
+            {
+                Float u[BatchSize];
+                random.Fill(u);
+                for (int index = 0; index < BatchSize; index++)
+                {
+                    const Float x = sample(u[index]);
+                    const Float p = pdf(x);
+                    sum += p > Float(0) ? f(x) / p : Float(0);
+                }
+            }
+            return sum / (numBatches * BatchSize);
+        };
+    }
+
+    //one sample of each strategy per sample count, weighted by the heuristic.
+    template<typename Function, typename Pdf1, typename Sample1, typename Pdf2, typename Sample2>
+    auto MakeMISEstimator(Function f, Pdf1 pdf1, Sample1 sample1, Pdf2 pdf2, Sample2 sample2, MISHeuristic heuristic)
+    {
+        return [=](uint32_t trial, int sampleCount)
+        {
+            TrialRandom random1(trial, 2);
+            TrialRandom random2(trial, 3);
+            const int numBatches = NumBatches(sampleCount);
+            Float sum = Float(0);
+            for (int batch = 0; batch < numBatches; batch++)
+            {
+                Float u1[BatchSize], u2[BatchSize];
+                random1.Fill(u1);
+                random2.Fill(u2);
+                for (int index = 0; index < BatchSize; index++)
+                {
+                    const Float x1 = sample1(u1[index]);
+                    const Float p11 = pdf1(x1), p21 = pdf2(x1);
+                    sum += p11 > Float(0) ? MISWeight(heuristic, p11, p21) * f(x1) / p11 : Float(0);
+
+                    const Float x2 = sample2(u2[index]);
+                    const Float p12 = pdf1(x2), p22 = pdf2(x2);
+                    sum += p22 > Float(0) ? MISWeight(heuristic, p22, p12) * f(x2) / p22 : Float(0);
+                }
+            }
+            return sum / (numBatches * BatchSize);
+        };
+    }
+
+    //van der corput points, shifted randomly per trial (cranley-patterson rotation),
+    // so the variance between trials is still meaningful.
+    template<typename Function>
+    auto MakeQMCEstimator(Function f, Float lower, Float upper)
+    {
+        return [=](uint32_t trial, int sampleCount)
+        {
+            TrialRandom random(trial, 4);
+            const Float shift = random();
+            const Float range = upper - lower;
+            const int numBatches = NumBatches(sampleCount);
+            Float sum = Float(0);
+            for (int batch = 0; batch < numBatches; batch++)
+            {
+                Float u[BatchSize];
+                for (int index = 0; index < BatchSize; index++)
+                {
+                    const Float point = RadicalInverse2(static_cast<uint32_t>(batch * BatchSize + index)) + shift;
+                    u[index] = point < Float(1) ? point : point - Float(1);
+                }
+                for (int index = 0; index < BatchSize; index++)
+                {
+                    sum += f(lower + u[index] * range);
+                }
+            }
+            return sum * range / (numBatches * BatchSize);
+        };
+    }
+
+    struct EstimatorReport
+    {
+        std::string Name;
+        int SampleCount = 0;
+        int NumTrials = 0;
+        Float Mean = Float(0);
+        Float Variance = Float(0);
+        Float RMSE = Float(0);
+        Float SamplesPerSecond = Float(0);
+    };
+
+    /**
+    * runs independent trials of an estimator on TaskGraph workers,
+    * and measures them against the reference value.
+    */
+    class EstimatorBench
+    {
+    public:
+        static const int TrialsPerTask = 16;
+
+        EstimatorBench(Float reference, int numTrials = 256)
+            : mReference(reference), mNumTrials(numTrials) { }
+
+        template<typename Estimator>
+        EstimatorReport Run(const std::string& name, const Estimator& estimator, int sampleCount) const
+        {
+            std::vector<Float> estimates(mNumTrials);
+            const auto startTime = std::chrono::steady_clock::now();
+
+            std::vector<Task> trialTasks;
+            for (int trialStart = 0; trialStart < mNumTrials; trialStart += TrialsPerTask)
+            {
+                const int trialEnd = trialStart + TrialsPerTask < mNumTrials ? trialStart + TrialsPerTask : mNumTrials;
+                trialTasks.push_back(Task::Start(ThreadName::Worker, [&estimator, &estimates, trialStart, trialEnd, sampleCount](Task&)
+                    {
+                        for (int trial = trialStart; trial < trialEnd; trial++)
+                        {
+                            estimates[trial] = estimator(static_cast<uint32_t>(trial), sampleCount);
+                        }
+                    }));
+            }
+            for (Task& task : trialTasks)
+            {
+                task.SpinWait();
+            }
+
+            const std::chrono::duration<Float> elapsed = std::chrono::steady_clock::now() - startTime;
+
+            EstimatorReport report;
+            report.Name = name;
+            report.SampleCount = NumBatches(sampleCount) * BatchSize;
+            report.NumTrials = mNumTrials;
+
+            Float sum = Float(0), squareError = Float(0);
+            for (Float estimate : estimates)
+            {
+                sum += estimate;
+                squareError += (estimate - mReference) * (estimate - mReference);
+            }
+            report.Mean = sum / mNumTrials;
+
+            Float squareDeviation = Float(0);
+            for (Float estimate : estimates)
+            {
+                squareDeviation += (estimate - report.Mean) * (estimate - report.Mean);
+            }
+            report.Variance = mNumTrials > 1 ? squareDeviation / (mNumTrials - 1) : Float(0);
+            report.RMSE = std::sqrt(squareError / mNumTrials);
+            report.SamplesPerSecond = elapsed.count() > Float(0)
+                ? Float(report.SampleCount) * mNumTrials / elapsed.count()
+                : Float(0);
+            return report;
+        }
+
+        //rmse against doubling sample counts, a slope of -1/2 on log-log scale is plain monte carlo.
+        template<typename Estimator>
+        std::vector<EstimatorReport> Convergence(const std::string& name, const Estimator& estimator, int minSampleCount, int maxSampleCount) const
+        {
+            std::vector<EstimatorReport> curve;
+            for (int sampleCount = minSampleCount; sampleCount <= maxSampleCount; sampleCount *= 2)
+            {
+                curve.push_back(Run(name, estimator, sampleCount));
+            }
+            return curve;
+        }
+
+    private:
+        const Float mReference;
+        const int mNumTrials;
+    };
+}
@@ -1,127 +1,92 @@
-#include <iostream>
-#include <random>
-
-
-std::random_device rdevice;
-std::mt19937 generator(rdevice());
-
-const float kPI = 3.1415926535f;
-const float kUpperBound = kPI * 0.5f;
-const float kLowerBound = 0.0f;
-const int kSamples = 500;
-
-template<typename Float>
-float Trapezoid(Float f)
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "Estimators.h"
+
+using testbed::Float;
+
+const Float kPI = Float(3.14159265358979323846);
+const Float kUpperBound = kPI * Float(0.5);
+const Float kLowerBound = Float(0);
+const int kSamples = 512;
+const int kTrials = 256;
+const int kMinCurveSamples = 16;
+const int kMaxCurveSamples = 16384;
+
+template<typename Function>
+Float Trapezoid(Function f)
 {
-    float sum = 0.0f;
-    const float dx = 0.001f;
-    for (float x = kLowerBound; x < kUpperBound; x += dx)
+    Float sum = Float(0);
+    const int steps = 1000;
+    const Float dx = (kUpperBound - kLowerBound) / steps;
+    for (int i = 0; i < steps; i++)
     {
-        float height = 0.5f * (f(x + dx) + f(x));
+        Float x = kLowerBound + i * dx;
+        Float height = Float(0.5) * (f(x + dx) + f(x));
         sum += height * dx;
     }
     return sum;
 }
 
-template<typename Float>
-float UniformSampling(Float f)
+void PrintReport(const testbed::EstimatorReport& report)
 {
-    std::uniform_real_distribution<float> distribution(kLowerBound, kUpperBound);
-
-    float sum = 0.0f;
-    float pdf = 1.0f / (kUpperBound - kLowerBound);
-    for (int i = 0; i < kSamples; i++)
-    {
-        float x = distribution(generator);
-        sum += f(x);
-    }
-    return sum / (kSamples * pdf);
-}
-
-template<typename Float, typename PDF, typename Distribution>
-float ImportanceSampling(Float f, PDF pdf, Distribution distrib)
-{
-    std::uniform_real_distribution<float> u(0.0f, 1.0f);
-
-    float sum = 0.0f;
-    for (int i = 0; i < kSamples; i++)
-    {
-        float epsilon = u(generator);
-        float x = distrib(epsilon);
-        sum += f(x) / pdf(x);
-    }
-
-    return sum / kSamples;
+    printf("%-28s n=%-6d mean=%.6f variance=%.3e rmse=%.3e samples/sec=%.3e\n",
+        report.Name.c_str(), report.SampleCount, report.Mean, report.Variance, report.RMSE, report.SamplesPerSecond);
 }
 
-template<typename Float
-    , typename PDF1, typename Distribution1
-    , typename PDF2, typename Distribution2>
-    float MultipleImportanceSampling(Float f,
-        PDF1 pdf1, Distribution1 distrib1,
-        PDF2 pdf2, Distribution2 distrib2)
+void PrintCurve(const std::vector<testbed::EstimatorReport>& curve)
 {
-    auto weight = [](float pdf1, float pdf2)
-    {
-        pdf1 *= pdf1; pdf2 *= pdf2;
-        return pdf1 / (pdf1 + pdf2);
-    };
-
-    std::uniform_real_distribution<float> u1(0.0f, 1.0f);
-    std::uniform_real_distribution<float> u2(0.0f, 1.0f);
-
-    float sum = 0.0f;
-    for (int i = 0; i < kSamples; i++)
+    printf("%s\n", curve.front().Name.c_str());
+    for (const testbed::EstimatorReport& point : curve)
     {
-        //sample pdf 1;
-        float epsilon1 = u1(generator);
-        float x1 = distrib1(epsilon1);
-
-        sum += weight(pdf1(x1), pdf2(x1)) * f(x1) / pdf1(x1);
-
-        //sample pdf 2;
-        float epsilon2 = u2(generator);
-        float x2 = distrib2(epsilon2);
-
-        sum += weight(pdf1(x2), pdf2(x2)) * f(x2) / pdf2(x2);
+        printf("    n=%-6d rmse=%.3e\n", point.SampleCount, point.RMSE);
     }
-
-    return sum / kSamples;
 }
 
-
-void main()
+int main()
 {
 #if 0
-    auto y = [](float x) { return 2.0f + (x - 2.0f) * x * x; };
-    auto Fy = [](float x) { return x * (x * x * (x / 4.0f - 2.0f / 3.0f) + 2.0f); };
-    auto pdf1 = [](float x) { return x * x * x / 4.0f; };
-    auto pdf2 = [](float x) { return 1.0f - 0.5f * x; };
-    auto distrib1 = [](float e) { return sqrt(sqrt(e)) * 2.0f; };
-    auto distrib2 = [](float e) { return 2.0f * (1.0f - sqrt(1.0f - e)); };
+    auto y = [](Float x) { return 2.0 + (x - 2.0) * x * x; };
+    auto Fy = [](Float x) { return x * (x * x * (x / 4.0 - 2.0 / 3.0) + 2.0); };
+    auto pdf1 = [](Float x) { return x * x * x / 4.0; };
+    auto pdf2 = [](Float x) { return 1.0 - 0.5 * x; };
+    auto distrib1 = [](Float e) { return std::sqrt(std::sqrt(e)) * 2.0; };
+    auto distrib2 = [](Float e) { return 2.0 * (1.0 - std::sqrt(1.0 - e)); };
 #else
 
-    auto y = [](float x) { return cosf(x) * sinf(x); };
-    auto Fy = [](float x) { return 0.5f * sinf(x) * sinf(x); };
-    auto pdf1 = [](float x) { return 8.0f * x / (kPI * kPI); };
-    auto pdf2 = [](float x) { return 4.0f / kPI - 8 * x / (kPI * kPI); };
-    auto distrib1 = [](float e) { return kPI * 0.5f * sqrt(e); };
-    auto distrib2 = [](float e) { return kPI * 0.5f * (1.0f - sqrt(1 - e)); };
+    auto y = [](Float x) { return std::cos(x) * std::sin(x); };
+    auto Fy = [](Float x) { return 0.5 * std::sin(x) * std::sin(x); };
+    auto pdf1 = [](Float x) { return 8.0 * x / (kPI * kPI); };
+    auto pdf2 = [](Float x) { return 4.0 / kPI - 8.0 * x / (kPI * kPI); };
+    auto distrib1 = [](Float e) { return kPI * 0.5 * std::sqrt(e); };
+    auto distrib2 = [](Float e) { return kPI * 0.5 * (1.0 - std::sqrt(1.0 - e)); };
 #endif
 
-    float analytic = Fy(kUpperBound) - Fy(kLowerBound);
-    float trapezoid = Trapezoid(y);
-    float uniform = UniformSampling(y);
-    float importance1 = ImportanceSampling(y, pdf1, distrib1);
-    float importance2 = ImportanceSampling(y, pdf2, distrib2);
-    float mult_importance = MultipleImportanceSampling(y, pdf1, distrib1, pdf2, distrib2);
-
-
-    std::cout
-        << "analytic result=" << analytic << std::endl
-        << "trapezoid sum=" << trapezoid << std::endl
-        << "uniform sampling=" << uniform << std::endl
-        << "importance sampling =" << importance1 << std::endl
-        << "importance sampling =" << importance2 << std::endl
-        << "multiple importance sampling =" << mult_importance << std::endl;
+    Task::StartSystem(std::thread::hardware_concurrency());
+    {
+        const Float analytic = Fy(kUpperBound) - Fy(kLowerBound);
+        printf("analytic result=%.6f\n", analytic);
+        printf("trapezoid sum=%.6f\n", Trapezoid(y));
+
+        auto uniform = testbed::MakeUniformEstimator(y, kLowerBound, kUpperBound);
+        auto importance1 = testbed::MakeImportanceEstimator(y, pdf1, distrib1);
+        auto importance2 = testbed::MakeImportanceEstimator(y, pdf2, distrib2);
+        auto misBalance = testbed::MakeMISEstimator(y, pdf1, distrib1, pdf2, distrib2, testbed::MISHeuristic::Balance);
+        auto misPower = testbed::MakeMISEstimator(y, pdf1, distrib1, pdf2, distrib2, testbed::MISHeuristic::Power);
+        auto qmc = testbed::MakeQMCEstimator(y, kLowerBound, kUpperBound);
+
+        testbed::EstimatorBench bench(analytic, kTrials);
+        PrintReport(bench.Run("uniform sampling", uniform, kSamples));
+        PrintReport(bench.Run("importance sampling 1", importance1, kSamples));
+        PrintReport(bench.Run("importance sampling 2", importance2, kSamples));
+        PrintReport(bench.Run("mis balance heuristic", misBalance, kSamples));
+        PrintReport(bench.Run("mis power heuristic", misPower, kSamples));
+        PrintReport(bench.Run("qmc van der corput", qmc, kSamples));
+
+        PrintCurve(bench.Convergence("uniform sampling", uniform, kMinCurveSamples, kMaxCurveSamples));
+        PrintCurve(bench.Convergence("mis power heuristic", misPower, kMinCurveSamples, kMaxCurveSamples));
+        PrintCurve(bench.Convergence("qmc van der corput", qmc, kMinCurveSamples, kMaxCurveSamples));
+    }
+    Task::StopSystem();
+    return 0;
 }
@@ -0,0 +1,172 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#define NOMINMAX
+#include <Windows.h>
+
+/**
+* timing and error bookkeeping of the foundation math benchmark.
+* every case is timed over the whole input set several times and the fastest pass is kept,
+* its error is measured against the same routine in double precision.
+*/
+namespace bench
+{
+    struct Result
+    {
+        std::string Name;
+        double NanosecondsPerOp = 0.0;
+        double MaxError = 0.0;
+        double MismatchRate = 0.0;  // hit / miss or classification differs from the reference
+    };
+
+    struct ErrorStats
+    {
+        double MaxError = 0.0;
+        int NumMismatches = 0;
+        int NumSamples = 0;
+
+        void Add(double error)
+        {
+            MaxError = std::max(MaxError, error);
+            NumSamples++;
+        }
+
+        void AddMismatch()
+        {
+            NumMismatches++;
+            NumSamples++;
+        }
+
+        double MismatchRate() const { return NumSamples > 0 ? double(NumMismatches) / NumSamples : 0.0; }
+    };
+
+    //relative to the reference, but absolute near zero.
+    inline double RelativeError(double value, double reference)
+    {
+        return std::fabs(value - reference) / std::max(1.0, std::fabs(reference));
+    }
+
+    //in units of the last place of the reference rounded to float.
+    inline double UlpError(float value, double reference)
+    {
+        const float rounded = std::fabs(static_cast<float>(reference));
+        const double ulp = double(std::nextafter(rounded, INFINITY)) - double(rounded);
+        return std::fabs(double(value) - reference) / ulp;
+    }
+
+    //pins the calling thread, so the timings do not include migrations between cores.
+    inline bool PinCurrentThread(int cpu)
+    {
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+        return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+    }
+
+    //op(index) is called for every input, its results are summed so the calls can not be optimized away.
+    template<typename Operation>
+    double NanosecondsPerOp(int numInputs, int numPasses, Operation op)
+    {
+        volatile double sink = 0.0;
+        double best = 0.0;
+        for (int pass = -1; pass < numPasses; pass++)
+        {
+            double sum = 0.0;
+            const auto startTime = std::chrono::steady_clock::now();
+            for (int index = 0; index < numInputs; index++)
+            {
+                sum += op(index);
+            }
+            const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - startTime;
+            sink = sink + sum;
+
+            // pass -1 warms up caches and branch predictors.
+            if (pass == 0 || (pass > 0 && elapsed.count() < best))
+            {
+                best = elapsed.count();
+            }
+        }
+        return best / numInputs;
+    }
+
+    inline bool WriteResults(FILE* file, const std::vector<Result>& results)
+    {
+        fprintf(file, "name,ns_per_op,max_error,mismatch_rate\n");
+        for (const Result& result : results)
+        {
+            fprintf(file, "%s,%.4f,%.6e,%.6e\n", result.Name.c_str(), result.NanosecondsPerOp, result.MaxError, result.MismatchRate);
+        }
+        return ferror(file) == 0;
+    }
+
+    inline bool ReadResults(const std::string& path, std::vector<Result>& outResults)
+    {
+        FILE* f = nullptr;
+        if (fopen_s(&f, path.c_str(), "r") != 0 || f == nullptr)
+        {
+            return false;
+        }
+
+        char line[256];
+        bool header = true;
+        while (fgets(line, sizeof(line), f) != nullptr)
+        {
+            if (header)
+            {
+                header = false;
+                continue;
+            }
+
+            char name[128];
+            Result result;
+            if (sscanf_s(line, "%127[^,],%lf,%lf,%lf", name, unsigned(sizeof(name)), &result.NanosecondsPerOp, &result.MaxError, &result.MismatchRate) == 4)
+            {
+                result.Name = name;
+                outResults.push_back(result);
+            }
+        }
+        fclose(f);
+        return true;
+    }
+
+    /**
+    * flags cases slower than the baseline by more than the threshold,
+    * and cases whose error or mismatch rate grew by more than the threshold.
+    * returns the number of flagged cases.
+    */
+    inline int Compare(const std::vector<Result>& baseline, const std::vector<Result>& current, double threshold)
+    {
+        // a change of error below this is noise of the last bits, not drift.
+        const double errorFloor = 1e-12;
+        int numRegressions = 0;
+        for (const Result& now : current)
+        {
+            auto it = std::find_if(baseline.begin(), baseline.end(), [&now](const Result& r) { return r.Name == now.Name; });
+            if (it == baseline.end())
+            {
+                printf("%-24s new case\n", now.Name.c_str());
+                continue;
+            }
+
+            const Result& before = *it;
+            const double speedup = now.NanosecondsPerOp > 0.0 ? before.NanosecondsPerOp / now.NanosecondsPerOp : 0.0;
+            const bool slower = now.NanosecondsPerOp > before.NanosecondsPerOp * (1.0 + threshold);
+            const bool drifted = now.MaxError > before.MaxError * (1.0 + threshold) + errorFloor
+                || now.MismatchRate > before.MismatchRate * (1.0 + threshold) + errorFloor;
+
+            printf("%-24s %8.3f -> %8.3f ns (x%.2f)  error %.3e -> %.3e  mismatch %.3e -> %.3e%s%s\n",
+                now.Name.c_str(), before.NanosecondsPerOp, now.NanosecondsPerOp, speedup,
+                before.MaxError, now.MaxError, before.MismatchRate, now.MismatchRate,
+                slower ? "  THROUGHPUT REGRESSION" : "",
+                drifted ? "  ACCURACY DRIFT" : "");
+
+            if (slower || drifted)
+            {
+                numRegressions++;
+            }
+        }
+        return numRegressions;
+    }
+}
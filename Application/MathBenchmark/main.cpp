@@ -0,0 +1,505 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <Foundation/Math/Vector.h>
+#include <Foundation/Math/Matrix.h>
+#include <Foundation/Math/Rotation.h>
+#include <Foundation/Math/Geometry.h>
+#include <Foundation/Math/FastMath.h>
+#include "Benchmark.h"
+
+/**
+* usage: MathBenchmark [--out results.csv] [--baseline results.csv] [--threshold 0.1] [--cpu 0]
+* results go to stdout when no output is given, with a baseline the run is compared against it
+* and the exit code is the number of flagged cases.
+* max_error is relative to the double result, except for cases named *_ulp, where it is in float ulp,
+* and srgb_encode_fast_pow, where it is in 8-bit output steps.
+*/
+const int kNumInputs = 4096;
+const int kNumPasses = 32;
+const unsigned kSeed = 0x6d617468;
+const int kNumSweepInputs = 1 << 22;
+
+struct RawInputs
+{
+    std::vector<double> Matrices;       // 16 per input
+    std::vector<double> Quaternions;    // 4 per input, unit length
+    std::vector<double> Scalars;        // 4 per input, in [0, 1)
+    std::vector<double> Points;         // 3 points per input, in [-1, 1)
+};
+
+RawInputs GenerateInputs(unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::uniform_real_distribution<double> signedUnit(-1.0, 1.0);
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    RawInputs inputs;
+    for (int index = 0; index < kNumInputs; index++)
+    {
+        for (int cell = 0; cell < 16; cell++)
+        {
+            inputs.Matrices.push_back(signedUnit(random) * 4.0);
+        }
+
+        double q[4], length = 0.0;
+        for (double& component : q)
+        {
+            component = normal(random);
+            length += component * component;
+        }
+        for (double component : q)
+        {
+            inputs.Quaternions.push_back(component / std::sqrt(length));
+        }
+
+        for (int scalar = 0; scalar < 4; scalar++)
+        {
+            inputs.Scalars.push_back(unit(random));
+        }
+
+        for (int coordinate = 0; coordinate < 9; coordinate++)
+        {
+            inputs.Points.push_back(signedUnit(random));
+        }
+    }
+    return inputs;
+}
+
+template<typename value_type>
+math::matrix4x4<value_type> MakeMatrix(const RawInputs& inputs, int index)
+{
+    const double* m = &inputs.Matrices[index * 16];
+    return math::matrix4x4<value_type>(
+        value_type(m[0]), value_type(m[1]), value_type(m[2]), value_type(m[3]),
+        value_type(m[4]), value_type(m[5]), value_type(m[6]), value_type(m[7]),
+        value_type(m[8]), value_type(m[9]), value_type(m[10]), value_type(m[11]),
+        value_type(m[12]), value_type(m[13]), value_type(m[14]), value_type(m[15]));
+}
+
+template<typename value_type>
+math::quaternion<value_type> MakeQuaternion(const RawInputs& inputs, int index)
+{
+    const double* q = &inputs.Quaternions[index * 4];
+    return math::quaternion<value_type>(value_type(q[0]), value_type(q[1]), value_type(q[2]), value_type(q[3]));
+}
+
+template<typename value_type>
+math::point3d<value_type> MakePoint(const RawInputs& inputs, int index, int which)
+{
+    const double* p = &inputs.Points[index * 9 + which * 3];
+    return math::point3d<value_type>(value_type(p[0]), value_type(p[1]), value_type(p[2]));
+}
+
+template<typename value_type>
+double Error(const math::matrix4x4<value_type>& value, const math::double4x4& reference)
+{
+    double error = 0.0;
+    for (int cell = 0; cell < 16; cell++)
+    {
+        error = std::max(error, bench::RelativeError(value.m[cell], reference.m[cell]));
+    }
+    return error;
+}
+
+template<typename value_type>
+double Error(const math::vector3<value_type>& value, const math::double3& reference)
+{
+    double error = 0.0;
+    for (int component = 0; component < 3; component++)
+    {
+        error = std::max(error, bench::RelativeError(value.v[component], reference.v[component]));
+    }
+    return error;
+}
+
+template<typename value_type>
+double Error(const math::quaternion<value_type>& value, const math::quaterniond& reference)
+{
+    return std::max(bench::RelativeError(value.w, reference.w), Error(value.v, reference.v));
+}
+
+//one component of a result, summed by the timing loop.
+template<typename value_type>
+double Checksum(const math::matrix4x4<value_type>& value) { return double(value.m[0]); }
+
+template<typename value_type>
+double Checksum(const math::vector3<value_type>& value) { return double(value.x); }
+
+template<typename value_type>
+double Checksum(const math::quaternion<value_type>& value) { return double(value.w); }
+
+//times the float version, and compares every result with the double one.
+template<typename FloatOp, typename DoubleOp>
+bench::Result RunCase(const char* name, FloatOp floatOp, DoubleOp doubleOp)
+{
+    std::vector<decltype(floatOp(0))> values(kNumInputs);
+    bench::Result result;
+    result.Name = name;
+    result.NanosecondsPerOp = bench::NanosecondsPerOp(kNumInputs, kNumPasses, [&](int index)
+        {
+            values[index] = floatOp(index);
+            return Checksum(values[index]);
+        });
+
+    bench::ErrorStats stats;
+    for (int index = 0; index < kNumInputs; index++)
+    {
+        stats.Add(Error(values[index], doubleOp(index)));
+    }
+    result.MaxError = stats.MaxError;
+    return result;
+}
+
+/**
+* fast approximation against the std function in double,
+* timed on inputs spread over the sweep, the error is the maximum over the whole sweep.
+* input(t) maps t in [0, 1] to the range of the function.
+*/
+template<typename Input, typename FastOp, typename ReferenceOp>
+bench::Result RunUlpCase(const char* name, Input input, FastOp fastOp, ReferenceOp referenceOp)
+{
+    std::vector<float> values(kNumSweepInputs);
+    for (int index = 0; index < kNumSweepInputs; index++)
+    {
+        values[index] = static_cast<float>(input(double(index) / (kNumSweepInputs - 1)));
+    }
+
+    std::vector<float> timedValues(kNumInputs);
+    for (int index = 0; index < kNumInputs; index++)
+    {
+        timedValues[index] = values[index * (kNumSweepInputs / kNumInputs)];
+    }
+
+    bench::Result result;
+    result.Name = name;
+    result.NanosecondsPerOp = bench::NanosecondsPerOp(kNumInputs, kNumPasses, [&](int index)
+        {
+            return double(fastOp(timedValues[index]));
+        });
+
+    bench::ErrorStats stats;
+    for (float value : values)
+    {
+        stats.Add(bench::UlpError(fastOp(value), referenceOp(double(value))));
+    }
+    result.MaxError = stats.MaxError;
+    return result;
+}
+
+//the srgb curve of LDRFilm, pow is given so the fast and the std versions share the rest.
+template<typename Pow>
+double EncodeSRGB(double value, Pow pow)
+{
+    if (value <= 0.0031308)
+    {
+        return value < 0.0 ? 0.0 : 12.92 * value;
+    }
+    return value < 1.0 ? 1.055 * pow(value, 1.0 / 2.4) - 0.055 : pow(value, 1.0 / 2.2);
+}
+
+//error in 8-bit output steps, mismatches are pixels that quantize to another code than with std::pow.
+bench::Result RunSRGBCase()
+{
+    auto fastPow = [](double x, double y) { return math::fast_pow(x, y); };
+    auto stdPow = [](double x, double y) { return std::pow(x, y); };
+    auto quantize = [](double value) { return int(std::floor(std::min(std::max(value, 0.0), 1.0) * 256.0 - 0.0001)); };
+
+    bench::Result result;
+    result.Name = "srgb_encode_fast_pow";
+    result.NanosecondsPerOp = bench::NanosecondsPerOp(kNumInputs, kNumPasses, [&](int index)
+        {
+            return EncodeSRGB(double(index) / kNumInputs, fastPow);
+        });
+
+    bench::ErrorStats stats;
+    for (int index = 0; index < kNumSweepInputs; index++)
+    {
+        const double linear = 1.25 * index / (kNumSweepInputs - 1);
+        const double value = EncodeSRGB(linear, fastPow);
+        const double reference = EncodeSRGB(linear, stdPow);
+        if (quantize(value) != quantize(reference))
+        {
+            stats.AddMismatch();
+        }
+        else
+        {
+            stats.Add(std::fabs(value - reference) * 256.0);
+        }
+    }
+    result.MaxError = stats.MaxError;
+    result.MismatchRate = stats.MismatchRate();
+    return result;
+}
+
+/**
+* the shape of every intersection case is built from the same input points,
+* so all of them see rays that hit about half of the time.
+*/
+template<typename value_type>
+struct Scenario
+{
+    math::ray3d<value_type> Ray;
+    math::point3d<value_type> Position;
+    math::point3d<value_type> Vertices[3];
+    math::nvector3<value_type> Axes[3];
+    value_type Extents[3];
+};
+
+template<typename value_type>
+Scenario<value_type> MakeScenario(const RawInputs& inputs, int index)
+{
+    using vector3 = math::vector3<value_type>;
+    const math::quaternion<value_type> orientation = MakeQuaternion<value_type>(inputs, index);
+    const double* s = &inputs.Scalars[index * 4];
+
+    Scenario<value_type> scenario;
+    const math::point3d<value_type> target = MakePoint<value_type>(inputs, index, 0);
+    const math::point3d<value_type> origin = MakePoint<value_type>(inputs, index, 1) * value_type(4);
+    scenario.Ray = math::ray3d<value_type>(origin, target);
+    scenario.Position = MakePoint<value_type>(inputs, index, 2) * value_type(0.5);
+    for (int vertex = 0; vertex < 3; vertex++)
+    {
+        scenario.Vertices[vertex] = MakePoint<value_type>(inputs, (index + vertex) % kNumInputs, 0);
+    }
+    scenario.Axes[0] = math::rotate(orientation, vector3(value_type(1), value_type(0), value_type(0)));
+    scenario.Axes[1] = math::rotate(orientation, vector3(value_type(0), value_type(1), value_type(0)));
+    scenario.Axes[2] = math::rotate(orientation, vector3(value_type(0), value_type(0), value_type(1)));
+    for (int axis = 0; axis < 3; axis++)
+    {
+        scenario.Extents[axis] = value_type(0.25 + 0.75 * s[axis]);
+    }
+    return scenario;
+}
+
+struct Hit
+{
+    math::intersection Kind = math::intersection::none;
+    double T = 0.0;
+};
+
+struct PlaneCase
+{
+    template<typename value_type>
+    Hit operator()(const Scenario<value_type>& s) const
+    {
+        value_type t = value_type(0);
+        const math::intersection kind = math::intersect_plane(s.Ray, s.Position, s.Axes[0], true, math::EPSILON<value_type>, t);
+        return { kind, double(t) };
+    }
+};
+
+struct DiskCase
+{
+    template<typename value_type>
+    Hit operator()(const Scenario<value_type>& s) const
+    {
+        value_type t = value_type(0);
+        const math::intersection kind = math::intersect_disk(s.Ray, s.Position, s.Axes[0], s.Extents[0], true, math::EPSILON<value_type>, t);
+        return { kind, double(t) };
+    }
+};
+
+struct RectCase
+{
+    template<typename value_type>
+    Hit operator()(const Scenario<value_type>& s) const
+    {
+        value_type t = value_type(0);
+        const math::vector2<value_type> extents(s.Extents[0], s.Extents[1]);
+        const math::intersection kind = math::intersect_rect(s.Ray, s.Position, s.Axes[0], s.Axes[1], extents, true, math::EPSILON<value_type>, t);
+        return { kind, double(t) };
+    }
+};
+
+struct SphereCase
+{
+    template<typename value_type>
+    Hit operator()(const Scenario<value_type>& s) const
+    {
+        value_type t0 = value_type(0), t1 = value_type(0);
+        const math::intersection kind = math::intersect_sphere(s.Ray, s.Position, s.Extents[0] * s.Extents[0], math::EPSILON<value_type>, t0, t1);
+        return { kind, double(kind == math::intersection::inside ? t1 : t0) };
+    }
+};
+
+struct CubeCase
+{
+    template<typename value_type>
+    Hit operator()(const Scenario<value_type>& s) const
+    {
+        value_type t0 = value_type(0), t1 = value_type(0);
+        math::vector3<value_type> n0, n1;
+        const math::intersection kind = math::intersect_cube(s.Ray, s.Position, s.Axes[0], s.Axes[1], s.Axes[2],
+            s.Extents[0], s.Extents[1], s.Extents[2], math::EPSILON<value_type>, t0, t1, n0, n1);
+        return { kind, double(kind == math::intersection::inside ? t1 : t0) };
+    }
+};
+
+struct TriangleCase
+{
+    template<typename value_type>
+    Hit operator()(const Scenario<value_type>& s) const
+    {
+        value_type t = value_type(0), u = value_type(0), v = value_type(0);
+        math::vector3<value_type> normal;
+        const math::intersection kind = math::intersect_triangle(s.Ray, s.Vertices[0], s.Vertices[1], s.Vertices[2], math::EPSILON<value_type>, t, u, v, normal);
+        return { kind, double(t) };
+    }
+};
+
+//the error is the one of t when both precisions agree on the kind of intersection.
+template<typename Intersect>
+bench::Result RunIntersectionCase(const char* name, const std::vector<Scenario<float>>& floatScenarios, const std::vector<Scenario<double>>& doubleScenarios)
+{
+    const Intersect intersect{};
+    bench::Result result;
+    result.Name = name;
+    result.NanosecondsPerOp = bench::NanosecondsPerOp(kNumInputs, kNumPasses, [&](int index)
+        {
+            const Hit hit = intersect(floatScenarios[index]);
+            return hit.Kind == math::intersection::none ? 0.0 : hit.T;
+        });
+
+    bench::ErrorStats stats;
+    for (int index = 0; index < kNumInputs; index++)
+    {
+        const Hit value = intersect(floatScenarios[index]);
+        const Hit reference = intersect(doubleScenarios[index]);
+        if (value.Kind != reference.Kind)
+        {
+            stats.AddMismatch();
+        }
+        else if (value.Kind != math::intersection::none)
+        {
+            stats.Add(bench::RelativeError(value.T, reference.T));
+        }
+    }
+    result.MaxError = stats.MaxError;
+    result.MismatchRate = stats.MismatchRate();
+    return result;
+}
+
+std::vector<bench::Result> RunAll(const RawInputs& inputs)
+{
+    std::vector<math::float4x4> floatMatrices;
+    std::vector<math::double4x4> doubleMatrices;
+    std::vector<math::quaternionf> floatQuaternions;
+    std::vector<math::quaterniond> doubleQuaternions;
+    std::vector<math::float3> floatVectors;
+    std::vector<math::double3> doubleVectors;
+    std::vector<Scenario<float>> floatScenarios;
+    std::vector<Scenario<double>> doubleScenarios;
+    for (int index = 0; index < kNumInputs; index++)
+    {
+        floatMatrices.push_back(MakeMatrix<float>(inputs, index));
+        doubleMatrices.push_back(MakeMatrix<double>(inputs, index));
+        floatQuaternions.push_back(MakeQuaternion<float>(inputs, index));
+        doubleQuaternions.push_back(MakeQuaternion<double>(inputs, index));
+        floatVectors.push_back(MakePoint<float>(inputs, index, 0));
+        doubleVectors.push_back(MakePoint<double>(inputs, index, 0));
+        floatScenarios.push_back(MakeScenario<float>(inputs, index));
+        doubleScenarios.push_back(MakeScenario<double>(inputs, index));
+    }
+
+    // neighbouring inputs are the second operand.
+    auto next = [](int index) { return (index + 1) % kNumInputs; };
+
+    std::vector<bench::Result> results;
+    results.push_back(RunCase("matrix4x4_multiply",
+        [&](int i) { return floatMatrices[i] * floatMatrices[next(i)]; },
+        [&](int i) { return doubleMatrices[i] * doubleMatrices[next(i)]; }));
+    results.push_back(RunCase("matrix4x4_inverse",
+        [&](int i) { return math::inversed(floatMatrices[i]); },
+        [&](int i) { return math::inversed(doubleMatrices[i]); }));
+
+    // the templates called directly, with MATH_ENABLE_SIMD the cases above take the simd overloads instead.
+    results.push_back(RunCase("matrix4x4_multiply_scalar",
+        [&](int i) { return math::operator*<float, math::EDim::_4, math::EDim::_4, math::EDim::_4>(floatMatrices[i], floatMatrices[next(i)]); },
+        [&](int i) { return doubleMatrices[i] * doubleMatrices[next(i)]; }));
+    results.push_back(RunCase("matrix4x4_inverse_scalar",
+        [&](int i) { math::float4x4 matrix = floatMatrices[i]; math::inverse<float>(matrix); return matrix; },
+        [&](int i) { return math::inversed(doubleMatrices[i]); }));
+    results.push_back(RunCase("quaternion_slerp",
+        [&](int i) { return math::slerp(floatQuaternions[i], floatQuaternions[next(i)], float(inputs.Scalars[i * 4 + 3])); },
+        [&](int i) { return math::slerp(doubleQuaternions[i], doubleQuaternions[next(i)], inputs.Scalars[i * 4 + 3]); }));
+    results.push_back(RunCase("quaternion_rotate",
+        [&](int i) { return math::rotate(floatQuaternions[i], floatVectors[i]); },
+        [&](int i) { return math::rotate(doubleQuaternions[i], doubleVectors[i]); }));
+
+    results.push_back(RunIntersectionCase<PlaneCase>("intersect_plane", floatScenarios, doubleScenarios));
+    results.push_back(RunIntersectionCase<DiskCase>("intersect_disk", floatScenarios, doubleScenarios));
+    results.push_back(RunIntersectionCase<RectCase>("intersect_rect", floatScenarios, doubleScenarios));
+    results.push_back(RunIntersectionCase<SphereCase>("intersect_sphere", floatScenarios, doubleScenarios));
+    results.push_back(RunIntersectionCase<CubeCase>("intersect_cube", floatScenarios, doubleScenarios));
+    results.push_back(RunIntersectionCase<TriangleCase>("intersect_triangle", floatScenarios, doubleScenarios));
+
+    // ranges of the error table in FastMath.h.
+    auto logSpaced = [](double t) { return std::pow(10.0, -30.0 + 60.0 * t); };
+    results.push_back(RunUlpCase("fast_exp2_ulp", [](double t) { return -126.0 + 252.0 * t; },
+        [](float x) { return math::fast_exp2(x); }, [](double x) { return std::exp2(x); }));
+    results.push_back(RunUlpCase("fast_log2_ulp", logSpaced,
+        [](float x) { return math::fast_log2(x); }, [](double x) { return std::log2(x); }));
+    results.push_back(RunUlpCase("fast_pow_ulp", [](double t) { return 1e-4 + (1.0 - 1e-4) * t; },
+        [](float x) { return math::fast_pow(x, 1.0f / 2.4f); }, [](double x) { return std::pow(x, double(1.0f / 2.4f)); }));
+    results.push_back(RunUlpCase("fast_sin_ulp", [](double t) { return -1e4 + 2e4 * t; },
+        [](float x) { return math::fast_sin(x); }, [](double x) { return std::sin(x); }));
+    results.push_back(RunUlpCase("fast_rsqrt_ulp", logSpaced,
+        [](float x) { return math::fast_rsqrt(x); }, [](double x) { return 1.0 / std::sqrt(x); }));
+    results.push_back(RunUlpCase("fast_acos_ulp", [](double t) { return -1.0 + 2.0 * t; },
+        [](float x) { return math::fast_acos(x); }, [](double x) { return std::acos(x); }));
+    results.push_back(RunSRGBCase());
+    return results;
+}
+
+int main(int argc, char** argv)
+{
+    std::string outputPath, baselinePath;
+    double threshold = 0.1;
+    int cpu = 0;
+    for (int index = 1; index + 1 < argc; index += 2)
+    {
+        if (strcmp(argv[index], "--out") == 0) { outputPath = argv[index + 1]; }
+        else if (strcmp(argv[index], "--baseline") == 0) { baselinePath = argv[index + 1]; }
+        else if (strcmp(argv[index], "--threshold") == 0) { threshold = atof(argv[index + 1]); }
+        else if (strcmp(argv[index], "--cpu") == 0) { cpu = atoi(argv[index + 1]); }
+    }
+
+    if (!bench::PinCurrentThread(cpu))
+    {
+        fprintf(stderr, "can not pin to cpu %d, timings may be noisy.\n", cpu);
+    }
+
+    const std::vector<bench::Result> results = RunAll(GenerateInputs(kSeed));
+
+    if (outputPath.empty())
+    {
+        bench::WriteResults(stdout, results);
+    }
+    else
+    {
+        FILE* f = nullptr;
+        if (fopen_s(&f, outputPath.c_str(), "w") != 0 || f == nullptr || !bench::WriteResults(f, results))
+        {
+            fprintf(stderr, "can not write %s.\n", outputPath.c_str());
+            return -1;
+        }
+        fclose(f);
+    }
+
+    if (!baselinePath.empty())
+    {
+        std::vector<bench::Result> baseline;
+        if (!bench::ReadResults(baselinePath, baseline))
+        {
+            fprintf(stderr, "can not read %s.\n", baselinePath.c_str());
+            return -1;
+        }
+        return bench::Compare(baseline, results, threshold);
+    }
+    return 0;
+}
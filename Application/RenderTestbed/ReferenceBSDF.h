@@ -0,0 +1,163 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <Application/LitRenderer/Material.h>
+
+/**
+* per-lobe formulas as the virtual BSDF classes wrote them before lobes were flattened,
+* kept apart from Material.cpp so a change in its dispatch can be checked against them.
+* only the parameters stored in BSDFLobe are read, every term is recomputed here.
+* microfacet pdfs follow the visible normal sampling of SampleGGXVNDF.
+*/
+namespace reference
+{
+    inline Spectrum FresnelSchlick(Float CosTheta, const Spectrum& R0)
+    {
+        return R0 + (Spectrum::one() - R0) * math::power<5>(Float(1) - CosTheta);
+    }
+
+    inline Float DistributionGTR2(Float AlphaSquare, Float NdotH)
+    {
+        NdotH = math::saturate(NdotH);
+        Float denominator = math::square(NdotH) * (AlphaSquare - 1) + 1;
+        return AlphaSquare * math::InvPI<Float> / math::square(denominator);
+    }
+
+    inline Float ShadowingGGX(Float AlphaSquare, Float HdotV)
+    {
+        Float numerator = Float(2) * HdotV;
+        Float denominator = HdotV + sqrt(math::square(HdotV) * (Float(1) - AlphaSquare) + AlphaSquare);
+        return numerator / denominator;
+    }
+
+    //pdf of Wi when H is drawn from visible normals: G1(V) * D / (4 * NdotV).
+    inline Float VisibleNormalPdf(Float AlphaSquare, const Direction& Wo, const Direction& Wi)
+    {
+        const Direction H = Wo + Wi;
+        const Float NdotV = Ndot(Wo);
+        if (NdotV <= Float(0) || math::dot(H, Wo) <= Float(0))
+        {
+            return Float(0);
+        }
+        return ShadowingGGX(AlphaSquare, NdotV) * DistributionGTR2(AlphaSquare, Ndot(H)) * Float(0.25) / NdotV;
+    }
+
+    inline Spectrum LambertianF(const BSDFLobe& lobe, const Direction& Wo, const Direction& Wi)
+    {
+        return lobe.Rd * math::InvPI<Float>;
+    }
+
+    inline Spectrum OrenNayarF(const BSDFLobe& lobe, const Direction& Wo, const Direction& Wi)
+    {
+        const Float CosineWi = Ndot(Wi);
+        const Float CosineWo = Ndot(Wo);
+        const Float SineWi = sqrt(Float(1) - math::saturate(math::square(CosineWi)));
+        const Float SineWo = sqrt(Float(1) - math::saturate(math::square(CosineWo)));
+
+        const bool bIsWiGreater = CosineWi < CosineWo;
+        const Float SineAlpha = bIsWiGreater ? SineWi : SineWo;
+        const Float TangentBeta = bIsWiGreater ? SineWo / CosineWo : SineWi / CosineWi;
+        const Float maxWi_Wo = math::saturate(CosineWi * CosineWo + SineWi * SineWo);
+        const Float factor = lobe.A + lobe.B * maxWi_Wo * SineAlpha * TangentBeta;
+        return (factor * CosineWi * math::InvPI<Float>) * lobe.Rd;
+    }
+
+    inline Spectrum TorranceSparrowF(const BSDFLobe& lobe, const Direction& Wo, const Direction& Wi)
+    {
+        const Float NdotL = math::saturate(Ndot(Wi));
+        const Float NdotV = math::saturate(Ndot(Wo));
+        if (NdotL > Float(0) && NdotV > Float(0))
+        {
+            const Direction H = Wo + Wi;
+            const Float NdotH = math::saturate(Ndot(H));
+            const Float HdotV = math::saturate(math::dot(H, Wo));
+            const Float HdotL = math::saturate(math::dot(H, Wi));
+            const Float D = DistributionGTR2(lobe.AlphaSquare, NdotH);
+            const Float G = std::min(ShadowingGGX(lobe.AlphaSquare, HdotV), ShadowingGGX(lobe.AlphaSquare, HdotL));
+            const Spectrum F = FresnelSchlick(HdotL, lobe.Rs);
+            return Float(0.25) * D * F * G / (NdotV * NdotL);
+        }
+        return Spectrum::zero();
+    }
+
+    inline Spectrum AshikhminAndShirleyDiffuseF(const BSDFLobe& lobe, const Direction& Wo, const Direction& Wi)
+    {
+        const Float NdotL = Ndot(Wi);
+        const Float NdotV = Ndot(Wo);
+        return Spectrum::one() * (lobe.Rd
+            * (Float(1) - math::power<5>(Float(1) - Float(0.5) * NdotL))
+            * (Float(1) - math::power<5>(Float(1) - Float(0.5) * NdotV)));
+    }
+
+    inline Spectrum AshikhminAndShirleySpecularF(const BSDFLobe& lobe, const Direction& Wo, const Direction& Wi)
+    {
+        const math::vector3<Float> sum = Wo + Wi;
+        if (math::near_zero(sum))
+        {
+            return Spectrum::zero();
+        }
+        const Direction H = sum;
+        const Float HdotL = math::dot(H, Wi);
+        const Float D = DistributionGTR2(lobe.AlphaSquare, Ndot(H));
+        const Spectrum Fresnel = FresnelSchlick(HdotL, lobe.Rs);
+        return (D * Fresnel * Float(0.25)) / (HdotL * std::max(Ndot(Wi), Ndot(Wo))) * Spectrum::one();
+    }
+
+    inline Spectrum AshikhminAndShirleyF(const BSDFLobe& lobe, const Direction& Wo, const Direction& Wi)
+    {
+        if (math::near_zero(Wo + Wi))
+        {
+            return Spectrum::zero();
+        }
+        const Spectrum Diffuse = lobe.DiffuseWeight
+            * (Float(1) - math::power<5>(Float(1) - Float(0.5) * Ndot(Wi)))
+            * (Float(1) - math::power<5>(Float(1) - Float(0.5) * Ndot(Wo)));
+        return Diffuse + AshikhminAndShirleySpecularF(lobe, Wo, Wi);
+    }
+
+    inline Spectrum LobeF(const BSDFLobe& lobe, const Direction& Wo, const Direction& Wi)
+    {
+        switch (lobe.Type)
+        {
+        case BSDFLobeType::Lambertian: return LambertianF(lobe, Wo, Wi);
+        case BSDFLobeType::OrenNayar: return OrenNayarF(lobe, Wo, Wi);
+        case BSDFLobeType::TorranceSparrow: return TorranceSparrowF(lobe, Wo, Wi);
+        case BSDFLobeType::AshikhminAndShirley: return AshikhminAndShirleyF(lobe, Wo, Wi);
+        case BSDFLobeType::AshikhminAndShirleyDiffuse: return AshikhminAndShirleyDiffuseF(lobe, Wo, Wi);
+        case BSDFLobeType::AshikhminAndShirleySpecular: return AshikhminAndShirleySpecularF(lobe, Wo, Wi);
+        }
+        return Spectrum::zero();
+    }
+
+    inline Float LobePdf(const BSDFLobe& lobe, const Direction& Wo, const Direction& Wi)
+    {
+        const Float DiffusePdf = math::saturate(Ndot(Wi)) * math::InvPI<Float>;
+        switch (lobe.Type)
+        {
+        case BSDFLobeType::Lambertian:
+        case BSDFLobeType::OrenNayar:
+        case BSDFLobeType::AshikhminAndShirleyDiffuse:
+            return DiffusePdf;
+        case BSDFLobeType::TorranceSparrow:
+            return VisibleNormalPdf(lobe.AlphaSquare, Wo, Wi);
+        case BSDFLobeType::AshikhminAndShirley:
+            return math::near_zero(Wo + Wi) ? Float(0) : Float(0.5) * (VisibleNormalPdf(lobe.AlphaSquare, Wo, Wi) + DiffusePdf);
+        case BSDFLobeType::AshikhminAndShirleySpecular:
+            return math::near_zero(Wo + Wi) ? Float(0) : VisibleNormalPdf(lobe.AlphaSquare, Wo, Wi);
+        }
+        return Float(0);
+    }
+
+    //weighted sum of lobe f, and the one-sample mixture of lobe pdfs.
+    inline void Evaluate(const Material& material, const Direction& Wo, const Direction& Wi, Spectrum& f, Float& pdf)
+    {
+        f = Spectrum::zero();
+        pdf = Float(0);
+        for (uint32_t index = 0; index < material.GetLobeCount(); index++)
+        {
+            const BSDFLobe& lobe = material.GetLobeByIndex(index);
+            f += lobe.Weight * LobeF(lobe, Wo, Wi);
+            pdf += material.GetLobeSelectionPdf(index) * LobePdf(lobe, Wo, Wi);
+        }
+    }
+}
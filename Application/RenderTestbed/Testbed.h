@@ -0,0 +1,287 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <Application/LitRenderer/Denoiser.h>
+#include <Application/LitRenderer/Integrator.h>
+#include <Application/LitRenderer/LDRFilm.h>
+#include <Application/LitRenderer/PathGuide.h>
+#include <Application/LitRenderer/Scene.h>
+
+/**
+* offline checks of LitRenderer, without window and frame pacing.
+* a fixed camera looks into a closed box, every pass adds one sample to each pixel,
+* so images of two integrator settings can be compared by pass or by time.
+*/
+namespace testbed
+{
+    using MaterialFactory = std::function<std::unique_ptr<Material>(int index)>;
+
+    //same room as the default scene of LitRenderer, with a row of four spheres.
+    // in indirect mode the only light faces the ceiling, everything else is lit by bounces.
+    class BoxScene : public Scene
+    {
+    public:
+        BoxScene(MaterialFactory sphereMaterial, bool bIndirectLight)
+            : mSphereMaterial(std::move(sphereMaterial)), mIndirectLight(bIndirectLight) { }
+
+    private:
+        virtual void CreateScene(Float aspect, std::vector<SceneObject*>& OutSceneObjects) override
+        {
+            const Float SceneSize = 60;
+            const Float SceneNear = -30;
+            const Float SceneFar = 30;
+            const Float SceneBottom = -SceneSize;
+            const Float SceneTop = SceneSize;
+            const Float SceneLeft = -SceneSize * aspect;
+            const Float SceneRight = SceneSize * aspect;
+            const Float SceneCenterZ = (SceneNear + SceneFar) * Float(0.5);
+            const Float SceneExtendX = (SceneRight - SceneLeft) * Float(0.5);
+            const Float SceneExtendY = (SceneTop - SceneBottom) * Float(0.5);
+            const Float SceneExtendZ = (SceneFar - SceneNear) * Float(0.5);
+
+            for (int i = 0; i < 4; i++)
+            {
+                SceneSphere* sphere = new SceneSphere(); OutSceneObjects.push_back(sphere);
+                sphere->SetRadius(12);
+                sphere->SetTranslate(Float(-45 + i * 30), SceneBottom + 12, SceneCenterZ);
+                sphere->Material = mSphereMaterial(i);
+            }
+
+            SceneRect* wallLeft = new SceneRect(); OutSceneObjects.push_back(wallLeft);
+            wallLeft->SetTranslate(SceneLeft, 0, SceneCenterZ);
+            wallLeft->SetExtends(SceneExtendZ, SceneExtendY);
+            wallLeft->Material = Material::CreateMatte(Spectrum(Float(0.75), Float(0.2), Float(0.2)));
+
+            SceneRect* wallRight = new SceneRect(); OutSceneObjects.push_back(wallRight);
+            wallRight->SetTranslate(SceneRight, 0, SceneCenterZ);
+            wallRight->SetRotation(math::make_rotation_y_axis<Float>(180_degd));
+            wallRight->SetExtends(SceneExtendZ, SceneExtendY);
+            wallRight->Material = Material::CreateMatte(Spectrum(Float(0.2), Float(0.2), Float(0.75)));
+
+            SceneRect* wallTop = new SceneRect(); OutSceneObjects.push_back(wallTop);
+            wallTop->SetTranslate(0, SceneTop, SceneCenterZ);
+            wallTop->SetExtends(SceneExtendZ, SceneExtendX);
+            wallTop->SetRotation(math::make_rotation_z_axis<Float>(-90_degd));
+            wallTop->Material = Material::CreateMatte(Spectrum(Float(0.75)));
+
+            SceneRect* wallFar = new SceneRect(); OutSceneObjects.push_back(wallFar);
+            wallFar->SetTranslate(0, 0, SceneFar);
+            wallFar->SetExtends(SceneExtendX, SceneExtendY);
+            wallFar->SetRotation(math::make_rotation_y_axis<Float>(90_degd));
+            wallFar->Material = Material::CreateMatte(Spectrum(Float(0.6)));
+
+            SceneRect* wallBottom = new SceneRect(); OutSceneObjects.push_back(wallBottom);
+            wallBottom->SetTranslate(0, SceneBottom, SceneCenterZ);
+            wallBottom->SetExtends(SceneExtendZ, SceneExtendX);
+            wallBottom->SetRotation(math::make_rotation_z_axis<Float>(90_degd));
+            wallBottom->Material = Material::CreateMatte(Spectrum(Float(0.75)));
+
+            SceneRect* light = new SceneRect(); OutSceneObjects.push_back(light);
+            light->SetDualFace(!mIndirectLight);
+            light->SetTranslate(0, SceneTop - (mIndirectLight ? Float(8) : Float(0.01)), SceneCenterZ);
+            light->SetExtends(20, 20);
+            light->SetRotation(math::make_rotation_z_axis<Float>(90_degd));
+            const Float Intensity = mIndirectLight ? Float(8) : Float(2);
+            light->LightSource = std::make_unique<LightSource>(Intensity, Intensity, Intensity);
+        }
+
+        MaterialFactory mSphereMaterial;
+        bool mIndirectLight;
+    };
+
+    /**
+    * accumulates passes of PathIntegrator into a film, rows are integrated on workers.
+    * first hits and AOVs are found once, the same as LitRenderer::GenerateCameraRays().
+    */
+    class OfflineRenderer
+    {
+    public:
+        //renderers of different sequence never share random streams.
+        OfflineRenderer(Scene& scene, int width, int height, uint32_t sequence = 0)
+            : mScene(scene), mSequence(sequence), mFilm(width, height), mDenoiser(width, height)
+            , mRays(width * height), mRecordP1(width * height)
+        {
+            //camera of LitRenderer: 50 degree vertical fov, 130 units in front of the box.
+            const Float HalfFovTangent = std::tan(Float(25) * math::PI<Float> / Float(180));
+            const Float CameraZ = height * Float(0.5) / HalfFovTangent;
+            mPixelSpreadAngle = Float(2) * HalfFovTangent / height;
+
+            scene.Create(Float(width) / Float(height));
+            scene.UpdateWorldTransform();
+
+            SurfaceAOV* AOVBufferPtr = mDenoiser.GetAOVBufferPtr();
+            for (int row = 0; row < height; row++)
+            {
+                for (int col = 0; col < width; col++)
+                {
+                    const int index = col + row * width;
+                    mRays[index].set_origin(Point(0, 0, -130));
+                    mRays[index].set_direction(math::vector3<Float>(col + Float(0.5) - width * Float(0.5), row + Float(0.5) - height * Float(0.5), CameraZ));
+                    mRecordP1[index] = scene.DetectIntersecting(mRays[index], nullptr, math::SMALL_NUM<Float>);
+
+                    SurfaceAOV& AOV = AOVBufferPtr[index];
+                    AOV.IsOnSurface = mRecordP1[index];
+                    if (AOV.IsOnSurface)
+                    {
+                        const SceneObject* object = mRecordP1[index].Object;
+                        AOV.Normal = mRecordP1[index].SurfaceNormal;
+                        AOV.Depth = mRecordP1[index].Distance;
+                        AOV.Albedo = (object->Material != nullptr && object->Material->IsValid())
+                            ? object->Material->GetAlbedo()
+                            : Spectrum::one();
+                    }
+                }
+            }
+            mFilm.Clear();
+        }
+
+        int GetWidth() const { return mFilm.CanvasWidth; }
+        int GetHeight() const { return mFilm.CanvasHeight; }
+        int GetPassCount() const { return mPassCount; }
+        LDRFilm& GetFilm() { return mFilm; }
+        ATrousDenoiser& GetDenoiser() { return mDenoiser; }
+
+        //returns seconds spent, passes of the same index use the same random streams.
+        double AddPass(PathGuide* pathGuide = nullptr)
+        {
+            const auto startTime = std::chrono::steady_clock::now();
+            const int width = mFilm.CanvasWidth;
+            const uint64_t passSeed = static_cast<uint64_t>(mPassCount++) << 32;
+            AccumulatedSpectrum* pixels = mFilm.GetBackbufferPtr();
+
+            std::vector<Task> rowTasks;
+            for (int row = 0; row < mFilm.CanvasHeight; row++)
+            {
+                rowTasks.push_back(Task::Start(ThreadName::Worker,
+                    [this, width, row, pixels, pathGuide, seed = passSeed + row](::Task&)
+                    {
+                        PathIntegrator pathIntegrator(pathGuide);
+                        pathIntegrator.Seed(seed, mSequence);
+                        pathIntegrator.SetPixelSpreadAngle(mPixelSpreadAngle);
+                        for (int col = 0; col < width; col++)
+                        {
+                            const int index = col + row * width;
+                            const Spectrum Li = pathIntegrator.EvaluateLi(mScene, mRays[index], mRecordP1[index]);
+                            AccumulatedSpectrum& pixel = pixels[index];
+                            pixel.Value += Li;
+                            pixel.LuminanceSquare += math::square(Luminance(Li));
+                            pixel.Weight += Float(1);
+                            pixel.Count += 1;
+                        }
+                    }));
+            }
+            for (Task& task : rowTasks)
+            {
+                task.SpinWait();
+            }
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        }
+
+        //8-bit bgr canvas, the same as LitRenderer shows.
+        std::vector<unsigned char> Resolve()
+        {
+            std::vector<unsigned char> canvas(mFilm.CanvasWidth * mFilm.CanvasHeight * 3);
+            const AccumulatedSpectrum* pixels = mFilm.GetBackbufferPtr();
+            for (int row = 0; row < mFilm.CanvasHeight; row++)
+            {
+                for (int col = 0; col < mFilm.CanvasWidth; col++)
+                {
+                    mFilm.FlushTo(pixels[col + row * mFilm.CanvasWidth], row, col, canvas.data(), mFilm.CanvasWidth * 3);
+                }
+            }
+            return canvas;
+        }
+
+        std::vector<unsigned char> ResolveDenoised(double& seconds)
+        {
+            std::vector<unsigned char> canvas(mFilm.CanvasWidth * mFilm.CanvasHeight * 3);
+            const auto startTime = std::chrono::steady_clock::now();
+            Task done = Task::Start(ThreadName::Worker, [](auto) {});
+            done = mDenoiser.Denoise(done, mFilm, canvas.data(), mFilm.CanvasWidth * 3);
+            done.SpinWait();
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+            return canvas;
+        }
+
+        //mean radiance of every pixel.
+        std::vector<Spectrum> Radiance()
+        {
+            std::vector<Spectrum> result(mFilm.CanvasWidth * mFilm.CanvasHeight);
+            const AccumulatedSpectrum* pixels = mFilm.GetBackbufferPtr();
+            for (size_t index = 0; index < result.size(); index++)
+            {
+                result[index] = pixels[index].Weight > Float(0) ? pixels[index].Value / pixels[index].Weight : Spectrum::zero();
+            }
+            return result;
+        }
+
+    private:
+        Scene& mScene;
+        uint32_t mSequence;
+        LDRFilm mFilm;
+        ATrousDenoiser mDenoiser;
+        std::vector<Ray> mRays;
+        std::vector<SurfaceIntersection> mRecordP1;
+        Float mPixelSpreadAngle = Float(0);
+        int mPassCount = 0;
+    };
+
+    //mean SSIM of luma over 8x8 windows with stride 4, constants of Wang et al. 2004.
+    inline double SSIM(const std::vector<unsigned char>& image, const std::vector<unsigned char>& reference, int width, int height)
+    {
+        auto Luma = [width](const std::vector<unsigned char>& canvas, int row, int col)
+        {
+            const unsigned char* bgr = &canvas[(col + row * width) * 3];
+            return 0.0722 * bgr[0] + 0.7152 * bgr[1] + 0.2126 * bgr[2];
+        };
+
+        const double C1 = (0.01 * 255) * (0.01 * 255);
+        const double C2 = (0.03 * 255) * (0.03 * 255);
+        const int Window = 8;
+        double sum = 0.0;
+        int numWindows = 0;
+        for (int row = 0; row + Window <= height; row += Window / 2)
+        {
+            for (int col = 0; col + Window <= width; col += Window / 2)
+            {
+                double meanX = 0.0, meanY = 0.0, xx = 0.0, yy = 0.0, xy = 0.0;
+                for (int y = row; y < row + Window; y++)
+                {
+                    for (int x = col; x < col + Window; x++)
+                    {
+                        const double a = Luma(image, y, x);
+                        const double b = Luma(reference, y, x);
+                        meanX += a; meanY += b;
+                        xx += a * a; yy += b * b; xy += a * b;
+                    }
+                }
+                const double n = Window * Window;
+                meanX /= n; meanY /= n;
+                const double varianceX = xx / n - meanX * meanX;
+                const double varianceY = yy / n - meanY * meanY;
+                const double covariance = xy / n - meanX * meanY;
+                sum += ((2.0 * meanX * meanY + C1) * (2.0 * covariance + C2))
+                    / ((meanX * meanX + meanY * meanY + C1) * (varianceX + varianceY + C2));
+                numWindows++;
+            }
+        }
+        return numWindows > 0 ? sum / numWindows : 1.0;
+    }
+
+    //mean of squared error over squared reference luminance, insensitive to exposure.
+    inline double RelativeMSE(const std::vector<Spectrum>& image, const std::vector<Spectrum>& reference)
+    {
+        double sum = 0.0;
+        for (size_t index = 0; index < image.size(); index++)
+        {
+            const double difference = Luminance(image[index]) - Luminance(reference[index]);
+            const double scale = Luminance(reference[index]);
+            sum += difference * difference / (scale * scale + 1e-2);
+        }
+        return image.empty() ? 0.0 : sum / image.size();
+    }
+}
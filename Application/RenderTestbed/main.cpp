@@ -0,0 +1,643 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <thread>
+#include "ReferenceBSDF.h"
+#include "Testbed.h"
+
+/**
+* usage: RenderTestbed [denoise | guiding | bsdf | furnace | alloc]
+* runs the named case, or all of them, the exit code is the number of failed checks.
+*/
+
+//every allocation from the global heap, on any thread, the alloc case reads it around each frame.
+std::atomic<uint64_t> gNumAllocations = 0;
+
+void* operator new(size_t size)
+{
+    gNumAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* data = std::malloc(size > 0 ? size : 1))
+    {
+        return data;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* data) noexcept { std::free(data); }
+void operator delete(void* data, size_t) noexcept { std::free(data); }
+
+//small_vector allocates with explicit alignment, those count as well.
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    gNumAllocations.fetch_add(1, std::memory_order_relaxed);
+    const size_t align = static_cast<size_t>(alignment);
+#if defined(_WIN32)
+    void* data = _aligned_malloc(size > 0 ? size : 1, align);
+#else
+    void* data = std::aligned_alloc(align, (size + align - 1) / align * align + (size > 0 ? 0 : align));
+#endif
+    if (data != nullptr)
+    {
+        return data;
+    }
+    throw std::bad_alloc();
+}
+
+#if defined(_WIN32)
+void operator delete(void* data, std::align_val_t) noexcept { _aligned_free(data); }
+void operator delete(void* data, size_t, std::align_val_t) noexcept { _aligned_free(data); }
+#else
+void operator delete(void* data, std::align_val_t) noexcept { std::free(data); }
+void operator delete(void* data, size_t, std::align_val_t) noexcept { std::free(data); }
+#endif
+
+const int kWidth = 160;
+const int kHeight = 120;
+const int kReferencePasses = 1024;
+
+//passes with one sample per pixel, and the SSIM an image must reach to count as acceptable.
+const int kDenoiserPasses = 64;
+const double kAcceptableSSIM[] = { 0.90, 0.95 };
+
+//render time given to both sides of the guiding case.
+const double kGuidingSeconds = 20.0;
+
+//direction pairs of the bsdf case, some of Wi are under the surface.
+// the reference formulas are written apart, so only rounding may differ.
+const int kNumDirectionPairs = 1 << 20;
+const double kBSDFTolerance = 1e-9;
+const int kTimingPasses = 15;
+
+//bsdf samples per view angle of the furnace case.
+const int kNumFurnaceSamples = 1 << 20;
+const Float kFurnaceCosines[] = { Float(0.9), Float(0.5), Float(0.1) };
+//midpoint grid of the albedo quadrature over (cos theta, phi), and how far the estimate may stray from it.
+const int kQuadratureCosines = 1024;
+const int kQuadraturePhis = 2048;
+const double kFurnaceSigmas = 4.0;
+const double kFurnaceFloor = 5e-4;
+
+//frames of the alloc case, the first ones fill the task node pools and the frame arenas.
+const int kAllocationWarmupFrames = 8;
+const int kAllocationFrames = 64;
+//roots of the subsequent list graph, each gets fan-out dependents, four of them fit inline.
+const int kGraphRoots = 1024;
+const int kInlineSubsequents = 4;
+
+struct Convergence
+{
+    int Passes = 0;
+    double Seconds = 0.0;
+};
+
+//fails unless the denoised image reaches every acceptable SSIM.
+int RunDenoiserCase()
+{
+    auto Plastic = [](int index) { return Material::CreatePlastic(Spectrum(Float(0.5)), Float(0.2 + 0.15 * index)); };
+
+    testbed::BoxScene referenceScene(Plastic, false);
+    testbed::OfflineRenderer reference(referenceScene, kWidth, kHeight, 1);
+    double referenceSeconds = 0.0;
+    for (int pass = 0; pass < kReferencePasses; pass++)
+    {
+        referenceSeconds += reference.AddPass();
+    }
+    const std::vector<unsigned char> referenceImage = reference.Resolve();
+    printf("denoiser: reference %d spp in %.2f s\n", kReferencePasses, referenceSeconds);
+
+    testbed::BoxScene scene(Plastic, false);
+    testbed::OfflineRenderer renderer(scene, kWidth, kHeight);
+    const int numThresholds = sizeof(kAcceptableSSIM) / sizeof(kAcceptableSSIM[0]);
+    Convergence raw[numThresholds], denoised[numThresholds];
+    double renderSeconds = 0.0, denoiseSeconds = 0.0;
+    for (int pass = 1; pass <= kDenoiserPasses; pass++)
+    {
+        renderSeconds += renderer.AddPass();
+        double seconds = 0.0;
+        const double ssimRaw = testbed::SSIM(renderer.Resolve(), referenceImage, kWidth, kHeight);
+        const double ssimDenoised = testbed::SSIM(renderer.ResolveDenoised(seconds), referenceImage, kWidth, kHeight);
+        denoiseSeconds += seconds;
+
+        //every pass is denoised when the denoiser is on, so its cost is paid for all of them.
+        for (int index = 0; index < numThresholds; index++)
+        {
+            if (raw[index].Passes == 0 && ssimRaw >= kAcceptableSSIM[index])
+            {
+                raw[index] = { pass, renderSeconds };
+            }
+            if (denoised[index].Passes == 0 && ssimDenoised >= kAcceptableSSIM[index])
+            {
+                denoised[index] = { pass, renderSeconds + denoiseSeconds };
+            }
+        }
+        if ((pass & (pass - 1)) == 0)
+        {
+            printf("    spp=%-4d ssim raw=%.4f denoised=%.4f\n", pass, ssimRaw, ssimDenoised);
+        }
+    }
+
+    int numFailures = 0;
+    printf("    denoise pass %.2f ms, render pass %.2f ms\n", denoiseSeconds * 1000.0 / kDenoiserPasses, renderSeconds * 1000.0 / kDenoiserPasses);
+    for (int index = 0; index < numThresholds; index++)
+    {
+        auto Print = [](const char* name, double threshold, const Convergence& result)
+        {
+            if (result.Passes > 0)
+            {
+                printf("    %-8s ssim>=%.2f after %d spp, %.3f s\n", name, threshold, result.Passes, result.Seconds);
+            }
+            else
+            {
+                printf("    %-8s ssim>=%.2f not reached in %d spp\n", name, threshold, kDenoiserPasses);
+            }
+        };
+        Print("raw", kAcceptableSSIM[index], raw[index]);
+        Print("denoised", kAcceptableSSIM[index], denoised[index]);
+        numFailures += denoised[index].Passes > 0 ? 0 : 1;
+    }
+    return numFailures;
+}
+
+//the generic route: every lobe dispatched on its own, the one Material::Evaluate is timed against.
+void EvaluateByLobe(const Material& material, const Direction& Wo, const Direction& Wi, Spectrum& f, Float& pdf)
+{
+    const ShadingGeometry geometry(Wo, Wi);
+    f = Spectrum::zero();
+    pdf = Float(0);
+    for (uint32_t index = 0; index < material.GetLobeCount(); index++)
+    {
+        const BSDFLobe& lobe = material.GetLobeByIndex(index);
+        f += lobe.Weight * lobe.f(geometry);
+        pdf += material.GetLobeSelectionPdf(index) * lobe.pdf(geometry);
+    }
+}
+
+//fastest of all passes, the two routes take turns so both see the same machine load.
+template<typename EvaluationA, typename EvaluationB>
+void EvaluationsPerSecond(const std::vector<Direction>& Wo, const std::vector<Direction>& Wi, EvaluationA evaluateA, EvaluationB evaluateB, double& bestA, double& bestB)
+{
+    volatile Float sink = Float(0);
+    auto Run = [&](auto evaluate)
+    {
+        Float sum = Float(0);
+        const auto startTime = std::chrono::steady_clock::now();
+        for (size_t index = 0; index < Wo.size(); index++)
+        {
+            Spectrum f; Float pdf;
+            evaluate(Wo[index], Wi[index], f, pdf);
+            sum += f.x + pdf;
+        }
+        sink = sink + sum;
+        return Wo.size() / std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    };
+
+    bestA = bestB = 0.0;
+    for (int pass = 0; pass < kTimingPasses; pass++)
+    {
+        bestA = std::max(bestA, Run(evaluateA));
+        bestB = std::max(bestB, Run(evaluateB));
+    }
+}
+
+bool IsNear(double value, double reference)
+{
+    return std::abs(value - reference) <= kBSDFTolerance * std::max(std::abs(value), std::abs(reference));
+}
+
+//Evaluate, SampleF and SamplePdf against the formulas of ReferenceBSDF.h.
+int RunBSDFCase()
+{
+    std::mt19937 generator(27);
+    std::uniform_real_distribution<Float> uniform(Float(-1), Float(1));
+    auto RandomDirection = [&](bool bUpper)
+    {
+        math::vector3<Float> v;
+        do
+        {
+            v.set(uniform(generator), uniform(generator), uniform(generator));
+        } while (math::magnitude_sqr(v) > Float(1) || math::magnitude_sqr(v) < Float(1e-4));
+        if (bUpper)
+        {
+            v.z = std::abs(v.z);
+        }
+        return Direction(v);
+    };
+
+    std::vector<Direction> Wo(kNumDirectionPairs), Wi(kNumDirectionPairs);
+    for (int index = 0; index < kNumDirectionPairs; index++)
+    {
+        Wo[index] = RandomDirection(true);
+        Wi[index] = RandomDirection(index % 8 != 0);
+    }
+
+    struct NamedMaterial { const char* Name; std::unique_ptr<Material> Material; };
+    NamedMaterial materials[] =
+    {
+        { "matte", Material::CreateMatte(Spectrum(Float(0.75))) },
+        { "oren-nayar", Material::CreateMatte(Spectrum(Float(0.75)), Radian(Float(0.5))) },
+        { "ggx", Material::CreateMicrofacetGGX_Debug(Float(0.3), SpecularColor::Gold()) },
+        { "plastic", Material::CreatePlastic(Spectrum(Float(0.5)), Float(0.3)) },
+        { "ashikhmin-shirley", Material::CreateAshikhminAndShirley(Float(0.3), Spectrum(Float(0.5)), SpecularColor::Gold()) },
+    };
+
+    int numFailures = 0;
+    printf("bsdf: %d direction pairs, Material::Evaluate against reference formulas and per-lobe dispatch\n", kNumDirectionPairs);
+    for (const NamedMaterial& entry : materials)
+    {
+        const Material& material = *entry.Material;
+        int numMismatches = 0;
+        for (int index = 0; index < kNumDirectionPairs; index++)
+        {
+            Spectrum f, fReference; Float pdf, pdfReference;
+            material.Evaluate(Wo[index], Wi[index], f, pdf);
+            reference::Evaluate(material, Wo[index], Wi[index], fReference, pdfReference);
+
+            const bool bSame = IsNear(f.x, fReference.x) && IsNear(f.y, fReference.y) && IsNear(f.z, fReference.z) && IsNear(pdf, pdfReference)
+                && material.SampleF(Wo[index], Wi[index]).x == f.x && material.SamplePdf(Wo[index], Wi[index]) == pdf;
+            numMismatches += bSame ? 0 : 1;
+        }
+        numFailures += numMismatches > 0 ? 1 : 0;
+
+        double evaluated, byLobe;
+        EvaluationsPerSecond(Wo, Wi,
+            [&material](const Direction& wo, const Direction& wi, Spectrum& f, Float& pdf) { material.Evaluate(wo, wi, f, pdf); },
+            [&material](const Direction& wo, const Direction& wi, Spectrum& f, Float& pdf) { EvaluateByLobe(material, wo, wi, f, pdf); },
+            evaluated, byLobe);
+        printf("    %-18s mismatches=%-6d evaluate=%.1f M/s per-lobe=%.1f M/s speedup=%.2fx\n",
+            entry.Name, numMismatches, evaluated * 1e-6, byLobe * 1e-6, evaluated / byLobe);
+    }
+    return numFailures;
+}
+
+struct Moments
+{
+    double Sum = 0.0;
+    double SumSquare = 0.0;
+    int Count = 0;
+
+    void Add(double value) { Sum += value; SumSquare += value * value; Count++; }
+    double Mean() const { return Sum / Count; }
+    double Variance() const { return std::max(0.0, SumSquare / Count - Mean() * Mean()); }
+    double StandardError() const { return std::sqrt(Variance() / Count); }
+};
+
+//throughput f * cos / pdf of one bsdf sample, drawn the way the integrator does.
+Spectrum SampleThroughput(const Material& material, const Direction& Wo, Float u[3])
+{
+    const Direction Wi = material.GetRandomLobe(u[0]).SampleWi(u, Wo);
+    if (CosTheta(Wi) <= Float(0))
+    {
+        return Spectrum::zero();
+    }
+
+    Spectrum f; Float pdf;
+    material.Evaluate(Wo, Wi, f, pdf);
+    return pdf > Float(0) ? f * (CosTheta(Wi) / pdf) : Spectrum::zero();
+}
+
+bool IsMicrofacetLobe(const BSDFLobe& lobe)
+{
+    return lobe.Type == BSDFLobeType::TorranceSparrow || lobe.Type == BSDFLobeType::AshikhminAndShirleySpecular;
+}
+
+//pdf of a lobe when ggx half vectors are drawn from the full distribution D * NdotH.
+Float FullNDFPdf(const BSDFLobe& lobe, const Direction& Wo, const Direction& Wi)
+{
+    const ShadingGeometry geometry(Wo, Wi);
+    if (!IsMicrofacetLobe(lobe))
+    {
+        return lobe.pdf(geometry);
+    }
+    if (!geometry.IsHalfVectorValid || geometry.HdotV <= Float(0))
+    {
+        return Float(0);
+    }
+
+    const Float NdotH = math::saturate(geometry.NdotH);
+    const Float D = lobe.AlphaSquare * math::InvPI<Float> / math::square(math::square(NdotH) * (lobe.AlphaSquare - Float(1)) + Float(1));
+    return D * NdotH * Float(0.25) / geometry.HdotV;
+}
+
+//the sampling replaced by vndf and albedo-weighted selection:
+// lobes picked uniformly, ggx half vectors drawn from the full distribution.
+Spectrum SampleThroughputFullNDF(const Material& material, const Direction& Wo, Float u[3])
+{
+    const uint32_t numLobes = material.GetLobeCount();
+    const BSDFLobe& lobe = material.GetLobeByIndex(std::min(static_cast<uint32_t>(u[0] * numLobes), numLobes - 1));
+
+    Direction Wi = Direction::unit_z();
+    if (IsMicrofacetLobe(lobe))
+    {
+        const Float cosThetaSquare = (Float(1) - u[1]) / (Float(1) + (lobe.AlphaSquare - Float(1)) * u[1]);
+        const Float sinTheta = std::sqrt(math::max2(Float(0), Float(1) - cosThetaSquare));
+        const Float phi = math::TWO_PI<Float> * u[2];
+        const Direction H(sinTheta * std::cos(phi), sinTheta * std::sin(phi), std::sqrt(cosThetaSquare));
+        Wi = math::reflection(Wo, H);
+    }
+    else
+    {
+        Wi = lobe.SampleWi(u, Wo);
+    }
+    if (CosTheta(Wi) <= Float(0))
+    {
+        return Spectrum::zero();
+    }
+
+    Spectrum f; Float unused;
+    material.Evaluate(Wo, Wi, f, unused);
+    Float pdf = Float(0);
+    for (uint32_t index = 0; index < numLobes; index++)
+    {
+        pdf += FullNDFPdf(material.GetLobeByIndex(index), Wo, Wi) / numLobes;
+    }
+    return pdf > Float(0) ? f * (CosTheta(Wi) / pdf) : Spectrum::zero();
+}
+
+//deterministic albedo, luminance of f * cos integrated over the hemisphere with a midpoint rule.
+// Wo lies in the xz plane, so f is mirrored across it and half of phi is enough.
+double AlbedoQuadrature(const Material& material, const Direction& Wo)
+{
+    double albedo = 0.0;
+    for (int row = 0; row < kQuadratureCosines; row++)
+    {
+        const Float cosTheta = (row + Float(0.5)) / kQuadratureCosines;
+        const Float sinTheta = std::sqrt(Float(1) - cosTheta * cosTheta);
+        for (int column = 0; column < kQuadraturePhis; column++)
+        {
+            const Float phi = math::PI<Float> * (column + Float(0.5)) / kQuadraturePhis;
+            const Direction Wi(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+            Spectrum f; Float unused;
+            material.Evaluate(Wo, Wi, f, unused);
+            albedo += Luminance(f) * cosTheta;
+        }
+    }
+    return albedo * 2.0 * math::PI<double> / (double(kQuadratureCosines) * kQuadraturePhis);
+}
+
+//fails every view whose vndf estimate strays more than kFurnaceSigmas from the quadrature albedo.
+int RunFurnaceCase()
+{
+    struct NamedMaterial { const char* Name; std::unique_ptr<Material> Material; };
+    NamedMaterial materials[] =
+    {
+        { "white matte", Material::CreateMatte(Spectrum::one()) },
+        { "white ggx 0.3", Material::CreateMicrofacetGGX_Debug(Float(0.3), Spectrum::one()) },
+        { "white ggx 0.7", Material::CreateMicrofacetGGX_Debug(Float(0.7), Spectrum::one()) },
+        { "plastic 0.3", Material::CreatePlastic(Spectrum(Float(0.5)), Float(0.3)) },
+        { "plastic 0.7", Material::CreatePlastic(Spectrum(Float(0.5)), Float(0.7)) },
+        { "ashikhmin-shirley", Material::CreateAshikhminAndShirley(Float(0.3), Spectrum(Float(0.5)), SpecularColor::Gold()) },
+    };
+
+    //both estimators integrate the same f * cos, the means must agree and only variance may differ.
+    int numFailures = 0;
+    printf("furnace: %d samples per view, luminance of f * cos / pdf, vndf + albedo selection against full ndf + uniform selection\n", kNumFurnaceSamples);
+    for (const NamedMaterial& entry : materials)
+    {
+        for (Float cosine : kFurnaceCosines)
+        {
+            const Direction Wo(std::sqrt(Float(1) - cosine * cosine), Float(0), cosine);
+            std::mt19937 generator(28);
+            std::uniform_real_distribution<Float> uniform(Float(0), Float(1));
+            Moments current, fullNDF;
+            for (int sample = 0; sample < kNumFurnaceSamples; sample++)
+            {
+                Float u[3] = { uniform(generator), uniform(generator), uniform(generator) };
+                current.Add(Luminance(SampleThroughput(*entry.Material, Wo, u)));
+                fullNDF.Add(Luminance(SampleThroughputFullNDF(*entry.Material, Wo, u)));
+            }
+
+            //a perfect importance sampler has no variance at all, count it as no change.
+            const double reduction = current.Variance() > 1e-12 ? fullNDF.Variance() / current.Variance() : 1.0;
+            const double deviation = std::abs(current.Mean() - fullNDF.Mean()) / std::max(1e-12, std::hypot(current.StandardError(), fullNDF.StandardError()));
+            const double albedo = AlbedoQuadrature(*entry.Material, Wo);
+            const double error = std::abs(current.Mean() - albedo);
+            const bool bPassed = error <= kFurnaceSigmas * current.StandardError() + kFurnaceFloor * albedo;
+            numFailures += bPassed ? 0 : 1;
+            printf("    %-18s cos=%.1f albedo=%.4f/%.4f quadrature=%.4f (%.1f sigma) variance=%.5f/%.5f reduction=%.2fx%s\n",
+                entry.Name, cosine, current.Mean(), fullNDF.Mean(), albedo, deviation,
+                current.Variance(), fullNDF.Variance(), reduction, bPassed ? "" : " FAILED");
+        }
+    }
+    return numFailures;
+}
+
+struct EqualTimeResult
+{
+    int Passes = 0;
+    double Seconds = 0.0;
+    double RelativeMSE = 0.0;
+};
+
+//passes until the time budget runs out, the guide is rebuilt whenever its training samples doubled.
+EqualTimeResult RenderForTime(testbed::OfflineRenderer& renderer, PathGuide* pathGuide, const std::vector<Spectrum>& reference, const char* name)
+{
+    EqualTimeResult result;
+    while (result.Seconds < kGuidingSeconds)
+    {
+        if (pathGuide != nullptr && (result.Passes & (result.Passes - 1)) == 0)
+        {
+            const auto startTime = std::chrono::steady_clock::now();
+            pathGuide->Refresh();
+            result.Seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        }
+        result.Seconds += renderer.AddPass(pathGuide);
+        result.Passes++;
+        if ((result.Passes & (result.Passes - 1)) == 0)
+        {
+            printf("    %-8s spp=%-4d %.2f s relMSE=%.5f\n", name, result.Passes, result.Seconds, testbed::RelativeMSE(renderer.Radiance(), reference));
+        }
+    }
+    result.RelativeMSE = testbed::RelativeMSE(renderer.Radiance(), reference);
+    return result;
+}
+
+void RunGuidingCase()
+{
+    auto Matte = [](int index) { return Material::CreateMatte(Spectrum(Float(0.5) + Float(0.1) * index)); };
+
+    //the light faces the ceiling, all light reaching the room bounces there first.
+    testbed::BoxScene referenceScene(Matte, true);
+    testbed::OfflineRenderer reference(referenceScene, kWidth, kHeight, 1);
+    double referenceSeconds = 0.0;
+    for (int pass = 0; pass < kReferencePasses; pass++)
+    {
+        referenceSeconds += reference.AddPass();
+    }
+    const std::vector<Spectrum> referenceRadiance = reference.Radiance();
+    printf("guiding: reference %d spp in %.2f s, %.0f s for each side\n", kReferencePasses, referenceSeconds, kGuidingSeconds);
+
+    testbed::BoxScene scene(Matte, true);
+    testbed::OfflineRenderer unguided(scene, kWidth, kHeight);
+    const EqualTimeResult bsdf = RenderForTime(unguided, nullptr, referenceRadiance, "bsdf");
+
+    testbed::BoxScene guidedScene(Matte, true);
+    testbed::OfflineRenderer guided(guidedScene, kWidth, kHeight);
+    PathGuide pathGuide;
+    const EqualTimeResult guide = RenderForTime(guided, &pathGuide, referenceRadiance, "guided");
+
+    printf("    equal time: bsdf %d spp relMSE=%.5f, guided %d spp relMSE=%.5f, %.2fx lower error\n",
+        bsdf.Passes, bsdf.RelativeMSE, guide.Passes, guide.RelativeMSE, bsdf.RelativeMSE / std::max(1e-12, guide.RelativeMSE));
+}
+
+/**
+* one frame of task lists as LitRenderer builds them for the testbed canvas:
+* a list of 2x2 block tasks, then one list per row of film tiles, each waited on.
+* returns the global allocations per frame after warm-up.
+*/
+template<typename BeginFrame, typename MakeTaskList>
+double AllocationsPerFrame(BeginFrame beginFrame, MakeTaskList makeTaskList, int& numTasks)
+{
+    //RenderBlockSize and FilmTileSize of LitRenderer.
+    const int kBlockSize = 2;
+    const int kTileSize = 32;
+    const int numBlocks = ((kWidth + kBlockSize - 1) / kBlockSize) * ((kHeight + kBlockSize - 1) / kBlockSize);
+    const int numTileX = (kWidth + kTileSize - 1) / kTileSize;
+    const int numTileY = (kHeight + kTileSize - 1) / kTileSize;
+    numTasks = numBlocks + numTileX * numTileY;
+
+    std::atomic<int> sink = 0;
+    uint64_t numAllocations = 0;
+    for (int frame = 0; frame < kAllocationWarmupFrames + kAllocationFrames; frame++)
+    {
+        const uint64_t frameStart = gNumAllocations.load();
+        beginFrame();
+        {
+            auto blockTasks = makeTaskList();
+            for (int index = 0; index < numBlocks; index++)
+            {
+                blockTasks.push_back(Task::Start(ThreadName::Worker, [&sink, index](::Task&) { sink += index; }));
+            }
+            for (Task& task : blockTasks)
+            {
+                task.SpinWait();
+            }
+
+            for (int row = 0; row < numTileY; row++)
+            {
+                auto tileTasks = makeTaskList();
+                for (int index = 0; index < numTileX; index++)
+                {
+                    tileTasks.push_back(Task::Start(ThreadName::Worker, [&sink, index](::Task&) { sink += index; }));
+                }
+                for (Task& task : tileTasks)
+                {
+                    task.SpinWait();
+                }
+            }
+        }
+        numAllocations += frame >= kAllocationWarmupFrames ? gNumAllocations.load() - frameStart : 0;
+    }
+    return double(numAllocations) / kAllocationFrames;
+}
+
+/**
+* builds kGraphRoots roots with fanOut dependents each, behind a gate task that holds the roots back,
+* so nothing is scheduled and only the main thread allocates while the graph is built.
+* the second of two rounds is counted, the first fills the node pools.
+*/
+double SubsequentAllocationsPerRoot(int fanOut)
+{
+    std::vector<Task> roots, dependents;
+    roots.reserve(kGraphRoots);
+    dependents.reserve(kGraphRoots * fanOut);
+
+    uint64_t numAllocations = 0;
+    for (int round = 0; round < 2; round++)
+    {
+        roots.clear();
+        dependents.clear();
+        std::atomic<bool> bOpen = false;
+        Task gate = Task::Start(ThreadName::Worker, [&bOpen](::Task&)
+            {
+                while (!bOpen)
+                {
+                    std::this_thread::yield();
+                }
+            });
+
+        const uint64_t graphStart = gNumAllocations.load();
+        for (int root = 0; root < kGraphRoots; root++)
+        {
+            roots.push_back(Task::When(ThreadName::Worker, [](::Task&) { }, gate));
+            for (int index = 0; index < fanOut; index++)
+            {
+                dependents.push_back(Task::When(ThreadName::Worker, [](::Task&) { }, roots.back()));
+            }
+        }
+        numAllocations = gNumAllocations.load() - graphStart;
+
+        bOpen = true;
+        for (Task& task : dependents)
+        {
+            task.SpinWait();
+        }
+    }
+    return double(numAllocations) / kGraphRoots;
+}
+
+//per-frame task lists on frame_linear_allocator against the std::vector<Task> they replaced,
+// task nodes come from their pool in both, so only the lists and the scheduler queues may allocate.
+int RunAllocationCase()
+{
+    base::frame_linear_allocator frameAllocator;
+    int numTasks = 0;
+    const double byVector = AllocationsPerFrame([]() { }, []() { return std::vector<Task>(); }, numTasks);
+    const double byFrameAllocator = AllocationsPerFrame(
+        [&frameAllocator]() { frameAllocator.begin_frame(); },
+        [&frameAllocator]() { return FrameTaskList(frameAllocator); }, numTasks);
+
+    int numFailures = 0;
+    const bool bPassed = byFrameAllocator < byVector;
+    numFailures += bPassed ? 0 : 1;
+    printf("alloc: %dx%d canvas, %d tasks per frame, global allocations per frame of task lists\n", kWidth, kHeight, numTasks);
+    printf("    std::vector<Task> %.1f, FrameTaskList %.1f, frame arena blocks %llu%s\n",
+        byVector, byFrameAllocator, static_cast<unsigned long long>(frameAllocator.stats().num_system_allocations + frameAllocator.previous_stats().num_system_allocations),
+        bPassed ? "" : " FAILED");
+
+    //up to kInlineSubsequents dependents stay in the node, one more spills the list to the heap.
+    printf("    subsequent lists, global allocations per root while the graph is built\n");
+    for (int fanOut : { 1, kInlineSubsequents, kInlineSubsequents + 1 })
+    {
+        const double perRoot = SubsequentAllocationsPerRoot(fanOut);
+        const bool bInline = fanOut <= kInlineSubsequents;
+        const bool bExpected = bInline ? perRoot < 0.05 : perRoot > 0.5;
+        numFailures += bExpected ? 0 : 1;
+        printf("    fan-out %d %.3f%s\n", fanOut, perRoot, bExpected ? "" : " FAILED");
+    }
+    return numFailures;
+}
+
+int main(int argc, char** argv)
+{
+    //name of a case as the only argument runs just that case.
+    auto IsSelected = [argc, argv](const char* name) { return argc < 2 || strcmp(argv[1], name) == 0; };
+
+    int numFailures = 0;
+    Task::StartSystem(std::thread::hardware_concurrency());
+    if (IsSelected("denoise"))
+    {
+        numFailures += RunDenoiserCase();
+    }
+    if (IsSelected("guiding"))
+    {
+        RunGuidingCase();
+    }
+    if (IsSelected("bsdf"))
+    {
+        numFailures += RunBSDFCase();
+    }
+    if (IsSelected("furnace"))
+    {
+        numFailures += RunFurnaceCase();
+    }
+    if (IsSelected("alloc"))
+    {
+        numFailures += RunAllocationCase();
+    }
+    Task::StopSystem();
+    printf("%d failed\n", numFailures);
+    return numFailures;
+}
@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Foundation/Base/CompressionHelper.h>
+#include <Foundation/Base/MemoryHelper.h>
+#include <Foundation/Base/Serialization.h>
+#include <Application/LitRenderer/TaskGraph.h>
+
+/**
+* usage: SerializationBenchmark
+* round-trips about 100 MB of float and int vectors and strings through base_archive&,
+* once element by element, the way operator<< used to work, and once with the operators of Serialization.h.
+* both routes must write the same bytes, throughput is the fastest of all passes.
+* a length whose byte size exceeds 32 bits must fail the archive instead of wrapping.
+* then compresses random, film-like and text payloads with the block codec of CompressionHelper.h,
+* decoded through the archive and block by block on the task graph workers, both must match the source.
+* the exit code is the number of failed checks.
+*/
+const uint64_t kPayloadBytes = uint64_t(100) << 20;
+const int kNumPasses = 5;
+const unsigned kSeed = 0x73657269;
+const uint32_t kCodecPayloadBytes = 32u << 20;
+
+struct Payload
+{
+    std::vector<std::vector<float>> Floats;
+    std::vector<std::string> Strings;
+    std::vector<std::vector<int32_t>> Ints;
+    uint64_t Bytes = 0;     // serialized size, length prefixes included
+};
+
+Payload GeneratePayload(unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<uint32_t> vectorLength(1000, 31000);
+    std::uniform_int_distribution<uint32_t> stringLength(200, 2200);
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+
+    Payload payload;
+    while (payload.Bytes < kPayloadBytes)
+    {
+        const uint32_t length = vectorLength(random);
+        std::vector<float>& floats = payload.Floats.emplace_back(length);
+        std::generate(floats.begin(), floats.end(), [&]() { return value(random); });
+
+        std::string& text = payload.Strings.emplace_back(stringLength(random), ' ');
+        std::generate(text.begin(), text.end(), [&]() { return static_cast<char>('a' + random() % 26); });
+
+        std::vector<int32_t>& ints = payload.Ints.emplace_back(length / 2);
+        std::generate(ints.begin(), ints.end(), [&]() { return static_cast<int32_t>(random()); });
+
+        payload.Bytes += sizeof(uint32_t) * 3 + floats.size() * sizeof(float) + text.size() + ints.size() * sizeof(int32_t);
+    }
+    return payload;
+}
+
+//same layout as operator<<, one serialize() call for every element.
+template<typename Container>
+void SerializeByElement(base::base_archive& archive, Container& values)
+{
+    uint32_t length = static_cast<uint32_t>(values.size());
+    archive << length;
+    if (archive.is_loading())
+    {
+        values.resize(length);
+    }
+
+    for (uint32_t index = 0; index < length; index++)
+    {
+        archive << values[index];
+    }
+}
+
+template<bool bByElement>
+void SerializePayload(base::base_archive& archive, Payload& payload)
+{
+    for (size_t index = 0; index < payload.Floats.size(); index++)
+    {
+        if constexpr (bByElement)
+        {
+            SerializeByElement(archive, payload.Floats[index]);
+            SerializeByElement(archive, payload.Strings[index]);
+            SerializeByElement(archive, payload.Ints[index]);
+        }
+        else
+        {
+            archive << payload.Floats[index] << payload.Strings[index] << payload.Ints[index];
+        }
+    }
+}
+
+template<typename Operation>
+double BestSeconds(Operation op)
+{
+    double best = 0.0;
+    for (int pass = 0; pass < kNumPasses; pass++)
+    {
+        const auto startTime = std::chrono::steady_clock::now();
+        op();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        best = (pass == 0) ? seconds : std::min(best, seconds);
+    }
+    return best;
+}
+
+struct Result
+{
+    double WriteSeconds = 0.0;
+    double ReadSeconds = 0.0;
+    double GrowingWriteSeconds = 0.0;
+    std::vector<uint8_t> Bytes;
+    bool IsRoundTripExact = false;
+};
+
+//writes into a buffer touched beforehand, so page faults are not timed, then reads it back.
+template<bool bByElement>
+Result Measure(Payload& source)
+{
+    const uint32_t capacity = static_cast<uint32_t>(source.Bytes);
+    Result result;
+    result.Bytes.assign(capacity, 0);
+    bool bFailed = false;
+    result.WriteSeconds = BestSeconds([&]()
+        {
+            base::memory_archive_write archive(result.Bytes.data(), capacity);
+            SerializePayload<bByElement>(archive, source);
+            bFailed = bFailed || archive.has_error();
+        });
+
+    Payload loaded;
+    loaded.Floats.resize(source.Floats.size());
+    loaded.Strings.resize(source.Strings.size());
+    loaded.Ints.resize(source.Ints.size());
+    result.ReadSeconds = BestSeconds([&]()
+        {
+            base::memory_archive_read archive(result.Bytes.data(), capacity);
+            SerializePayload<bByElement>(archive, loaded);
+            bFailed = bFailed || archive.has_error();
+        });
+    result.IsRoundTripExact = !bFailed && loaded.Floats == source.Floats && loaded.Strings == source.Strings && loaded.Ints == source.Ints;
+
+    //an owned archive starting small, growth and first touch are both timed.
+    result.GrowingWriteSeconds = BestSeconds([&]()
+        {
+            base::memory_archive_write archive(256);
+            SerializePayload<bByElement>(archive, source);
+            result.IsRoundTripExact = result.IsRoundTripExact && !archive.has_error()
+                && archive.written_size() == capacity
+                && std::memcmp(archive.data(), result.Bytes.data(), capacity) == 0;
+        });
+    return result;
+}
+
+//a stored length of 2^31 floats is 8 GB, more than one serialize() can take, the archive must fail before allocating.
+bool IsOversizedLengthRejected()
+{
+    uint32_t header[2] = { 0x80000000u, 0u };
+    base::memory_archive_read archive(reinterpret_cast<uint8_t*>(header), sizeof(header));
+    std::vector<float> values;
+    archive << values;
+    return archive.has_error() && values.empty();
+}
+
+int RunArchiveCase()
+{
+    Payload payload = GeneratePayload(kSeed);
+    const double gigabytes = payload.Bytes * 1e-9;
+    printf("payload: %zu records, %.1f MB\n", payload.Floats.size(), payload.Bytes / double(1 << 20));
+
+    const Result byElement = Measure<true>(payload);
+    const Result bulk = Measure<false>(payload);
+
+    int numFailures = 0;
+    auto Print = [&](const char* name, const Result& result)
+    {
+        printf("    %-12s write=%.2f GB/s read=%.2f GB/s growing write=%.2f GB/s round trip=%s\n", name,
+            gigabytes / result.WriteSeconds, gigabytes / result.ReadSeconds, gigabytes / result.GrowingWriteSeconds,
+            result.IsRoundTripExact ? "exact" : "FAILED");
+        numFailures += result.IsRoundTripExact ? 0 : 1;
+    };
+    Print("per-element", byElement);
+    Print("bulk", bulk);
+
+    //bulk copies must not change the file format.
+    const bool bSameBytes = byElement.Bytes == bulk.Bytes;
+    numFailures += bSameBytes ? 0 : 1;
+    printf("    layout %s, speedup write=%.2fx read=%.2fx growing write=%.2fx\n", bSameBytes ? "identical" : "DIFFERS",
+        byElement.WriteSeconds / bulk.WriteSeconds, byElement.ReadSeconds / bulk.ReadSeconds, byElement.GrowingWriteSeconds / bulk.GrowingWriteSeconds);
+
+    const bool bRejected = IsOversizedLengthRejected();
+    numFailures += bRejected ? 0 : 1;
+    printf("    oversized length %s\n", bRejected ? "rejected" : "ACCEPTED");
+    return numFailures;
+}
+
+//incompressible, every block is stored as it is.
+std::vector<uint8_t> GenerateRandomBytes(unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::vector<uint8_t> bytes(kCodecPayloadBytes);
+    std::generate(bytes.begin(), bytes.end(), [&]() { return static_cast<uint8_t>(random()); });
+    return bytes;
+}
+
+//accumulated pixels of a checkpoint: rgb sums over a smooth gradient with some noise, weight and count shared by the film.
+std::vector<uint8_t> GenerateFilmBytes(unsigned seed)
+{
+    struct Pixel { float R, G, B, LuminanceSquare, Weight; uint32_t Count; };
+    const int width = 1920;
+    const float samples = 64.0f;
+    std::mt19937 random(seed);
+    std::normal_distribution<float> noise(0.0f, 0.02f);
+
+    std::vector<Pixel> pixels(kCodecPayloadBytes / sizeof(Pixel));
+    for (size_t index = 0; index < pixels.size(); index++)
+    {
+        const float u = static_cast<float>(index % width) / width;
+        const float v = static_cast<float>(index / width % 1080) / 1080;
+        //the upper third is flat sky, which is where pixels repeat.
+        const bool bSky = v < 0.33f;
+        const float r = bSky ? 0.4f : 0.2f + 0.6f * u + noise(random);
+        const float g = bSky ? 0.6f : 0.3f + 0.4f * v + noise(random);
+        const float b = bSky ? 0.9f : 0.1f + 0.2f * u * v + noise(random);
+        pixels[index] = { r * samples, g * samples, b * samples, (r * r + g * g + b * b) * samples, samples, static_cast<uint32_t>(samples) };
+    }
+
+    std::vector<uint8_t> bytes(kCodecPayloadBytes, 0);
+    std::memcpy(bytes.data(), pixels.data(), pixels.size() * sizeof(Pixel));
+    return bytes;
+}
+
+//statistics lines as RenderStatistics writes them, words of a small vocabulary and changing numbers.
+std::vector<uint8_t> GenerateTextBytes(unsigned seed)
+{
+    const char* keys[] = { "frame", "paths", "rays", "bounces", "shadow_rays", "texture_misses", "guided", "seconds" };
+    std::mt19937 random(seed);
+    std::string text;
+    text.reserve(kCodecPayloadBytes + 256);
+    while (text.size() < kCodecPayloadBytes)
+    {
+        text += "{";
+        for (const char* key : keys)
+        {
+            text += "\"";
+            text += key;
+            text += "\":";
+            text += std::to_string(random() % 100000);
+            text += key == keys[7] ? "}\n" : ",";
+        }
+    }
+    return std::vector<uint8_t>(text.begin(), text.begin() + kCodecPayloadBytes);
+}
+
+struct CodecResult
+{
+    uint64_t CompressedBytes = 0;
+    double EncodeSeconds = 0.0;
+    double DecodeSeconds = 0.0;
+    double ParallelDecodeSeconds = 0.0;
+    bool IsRoundTripExact = false;
+    bool IsParallelRoundTripExact = false;
+};
+
+CodecResult MeasureCodec(std::vector<uint8_t>& source)
+{
+    const uint32_t size = static_cast<uint32_t>(source.size());
+    CodecResult result;
+    std::vector<uint8_t> compressed;
+    result.EncodeSeconds = BestSeconds([&]()
+        {
+            base::memory_archive_write target(256);
+            {
+                base::compressed_archive_write archive(target);
+                archive.serialize(source.data(), size);
+            }
+            compressed.assign(target.data(), target.data() + target.written_size());
+        });
+    result.CompressedBytes = compressed.size();
+
+    std::vector<uint8_t> decoded(size);
+    bool bFailed = false;
+    result.DecodeSeconds = BestSeconds([&]()
+        {
+            base::compressed_archive_read archive(compressed.data(), compressed.size());
+            archive.serialize(decoded.data(), size);
+            bFailed = bFailed || !archive.is_valid() || archive.has_error() || archive.raw_size() != size;
+        });
+    result.IsRoundTripExact = !bFailed && decoded == source;
+
+    //one task per block, each writes its own slice of the output.
+    std::vector<uint8_t> parallelDecoded(size);
+    std::atomic<int> numFailedBlocks = 0;
+    result.ParallelDecodeSeconds = BestSeconds([&]()
+        {
+            base::compressed_archive_read archive(compressed.data(), compressed.size());
+            std::vector<Task> blockTasks;
+            for (uint32_t index = 0; index < archive.num_blocks(); index++)
+            {
+                blockTasks.push_back(Task::Start(ThreadName::Worker,
+                    [&archive, &parallelDecoded, &numFailedBlocks, index](::Task&)
+                    {
+                        uint8_t* out = parallelDecoded.data() + static_cast<size_t>(index) * archive.block_size();
+                        numFailedBlocks += archive.decompress_block(index, out) ? 0 : 1;
+                    }));
+            }
+            for (Task& task : blockTasks)
+            {
+                task.SpinWait();
+            }
+        });
+    result.IsParallelRoundTripExact = numFailedBlocks == 0 && parallelDecoded == source;
+    return result;
+}
+
+int RunCodecCase()
+{
+    struct NamedPayload { const char* Name; std::vector<uint8_t> Bytes; };
+    NamedPayload payloads[] =
+    {
+        { "random", GenerateRandomBytes(kSeed) },
+        { "film", GenerateFilmBytes(kSeed) },
+        { "text", GenerateTextBytes(kSeed) },
+    };
+
+    int numFailures = 0;
+    const double gigabytes = kCodecPayloadBytes * 1e-9;
+    printf("codec: %.1f MB per payload, %u KB blocks, %u workers\n", kCodecPayloadBytes / double(1 << 20),
+        base::compressed_archive_write::default_block_size / 1024, std::thread::hardware_concurrency());
+    for (NamedPayload& payload : payloads)
+    {
+        const CodecResult result = MeasureCodec(payload.Bytes);
+        printf("    %-8s ratio=%.2fx encode=%.2f GB/s decode=%.2f GB/s parallel decode=%.2f GB/s round trip=%s/%s\n",
+            payload.Name, double(kCodecPayloadBytes) / result.CompressedBytes,
+            gigabytes / result.EncodeSeconds, gigabytes / result.DecodeSeconds, gigabytes / result.ParallelDecodeSeconds,
+            result.IsRoundTripExact ? "exact" : "FAILED", result.IsParallelRoundTripExact ? "exact" : "FAILED");
+        numFailures += result.IsRoundTripExact ? 0 : 1;
+        numFailures += result.IsParallelRoundTripExact ? 0 : 1;
+    }
+    return numFailures;
+}
+
+int main()
+{
+    int numFailures = RunArchiveCase();
+    Task::StartSystem(std::thread::hardware_concurrency());
+    numFailures += RunCodecCase();
+    Task::StopSystem();
+    return numFailures;
+}
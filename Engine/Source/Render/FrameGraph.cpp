@@ -23,7 +23,11 @@ namespace engine
     }
 
     RenderFrameGraph::RenderFrameGraph(TransientBufferRegistry* registry)
-        : mTransientBufferRegistry(registry)
+        : mArena(kArenaBlockSize, "framegraph")
+        , mNodes(mArena)
+        , mResources(mArena)
+        , mCompiledNodeExecuteOrder(mArena)
+        , mTransientBufferRegistry(registry)
     {
         RFGResource& BackbufferRT = CreateNewResource("backbuffer.rendertarget",
             registry->GetDefaultBackbufferRT()->GetWidth(),
@@ -4,6 +4,8 @@
 #include <vector>
 #include <map>
 #include <functional>
+#include <Foundation/Base/AllocatorHelper.h>
+#include <Foundation/Base/ContainerHelper.h>
 #include "TransientBufferRegistry.h"
 namespace engine
 {
@@ -70,17 +72,20 @@ namespace engine
             return RenderPassType{ this, basePass.Index };
         }
     private:
+        //passes read and write a handful of resources, the lists stay inside nodes and resources.
+        using IndexList = base::small_vector<int, 4>;
+
         struct RFGNode
         {
             std::string DebugName;
             int Index;
-            std::vector<int> ReadingResources;
-            std::vector<int> ReadingResourcesAliasing;
-            std::vector<int> WritingRenderTargets;
-            std::vector<int> WritingRenderTargetAliasing;
+            IndexList ReadingResources;
+            IndexList ReadingResourcesAliasing;
+            IndexList WritingRenderTargets;
+            IndexList WritingRenderTargetAliasing;
             int WritingDepthStencil = -1;
             int WritingDepthStencilAliasing = -1;
-            std::vector<ClearState> RenderTargetBindStates;
+            base::small_vector<ClearState, 4> RenderTargetBindStates;
             ClearState DepthStencilBindState;
 
             std::function<void(GFXI::DeferredContext&)> mExecuteJob = nullptr;
@@ -100,9 +105,9 @@ namespace engine
                 GFXI::RenderTargetView::EFormat RenderTargetFormat;
                 GFXI::DepthStencilView::EFormat DepthStencilFormat;
             };
-            std::vector<int> ReadingNodes;
-            std::vector<int> WritingNodes;
-            std::vector<int> AliasingResources;
+            IndexList ReadingNodes;
+            IndexList WritingNodes;
+            IndexList AliasingResources;
 
             GFXI::RenderTargetView* GfxRenderTargetPtr = nullptr;
             GFXI::DepthStencilView* GfxDepthStencilPtr = nullptr;
@@ -117,9 +122,14 @@ namespace engine
         void ReleaseTransientResources(RFGNode& node);
         int GetAliasingResourceIndex(int);
 
-        std::vector<RFGNode> mNodes;
-        std::vector<RFGResource> mResources;
-        std::vector<int> mCompiledNodeExecuteOrder;
+        //graph is rebuilt every frame, its lists live in one arena instead of growing on the heap.
+        template<typename T> using ArenaVector = std::vector<T, base::std_allocator_adaptor<T, base::arena_allocator>>;
+        static const size_t kArenaBlockSize = 16 * 1024;
+
+        base::arena_allocator mArena;
+        ArenaVector<RFGNode> mNodes;
+        ArenaVector<RFGResource> mResources;
+        ArenaVector<int> mCompiledNodeExecuteOrder;
         TransientBufferRegistry* mTransientBufferRegistry;
         int mBackbufferRTIndex;
         int mBackbufferDSIndex;
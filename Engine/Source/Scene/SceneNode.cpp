@@ -1,3 +1,5 @@
+#include <cassert>
+#include <Foundation/Base/AllocatorHelper.h>
 #include "Scene.h"
 #include "SceneNode.h"
 
@@ -10,6 +12,19 @@ namespace GE
 }
 namespace engine
 {
+    using SceneNodePool = base::fixed_size_pool<sizeof(SceneNode), alignof(SceneNode)>;
+
+    void* SceneNode::operator new(size_t size)
+    {
+        assert(size == sizeof(SceneNode));
+        return SceneNodePool::allocate();
+    }
+
+    void SceneNode::operator delete(void* pointer)
+    {
+        SceneNodePool::deallocate(pointer);
+    }
+
     GE::Scene* SceneNode::GetScene()
     {
         return mScene;
@@ -1,5 +1,6 @@
 #pragma once
 #include <vector>
+#include <Foundation/Base/ContainerHelper.h>
 #include "PreIncludeFiles.h"
 #include "..\..\Include\GEScene.h"
 
@@ -64,6 +65,10 @@ namespace engine
         SceneNode(Scene* scene, SceneNode* parent, uint32_t orderIndex);
         virtual bool IsRoot() const { return false; }
 
+        //children are created and destroyed one by one, they come from a pool instead of the global heap.
+        static void* operator new(size_t size);
+        static void operator delete(void* pointer);
+
 
     private:
         struct ComponentWrap
@@ -82,8 +87,8 @@ namespace engine
         void PostUpdateRemoveComponents();
         Scene* mScene = nullptr;
         SceneNode* mParent = nullptr;
-        std::vector<SceneNode*> mChildren;
-        std::vector<ComponentWrap> mComponents;
+        base::small_vector<SceneNode*, 4> mChildren;
+        base::small_vector<ComponentWrap, 4> mComponents;
         math::float4x4 mLocalTransform;
 
         uint32_t mOrderedIndexInParent;
@@ -0,0 +1,424 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#endif
+
+/**
+* debug mode poisons fresh and freed memory, checks freed memory was not written before it is handed out again,
+* and reports allocations that are still alive when their allocator is reset or destroyed.
+* it is on in debug builds, define FOUNDATION_ALLOCATOR_DEBUG to 0 or 1 to override.
+*/
+#ifndef FOUNDATION_ALLOCATOR_DEBUG
+#if defined(_DEBUG)
+#define FOUNDATION_ALLOCATOR_DEBUG 1
+#else
+#define FOUNDATION_ALLOCATOR_DEBUG 0
+#endif
+#endif
+
+namespace base
+{
+    namespace base_impl
+    {
+        constexpr uint8_t allocated_poison = 0xCD;
+        constexpr uint8_t freed_poison = 0xDD;
+
+        constexpr size_t align_up(size_t value, size_t alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+
+        inline void poison(void* data, size_t size_in_bytes, uint8_t pattern)
+        {
+#if FOUNDATION_ALLOCATOR_DEBUG
+            std::memset(data, pattern, size_in_bytes);
+#else
+            (void)data; (void)size_in_bytes; (void)pattern;
+#endif
+        }
+
+        inline bool is_poisoned(const void* data, size_t size_in_bytes, uint8_t pattern)
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            for (size_t index = 0; index < size_in_bytes; index++)
+            {
+                if (bytes[index] != pattern)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // windows applications have no console, errors go to the debugger output there.
+        inline void report_allocator_error(const char* name, const char* message, unsigned long long count)
+        {
+            char text[256];
+            std::snprintf(text, sizeof(text), "[allocator] %s: %llu %s\n", name, count, message);
+#if defined(_WIN32)
+            ::OutputDebugStringA(text);
+#else
+            std::fputs(text, stderr);
+#endif
+        }
+    }
+
+    struct allocator_stats
+    {
+        uint64_t num_allocations = 0;
+        uint64_t num_deallocations = 0;
+        uint64_t num_system_allocations = 0;   // blocks taken from the global heap
+        uint64_t used_bytes = 0;
+        uint64_t reserved_bytes = 0;
+
+        uint64_t num_live_allocations() const { return num_allocations - num_deallocations; }
+    };
+
+    /**
+    * bump allocator, memory is only reclaimed by reset() and the blocks are kept for the next round.
+    * deallocate() is bookkeeping for the leak report, containers call it as usual.
+    * not thread-safe.
+    */
+    struct arena_allocator
+    {
+        explicit arena_allocator(size_t block_size = 64 * 1024, const char* name = "arena")
+            : block_size(block_size), debug_name(name) { }
+
+        ~arena_allocator()
+        {
+            reset();
+            for (block& b : blocks)
+            {
+                delete[] b.data;
+            }
+        }
+
+        void* allocate(size_t size_in_bytes, size_t alignment = alignof(std::max_align_t))
+        {
+            for (;;)
+            {
+                if (current_block < blocks.size())
+                {
+                    block& b = blocks[current_block];
+                    const size_t start = base_impl::align_up(reinterpret_cast<uintptr_t>(b.data) + offset, alignment) - reinterpret_cast<uintptr_t>(b.data);
+                    if (start + size_in_bytes <= b.size)
+                    {
+                        offset = start + size_in_bytes;
+                        statistics.num_allocations++;
+                        statistics.used_bytes += size_in_bytes;
+                        base_impl::poison(b.data + start, size_in_bytes, base_impl::allocated_poison);
+                        return b.data + start;
+                    }
+                    current_block++;
+                    offset = 0;
+                    continue;
+                }
+
+                // an oversized request gets a block of its own.
+                block b;
+                b.size = size_in_bytes + alignment > block_size ? size_in_bytes + alignment : block_size;
+                b.data = new uint8_t[b.size];
+                blocks.push_back(b);
+                statistics.num_system_allocations++;
+                statistics.reserved_bytes += b.size;
+            }
+        }
+
+        void deallocate(void* data, size_t size_in_bytes)
+        {
+            (void)data; (void)size_in_bytes;
+            statistics.num_deallocations++;
+        }
+
+        void reset()
+        {
+#if FOUNDATION_ALLOCATOR_DEBUG
+            if (statistics.num_live_allocations() > 0)
+            {
+                base_impl::report_allocator_error(debug_name, "allocations are still alive at reset.", statistics.num_live_allocations());
+            }
+            for (size_t index = 0; index < blocks.size() && index <= current_block; index++)
+            {
+                base_impl::poison(blocks[index].data, index == current_block ? offset : blocks[index].size, base_impl::freed_poison);
+            }
+#endif
+            current_block = 0;
+            offset = 0;
+            statistics.num_allocations = 0;
+            statistics.num_deallocations = 0;
+            statistics.used_bytes = 0;
+        }
+
+        bool owns(const void* data) const
+        {
+            for (const block& b : blocks)
+            {
+                if (data >= b.data && data < b.data + b.size)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // counters since the last reset, except the system allocations and reserved bytes.
+        const allocator_stats& stats() const { return statistics; }
+        const char* name() const { return debug_name; }
+
+    private:
+        arena_allocator(const arena_allocator&) = delete;
+        arena_allocator& operator=(const arena_allocator&) = delete;
+
+        struct block
+        {
+            uint8_t* data = nullptr;
+            size_t size = 0;
+        };
+
+        std::vector<block> blocks;
+        size_t current_block = 0;
+        size_t offset = 0;
+        size_t block_size;
+        const char* debug_name;
+        allocator_stats statistics;
+    };
+
+    /**
+    * two arenas used in turn, begin_frame() resets the one used two frames ago.
+    * memory allocated in a frame stays valid during the next one,
+    * so work issued in a frame may still read it while the next frame is being built.
+    * not thread-safe.
+    */
+    struct frame_linear_allocator
+    {
+        explicit frame_linear_allocator(size_t block_size = 256 * 1024, const char* name = "frame")
+            : frames{ arena_allocator(block_size, name), arena_allocator(block_size, name) } { }
+
+        void* allocate(size_t size_in_bytes, size_t alignment = alignof(std::max_align_t))
+        {
+            return frames[current_frame].allocate(size_in_bytes, alignment);
+        }
+
+        void deallocate(void* data, size_t size_in_bytes)
+        {
+            arena_allocator& owner = frames[current_frame].owns(data) ? frames[current_frame] : frames[current_frame ^ 1];
+            owner.deallocate(data, size_in_bytes);
+        }
+
+        void begin_frame()
+        {
+            current_frame ^= 1;
+            frames[current_frame].reset();
+            num_frames++;
+        }
+
+        uint64_t frame_index() const { return num_frames; }
+        const allocator_stats& stats() const { return frames[current_frame].stats(); }
+        const allocator_stats& previous_stats() const { return frames[current_frame ^ 1].stats(); }
+
+    private:
+        arena_allocator frames[2];
+        uint32_t current_frame = 0;
+        uint64_t num_frames = 0;
+    };
+
+    /**
+    * blocks of a fixed size, one pool per <BlockSize, Alignment> in the process.
+    * every thread allocates from and frees to its own list without locking,
+    * lists are balanced through a shared list in batches, so a block may be freed on any thread.
+    * chunks are released at exit, blocks still alive then are reported in debug mode.
+    */
+    template<size_t BlockSize, size_t Alignment = alignof(std::max_align_t)>
+    struct fixed_size_pool
+    {
+        static constexpr size_t block_stride = base_impl::align_up(BlockSize > sizeof(void*) ? BlockSize : sizeof(void*), Alignment > alignof(void*) ? Alignment : alignof(void*));
+        static constexpr size_t batch_size = 64;
+        static constexpr size_t blocks_per_chunk = (64 * 1024 / block_stride) > batch_size ? (64 * 1024 / block_stride) : batch_size;
+
+        static void* allocate()
+        {
+            local_list& local = local_list::instance();
+            if (local.head == nullptr)
+            {
+                shared_list::instance().take_batch(local);
+            }
+
+            free_block* b = local.head;
+            local.head = b->next;
+            local.count--;
+#if FOUNDATION_ALLOCATOR_DEBUG
+            if (!base_impl::is_poisoned(reinterpret_cast<uint8_t*>(b) + sizeof(free_block), block_stride - sizeof(free_block), base_impl::freed_poison))
+            {
+                base_impl::report_allocator_error("fixed_size_pool", "block was written after it was freed.", 1);
+            }
+            shared_list::instance().live_blocks.fetch_add(1, std::memory_order_relaxed);
+#endif
+            base_impl::poison(b, block_stride, base_impl::allocated_poison);
+            return b;
+        }
+
+        static void deallocate(void* data)
+        {
+            if (data == nullptr)
+            {
+                return;
+            }
+
+#if FOUNDATION_ALLOCATOR_DEBUG
+            if (block_stride > sizeof(free_block)
+                && base_impl::is_poisoned(static_cast<uint8_t*>(data) + sizeof(free_block), block_stride - sizeof(free_block), base_impl::freed_poison))
+            {
+                base_impl::report_allocator_error("fixed_size_pool", "block may be freed twice.", 1);
+            }
+            shared_list::instance().live_blocks.fetch_sub(1, std::memory_order_relaxed);
+#endif
+            base_impl::poison(data, block_stride, base_impl::freed_poison);
+
+            local_list& local = local_list::instance();
+            free_block* b = static_cast<free_block*>(data);
+            b->next = local.head;
+            local.head = b;
+            local.count++;
+            if (local.count >= 2 * batch_size)
+            {
+                shared_list::instance().give_batch(local, batch_size);
+            }
+        }
+
+        // chunks taken from the global heap so far.
+        static uint64_t num_chunks() { return shared_list::instance().num_chunks.load(std::memory_order_relaxed); }
+
+    private:
+        struct free_block
+        {
+            free_block* next;
+        };
+
+        struct batch
+        {
+            free_block* head;
+            size_t count;
+        };
+
+        struct local_list
+        {
+            free_block* head = nullptr;
+            size_t count = 0;
+
+            ~local_list()
+            {
+                if (count > 0)
+                {
+                    shared_list::instance().give_batch(*this, count);
+                }
+            }
+
+            static local_list& instance()
+            {
+                thread_local local_list list;
+                return list;
+            }
+        };
+
+        struct shared_list
+        {
+            std::mutex mutex;
+            std::vector<batch> batches;
+            std::vector<void*> chunks;
+            std::atomic<uint64_t> num_chunks = 0;
+            std::atomic<int64_t> live_blocks = 0;
+
+            ~shared_list()
+            {
+#if FOUNDATION_ALLOCATOR_DEBUG
+                if (live_blocks.load() > 0)
+                {
+                    base_impl::report_allocator_error("fixed_size_pool", "blocks are still alive at exit.", static_cast<unsigned long long>(live_blocks.load()));
+                }
+#endif
+                for (void* chunk : chunks)
+                {
+                    ::operator delete(chunk, std::align_val_t(Alignment));
+                }
+            }
+
+            static shared_list& instance()
+            {
+                static shared_list list;
+                return list;
+            }
+
+            void take_batch(local_list& local)
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                if (!batches.empty())
+                {
+                    local.head = batches.back().head;
+                    local.count = batches.back().count;
+                    batches.pop_back();
+                    return;
+                }
+
+                uint8_t* chunk = static_cast<uint8_t*>(::operator new(blocks_per_chunk * block_stride, std::align_val_t(Alignment)));
+                chunks.push_back(chunk);
+                num_chunks.fetch_add(1, std::memory_order_relaxed);
+
+                free_block* head = nullptr;
+                for (size_t index = blocks_per_chunk; index > 0; index--)
+                {
+                    uint8_t* data = chunk + (index - 1) * block_stride;
+                    base_impl::poison(data, block_stride, base_impl::freed_poison);
+                    free_block* b = reinterpret_cast<free_block*>(data);
+                    b->next = head;
+                    head = b;
+                }
+                local.head = head;
+                local.count = blocks_per_chunk;
+            }
+
+            void give_batch(local_list& local, size_t count)
+            {
+                batch given{ local.head, count };
+                free_block* tail = local.head;
+                for (size_t index = 1; index < count; index++)
+                {
+                    tail = tail->next;
+                }
+                local.head = tail->next;
+                local.count -= count;
+                tail->next = nullptr;
+
+                std::lock_guard<std::mutex> guard(mutex);
+                batches.push_back(given);
+            }
+        };
+    };
+
+    /**
+    * std allocator over an arena or a frame allocator, for containers whose lifetime ends before the allocator is reset.
+    */
+    template<typename T, typename Allocator>
+    struct std_allocator_adaptor
+    {
+        using value_type = T;
+
+        std_allocator_adaptor(Allocator& allocator) noexcept : allocator(&allocator) { }
+        template<typename U> std_allocator_adaptor(const std_allocator_adaptor<U, Allocator>& rhs) noexcept : allocator(rhs.allocator) { }
+
+        T* allocate(size_t count) { return static_cast<T*>(allocator->allocate(count * sizeof(T), alignof(T))); }
+        void deallocate(T* data, size_t count) { allocator->deallocate(data, count * sizeof(T)); }
+
+        template<typename U> friend bool operator==(const std_allocator_adaptor& lhs, const std_allocator_adaptor<U, Allocator>& rhs) { return lhs.allocator == rhs.allocator; }
+        template<typename U> friend bool operator!=(const std_allocator_adaptor& lhs, const std_allocator_adaptor<U, Allocator>& rhs) { return lhs.allocator != rhs.allocator; }
+
+        Allocator* allocator;
+    };
+}
@@ -0,0 +1,475 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "Serialization.h"
+
+namespace base
+{
+    /**
+    * lz77 block codec in the spirit of lz4, greedy matching on a 4-byte hash, no entropy coding.
+    * a block is a list of sequences: token (literal length << 4 | match length - 4),
+    * longer lengths continue in bytes of 255, literals, 16-bit match offset.
+    * the last sequence has literals only.
+    */
+    namespace lz
+    {
+        const uint32_t min_match = 4;
+        const uint32_t max_offset = 65535;
+        const uint32_t hash_bits = 12;
+
+        inline uint32_t compress_bound(uint32_t size_in_bytes) { return size_in_bytes + size_in_bytes / 255 + 16; }
+
+        namespace lz_impl
+        {
+            inline uint32_t read32(const uint8_t* p) { uint32_t v; std::memcpy(&v, p, sizeof(v)); return v; }
+            inline uint32_t hash(uint32_t v) { return (v * 2654435761u) >> (32 - hash_bits); }
+
+            inline uint8_t* write_length(uint8_t* op, uint32_t length)
+            {
+                for (; length >= 255; length -= 255)
+                {
+                    *op++ = 255;
+                }
+                *op++ = static_cast<uint8_t>(length);
+                return op;
+            }
+
+            inline bool read_length(const uint8_t*& ip, const uint8_t* iend, uint32_t& length)
+            {
+                uint8_t next = 255;
+                while (next == 255)
+                {
+                    if (ip >= iend)
+                    {
+                        return false;
+                    }
+                    next = *ip++;
+                    length += next;
+                }
+                return true;
+            }
+
+            inline uint8_t* write_sequence(uint8_t* op, const uint8_t* literals, uint32_t num_literals, uint32_t offset, uint32_t match_length)
+            {
+                uint8_t* token = op++;
+                const uint32_t match_code = match_length - min_match;
+                *token = static_cast<uint8_t>(((num_literals < 15 ? num_literals : 15) << 4) | (match_code < 15 ? match_code : 15));
+                if (num_literals >= 15)
+                {
+                    op = write_length(op, num_literals - 15);
+                }
+                std::memcpy(op, literals, num_literals);
+                op += num_literals;
+
+                *op++ = static_cast<uint8_t>(offset);
+                *op++ = static_cast<uint8_t>(offset >> 8);
+                if (match_code >= 15)
+                {
+                    op = write_length(op, match_code - 15);
+                }
+                return op;
+            }
+        }
+
+        // returns the compressed size, dst needs compress_bound(size_in_bytes) bytes.
+        inline uint32_t compress(const uint8_t* src, uint32_t size_in_bytes, uint8_t* dst)
+        {
+            uint32_t table[1 << hash_bits];
+            std::memset(table, 0, sizeof(table));
+
+            const uint8_t* ip = src;
+            const uint8_t* anchor = src;
+            const uint8_t* const iend = src + size_in_bytes;
+            // the tail is always literals, so matching never reads past the end.
+            const uint8_t* const match_limit = size_in_bytes > 12 ? iend - 12 : src;
+            uint8_t* op = dst;
+
+            // position 0 in table means empty, entries are stored with +1.
+            // the step grows with the number of misses in a row, incompressible data is skipped fast.
+            uint32_t num_misses = 0;
+            while (ip < match_limit)
+            {
+                const uint32_t sequence = lz_impl::read32(ip);
+                const uint32_t h = lz_impl::hash(sequence);
+                const uint32_t candidate = table[h];
+                table[h] = static_cast<uint32_t>(ip - src) + 1;
+
+                const uint8_t* ref = candidate > 0 ? src + candidate - 1 : nullptr;
+                if (ref == nullptr || static_cast<uint32_t>(ip - ref) > max_offset || lz_impl::read32(ref) != sequence)
+                {
+                    ip += 1 + (num_misses++ >> 6);
+                    continue;
+                }
+                num_misses = 0;
+
+                uint32_t match_length = min_match;
+                while (ip + match_length < iend - 5 && ref[match_length] == ip[match_length])
+                {
+                    match_length++;
+                }
+
+                op = lz_impl::write_sequence(op, anchor, static_cast<uint32_t>(ip - anchor), static_cast<uint32_t>(ip - ref), match_length);
+                ip += match_length;
+                anchor = ip;
+            }
+
+            const uint32_t num_literals = static_cast<uint32_t>(iend - anchor);
+            *op++ = static_cast<uint8_t>((num_literals < 15 ? num_literals : 15) << 4);
+            if (num_literals >= 15)
+            {
+                op = lz_impl::write_length(op, num_literals - 15);
+            }
+            std::memcpy(op, anchor, num_literals);
+            op += num_literals;
+            return static_cast<uint32_t>(op - dst);
+        }
+
+        // returns false on corrupted input, or when the output is not exactly dst_size bytes.
+        inline bool decompress(const uint8_t* src, uint32_t src_size, uint8_t* dst, uint32_t dst_size)
+        {
+            const uint8_t* ip = src;
+            const uint8_t* const iend = src + src_size;
+            uint8_t* op = dst;
+            uint8_t* const oend = dst + dst_size;
+
+            while (ip < iend)
+            {
+                const uint8_t token = *ip++;
+                uint32_t num_literals = token >> 4;
+                if (num_literals == 15 && !lz_impl::read_length(ip, iend, num_literals))
+                {
+                    return false;
+                }
+                if (num_literals > static_cast<uint32_t>(iend - ip) || num_literals > static_cast<uint32_t>(oend - op))
+                {
+                    return false;
+                }
+                if (num_literals <= 16 && iend - ip >= 16 && oend - op >= 16)
+                {
+                    // most runs are short, a fixed-size copy is cheaper than the exact one.
+                    std::memcpy(op, ip, 16);
+                }
+                else
+                {
+                    std::memcpy(op, ip, num_literals);
+                }
+                ip += num_literals;
+                op += num_literals;
+
+                if (ip == iend)
+                {
+                    break;
+                }
+
+                if (iend - ip < 2)
+                {
+                    return false;
+                }
+                const uint32_t offset = ip[0] | (ip[1] << 8);
+                ip += 2;
+                uint32_t match_length = token & 15;
+                if (match_length == 15 && !lz_impl::read_length(ip, iend, match_length))
+                {
+                    return false;
+                }
+                match_length += min_match;
+                if (offset == 0 || offset > static_cast<uint32_t>(op - dst) || match_length > static_cast<uint32_t>(oend - op))
+                {
+                    return false;
+                }
+
+                const uint8_t* match = op - offset;
+                if (offset >= 16 && static_cast<uint32_t>(oend - op) >= match_length + 15)
+                {
+                    // 16 bytes at a time may write past the match, but not past the output,
+                    // chunks do not overlap their own source as the offset is at least 16.
+                    for (uint32_t copied = 0; copied < match_length; copied += 16)
+                    {
+                        std::memcpy(op + copied, match + copied, 16);
+                    }
+                }
+                else if (offset >= 8)
+                {
+                    uint32_t copied = 0;
+                    for (; copied + 8 <= match_length; copied += 8)
+                    {
+                        std::memcpy(op + copied, match + copied, 8);
+                    }
+                    for (; copied < match_length; copied++)
+                    {
+                        op[copied] = match[copied];
+                    }
+                }
+                else
+                {
+                    for (uint32_t index = 0; index < match_length; index++)
+                    {
+                        op[index] = match[index];
+                    }
+                }
+                op += match_length;
+            }
+            return op == oend;
+        }
+    }
+
+    /**
+    * blocks compressed one by one, then an index of blocks and a footer:
+    *   [block 0] ... [block n-1] [block_entry x n] [compressed_archive_footer]
+    * a block that does not get smaller is stored as it is.
+    * the index makes blocks independent, they can be decompressed in any order and on any thread.
+    */
+    struct compressed_block_entry
+    {
+        uint64_t offset = 0;
+        uint32_t raw_size = 0;
+        uint32_t stored_size = 0;
+    };
+
+    struct compressed_archive_footer
+    {
+        static const uint32_t footer_magic = 0x4B4C425A; // "ZBLK"
+        static const uint32_t footer_version = 1;
+
+        uint64_t index_offset = 0;
+        uint32_t num_blocks = 0;
+        uint32_t block_size = 0;
+        uint32_t version = footer_version;
+        uint32_t magic = footer_magic;
+    };
+
+    /**
+    * compresses everything serialized into it and writes the blocks to target.
+    * finish() writes the index, it is called on destruction if it was not before.
+    */
+    struct compressed_archive_write : public base_archive
+    {
+        static const uint32_t default_block_size = 256 * 1024;
+
+        compressed_archive_write(base_archive& target_archive, uint32_t block_size_in_bytes = default_block_size)
+            : target(target_archive), block_size(block_size_in_bytes)
+        {
+            block.reserve(block_size);
+        }
+        virtual ~compressed_archive_write() { finish(); }
+
+        virtual bool is_at_end() sealed override { return false; }
+        virtual bool is_saving() sealed override { return true; }
+        virtual base_archive& serialize(void* data, uint32_t size_in_bytes) sealed override
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            while (size_in_bytes > 0 && !finished)
+            {
+                const uint32_t length = size_in_bytes < block_size - static_cast<uint32_t>(block.size())
+                    ? size_in_bytes : block_size - static_cast<uint32_t>(block.size());
+                block.insert(block.end(), bytes, bytes + length);
+                bytes += length;
+                size_in_bytes -= length;
+                if (block.size() == block_size)
+                {
+                    flush_block();
+                }
+            }
+            return *this;
+        }
+
+        void finish()
+        {
+            if (finished)
+            {
+                return;
+            }
+            flush_block();
+
+            compressed_archive_footer footer;
+            footer.index_offset = written_size;
+            footer.num_blocks = static_cast<uint32_t>(entries.size());
+            footer.block_size = block_size;
+            if (!entries.empty())
+            {
+                target.serialize(entries.data(), static_cast<uint32_t>(entries.size() * sizeof(compressed_block_entry)));
+            }
+            target << footer;
+            finished = true;
+        }
+
+        uint64_t raw_size() const { return total_raw_size; }
+        uint64_t compressed_size() const { return written_size; }
+
+    private:
+        void flush_block()
+        {
+            if (block.empty())
+            {
+                return;
+            }
+
+            const uint32_t raw_length = static_cast<uint32_t>(block.size());
+            compressed.resize(lz::compress_bound(raw_length));
+            uint32_t stored_length = lz::compress(block.data(), raw_length, compressed.data());
+            const uint8_t* stored = compressed.data();
+            if (stored_length >= raw_length)
+            {
+                stored_length = raw_length;
+                stored = block.data();
+            }
+
+            compressed_block_entry entry;
+            entry.offset = written_size;
+            entry.raw_size = raw_length;
+            entry.stored_size = stored_length;
+            entries.push_back(entry);
+
+            target.serialize(const_cast<uint8_t*>(stored), stored_length);
+            written_size += stored_length;
+            total_raw_size += raw_length;
+            block.clear();
+        }
+
+        base_archive& target;
+        const uint32_t block_size;
+        std::vector<uint8_t> block;
+        std::vector<uint8_t> compressed;
+        std::vector<compressed_block_entry> entries;
+        uint64_t written_size = 0;
+        uint64_t total_raw_size = 0;
+        bool finished = false;
+    };
+
+    /**
+    * reads a compressed archive from memory, usually a mapped file.
+    * serialize() decompresses block after block, decompress_block() is const and can run on several threads.
+    */
+    struct compressed_archive_read : public base_archive
+    {
+        compressed_archive_read(const uint8_t* data, uint64_t size_in_bytes) : source(data)
+        {
+            if (size_in_bytes < sizeof(footer))
+            {
+                return;
+            }
+            std::memcpy(&footer, data + size_in_bytes - sizeof(footer), sizeof(footer));
+
+            // checks are written as subtractions of known-good sizes, sums from the file may wrap.
+            const uint64_t index_size = static_cast<uint64_t>(footer.num_blocks) * sizeof(compressed_block_entry);
+            if (footer.magic != compressed_archive_footer::footer_magic
+                || footer.version != compressed_archive_footer::footer_version
+                || index_size > size_in_bytes - sizeof(footer)
+                || footer.index_offset != size_in_bytes - sizeof(footer) - index_size)
+            {
+                return;
+            }
+
+            entries.resize(footer.num_blocks);
+            if (index_size > 0)
+            {
+                std::memcpy(entries.data(), data + footer.index_offset, static_cast<size_t>(index_size));
+            }
+
+            for (const compressed_block_entry& entry : entries)
+            {
+                if (entry.offset > footer.index_offset
+                    || entry.stored_size > footer.index_offset - entry.offset
+                    || entry.stored_size > entry.raw_size
+                    || entry.raw_size > footer.block_size)
+                {
+                    entries.clear();
+                    return;
+                }
+                total_raw_size += entry.raw_size;
+            }
+            valid = true;
+        }
+
+        virtual bool is_at_end() sealed override { return current_block >= num_blocks() && block_offset >= block.size(); }
+        virtual bool is_saving() sealed override { return false; }
+        virtual base_archive& serialize(void* data, uint32_t size_in_bytes) sealed override
+        {
+            uint8_t* bytes = static_cast<uint8_t*>(data);
+            while (size_in_bytes > 0)
+            {
+                if (block_offset >= block.size())
+                {
+                    if (current_block >= num_blocks() || !load_block(current_block))
+                    {
+                        // reading past the end or a corrupt block, the rest of the output is zeroed.
+                        std::memset(bytes, 0, size_in_bytes);
+                        set_error();
+                        break;
+                    }
+                    current_block++;
+                }
+
+                const uint32_t available = static_cast<uint32_t>(block.size() - block_offset);
+                const uint32_t length = size_in_bytes < available ? size_in_bytes : available;
+                std::memcpy(bytes, block.data() + block_offset, length);
+                block_offset += length;
+                bytes += length;
+                size_in_bytes -= length;
+            }
+            return *this;
+        }
+
+        bool is_valid() const { return valid; }
+        uint32_t num_blocks() const { return static_cast<uint32_t>(entries.size()); }
+        uint32_t block_size() const { return footer.block_size; }
+        uint64_t raw_size() const { return total_raw_size; }
+        uint32_t block_raw_size(uint32_t index) const { return entries[index].raw_size; }
+
+        // output of block i starts at i * block_size(), every block but the last is full.
+        bool decompress_block(uint32_t index, uint8_t* out) const
+        {
+            if (index >= num_blocks())
+            {
+                return false;
+            }
+
+            const compressed_block_entry& entry = entries[index];
+            const uint8_t* stored = source + entry.offset;
+            if (entry.stored_size == entry.raw_size)
+            {
+                std::memcpy(out, stored, entry.raw_size);
+                return true;
+            }
+            return lz::decompress(stored, entry.stored_size, out, entry.raw_size);
+        }
+
+        // the next serialize() reads from the start of block i.
+        bool seek_block(uint32_t index)
+        {
+            if (index > num_blocks())
+            {
+                return false;
+            }
+            current_block = index;
+            block.clear();
+            block_offset = 0;
+            return true;
+        }
+
+    private:
+        bool load_block(uint32_t index)
+        {
+            block.resize(entries[index].raw_size);
+            block_offset = 0;
+            if (!decompress_block(index, block.data()))
+            {
+                block.clear();
+                return false;
+            }
+            return true;
+        }
+
+        const uint8_t* source = nullptr;
+        compressed_archive_footer footer;
+        std::vector<compressed_block_entry> entries;
+        uint64_t total_raw_size = 0;
+        bool valid = false;
+
+        std::vector<uint8_t> block;
+        size_t block_offset = 0;
+        uint32_t current_block = 0;
+    };
+}
@@ -0,0 +1,399 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace base
+{
+    /**
+    * vector with room for N elements inside the object, it only goes to the heap when it grows beyond that.
+    * api follows std::vector, iterators are plain pointers and are invalidated the same way.
+    * moving an inline small_vector moves its elements one by one.
+    */
+    template<typename T, size_t N>
+    struct small_vector
+    {
+        static_assert(N > 0, "use std::vector without inline storage.");
+
+        using value_type = T;
+        using size_type = size_t;
+        using difference_type = ptrdiff_t;
+        using reference = T&;
+        using const_reference = const T&;
+        using pointer = T*;
+        using const_pointer = const T*;
+        using iterator = T*;
+        using const_iterator = const T*;
+
+        small_vector() = default;
+        small_vector(size_t count, const T& value) { resize(count, value); }
+        explicit small_vector(size_t count) { resize(count); }
+        small_vector(std::initializer_list<T> values) { assign(values.begin(), values.end()); }
+        small_vector(const small_vector& rhs) { assign(rhs.begin(), rhs.end()); }
+        small_vector(small_vector&& rhs) noexcept(std::is_nothrow_move_constructible_v<T>) { steal(rhs); }
+        ~small_vector() { release(); }
+
+        small_vector& operator=(const small_vector& rhs)
+        {
+            if (this != &rhs)
+            {
+                assign(rhs.begin(), rhs.end());
+            }
+            return *this;
+        }
+
+        small_vector& operator=(small_vector&& rhs) noexcept(std::is_nothrow_move_constructible_v<T>)
+        {
+            if (this != &rhs)
+            {
+                release();
+                steal(rhs);
+            }
+            return *this;
+        }
+
+        small_vector& operator=(std::initializer_list<T> values)
+        {
+            assign(values.begin(), values.end());
+            return *this;
+        }
+
+        template<typename InputIterator>
+        void assign(InputIterator first, InputIterator last)
+        {
+            clear();
+            for (; first != last; ++first)
+            {
+                emplace_back(*first);
+            }
+        }
+
+        iterator begin() { return elements; }
+        iterator end() { return elements + length; }
+        const_iterator begin() const { return elements; }
+        const_iterator end() const { return elements + length; }
+        const_iterator cbegin() const { return elements; }
+        const_iterator cend() const { return elements + length; }
+
+        size_t size() const { return length; }
+        size_t capacity() const { return room; }
+        bool empty() const { return length == 0; }
+        T* data() { return elements; }
+        const T* data() const { return elements; }
+        static constexpr size_t inline_capacity() { return N; }
+        bool is_inline() const { return elements == inline_elements(); }
+
+        T& operator[](size_t index) { return elements[index]; }
+        const T& operator[](size_t index) const { return elements[index]; }
+        T& front() { return elements[0]; }
+        const T& front() const { return elements[0]; }
+        T& back() { return elements[length - 1]; }
+        const T& back() const { return elements[length - 1]; }
+
+        void reserve(size_t new_capacity)
+        {
+            if (new_capacity > room)
+            {
+                reallocate(new_capacity);
+            }
+        }
+
+        void resize(size_t count)
+        {
+            shrink_to(count);
+            reserve(count);
+            for (; length < count; length++)
+            {
+                new (elements + length) T();
+            }
+        }
+
+        void resize(size_t count, const T& value)
+        {
+            shrink_to(count);
+            if (count > length)
+            {
+                // value may live in this vector.
+                const T copy(value);
+                reserve(count);
+                for (; length < count; length++)
+                {
+                    new (elements + length) T(copy);
+                }
+            }
+        }
+
+        void clear() { shrink_to(0); }
+
+        template<typename... Args>
+        T& emplace_back(Args&&... args)
+        {
+            if (length == room)
+            {
+                // the new element is constructed first, args may refer to an element being moved.
+                const size_t new_capacity = room * 2 > length + 1 ? room * 2 : length + 1;
+                T* new_elements = allocate(new_capacity);
+                new (new_elements + length) T(std::forward<Args>(args)...);
+                relocate(new_elements, new_capacity);
+            }
+            else
+            {
+                new (elements + length) T(std::forward<Args>(args)...);
+            }
+            return elements[length++];
+        }
+
+        void push_back(const T& value) { emplace_back(value); }
+        void push_back(T&& value) { emplace_back(std::move(value)); }
+
+        void pop_back()
+        {
+            elements[--length].~T();
+        }
+
+        template<typename... Args>
+        iterator emplace(const_iterator position, Args&&... args)
+        {
+            const size_t index = position - elements;
+            emplace_back(std::forward<Args>(args)...);
+            std::rotate(elements + index, elements + length - 1, elements + length);
+            return elements + index;
+        }
+
+        iterator insert(const_iterator position, const T& value) { return emplace(position, value); }
+        iterator insert(const_iterator position, T&& value) { return emplace(position, std::move(value)); }
+
+        iterator erase(const_iterator position) { return erase(position, position + 1); }
+        iterator erase(const_iterator first, const_iterator last)
+        {
+            T* target = elements + (first - elements);
+            if (first != last)
+            {
+                T* new_end = std::move(elements + (last - elements), end(), target);
+                shrink_to(new_end - elements);
+            }
+            return target;
+        }
+
+        void swap(small_vector& rhs)
+        {
+            // only the buffers change hands when both are on the heap.
+            if (!is_inline() && !rhs.is_inline())
+            {
+                std::swap(elements, rhs.elements);
+                std::swap(length, rhs.length);
+                std::swap(room, rhs.room);
+                return;
+            }
+
+            small_vector temp(std::move(rhs));
+            rhs = std::move(*this);
+            *this = std::move(temp);
+        }
+
+        friend bool operator==(const small_vector& lhs, const small_vector& rhs) { return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin()); }
+        friend bool operator!=(const small_vector& lhs, const small_vector& rhs) { return !(lhs == rhs); }
+
+    private:
+        T* inline_elements() { return reinterpret_cast<T*>(storage); }
+        const T* inline_elements() const { return reinterpret_cast<const T*>(storage); }
+
+        static T* allocate(size_t count) { return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(alignof(T)))); }
+        static void deallocate(T* data) { ::operator delete(data, std::align_val_t(alignof(T))); }
+
+        void shrink_to(size_t count)
+        {
+            for (; length > count; length--)
+            {
+                elements[length - 1].~T();
+            }
+        }
+
+        // moves the elements into new_elements and takes it as storage.
+        void relocate(T* new_elements, size_t new_capacity)
+        {
+            std::uninitialized_move(elements, elements + length, new_elements);
+            std::destroy(elements, elements + length);
+            if (!is_inline())
+            {
+                deallocate(elements);
+            }
+            elements = new_elements;
+            room = new_capacity;
+        }
+
+        void reallocate(size_t new_capacity)
+        {
+            relocate(allocate(new_capacity), new_capacity);
+        }
+
+        void release()
+        {
+            clear();
+            if (!is_inline())
+            {
+                deallocate(elements);
+            }
+            elements = inline_elements();
+            room = N;
+        }
+
+        void steal(small_vector& rhs)
+        {
+            if (rhs.is_inline())
+            {
+                std::uninitialized_move(rhs.begin(), rhs.end(), elements);
+                length = rhs.length;
+                rhs.clear();
+            }
+            else
+            {
+                elements = rhs.elements;
+                length = rhs.length;
+                room = rhs.room;
+                rhs.elements = rhs.inline_elements();
+                rhs.length = 0;
+                rhs.room = N;
+            }
+        }
+
+        alignas(T) unsigned char storage[N * sizeof(T)];
+        T* elements = inline_elements();
+        size_t length = 0;
+        size_t room = N;
+    };
+
+    /**
+    * map kept as a sorted array of pairs, lookups are binary searches over contiguous memory.
+    * insertion and erasure move the elements behind, it suits small maps that are read much more than written.
+    * keys must not be changed through iterators, any insertion or erasure invalidates them.
+    */
+    template<typename Key, typename Value, typename Compare = std::less<Key>, typename Container = std::vector<std::pair<Key, Value>>>
+    struct flat_map
+    {
+        using key_type = Key;
+        using mapped_type = Value;
+        using value_type = std::pair<Key, Value>;
+        using container_type = Container;
+        using iterator = typename Container::iterator;
+        using const_iterator = typename Container::const_iterator;
+
+        flat_map() = default;
+        flat_map(std::initializer_list<value_type> values)
+        {
+            for (const value_type& value : values)
+            {
+                insert(value);
+            }
+        }
+
+        iterator begin() { return pairs.begin(); }
+        iterator end() { return pairs.end(); }
+        const_iterator begin() const { return pairs.begin(); }
+        const_iterator end() const { return pairs.end(); }
+
+        size_t size() const { return pairs.size(); }
+        bool empty() const { return pairs.empty(); }
+        void clear() { pairs.clear(); }
+        void reserve(size_t count) { pairs.reserve(count); }
+        const Container& values() const { return pairs; }
+
+        iterator lower_bound(const Key& key)
+        {
+            return std::lower_bound(pairs.begin(), pairs.end(), key, [this](const value_type& pair, const Key& k) { return compare(pair.first, k); });
+        }
+
+        const_iterator lower_bound(const Key& key) const
+        {
+            return std::lower_bound(pairs.begin(), pairs.end(), key, [this](const value_type& pair, const Key& k) { return compare(pair.first, k); });
+        }
+
+        iterator find(const Key& key)
+        {
+            iterator it = lower_bound(key);
+            return (it != pairs.end() && !compare(key, it->first)) ? it : pairs.end();
+        }
+
+        const_iterator find(const Key& key) const
+        {
+            const_iterator it = lower_bound(key);
+            return (it != pairs.end() && !compare(key, it->first)) ? it : pairs.end();
+        }
+
+        bool contains(const Key& key) const { return find(key) != end(); }
+        size_t count(const Key& key) const { return contains(key) ? 1 : 0; }
+
+        // the same as std::map::at(), a missing key throws instead of reading past the end.
+        Value& at(const Key& key)
+        {
+            iterator it = find(key);
+            if (it == pairs.end())
+            {
+                throw std::out_of_range("flat_map::at: key not found");
+            }
+            return it->second;
+        }
+
+        const Value& at(const Key& key) const
+        {
+            const_iterator it = find(key);
+            if (it == pairs.end())
+            {
+                throw std::out_of_range("flat_map::at: key not found");
+            }
+            return it->second;
+        }
+
+        template<typename... Args>
+        std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args)
+        {
+            iterator it = lower_bound(key);
+            if (it != pairs.end() && !compare(key, it->first))
+            {
+                return { it, false };
+            }
+            it = pairs.emplace(it, std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+            return { it, true };
+        }
+
+        std::pair<iterator, bool> insert(const value_type& value) { return try_emplace(value.first, value.second); }
+
+        template<typename V>
+        std::pair<iterator, bool> insert_or_assign(const Key& key, V&& value)
+        {
+            std::pair<iterator, bool> result = try_emplace(key, std::forward<V>(value));
+            if (!result.second)
+            {
+                result.first->second = std::forward<V>(value);
+            }
+            return result;
+        }
+
+        Value& operator[](const Key& key) { return try_emplace(key).first->second; }
+
+        iterator erase(const_iterator position) { return pairs.erase(position); }
+        size_t erase(const Key& key)
+        {
+            iterator it = find(key);
+            if (it == pairs.end())
+            {
+                return 0;
+            }
+            pairs.erase(it);
+            return 1;
+        }
+
+    private:
+        Container pairs;
+        Compare compare;
+    };
+}
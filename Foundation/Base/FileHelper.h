@@ -36,7 +36,14 @@ namespace base
     {
 
         virtual bool is_saving() sealed override { return false; }
-        virtual base_archive& serialize(void* data, uint32_t size_in_bytes) override { fread(data, 1, size_in_bytes, file); return *this; }
+        virtual base_archive& serialize(void* data, uint32_t size_in_bytes) override
+        {
+            if (fread(data, 1, size_in_bytes, file) != size_in_bytes)
+            {
+                set_error();
+            }
+            return *this;
+        }
         virtual void destroy() sealed override { delete this; }
         friend file_archive* create_archive_file_read(const std::string& path);
 
@@ -51,6 +58,10 @@ namespace base
         {
             size_t written_size_in_bytes = fwrite(data, 1, size_in_bytes, file);
             file_size += static_cast<uint32_t>(written_size_in_bytes);
+            if (written_size_in_bytes != size_in_bytes)
+            {
+                set_error();
+            }
             return *this;
         }
         virtual void destroy() sealed override { delete this; }
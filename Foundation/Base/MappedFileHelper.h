@@ -0,0 +1,237 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Serialization.h"
+
+namespace base
+{
+    template<typename T>
+    struct array_view
+    {
+        const T* data = nullptr;
+        uint64_t count = 0;
+
+        const T* begin() const { return data; }
+        const T* end() const { return data + count; }
+        const T& operator[](uint64_t index) const { return data[index]; }
+        bool empty() const { return count == 0; }
+    };
+
+    enum class access_hint { normal, sequential, random };
+
+    /**
+    * read-only archive over a memory-mapped file, offsets and sizes are 64-bit.
+    * serialize() copies like the other archives, view_array() returns pointers into the mapping,
+    * so only the pages that are touched are read from disk.
+    * views stay valid until the archive is destroyed.
+    */
+    struct mapped_file_archive_read : public base_archive
+    {
+        virtual ~mapped_file_archive_read() { unmap(); }
+        virtual bool is_at_end() sealed override { return offset >= file_size; }
+        virtual bool is_saving() sealed override { return false; }
+        virtual base_archive& serialize(void* data, uint32_t size_in_bytes) sealed override
+        {
+            const uint64_t length = size_in_bytes > remaining() ? remaining() : size_in_bytes;
+            if (length < size_in_bytes)
+            {
+                set_error();
+            }
+            if (length > 0)
+            {
+                std::memcpy(data, mapping + offset, static_cast<size_t>(length));
+                offset += length;
+            }
+            return *this;
+        }
+        void destroy() { delete this; }
+
+        uint64_t size() const { return file_size; }
+        uint64_t tell() const { return offset; }
+        uint64_t remaining() const { return file_size - offset; }
+        const uint8_t* data() const { return mapping; }
+        bool seek(uint64_t position)
+        {
+            if (position > file_size)
+            {
+                return false;
+            }
+            offset = position;
+            return true;
+        }
+
+        // count elements at the current offset, fails without moving when out of range or not aligned for T.
+        template<typename T, std::enable_if_t<std::is_trivially_copyable_v<T>, bool> = true>
+        bool view_array(uint64_t count, array_view<T>& out_view)
+        {
+            if (count > remaining() / sizeof(T) || (reinterpret_cast<uintptr_t>(mapping + offset) % alignof(T)) != 0)
+            {
+                return false;
+            }
+
+            out_view.data = reinterpret_cast<const T*>(mapping + offset);
+            out_view.count = count;
+            offset += count * sizeof(T);
+            return true;
+        }
+
+        // the layout written by operator<< of std::vector<T>, a uint32_t length and the elements.
+        template<typename T, std::enable_if_t<std::is_trivially_copyable_v<T>, bool> = true>
+        bool view_vector(array_view<T>& out_view)
+        {
+            const uint64_t start = offset;
+            uint32_t length = 0;
+            if (remaining() < sizeof(length))
+            {
+                return false;
+            }
+
+            *this << length;
+            if (!view_array(length, out_view))
+            {
+                offset = start;
+                return false;
+            }
+            return true;
+        }
+
+        // asks the os to start reading the range in background.
+        void prefetch(uint64_t position, uint64_t size_in_bytes) const
+        {
+            if (position >= file_size || size_in_bytes == 0)
+            {
+                return;
+            }
+            size_in_bytes = size_in_bytes > file_size - position ? file_size - position : size_in_bytes;
+
+#if defined(_WIN32)
+            WIN32_MEMORY_RANGE_ENTRY range;
+            range.VirtualAddress = mapping + position;
+            range.NumberOfBytes = static_cast<SIZE_T>(size_in_bytes);
+            PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+            const uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+            const uint64_t page_start = position - position % page_size;
+            madvise(mapping + page_start, static_cast<size_t>(size_in_bytes + position - page_start), MADV_WILLNEED);
+#endif
+        }
+
+        // read-ahead policy of the whole mapping, windows has no equivalent and ignores it.
+        void set_access_hint(access_hint hint) const
+        {
+#if !defined(_WIN32)
+            if (mapping != nullptr)
+            {
+                const int advice = hint == access_hint::sequential ? MADV_SEQUENTIAL
+                    : hint == access_hint::random ? MADV_RANDOM : MADV_NORMAL;
+                madvise(mapping, static_cast<size_t>(file_size), advice);
+            }
+#else
+            (void)hint;
+#endif
+        }
+
+        friend mapped_file_archive_read* create_archive_mapped_file_read(const std::string& path);
+
+    protected:
+        mapped_file_archive_read() = default;
+
+        bool map(const std::string& path)
+        {
+#if defined(_WIN32)
+            file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            LARGE_INTEGER length;
+            if (file_handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_handle, &length))
+            {
+                return false;
+            }
+
+            file_size = static_cast<uint64_t>(length.QuadPart);
+            if (file_size == 0)
+            {
+                return true;
+            }
+
+            mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping_handle == nullptr)
+            {
+                return false;
+            }
+            mapping = static_cast<uint8_t*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+            return mapping != nullptr;
+#else
+            file_descriptor = open(path.c_str(), O_RDONLY);
+            struct stat status;
+            if (file_descriptor < 0 || fstat(file_descriptor, &status) != 0)
+            {
+                return false;
+            }
+
+            file_size = static_cast<uint64_t>(status.st_size);
+            if (file_size == 0)
+            {
+                return true;
+            }
+
+            void* address = mmap(nullptr, static_cast<size_t>(file_size), PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+            mapping = address != MAP_FAILED ? static_cast<uint8_t*>(address) : nullptr;
+            return mapping != nullptr;
+#endif
+        }
+
+        void unmap()
+        {
+#if defined(_WIN32)
+            if (mapping != nullptr) UnmapViewOfFile(mapping);
+            if (mapping_handle != nullptr) CloseHandle(mapping_handle);
+            if (file_handle != INVALID_HANDLE_VALUE) CloseHandle(file_handle);
+            mapping_handle = nullptr;
+            file_handle = INVALID_HANDLE_VALUE;
+#else
+            if (mapping != nullptr) munmap(mapping, static_cast<size_t>(file_size));
+            if (file_descriptor >= 0) close(file_descriptor);
+            file_descriptor = -1;
+#endif
+            mapping = nullptr;
+        }
+
+        uint8_t* mapping = nullptr;
+        uint64_t file_size = 0;
+        uint64_t offset = 0;
+#if defined(_WIN32)
+        HANDLE file_handle = INVALID_HANDLE_VALUE;
+        HANDLE mapping_handle = nullptr;
+#else
+        int file_descriptor = -1;
+#endif
+
+    private:
+        mapped_file_archive_read(mapped_file_archive_read& rhs) = delete;
+        mapped_file_archive_read(mapped_file_archive_read&& rhs) = delete;
+    };
+
+    inline mapped_file_archive_read* create_archive_mapped_file_read(const std::string& path)
+    {
+        mapped_file_archive_read* archive = new mapped_file_archive_read();
+        if (!archive->map(path))
+        {
+            archive->destroy();
+            return nullptr;
+        }
+        return archive;
+    }
+}
@@ -78,9 +78,10 @@ namespace base
         virtual bool is_saving() sealed override { return false; }
         virtual base_archive& serialize(void* data, uint32_t size_in_bytes) sealed override
         {
-            if (offset + size_in_bytes > size)
+            if (static_cast<uint64_t>(offset) + size_in_bytes > size)
             {
                 size_in_bytes = size - offset;
+                set_error();
             }
 
             if (size_in_bytes > 0)
@@ -104,17 +105,34 @@ namespace base
         }
     };
 
+    /**
+    * an archive that owns its buffer grows it geometrically when it is full,
+    * one over an external buffer can not, the data past the end is dropped.
+    */
     struct memory_archive_write : public memory_archive
     {
         memory_archive_write(uint32_t size_in_bytes) : memory_archive(size_in_bytes) { }
         memory_archive_write(uint8_t* external_buffer, uint32_t size_in_bytes) : memory_archive(external_buffer, size_in_bytes) { }
 
+        uint32_t written_size() const { return offset; }
+        const uint8_t* data() const { return buffer; }
+
         virtual bool is_saving() sealed override { return true; }
         virtual base_archive& serialize(void* data, uint32_t size_in_bytes) sealed override
         {
-            if (offset + size_in_bytes > size)
+            const uint64_t required_size = static_cast<uint64_t>(offset) + size_in_bytes;
+            if (required_size > size)
             {
-                size_in_bytes = size - offset;
+                if (release_buffer)
+                {
+                    grow_to(required_size);
+                }
+                if (required_size > size)
+                {
+                    // past UINT32_MAX or the end of an external buffer, the rest is dropped.
+                    size_in_bytes = size - offset;
+                    set_error();
+                }
             }
 
             if (size_in_bytes > 0)
@@ -124,6 +142,23 @@ namespace base
             }
             return *this;
         }
+
+    private:
+        // the tail is zeroed, on_serialize() writes the whole buffer.
+        void grow_to(uint64_t required_size)
+        {
+            const uint64_t max_size = UINT32_MAX;
+            uint64_t new_size = size > 0 ? static_cast<uint64_t>(size) * 2 : 256;
+            new_size = new_size < required_size ? required_size : new_size;
+            new_size = new_size > max_size ? max_size : new_size;
+
+            uint8_t* new_buffer = new uint8_t[new_size];
+            std::memcpy(new_buffer, buffer, offset);
+            std::memset(new_buffer + offset, 0, static_cast<size_t>(new_size - offset));
+            safe_delete_array(buffer);
+            buffer = new_buffer;
+            size = static_cast<uint32_t>(new_size);
+        }
     };
 
     template<uint32_t N>
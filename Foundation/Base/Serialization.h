@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <type_traits>
 #include <vector>
 #include <string>
@@ -6,6 +7,13 @@
 
 namespace base
 {
+    namespace base_impl
+    {
+        // elements that can be copied as one block, vector<bool> is packed and has no data().
+        template<typename T>
+        constexpr bool is_bulk_serializable_v = std::is_trivially_copyable_v<T> && !std::is_same_v<T, bool>;
+    }
+
     struct base_archive
     {
         virtual ~base_archive() = default;
@@ -13,8 +21,45 @@ namespace base
         virtual bool is_saving() = 0;
         virtual bool is_loading() { return !is_saving(); }
         virtual base_archive& serialize(void* data, uint32_t size_in_bytes) = 0;
+
+        // set once a size did not fit 32 bits or bytes could not be written or read.
+        bool has_error() const { return failed; }
+        void set_error() { failed = true; }
+
+    protected:
+        bool failed = false;
     };
 
+    namespace base_impl
+    {
+        // byte size of length elements, computed in 64 bits, the archive fails when it exceeds serialize().
+        inline bool checked_size_in_bytes(base_archive& archive, uint64_t length, uint64_t element_size, uint32_t& size_in_bytes)
+        {
+            const uint64_t total_size = length * element_size;
+            if ((element_size != 0 && total_size / element_size != length) || total_size > UINT32_MAX)
+            {
+                archive.set_error();
+                size_in_bytes = 0;
+                return false;
+            }
+            size_in_bytes = static_cast<uint32_t>(total_size);
+            return true;
+        }
+
+        // element count written before a container, the archive fails when it exceeds 32 bits.
+        inline bool checked_length(base_archive& archive, size_t length, uint32_t& out_length)
+        {
+            if (static_cast<uint64_t>(length) > UINT32_MAX)
+            {
+                archive.set_error();
+                out_length = 0;
+                return false;
+            }
+            out_length = static_cast<uint32_t>(length);
+            return true;
+        }
+    }
+
     struct base_serializable_object
     {
         virtual ~base_serializable_object() = default;
@@ -43,7 +88,11 @@ namespace base
             array_length = array_length > N ? N : array_length;
         }
 
-        archive.serialize(arr, sizeof(T) * array_length);
+        uint32_t size_in_bytes;
+        if (base_impl::checked_size_in_bytes(archive, array_length, sizeof(T), size_in_bytes))
+        {
+            archive.serialize(arr, size_in_bytes);
+        }
         return archive;
     }
 
@@ -67,16 +116,20 @@ namespace base
 
     inline base_archive& operator<<(base_archive& archive, std::string& str)
     {
-        uint32_t str_length = static_cast<uint32_t>(str.size());
+        uint32_t str_length;
+        if (!base_impl::checked_length(archive, str.size(), str_length))
+        {
+            return archive;
+        }
         archive << str_length;
         if (archive.is_loading())
         {
             str.resize(str_length);
         }
 
-        for (uint32_t index = 0; index < str_length; index++)
+        if (str_length > 0)
         {
-            archive << str[index];
+            archive.serialize(&str[0], str_length);
         }
         return archive;
     }
@@ -84,16 +137,40 @@ namespace base
     template<typename T>
     inline base_archive& operator<< (base_archive& archive, std::vector<T>& arr)
     {
-        uint32_t array_length = static_cast<uint32_t>(arr.size());
-        archive << array_length;
-        if(archive.is_loading())
+        uint32_t array_length;
+        if (!base_impl::checked_length(archive, arr.size(), array_length))
         {
-            arr.resize(array_length);
+            return archive;
         }
+        archive << array_length;
 
-        for (uint32_t index = 0; index < array_length; index++)
+        if constexpr (base_impl::is_bulk_serializable_v<T>)
         {
-            archive << arr[index];
+            // checked before resize, a length read from a file must not allocate more than one serialize() can fill.
+            uint32_t size_in_bytes;
+            if (!base_impl::checked_size_in_bytes(archive, array_length, sizeof(T), size_in_bytes))
+            {
+                return archive;
+            }
+            if (archive.is_loading())
+            {
+                arr.resize(array_length);
+            }
+            if (size_in_bytes > 0)
+            {
+                archive.serialize(arr.data(), size_in_bytes);
+            }
+        }
+        else
+        {
+            if (archive.is_loading())
+            {
+                arr.resize(array_length);
+            }
+            for (uint32_t index = 0; index < array_length; index++)
+            {
+                archive << arr[index];
+            }
         }
 
         return archive;
@@ -102,7 +179,11 @@ namespace base
     template<typename K, typename V>
     inline base_archive& operator<< (base_archive& archive, std::map<K, V>& m)
     {
-        uint32_t length = static_cast<uint32_t>(m.size());
+        uint32_t length;
+        if (!base_impl::checked_length(archive, m.size(), length))
+        {
+            return archive;
+        }
         archive << length;
 
         if (archive.is_saving())
@@ -13,7 +13,11 @@ int MathLibraryDummy()
 
 #include "Serialization.h"
 #include "FileHelper.h"
+#include "MappedFileHelper.h"
+#include "CompressionHelper.h"
 #include "MemoryHelper.h"
+#include "AllocatorHelper.h"
+#include "ContainerHelper.h"
 
 
 struct TrivialA
@@ -0,0 +1,468 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Vector.h"
+#include "Matrix.h"
+#include "Geometry.h"
+
+/**
+* structure-of-arrays batches, for throughput work on many elements at once,
+* like transforming all vertices of a mesh, or testing a bundle of rays against one shape.
+* a packet holds N lanes, the per-lane loops have no branches so the compiler can vectorize them,
+* float packets of 4 lanes get explicit sse code when MATH_ENABLE_SIMD is on.
+* streams are arrays of packets, the lanes after the last element are padding.
+*/
+namespace math
+{
+    template<typename value_type, size_t N>
+    struct alignas(sizeof(value_type) * N) scalar_soa
+    {
+        static constexpr size_t width = N;
+        static_assert((N & (N - 1)) == 0, "lane count should be power of two.");
+        value_type v[N];
+
+        static scalar_soa broadcast(value_type s)
+        {
+            scalar_soa rst;
+            for (size_t i = 0; i < N; i++) { rst.v[i] = s; }
+            return rst;
+        }
+    };
+
+    template<typename value_type, size_t N>
+    struct alignas(sizeof(value_type) * N) vector3_soa
+    {
+        static constexpr size_t width = N;
+        static_assert((N & (N - 1)) == 0, "lane count should be power of two.");
+        value_type x[N];
+        value_type y[N];
+        value_type z[N];
+
+        vector_t<value_type, EDim::_3> get(size_t lane) const { return vector_t<value_type, EDim::_3>(x[lane], y[lane], z[lane]); }
+        void set(size_t lane, const vector_t<value_type, EDim::_3>& v) { x[lane] = v.x; y[lane] = v.y; z[lane] = v.z; }
+
+        static vector3_soa broadcast(const vector_t<value_type, EDim::_3>& v)
+        {
+            vector3_soa rst;
+            for (size_t i = 0; i < N; i++) { rst.set(i, v); }
+            return rst;
+        }
+    };
+
+    template<typename value_type, size_t N>
+    struct ray3_soa
+    {
+        static constexpr size_t width = N;
+        vector3_soa<value_type, N> origin;
+        vector3_soa<value_type, N> direction;
+        vector3_soa<value_type, N> inv_direction;
+
+        void set(size_t lane, const vector_t<value_type, EDim::_3>& o, const vector_t<value_type, EDim::_3>& d)
+        {
+            origin.set(lane, o);
+            direction.set(lane, d);
+            inv_direction.set(lane, vector_t<value_type, EDim::_3>(value_type(1) / d.x, value_type(1) / d.y, value_type(1) / d.z));
+        }
+
+        void set(size_t lane, const ray<value_type, EDim::_3>& r)
+        {
+            set(lane, r.origin(), r.direction());
+        }
+    };
+
+    template<typename value_type> using scalar4_soa = scalar_soa<value_type, 4>;
+    template<typename value_type> using vector3x4_soa = vector3_soa<value_type, 4>;
+    template<typename value_type> using ray3x4_soa = ray3_soa<value_type, 4>;
+
+    using float3x4_soa = vector3x4_soa<float>;
+    using double3x4_soa = vector3x4_soa<double>;
+
+    // packet operations
+
+    // point, w = 1.
+    template<typename value_type, size_t N>
+    inline vector3_soa<value_type, N> transform_point(const matrix_t<value_type, EDim::_4, EDim::_4>& m, const vector3_soa<value_type, N>& p)
+    {
+        vector3_soa<value_type, N> rst;
+        for (size_t i = 0; i < N; i++)
+        {
+            rst.x[i] = m._00 * p.x[i] + m._01 * p.y[i] + m._02 * p.z[i] + m._03;
+            rst.y[i] = m._10 * p.x[i] + m._11 * p.y[i] + m._12 * p.z[i] + m._13;
+            rst.z[i] = m._20 * p.x[i] + m._21 * p.y[i] + m._22 * p.z[i] + m._23;
+        }
+        return rst;
+    }
+
+    // direction, w = 0, normals should pass the inverse transposed matrix.
+    template<typename value_type, size_t N>
+    inline vector3_soa<value_type, N> transform_vector(const matrix_t<value_type, EDim::_3, EDim::_3>& m, const vector3_soa<value_type, N>& v)
+    {
+        vector3_soa<value_type, N> rst;
+        for (size_t i = 0; i < N; i++)
+        {
+            rst.x[i] = m._00 * v.x[i] + m._01 * v.y[i] + m._02 * v.z[i];
+            rst.y[i] = m._10 * v.x[i] + m._11 * v.y[i] + m._12 * v.z[i];
+            rst.z[i] = m._20 * v.x[i] + m._21 * v.y[i] + m._22 * v.z[i];
+        }
+        return rst;
+    }
+
+    template<typename value_type, size_t N>
+    inline scalar_soa<value_type, N> dot(const vector3_soa<value_type, N>& l, const vector3_soa<value_type, N>& r)
+    {
+        scalar_soa<value_type, N> rst;
+        for (size_t i = 0; i < N; i++)
+        {
+            rst.v[i] = l.x[i] * r.x[i] + l.y[i] * r.y[i] + l.z[i] * r.z[i];
+        }
+        return rst;
+    }
+
+    template<typename value_type, size_t N>
+    inline vector3_soa<value_type, N> cross(const vector3_soa<value_type, N>& l, const vector3_soa<value_type, N>& r)
+    {
+        vector3_soa<value_type, N> rst;
+        for (size_t i = 0; i < N; i++)
+        {
+            rst.x[i] = l.y[i] * r.z[i] - l.z[i] * r.y[i];
+            rst.y[i] = l.z[i] * r.x[i] - l.x[i] * r.z[i];
+            rst.z[i] = l.x[i] * r.y[i] - l.y[i] * r.x[i];
+        }
+        return rst;
+    }
+
+    // zero-length lanes stay zero.
+    template<typename value_type, size_t N>
+    inline void normalize(vector3_soa<value_type, N>& v)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            value_type length_sqr = v.x[i] * v.x[i] + v.y[i] * v.y[i] + v.z[i] * v.z[i];
+            value_type inv_length = length_sqr > value_type(0) ? value_type(1) / std::sqrt(length_sqr) : value_type(0);
+            v.x[i] *= inv_length;
+            v.y[i] *= inv_length;
+            v.z[i] *= inv_length;
+        }
+    }
+
+    template<typename value_type, size_t N>
+    inline vector3_soa<value_type, N> normalized(const vector3_soa<value_type, N>& v)
+    {
+        vector3_soa<value_type, N> rst(v);
+        normalize(rst);
+        return rst;
+    }
+
+    // returns bit mask of the hit lanes, t is the nearest distance not less than error,
+    // which is the far one when the origin is inside.
+    template<typename value_type, size_t N>
+    inline uint32_t intersect_sphere(const ray3_soa<value_type, N>& rays,
+        const point<value_type, EDim::_3>& center, value_type radius_sqr,
+        value_type error, scalar_soa<value_type, N>& t)
+    {
+        static_assert(N <= 32, "hit mask holds 32 lanes at most.");
+        uint32_t mask = 0;
+        for (size_t i = 0; i < N; i++)
+        {
+            value_type ox = rays.origin.x[i] - center.x;
+            value_type oy = rays.origin.y[i] - center.y;
+            value_type oz = rays.origin.z[i] - center.z;
+            value_type dx = rays.direction.x[i], dy = rays.direction.y[i], dz = rays.direction.z[i];
+
+            // half b form of the quadratic in intersect_sphere().
+            value_type a = dx * dx + dy * dy + dz * dz;
+            value_type b = dx * ox + dy * oy + dz * oz;
+            value_type c = ox * ox + oy * oy + oz * oz - radius_sqr;
+            value_type det = b * b - a * c;
+            value_type root = std::sqrt(det > value_type(0) ? det : value_type(0));
+            value_type t0 = (-b - root) / a;
+            value_type t1 = (-b + root) / a;
+            t.v[i] = t0 >= error ? t0 : t1;
+            mask |= (det >= value_type(0) && t.v[i] >= error) ? (1u << i) : 0u;
+        }
+        return mask;
+    }
+
+    // slab test against an axis-aligned box, t is the entering distance clamped to error.
+    template<typename value_type, size_t N>
+    inline uint32_t intersect_aabb(const ray3_soa<value_type, N>& rays,
+        const vector_t<value_type, EDim::_3>& box_min, const vector_t<value_type, EDim::_3>& box_max,
+        value_type error, value_type t_max, scalar_soa<value_type, N>& t)
+    {
+        static_assert(N <= 32, "hit mask holds 32 lanes at most.");
+        uint32_t mask = 0;
+        for (size_t i = 0; i < N; i++)
+        {
+            value_type tx0 = (box_min.x - rays.origin.x[i]) * rays.inv_direction.x[i];
+            value_type tx1 = (box_max.x - rays.origin.x[i]) * rays.inv_direction.x[i];
+            value_type ty0 = (box_min.y - rays.origin.y[i]) * rays.inv_direction.y[i];
+            value_type ty1 = (box_max.y - rays.origin.y[i]) * rays.inv_direction.y[i];
+            value_type tz0 = (box_min.z - rays.origin.z[i]) * rays.inv_direction.z[i];
+            value_type tz1 = (box_max.z - rays.origin.z[i]) * rays.inv_direction.z[i];
+
+            value_type t_near = max2(max2(min2(tx0, tx1), min2(ty0, ty1)), max2(min2(tz0, tz1), error));
+            value_type t_far = min2(min2(max2(tx0, tx1), max2(ty0, ty1)), min2(max2(tz0, tz1), t_max));
+            t.v[i] = t_near;
+            mask |= (t_near <= t_far) ? (1u << i) : 0u;
+        }
+        return mask;
+    }
+
+#if defined(MATH_SIMD_SSE)
+    namespace math_impl
+    {
+        struct sse_vector3 { __m128 x, y, z; };
+
+        inline sse_vector3 load(const float3x4_soa& v) { return { _mm_load_ps(v.x), _mm_load_ps(v.y), _mm_load_ps(v.z) }; }
+        inline void store(float3x4_soa& rst, const sse_vector3& v) { _mm_store_ps(rst.x, v.x); _mm_store_ps(rst.y, v.y); _mm_store_ps(rst.z, v.z); }
+
+        inline __m128 dot(const sse_vector3& l, const sse_vector3& r)
+        {
+            return _mm_add_ps(_mm_add_ps(_mm_mul_ps(l.x, r.x), _mm_mul_ps(l.y, r.y)), _mm_mul_ps(l.z, r.z));
+        }
+
+        inline __m128 transform_row(const float* row, const sse_vector3& v)
+        {
+            return _mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(_mm_set1_ps(row[0]), v.x),
+                _mm_mul_ps(_mm_set1_ps(row[1]), v.y)),
+                _mm_mul_ps(_mm_set1_ps(row[2]), v.z));
+        }
+    }
+
+    inline float3x4_soa transform_point(const float4x4& m, const float3x4_soa& p)
+    {
+        const math_impl::sse_vector3 v = math_impl::load(p);
+        float3x4_soa rst;
+        math_impl::store(rst,
+            {
+                _mm_add_ps(math_impl::transform_row(m.m + 0, v), _mm_set1_ps(m._03)),
+                _mm_add_ps(math_impl::transform_row(m.m + 4, v), _mm_set1_ps(m._13)),
+                _mm_add_ps(math_impl::transform_row(m.m + 8, v), _mm_set1_ps(m._23))
+            });
+        return rst;
+    }
+
+    inline float3x4_soa transform_vector(const float3x3& m, const float3x4_soa& d)
+    {
+        const math_impl::sse_vector3 v = math_impl::load(d);
+        float3x4_soa rst;
+        math_impl::store(rst, { math_impl::transform_row(m.m + 0, v), math_impl::transform_row(m.m + 3, v), math_impl::transform_row(m.m + 6, v) });
+        return rst;
+    }
+
+    inline scalar4_soa<float> dot(const float3x4_soa& l, const float3x4_soa& r)
+    {
+        scalar4_soa<float> rst;
+        _mm_store_ps(rst.v, math_impl::dot(math_impl::load(l), math_impl::load(r)));
+        return rst;
+    }
+
+    inline void normalize(float3x4_soa& v)
+    {
+        math_impl::sse_vector3 lanes = math_impl::load(v);
+        const __m128 length_sqr = math_impl::dot(lanes, lanes);
+        const __m128 valid = _mm_cmpgt_ps(length_sqr, _mm_setzero_ps());
+        const __m128 inv_length = _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length_sqr)));
+        math_impl::store(v, { _mm_mul_ps(lanes.x, inv_length), _mm_mul_ps(lanes.y, inv_length), _mm_mul_ps(lanes.z, inv_length) });
+    }
+
+    inline uint32_t intersect_sphere(const ray3x4_soa<float>& rays,
+        const point<float, EDim::_3>& center, float radius_sqr,
+        float error, scalar4_soa<float>& t)
+    {
+        const math_impl::sse_vector3 d = math_impl::load(rays.direction);
+        math_impl::sse_vector3 o = math_impl::load(rays.origin);
+        o.x = _mm_sub_ps(o.x, _mm_set1_ps(center.x));
+        o.y = _mm_sub_ps(o.y, _mm_set1_ps(center.y));
+        o.z = _mm_sub_ps(o.z, _mm_set1_ps(center.z));
+
+        const __m128 a = math_impl::dot(d, d);
+        const __m128 b = math_impl::dot(d, o);
+        const __m128 c = _mm_sub_ps(math_impl::dot(o, o), _mm_set1_ps(radius_sqr));
+        const __m128 det = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(a, c));
+        const __m128 root = _mm_sqrt_ps(_mm_max_ps(det, _mm_setzero_ps()));
+        const __m128 inv_a = _mm_div_ps(_mm_set1_ps(1.0f), a);
+        const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), _mm_add_ps(b, root)), inv_a);
+        const __m128 t1 = _mm_mul_ps(_mm_sub_ps(root, b), inv_a);
+
+        const __m128 err = _mm_set1_ps(error);
+        const __m128 use_t0 = _mm_cmpge_ps(t0, err);
+        const __m128 nearest = _mm_or_ps(_mm_and_ps(use_t0, t0), _mm_andnot_ps(use_t0, t1));
+        _mm_store_ps(t.v, nearest);
+
+        const __m128 hit = _mm_and_ps(_mm_cmpge_ps(det, _mm_setzero_ps()), _mm_cmpge_ps(nearest, err));
+        return static_cast<uint32_t>(_mm_movemask_ps(hit));
+    }
+
+    inline uint32_t intersect_aabb(const ray3x4_soa<float>& rays,
+        const float3& box_min, const float3& box_max,
+        float error, float t_max, scalar4_soa<float>& t)
+    {
+        const math_impl::sse_vector3 o = math_impl::load(rays.origin);
+        const math_impl::sse_vector3 inv = math_impl::load(rays.inv_direction);
+
+        const __m128 tx0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box_min.x), o.x), inv.x);
+        const __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box_max.x), o.x), inv.x);
+        const __m128 ty0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box_min.y), o.y), inv.y);
+        const __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box_max.y), o.y), inv.y);
+        const __m128 tz0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box_min.z), o.z), inv.z);
+        const __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box_max.z), o.z), inv.z);
+
+        const __m128 t_near = _mm_max_ps(
+            _mm_max_ps(_mm_min_ps(tx0, tx1), _mm_min_ps(ty0, ty1)),
+            _mm_max_ps(_mm_min_ps(tz0, tz1), _mm_set1_ps(error)));
+        const __m128 t_far = _mm_min_ps(
+            _mm_min_ps(_mm_max_ps(tx0, tx1), _mm_max_ps(ty0, ty1)),
+            _mm_min_ps(_mm_max_ps(tz0, tz1), _mm_set1_ps(t_max)));
+        _mm_store_ps(t.v, t_near);
+        return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(t_near, t_far)));
+    }
+#endif
+
+    // streams
+
+    template<typename value_type, size_t N = 4>
+    class scalar_stream
+    {
+    public:
+        using packet_type = scalar_soa<value_type, N>;
+
+        void resize(size_t count) { _count = count; _packets.resize((count + N - 1) / N); }
+        size_t size() const { return _count; }
+        size_t packet_count() const { return _packets.size(); }
+        packet_type* packets() { return _packets.data(); }
+        const packet_type* packets() const { return _packets.data(); }
+        value_type get(size_t index) const { return _packets[index / N].v[index % N]; }
+        void set(size_t index, value_type s) { _packets[index / N].v[index % N] = s; }
+
+    private:
+        std::vector<packet_type> _packets;
+        size_t _count = 0;
+    };
+
+    template<typename value_type, size_t N = 4>
+    class vector3_stream
+    {
+    public:
+        using packet_type = vector3_soa<value_type, N>;
+
+        // padding lanes are zero.
+        void resize(size_t count) { _count = count; _packets.resize((count + N - 1) / N, packet_type::broadcast(vector_t<value_type, EDim::_3>::zero())); }
+        size_t size() const { return _count; }
+        size_t packet_count() const { return _packets.size(); }
+        packet_type* packets() { return _packets.data(); }
+        const packet_type* packets() const { return _packets.data(); }
+        vector_t<value_type, EDim::_3> get(size_t index) const { return _packets[index / N].get(index % N); }
+        void set(size_t index, const vector_t<value_type, EDim::_3>& v) { _packets[index / N].set(index % N, v); }
+
+    private:
+        std::vector<packet_type> _packets;
+        size_t _count = 0;
+    };
+
+    template<typename value_type, size_t N = 4>
+    class ray3_stream
+    {
+    public:
+        using packet_type = ray3_soa<value_type, N>;
+
+        void resize(size_t count) { _count = count; _packets.resize((count + N - 1) / N); }
+        size_t size() const { return _count; }
+        size_t packet_count() const { return _packets.size(); }
+        packet_type* packets() { return _packets.data(); }
+        const packet_type* packets() const { return _packets.data(); }
+        void set(size_t index, const ray<value_type, EDim::_3>& r) { _packets[index / N].set(index % N, r); }
+
+    private:
+        std::vector<packet_type> _packets;
+        size_t _count = 0;
+    };
+
+    template<typename value_type, size_t N>
+    inline void transform_points(const matrix_t<value_type, EDim::_4, EDim::_4>& m, const vector3_stream<value_type, N>& points, vector3_stream<value_type, N>& rst)
+    {
+        rst.resize(points.size());
+        for (size_t pi = 0; pi < points.packet_count(); pi++)
+        {
+            rst.packets()[pi] = transform_point(m, points.packets()[pi]);
+        }
+    }
+
+    // normal_matrix is the inverse transpose of the upper 3x3.
+    template<typename value_type, size_t N>
+    inline void transform_normals(const matrix_t<value_type, EDim::_3, EDim::_3>& normal_matrix, const vector3_stream<value_type, N>& normals, vector3_stream<value_type, N>& rst)
+    {
+        rst.resize(normals.size());
+        for (size_t pi = 0; pi < normals.packet_count(); pi++)
+        {
+            rst.packets()[pi] = transform_vector(normal_matrix, normals.packets()[pi]);
+            normalize(rst.packets()[pi]);
+        }
+    }
+
+    template<typename value_type, size_t N>
+    inline void dot(const vector3_stream<value_type, N>& l, const vector3_stream<value_type, N>& r, scalar_stream<value_type, N>& rst)
+    {
+        rst.resize(l.size());
+        for (size_t pi = 0; pi < l.packet_count(); pi++)
+        {
+            rst.packets()[pi] = dot(l.packets()[pi], r.packets()[pi]);
+        }
+    }
+
+    template<typename value_type, size_t N>
+    inline void cross(const vector3_stream<value_type, N>& l, const vector3_stream<value_type, N>& r, vector3_stream<value_type, N>& rst)
+    {
+        rst.resize(l.size());
+        for (size_t pi = 0; pi < l.packet_count(); pi++)
+        {
+            rst.packets()[pi] = cross(l.packets()[pi], r.packets()[pi]);
+        }
+    }
+
+    template<typename value_type, size_t N>
+    inline void normalize(vector3_stream<value_type, N>& v)
+    {
+        for (size_t pi = 0; pi < v.packet_count(); pi++)
+        {
+            normalize(v.packets()[pi]);
+        }
+    }
+
+    // hit_masks has one mask per packet, bits of padding lanes are cleared.
+    template<typename value_type, size_t N>
+    inline void intersect_sphere(const ray3_stream<value_type, N>& rays,
+        const point<value_type, EDim::_3>& center, value_type radius_sqr, value_type error,
+        scalar_stream<value_type, N>& t, std::vector<uint32_t>& hit_masks)
+    {
+        t.resize(rays.size());
+        hit_masks.resize(rays.packet_count());
+        for (size_t pi = 0; pi < rays.packet_count(); pi++)
+        {
+            hit_masks[pi] = intersect_sphere(rays.packets()[pi], center, radius_sqr, error, t.packets()[pi]);
+        }
+        if (rays.size() % N != 0)
+        {
+            hit_masks.back() &= (1u << (rays.size() % N)) - 1u;
+        }
+    }
+
+    template<typename value_type, size_t N>
+    inline void intersect_aabb(const ray3_stream<value_type, N>& rays,
+        const vector_t<value_type, EDim::_3>& box_min, const vector_t<value_type, EDim::_3>& box_max,
+        value_type error, value_type t_max,
+        scalar_stream<value_type, N>& t, std::vector<uint32_t>& hit_masks)
+    {
+        t.resize(rays.size());
+        hit_masks.resize(rays.packet_count());
+        for (size_t pi = 0; pi < rays.packet_count(); pi++)
+        {
+            hit_masks[pi] = intersect_aabb(rays.packets()[pi], box_min, box_max, error, t_max, t.packets()[pi]);
+        }
+        if (rays.size() % N != 0)
+        {
+            hit_masks.back() &= (1u << (rays.size() % N)) - 1u;
+        }
+    }
+}
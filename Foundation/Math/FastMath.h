@@ -0,0 +1,209 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "PredefinedConstantValues.h"
+
+/**
+* polynomial approximations of transcendental functions, without table lookups or branches on the value,
+* so loops over them can be vectorized. call sites choose them over the std versions where the error is acceptable.
+* errors are the maxima of a dense sweep over the stated range, ulp are float ulp of the exact result:
+*                                         float                         double
+*   fast_exp2    x in [-126, 126]         relative 2.4e-7, 2.9 ulp      relative 1.6e-7
+*   fast_log2    x in [1e-30, 1e30]       absolute 3.9e-6, 3.9 ulp      absolute 1.0e-9
+*   fast_pow     x > 0                    relative 1.8e-7 * (1 + |y * log2(x)|)
+*                x in (0, 1], y = 1/2.4   5.3 ulp
+*   fast_sincos  x in [-1e4, 1e4]         absolute 8.6e-8, 1.5 ulp      absolute 6.9e-12
+*                                         where |sin|, |cos| >= 0.5, 232 ulp near their zeros
+*   fast_rsqrt   x in [1e-30, 1e30]       relative 1.5e-7, 3.1 ulp      relative 4.2e-16
+*   fast_acos    x in [-1, 1]             absolute 4.3e-7, 2.8 ulp      absolute 2.2e-8
+* log2 and rsqrt ulp are from all normal floats, MathBenchmark tracks the float ulp as the *_ulp cases.
+* exp2, log2 and acos use the same polynomials in double, so they are not more accurate than float.
+*/
+namespace math
+{
+    namespace math_impl
+    {
+        template<typename value_type> struct float_bits;
+
+        template<> struct float_bits<float>
+        {
+            using bits_type = uint32_t;
+            using int_type = int32_t;
+            static constexpr int mantissa_bits = 23;
+            static constexpr int exponent_bias = 127;
+            static constexpr bits_type rsqrt_magic = 0x5F375A86u;
+            static constexpr int rsqrt_iterations = 3;
+            // pi/2 in three parts, the first ones have few bits so that quadrant * part is exact.
+            static constexpr float half_pi_parts[3] = { 1.5703125f, 4.837512969970703125e-4f, 7.54978995489188216e-8f };
+        };
+
+        template<> struct float_bits<double>
+        {
+            using bits_type = uint64_t;
+            using int_type = int64_t;
+            static constexpr int mantissa_bits = 52;
+            static constexpr int exponent_bias = 1023;
+            static constexpr bits_type rsqrt_magic = 0x5FE6EB50C7B537A9ull;
+            static constexpr int rsqrt_iterations = 4;
+            static constexpr double half_pi_parts[3] = { 1.57079632673412561417e+00, 6.07710050650619224932e-11, 0.0 };
+        };
+
+        template<typename value_type>
+        inline typename float_bits<value_type>::bits_type to_bits(value_type v)
+        {
+            typename float_bits<value_type>::bits_type bits;
+            std::memcpy(&bits, &v, sizeof(v));
+            return bits;
+        }
+
+        template<typename value_type>
+        inline value_type from_bits(typename float_bits<value_type>::bits_type bits)
+        {
+            value_type v;
+            std::memcpy(&v, &bits, sizeof(v));
+            return v;
+        }
+    }
+
+    // 2^x, the integer part goes to the exponent bits, the fraction in [-0.5, 0.5] to a degree 6 polynomial.
+    template<typename value_type, typename = std::enable_if_t<std::is_floating_point_v<value_type>>>
+    inline value_type fast_exp2(value_type x)
+    {
+        using traits = math_impl::float_bits<value_type>;
+        using bits_type = typename traits::bits_type;
+        using int_type = typename traits::int_type;
+
+        const value_type limit = value_type(traits::exponent_bias - 1);
+        x = x < -limit ? -limit : (x > limit ? limit : x);
+
+        const value_type rounded = std::floor(x + value_type(0.5));
+        const value_type f = x - rounded;
+
+        // taylor series of e^(f*ln2).
+        value_type p = value_type(1.5403530393381606e-4);
+        p = p * f + value_type(1.3333558146428443e-3);
+        p = p * f + value_type(9.6181291076284772e-3);
+        p = p * f + value_type(5.5504108664821580e-2);
+        p = p * f + value_type(2.4022650695910071e-1);
+        p = p * f + value_type(6.9314718055994531e-1);
+        p = p * f + value_type(1);
+
+        const bits_type exponent = static_cast<bits_type>(static_cast<int_type>(rounded) + traits::exponent_bias) << traits::mantissa_bits;
+        return p * math_impl::from_bits<value_type>(exponent);
+    }
+
+    // log2(x) for x > 0, the mantissa is moved to [sqrt(0.5), sqrt(2)),
+    // and log2(m) = 2/ln2 * atanh((m - 1) / (m + 1)) by an odd polynomial.
+    template<typename value_type, typename = std::enable_if_t<std::is_floating_point_v<value_type>>>
+    inline value_type fast_log2(value_type x)
+    {
+        using traits = math_impl::float_bits<value_type>;
+        using bits_type = typename traits::bits_type;
+        using int_type = typename traits::int_type;
+
+        const bits_type mantissa_mask = (bits_type(1) << traits::mantissa_bits) - 1;
+        const bits_type bits = math_impl::to_bits(x);
+        const value_type m1 = math_impl::from_bits<value_type>((bits & mantissa_mask) | (bits_type(traits::exponent_bias) << traits::mantissa_bits));
+        const bool upper = m1 > value_type(1.4142135623730951);
+        const value_type m = upper ? m1 * value_type(0.5) : m1;
+        const value_type exponent = static_cast<value_type>(static_cast<int_type>(bits >> traits::mantissa_bits) - traits::exponent_bias + (upper ? 1 : 0));
+
+        const value_type t = (m - value_type(1)) / (m + value_type(1));
+        const value_type t2 = t * t;
+        value_type p = value_type(2) / value_type(9);
+        p = p * t2 + value_type(2) / value_type(7);
+        p = p * t2 + value_type(2) / value_type(5);
+        p = p * t2 + value_type(2) / value_type(3);
+        p = p * t2 + value_type(2);
+        return exponent + p * t * value_type(1.4426950408889634);
+    }
+
+    // x^y for x >= 0.
+    template<typename value_type, typename = std::enable_if_t<std::is_floating_point_v<value_type>>>
+    inline value_type fast_pow(value_type x, value_type y)
+    {
+        return x > value_type(0) ? fast_exp2(y * fast_log2(x)) : value_type(0);
+    }
+
+    // reduced to [-pi/4, pi/4] by quadrant, then taylor series of degree 11 and 12.
+    template<typename value_type, typename = std::enable_if_t<std::is_floating_point_v<value_type>>>
+    inline void fast_sincos(value_type x, value_type& out_sin, value_type& out_cos)
+    {
+        using traits = math_impl::float_bits<value_type>;
+        using int_type = typename traits::int_type;
+
+        const value_type quadrant = std::floor(x * value_type(0.63661977236758134) + value_type(0.5));
+        const value_type r = ((x - quadrant * traits::half_pi_parts[0]) - quadrant * traits::half_pi_parts[1]) - quadrant * traits::half_pi_parts[2];
+        const value_type r2 = r * r;
+
+        value_type s = value_type(-2.5052108385441720e-8);
+        s = s * r2 + value_type(2.7557319223985893e-6);
+        s = s * r2 + value_type(-1.9841269841269841e-4);
+        s = s * r2 + value_type(8.3333333333333333e-3);
+        s = s * r2 + value_type(-1.6666666666666667e-1);
+        s = (s * r2 + value_type(1)) * r;
+
+        value_type c = value_type(2.0876756987868099e-9);
+        c = c * r2 + value_type(-2.7557319223985891e-7);
+        c = c * r2 + value_type(2.4801587301587302e-5);
+        c = c * r2 + value_type(-1.3888888888888889e-3);
+        c = c * r2 + value_type(4.1666666666666667e-2);
+        c = c * r2 + value_type(-0.5);
+        c = c * r2 + value_type(1);
+
+        const int_type q = static_cast<int_type>(quadrant) & 3;
+        const value_type sin_value = (q & 1) ? c : s;
+        const value_type cos_value = (q & 1) ? s : c;
+        out_sin = (q & 2) ? -sin_value : sin_value;
+        out_cos = ((q + 1) & 2) ? -cos_value : cos_value;
+    }
+
+    template<typename value_type, typename = std::enable_if_t<std::is_floating_point_v<value_type>>>
+    inline value_type fast_sin(value_type x)
+    {
+        value_type s, c;
+        fast_sincos(x, s, c);
+        return s;
+    }
+
+    template<typename value_type, typename = std::enable_if_t<std::is_floating_point_v<value_type>>>
+    inline value_type fast_cos(value_type x)
+    {
+        value_type s, c;
+        fast_sincos(x, s, c);
+        return c;
+    }
+
+    // 1/sqrt(x) for x > 0, bit trick guess refined by newton iterations, 3 for float, 4 for double.
+    template<typename value_type, typename = std::enable_if_t<std::is_floating_point_v<value_type>>>
+    inline value_type fast_rsqrt(value_type x)
+    {
+        using traits = math_impl::float_bits<value_type>;
+        const value_type half = value_type(0.5) * x;
+        value_type y = math_impl::from_bits<value_type>(traits::rsqrt_magic - (math_impl::to_bits(x) >> 1));
+        for (int i = 0; i < traits::rsqrt_iterations; i++)
+        {
+            y = y * (value_type(1.5) - half * y * y);
+        }
+        return y;
+    }
+
+    // abramowitz and stegun 4.4.46, acos(x) = sqrt(1 - x) * p(x) on [0, 1], mirrored for negative x.
+    template<typename value_type, typename = std::enable_if_t<std::is_floating_point_v<value_type>>>
+    inline value_type fast_acos(value_type x)
+    {
+        const value_type a = std::fabs(x) < value_type(1) ? std::fabs(x) : value_type(1);
+        value_type p = value_type(-0.0012624911);
+        p = p * a + value_type(0.0066700901);
+        p = p * a + value_type(-0.0170881256);
+        p = p * a + value_type(0.0308918810);
+        p = p * a + value_type(-0.0501743046);
+        p = p * a + value_type(0.0889789874);
+        p = p * a + value_type(-0.2145988016);
+        p = p * a + value_type(1.5707963050);
+        const value_type rst = std::sqrt(value_type(1) - a) * p;
+        return x < value_type(0) ? PI<value_type> - rst : rst;
+    }
+}
@@ -451,10 +451,10 @@ namespace math
         vector_t<value_type, EDim::_3> v2v0 = v2 - v0;
 
         vector_t<value_type, EDim::_3> pv = cross(ray.direction(), v2v0);
-        float det = dot(v1v0, pv);
+        value_type det = dot(v1v0, pv);
         if (det > value_type(0))
         {
-            float invDet = Float(1) / det;
+            value_type invDet = value_type(1) / det;
 
             vector_t<value_type, EDim::_3> tv = ray.origin() - v0;
             u = dot(tv, pv) * invDet;
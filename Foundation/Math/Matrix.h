@@ -2101,6 +2101,197 @@ namespace math
         return normalized(rst);
     }
 
+    /**
+    * affine transform with the last row (0, 0, 0, 1) left out,
+    * the linear part is cells[r][0..2] and the translation is cells[r][3], same as matrix4x4.
+    */
+    template<typename value_type>
+    struct affine3x4
+    {
+        using index_type = size_t;
+        static constexpr EDim row_dim = EDim::_3;
+        static constexpr EDim col_dim = EDim::_4;
+        static constexpr size_t cell_count = row_dim * col_dim;
+
+        union
+        {
+            char mem[cell_count * sizeof(value_type)];
+            value_type  m[cell_count];
+            value_type  cells[row_dim][col_dim];
+            vector_t<value_type, EDim::_4> rows[row_dim];
+            struct
+            {
+                value_type
+                    _00, _01, _02, _03,
+                    _10, _11, _12, _13,
+                    _20, _21, _22, _23;
+            };
+        };
+
+        constexpr affine3x4() : cells{
+             { value_type(1), value_type(0), value_type(0), value_type(0) }
+            ,{ value_type(0), value_type(1), value_type(0), value_type(0) }
+            ,{ value_type(0), value_type(0), value_type(1), value_type(0) } } { }
+
+        constexpr affine3x4(
+            value_type _m00, value_type _m01, value_type _m02, value_type _m03,
+            value_type _m10, value_type _m11, value_type _m12, value_type _m13,
+            value_type _m20, value_type _m21, value_type _m22, value_type _m23) : cells{
+             { _m00, _m01, _m02, _m03 }
+            ,{ _m10, _m11, _m12, _m13 }
+            ,{ _m20, _m21, _m22, _m23 } } { }
+
+        constexpr affine3x4(const matrix_t<value_type, EDim::_3, EDim::_3>& linear, const vector_t<value_type, EDim::_3>& trans) : cells{
+             { linear.cells[0][0], linear.cells[0][1], linear.cells[0][2], trans.x }
+            ,{ linear.cells[1][0], linear.cells[1][1], linear.cells[1][2], trans.y }
+            ,{ linear.cells[2][0], linear.cells[2][1], linear.cells[2][2], trans.z } } { }
+
+        constexpr matrix_t<value_type, EDim::_3, EDim::_3> linear() const
+        {
+            return matrix_t<value_type, EDim::_3, EDim::_3>(
+                cells[0][0], cells[0][1], cells[0][2],
+                cells[1][0], cells[1][1], cells[1][2],
+                cells[2][0], cells[2][1], cells[2][2]);
+        }
+
+        constexpr vector_t<value_type, EDim::_3> translation() const
+        {
+            return vector_t<value_type, EDim::_3>(cells[0][3], cells[1][3], cells[2][3]);
+        }
+
+        constexpr vector_t<value_type, EDim::_3> column3(size_t index) const
+        {
+            return vector_t<value_type, EDim::_3>(cells[0][index], cells[1][index], cells[2][index]);
+        }
+
+        constexpr matrix_t<value_type, EDim::_4, EDim::_4> to_matrix4x4() const
+        {
+            return matrix_t<value_type, EDim::_4, EDim::_4>(
+                rows[0], rows[1], rows[2],
+                vector_t<value_type, EDim::_4>(value_type(0), value_type(0), value_type(0), value_type(1)));
+        }
+
+        // static utilities
+        static constexpr affine3x4 identity()
+        {
+            return affine3x4();
+        }
+
+        static inline affine3x4 tr(const vector_t<value_type, EDim::_3>& t, const quaternion<value_type>& r)
+        {
+            return affine3x4(rotation_matrix_t<value_type, EDim::_3, EDim::_3>(r), t);
+        }
+
+        // scale is applied first, so the columns of linear part are the scaled rotation axes.
+        static inline affine3x4 trs(const vector_t<value_type, EDim::_3>& t,
+            const quaternion<value_type>& r,
+            const vector_t<value_type, EDim::_3>& s)
+        {
+            affine3x4 rst = tr(t, r);
+            for (size_t ri = 0; ri < row_dim; ri++)
+            {
+                rst.cells[ri][0] *= s.x;
+                rst.cells[ri][1] *= s.y;
+                rst.cells[ri][2] *= s.z;
+            }
+            return rst;
+        }
+    };
+
+    template<typename value_type>
+    inline affine3x4<value_type> operator* (const affine3x4<value_type>& l, const affine3x4<value_type>& r)
+    {
+        affine3x4<value_type> rst;
+        for (size_t ri = 0; ri < 3; ri++)
+        {
+            for (size_t ci = 0; ci < 4; ci++)
+            {
+                rst.cells[ri][ci] = l.cells[ri][0] * r.cells[0][ci] + l.cells[ri][1] * r.cells[1][ci] + l.cells[ri][2] * r.cells[2][ci];
+            }
+            rst.cells[ri][3] += l.cells[ri][3];
+        }
+        return rst;
+    }
+
+    template<typename value_type>
+    constexpr vector_t<value_type, EDim::_3> transform_point(const affine3x4<value_type>& l, const vector_t<value_type, EDim::_3>& r)
+    {
+        return vector_t<value_type, EDim::_3>(
+            l._00 * r.x + l._01 * r.y + l._02 * r.z + l._03,
+            l._10 * r.x + l._11 * r.y + l._12 * r.z + l._13,
+            l._20 * r.x + l._21 * r.y + l._22 * r.z + l._23);
+    }
+
+    template<typename value_type>
+    constexpr vector_t<value_type, EDim::_3> transform_vector(const affine3x4<value_type>& l, const vector_t<value_type, EDim::_3>& r)
+    {
+        return vector_t<value_type, EDim::_3>(
+            l._00 * r.x + l._01 * r.y + l._02 * r.z,
+            l._10 * r.x + l._11 * r.y + l._12 * r.z,
+            l._20 * r.x + l._21 * r.y + l._22 * r.z);
+    }
+
+    // transposed linear part times r,
+    // normals go from local to world with the inverse transform, and back with the transform itself.
+    template<typename value_type>
+    constexpr vector_t<value_type, EDim::_3> transform_vector_transposed(const affine3x4<value_type>& l, const vector_t<value_type, EDim::_3>& r)
+    {
+        return vector_t<value_type, EDim::_3>(
+            l._00 * r.x + l._10 * r.y + l._20 * r.z,
+            l._01 * r.x + l._11 * r.y + l._21 * r.z,
+            l._02 * r.x + l._12 * r.y + l._22 * r.z);
+    }
+
+    // for rotation and translation only.
+    template<typename value_type>
+    inline affine3x4<value_type> inversed_rigid(const affine3x4<value_type>& matrix)
+    {
+        affine3x4<value_type> rst(
+            matrix._00, matrix._10, matrix._20, value_type(0),
+            matrix._01, matrix._11, matrix._21, value_type(0),
+            matrix._02, matrix._12, matrix._22, value_type(0));
+        vector_t<value_type, EDim::_3> t = transform_vector(rst, matrix.translation());
+        rst._03 = -t.x;
+        rst._13 = -t.y;
+        rst._23 = -t.z;
+        return rst;
+    }
+
+    // for trs, linear part is R * S, so its inverse is S^-1 * R^T,
+    // that is the columns divided by their squared length, transposed.
+    template<typename value_type>
+    inline affine3x4<value_type> inversed_trs(const affine3x4<value_type>& matrix)
+    {
+        vector_t<value_type, EDim::_3> inv_scale_sqr;
+        for (size_t ci = 0; ci < 3; ci++)
+        {
+            value_type length_sqr = magnitude_sqr(matrix.column3(ci));
+            inv_scale_sqr.v[ci] = is_equal(length_sqr, value_type(0)) ? value_type(0) : value_type(1) / length_sqr;
+        }
+
+        affine3x4<value_type> rst(
+            matrix._00 * inv_scale_sqr.x, matrix._10 * inv_scale_sqr.x, matrix._20 * inv_scale_sqr.x, value_type(0),
+            matrix._01 * inv_scale_sqr.y, matrix._11 * inv_scale_sqr.y, matrix._21 * inv_scale_sqr.y, value_type(0),
+            matrix._02 * inv_scale_sqr.z, matrix._12 * inv_scale_sqr.z, matrix._22 * inv_scale_sqr.z, value_type(0));
+        vector_t<value_type, EDim::_3> t = transform_vector(rst, matrix.translation());
+        rst._03 = -t.x;
+        rst._13 = -t.y;
+        rst._23 = -t.z;
+        return rst;
+    }
+
+    // general affine inverse, for linear parts with shear.
+    template<typename value_type>
+    inline affine3x4<value_type> inversed(const affine3x4<value_type>& matrix)
+    {
+        affine3x4<value_type> rst(inversed(matrix.linear()), vector_t<value_type, EDim::_3>::zero());
+        vector_t<value_type, EDim::_3> t = transform_vector(rst, matrix.translation());
+        rst._03 = -t.x;
+        rst._13 = -t.y;
+        rst._23 = -t.z;
+        return rst;
+    }
+
     template<typename value_type> using matrix2x2 = matrix_t<value_type, EDim::_2, EDim::_2>;
     template<typename value_type> using matrix2x3 = matrix_t<value_type, EDim::_2, EDim::_3>;
     template<typename value_type> using matrix3x3 = matrix_t<value_type, EDim::_3, EDim::_3>;
@@ -2132,6 +2323,9 @@ namespace math
     using double3x3 = matrix3x3<double>;
     using double4x4 = matrix4x4<double>;
 
+    using affine3x4f = affine3x4<float>;
+    using affine3x4d = affine3x4<double>;
+
     using translation_matrix4x4f = translation_matrix4x4<float>;
     using rotation_matrix4x4f = rotation_matrix4x4<float>;
     using scale_matrix4x4f = scale_matrix4x4<float>;
@@ -2139,3 +2333,5 @@ namespace math
     using perspective_lh_matrix4x4f = perspective_lh_matrix4x4<float>;
     using ortho_lh_matrix4x4f = ortho_lh_matrix4x4<float>;
 }
+
+#include "SIMD.h"
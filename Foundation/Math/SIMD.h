@@ -0,0 +1,423 @@
+#pragma once
+
+/**
+* opt-in simd specializations of float4, float4x4 and double4.
+* they are plain overloads of the template operations, so the templates stay the scalar fallback,
+* and storage is not changed: unaligned loads keep the layout that vertex and constant buffers rely on.
+* sse2 and neon cover float4 / float4x4, avx covers double4.
+* enabled by defining MATH_ENABLE_SIMD, the MATH_ENABLE_SIMD cmake option does it for all targets.
+*/
+
+#if defined(MATH_ENABLE_SIMD)
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#define MATH_SIMD_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATH_SIMD_SSE
+#include <emmintrin.h>
+#if defined(__AVX__)
+#define MATH_SIMD_AVX
+#include <immintrin.h>
+#endif
+#endif
+#endif
+
+namespace math
+{
+#if defined(MATH_SIMD_SSE) || defined(MATH_SIMD_NEON)
+    namespace math_impl
+    {
+        // the determinant is rounded differently from the scalar one,
+        // matrices close to singular are left to the scalar version, so both agree on which are singular.
+        inline bool is_nearly_singular(float det) { return near_zero(det, 4.0f * SMALL_NUM<float>); }
+    }
+#endif
+
+#if defined(MATH_SIMD_SSE)
+    namespace math_impl
+    {
+        inline __m128 load(const float4& v) { return _mm_loadu_ps(v.v); }
+        inline float4 store(__m128 v) { float4 rst; _mm_storeu_ps(rst.v, v); return rst; }
+
+        inline float horizontal_add(__m128 v)
+        {
+            __m128 sum = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+            sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(2, 3, 0, 1)));
+            return _mm_cvtss_f32(sum);
+        }
+
+        // r = v0 * m.row0 + v1 * m.row1 + v2 * m.row2 + v3 * m.row3
+        inline __m128 linear_combine(const float* v, const __m128* rows)
+        {
+            __m128 rst = _mm_mul_ps(_mm_set1_ps(v[0]), rows[0]);
+            rst = _mm_add_ps(rst, _mm_mul_ps(_mm_set1_ps(v[1]), rows[1]));
+            rst = _mm_add_ps(rst, _mm_mul_ps(_mm_set1_ps(v[2]), rows[2]));
+            rst = _mm_add_ps(rst, _mm_mul_ps(_mm_set1_ps(v[3]), rows[3]));
+            return rst;
+        }
+
+        inline void load_transposed(const float4x4& matrix, __m128* columns)
+        {
+            columns[0] = _mm_loadu_ps(matrix.m + 0);
+            columns[1] = _mm_loadu_ps(matrix.m + 4);
+            columns[2] = _mm_loadu_ps(matrix.m + 8);
+            columns[3] = _mm_loadu_ps(matrix.m + 12);
+            _MM_TRANSPOSE4_PS(columns[0], columns[1], columns[2], columns[3]);
+        }
+
+        // 2x2 blocks are stored as (a00, a01, a10, a11).
+        // A * B
+        inline __m128 mul2x2(__m128 a, __m128 b)
+        {
+            return _mm_add_ps(
+                _mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 3, 0))),
+                _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+        }
+
+        // adjugate(A) * B
+        inline __m128 adj_mul2x2(__m128 a, __m128 b)
+        {
+            return _mm_sub_ps(
+                _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 3, 3)), b),
+                _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 1, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2))));
+        }
+
+        // A * adjugate(B)
+        inline __m128 mul_adj2x2(__m128 a, __m128 b)
+        {
+            return _mm_sub_ps(
+                _mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 0, 3))),
+                _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+        }
+    }
+
+    inline float4 operator+(const float4& l, const float4& r) { return math_impl::store(_mm_add_ps(math_impl::load(l), math_impl::load(r))); }
+    inline float4 operator-(const float4& l, const float4& r) { return math_impl::store(_mm_sub_ps(math_impl::load(l), math_impl::load(r))); }
+    inline float4 operator*(const float4& l, const float4& r) { return math_impl::store(_mm_mul_ps(math_impl::load(l), math_impl::load(r))); }
+    inline float4 operator*(const float4& l, float r) { return math_impl::store(_mm_mul_ps(math_impl::load(l), _mm_set1_ps(r))); }
+    inline float4 operator*(float l, const float4& r) { return r * l; }
+    inline float dot(const float4& l, const float4& r) { return math_impl::horizontal_add(_mm_mul_ps(math_impl::load(l), math_impl::load(r))); }
+
+    inline float4x4 operator*(const float4x4& l, const float4x4& r)
+    {
+        __m128 rows[4] =
+        {
+            _mm_loadu_ps(r.m + 0), _mm_loadu_ps(r.m + 4),
+            _mm_loadu_ps(r.m + 8), _mm_loadu_ps(r.m + 12)
+        };
+
+        float4x4 rst;
+        _mm_storeu_ps(rst.m + 0, math_impl::linear_combine(l.m + 0, rows));
+        _mm_storeu_ps(rst.m + 4, math_impl::linear_combine(l.m + 4, rows));
+        _mm_storeu_ps(rst.m + 8, math_impl::linear_combine(l.m + 8, rows));
+        _mm_storeu_ps(rst.m + 12, math_impl::linear_combine(l.m + 12, rows));
+        return rst;
+    }
+
+    inline float4 operator*(const float4x4& l, const float4& r)
+    {
+        __m128 columns[4];
+        math_impl::load_transposed(l, columns);
+        return math_impl::store(math_impl::linear_combine(r.v, columns));
+    }
+
+    inline float4 operator*(const float4& l, const float4x4& r)
+    {
+        __m128 rows[4] =
+        {
+            _mm_loadu_ps(r.m + 0), _mm_loadu_ps(r.m + 4),
+            _mm_loadu_ps(r.m + 8), _mm_loadu_ps(r.m + 12)
+        };
+        return math_impl::store(math_impl::linear_combine(l.v, rows));
+    }
+
+    inline float4 transform(const float4x4& l, const float4& r)
+    {
+        return l * r;
+    }
+
+    inline float3 transform(const float4x4& l, const float3& r)
+    {
+        float4 rst = l * float4(r, 0.0f);
+        return float3(rst.x, rst.y, rst.z);
+    }
+
+    inline void transpose(float4x4& matrix)
+    {
+        __m128 columns[4];
+        math_impl::load_transposed(matrix, columns);
+        _mm_storeu_ps(matrix.m + 0, columns[0]);
+        _mm_storeu_ps(matrix.m + 4, columns[1]);
+        _mm_storeu_ps(matrix.m + 8, columns[2]);
+        _mm_storeu_ps(matrix.m + 12, columns[3]);
+    }
+
+    inline float4x4 transposed(const float4x4& matrix)
+    {
+        float4x4 rst(matrix);
+        transpose(rst);
+        return rst;
+    }
+
+    // block-wise inverse,
+    // M = | A B |, inverse(M) = 1/|M| * adjugate of | |D|A - B(D#C)   |B|C - D(A#B)# |
+    //     | C D |                                   | |C|B - A(D#C)#  |A|D - C(A#B)  |
+    // where X# is adjugate of X, and |M| = |A||D| + |B||C| - tr((A#B)(D#C)).
+    inline void inverse(float4x4& matrix)
+    {
+        if (is_orthogonal(matrix))
+        {
+            transpose(matrix);
+            return;
+        }
+
+        const __m128 row0 = _mm_loadu_ps(matrix.m + 0);
+        const __m128 row1 = _mm_loadu_ps(matrix.m + 4);
+        const __m128 row2 = _mm_loadu_ps(matrix.m + 8);
+        const __m128 row3 = _mm_loadu_ps(matrix.m + 12);
+
+        const __m128 A = _mm_movelh_ps(row0, row1);
+        const __m128 B = _mm_movehl_ps(row1, row0);
+        const __m128 C = _mm_movelh_ps(row2, row3);
+        const __m128 D = _mm_movehl_ps(row3, row2);
+
+        // (|A|, |B|, |C|, |D|)
+        const __m128 detSub = _mm_sub_ps(
+            _mm_mul_ps(_mm_shuffle_ps(row0, row2, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(row1, row3, _MM_SHUFFLE(3, 1, 3, 1))),
+            _mm_mul_ps(_mm_shuffle_ps(row0, row2, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(row1, row3, _MM_SHUFFLE(2, 0, 2, 0))));
+        const __m128 detA = _mm_shuffle_ps(detSub, detSub, _MM_SHUFFLE(0, 0, 0, 0));
+        const __m128 detB = _mm_shuffle_ps(detSub, detSub, _MM_SHUFFLE(1, 1, 1, 1));
+        const __m128 detC = _mm_shuffle_ps(detSub, detSub, _MM_SHUFFLE(2, 2, 2, 2));
+        const __m128 detD = _mm_shuffle_ps(detSub, detSub, _MM_SHUFFLE(3, 3, 3, 3));
+
+        const __m128 D_C = math_impl::adj_mul2x2(D, C);
+        const __m128 A_B = math_impl::adj_mul2x2(A, B);
+        __m128 X_ = _mm_sub_ps(_mm_mul_ps(detD, A), math_impl::mul2x2(B, D_C));
+        __m128 W_ = _mm_sub_ps(_mm_mul_ps(detA, D), math_impl::mul2x2(C, A_B));
+        __m128 Y_ = _mm_sub_ps(_mm_mul_ps(detB, C), math_impl::mul_adj2x2(D, A_B));
+        __m128 Z_ = _mm_sub_ps(_mm_mul_ps(detC, B), math_impl::mul_adj2x2(A, D_C));
+
+        const float trace = math_impl::horizontal_add(_mm_mul_ps(A_B, _mm_shuffle_ps(D_C, D_C, _MM_SHUFFLE(3, 1, 2, 0))));
+        const float det = _mm_cvtss_f32(detA) * _mm_cvtss_f32(detD) + _mm_cvtss_f32(detB) * _mm_cvtss_f32(detC) - trace;
+        if (math_impl::is_nearly_singular(det))
+        {
+            inverse<float>(matrix);
+            return;
+        }
+
+        const __m128 invDet = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), _mm_set1_ps(det));
+        X_ = _mm_mul_ps(X_, invDet);
+        Y_ = _mm_mul_ps(Y_, invDet);
+        Z_ = _mm_mul_ps(Z_, invDet);
+        W_ = _mm_mul_ps(W_, invDet);
+
+        // adjugate of every block, and put them back to rows.
+        _mm_storeu_ps(matrix.m + 0, _mm_shuffle_ps(X_, Y_, _MM_SHUFFLE(1, 3, 1, 3)));
+        _mm_storeu_ps(matrix.m + 4, _mm_shuffle_ps(X_, Y_, _MM_SHUFFLE(0, 2, 0, 2)));
+        _mm_storeu_ps(matrix.m + 8, _mm_shuffle_ps(Z_, W_, _MM_SHUFFLE(1, 3, 1, 3)));
+        _mm_storeu_ps(matrix.m + 12, _mm_shuffle_ps(Z_, W_, _MM_SHUFFLE(0, 2, 0, 2)));
+    }
+
+    inline float4x4 inversed(const float4x4& matrix)
+    {
+        float4x4 rst(matrix);
+        inverse(rst);
+        return rst;
+    }
+#endif
+
+#if defined(MATH_SIMD_NEON)
+    namespace math_impl
+    {
+        inline float32x4_t load(const float4& v) { return vld1q_f32(v.v); }
+        inline float4 store(float32x4_t v) { float4 rst; vst1q_f32(rst.v, v); return rst; }
+
+        inline float horizontal_add(float32x4_t v)
+        {
+            float32x2_t sum = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+            return vget_lane_f32(vpadd_f32(sum, sum), 0);
+        }
+
+        inline float32x4_t linear_combine(const float* v, const float32x4_t* rows)
+        {
+            float32x4_t rst = vmulq_n_f32(rows[0], v[0]);
+            rst = vmlaq_n_f32(rst, rows[1], v[1]);
+            rst = vmlaq_n_f32(rst, rows[2], v[2]);
+            rst = vmlaq_n_f32(rst, rows[3], v[3]);
+            return rst;
+        }
+
+        // lane permutations used by the 2x2 blocks, named after the lanes they pick.
+        inline float32x4_t lanes_1032(float32x4_t v) { return vrev64q_f32(v); }
+        inline float32x4_t lanes_2301(float32x4_t v) { return vextq_f32(v, v, 2); }
+        inline float32x4_t lanes_3030(float32x4_t v) { float32x2_t p = vext_f32(vget_high_f32(v), vget_low_f32(v), 1); return vcombine_f32(p, p); }
+        inline float32x4_t lanes_0303(float32x4_t v) { float32x2_t p = vrev64_f32(vext_f32(vget_high_f32(v), vget_low_f32(v), 1)); return vcombine_f32(p, p); }
+        inline float32x4_t lanes_2121(float32x4_t v) { float32x2_t p = vrev64_f32(vext_f32(vget_low_f32(v), vget_high_f32(v), 1)); return vcombine_f32(p, p); }
+        inline float32x4_t lanes_3300(float32x4_t v) { return vcombine_f32(vdup_lane_f32(vget_high_f32(v), 1), vdup_lane_f32(vget_low_f32(v), 0)); }
+        inline float32x4_t lanes_1122(float32x4_t v) { return vcombine_f32(vdup_lane_f32(vget_low_f32(v), 1), vdup_lane_f32(vget_high_f32(v), 0)); }
+        inline float32x4_t lanes_0213(float32x4_t v) { float32x4x2_t halves = vuzpq_f32(v, v); return vcombine_f32(vget_low_f32(halves.val[0]), vget_low_f32(halves.val[1])); }
+
+        inline float determinant2x2(float32x4_t v) { return vgetq_lane_f32(v, 0) * vgetq_lane_f32(v, 3) - vgetq_lane_f32(v, 1) * vgetq_lane_f32(v, 2); }
+
+        // same block layout and formulas as the sse version.
+        inline float32x4_t mul2x2(float32x4_t a, float32x4_t b)
+        {
+            return vmlaq_f32(vmulq_f32(a, lanes_0303(b)), lanes_1032(a), lanes_2121(b));
+        }
+
+        inline float32x4_t adj_mul2x2(float32x4_t a, float32x4_t b)
+        {
+            return vmlsq_f32(vmulq_f32(lanes_3300(a), b), lanes_1122(a), lanes_2301(b));
+        }
+
+        inline float32x4_t mul_adj2x2(float32x4_t a, float32x4_t b)
+        {
+            return vmlsq_f32(vmulq_f32(a, lanes_3030(b)), lanes_1032(a), lanes_2121(b));
+        }
+    }
+
+    inline float4 operator+(const float4& l, const float4& r) { return math_impl::store(vaddq_f32(math_impl::load(l), math_impl::load(r))); }
+    inline float4 operator-(const float4& l, const float4& r) { return math_impl::store(vsubq_f32(math_impl::load(l), math_impl::load(r))); }
+    inline float4 operator*(const float4& l, const float4& r) { return math_impl::store(vmulq_f32(math_impl::load(l), math_impl::load(r))); }
+    inline float4 operator*(const float4& l, float r) { return math_impl::store(vmulq_n_f32(math_impl::load(l), r)); }
+    inline float4 operator*(float l, const float4& r) { return r * l; }
+    inline float dot(const float4& l, const float4& r) { return math_impl::horizontal_add(vmulq_f32(math_impl::load(l), math_impl::load(r))); }
+
+    inline float4x4 operator*(const float4x4& l, const float4x4& r)
+    {
+        float32x4_t rows[4] = { vld1q_f32(r.m + 0), vld1q_f32(r.m + 4), vld1q_f32(r.m + 8), vld1q_f32(r.m + 12) };
+
+        float4x4 rst;
+        vst1q_f32(rst.m + 0, math_impl::linear_combine(l.m + 0, rows));
+        vst1q_f32(rst.m + 4, math_impl::linear_combine(l.m + 4, rows));
+        vst1q_f32(rst.m + 8, math_impl::linear_combine(l.m + 8, rows));
+        vst1q_f32(rst.m + 12, math_impl::linear_combine(l.m + 12, rows));
+        return rst;
+    }
+
+    inline float4 operator*(const float4x4& l, const float4& r)
+    {
+        // de-interleaved load gives the columns.
+        float32x4x4_t columns = vld4q_f32(l.m);
+        return math_impl::store(math_impl::linear_combine(r.v, columns.val));
+    }
+
+    inline float4 operator*(const float4& l, const float4x4& r)
+    {
+        float32x4_t rows[4] = { vld1q_f32(r.m + 0), vld1q_f32(r.m + 4), vld1q_f32(r.m + 8), vld1q_f32(r.m + 12) };
+        return math_impl::store(math_impl::linear_combine(l.v, rows));
+    }
+
+    inline float4 transform(const float4x4& l, const float4& r)
+    {
+        return l * r;
+    }
+
+    inline float3 transform(const float4x4& l, const float3& r)
+    {
+        float4 rst = l * float4(r, 0.0f);
+        return float3(rst.x, rst.y, rst.z);
+    }
+
+    inline void transpose(float4x4& matrix)
+    {
+        float32x4x4_t columns = vld4q_f32(matrix.m);
+        vst1q_f32(matrix.m + 0, columns.val[0]);
+        vst1q_f32(matrix.m + 4, columns.val[1]);
+        vst1q_f32(matrix.m + 8, columns.val[2]);
+        vst1q_f32(matrix.m + 12, columns.val[3]);
+    }
+
+    inline float4x4 transposed(const float4x4& matrix)
+    {
+        float4x4 rst(matrix);
+        transpose(rst);
+        return rst;
+    }
+
+    // block-wise inverse, see the sse version.
+    inline void inverse(float4x4& matrix)
+    {
+        if (is_orthogonal(matrix))
+        {
+            transpose(matrix);
+            return;
+        }
+
+        const float32x4_t row0 = vld1q_f32(matrix.m + 0);
+        const float32x4_t row1 = vld1q_f32(matrix.m + 4);
+        const float32x4_t row2 = vld1q_f32(matrix.m + 8);
+        const float32x4_t row3 = vld1q_f32(matrix.m + 12);
+
+        const float32x4_t A = vcombine_f32(vget_low_f32(row0), vget_low_f32(row1));
+        const float32x4_t B = vcombine_f32(vget_high_f32(row0), vget_high_f32(row1));
+        const float32x4_t C = vcombine_f32(vget_low_f32(row2), vget_low_f32(row3));
+        const float32x4_t D = vcombine_f32(vget_high_f32(row2), vget_high_f32(row3));
+
+        const float detA = math_impl::determinant2x2(A);
+        const float detB = math_impl::determinant2x2(B);
+        const float detC = math_impl::determinant2x2(C);
+        const float detD = math_impl::determinant2x2(D);
+
+        const float32x4_t D_C = math_impl::adj_mul2x2(D, C);
+        const float32x4_t A_B = math_impl::adj_mul2x2(A, B);
+        float32x4_t X_ = vsubq_f32(vmulq_n_f32(A, detD), math_impl::mul2x2(B, D_C));
+        float32x4_t W_ = vsubq_f32(vmulq_n_f32(D, detA), math_impl::mul2x2(C, A_B));
+        float32x4_t Y_ = vsubq_f32(vmulq_n_f32(C, detB), math_impl::mul_adj2x2(D, A_B));
+        float32x4_t Z_ = vsubq_f32(vmulq_n_f32(B, detC), math_impl::mul_adj2x2(A, D_C));
+
+        const float trace = math_impl::horizontal_add(vmulq_f32(A_B, math_impl::lanes_0213(D_C)));
+        const float det = detA * detD + detB * detC - trace;
+        if (math_impl::is_nearly_singular(det))
+        {
+            inverse<float>(matrix);
+            return;
+        }
+
+        const float rcpDet = 1.0f / det;
+        const float signs[4] = { rcpDet, -rcpDet, -rcpDet, rcpDet };
+        const float32x4_t invDet = vld1q_f32(signs);
+        X_ = vmulq_f32(X_, invDet);
+        Y_ = vmulq_f32(Y_, invDet);
+        Z_ = vmulq_f32(Z_, invDet);
+        W_ = vmulq_f32(W_, invDet);
+
+        // adjugate of every block, and put them back to rows.
+        const float32x4x2_t XY = vuzpq_f32(X_, Y_);
+        const float32x4x2_t ZW = vuzpq_f32(Z_, W_);
+        vst1q_f32(matrix.m + 0, vrev64q_f32(XY.val[1]));
+        vst1q_f32(matrix.m + 4, vrev64q_f32(XY.val[0]));
+        vst1q_f32(matrix.m + 8, vrev64q_f32(ZW.val[1]));
+        vst1q_f32(matrix.m + 12, vrev64q_f32(ZW.val[0]));
+    }
+
+    inline float4x4 inversed(const float4x4& matrix)
+    {
+        float4x4 rst(matrix);
+        inverse(rst);
+        return rst;
+    }
+#endif
+
+#if defined(MATH_SIMD_AVX)
+    namespace math_impl
+    {
+        inline __m256d load(const double4& v) { return _mm256_loadu_pd(v.v); }
+        inline double4 store(__m256d v) { double4 rst; _mm256_storeu_pd(rst.v, v); return rst; }
+    }
+
+    inline double4 operator+(const double4& l, const double4& r) { return math_impl::store(_mm256_add_pd(math_impl::load(l), math_impl::load(r))); }
+    inline double4 operator-(const double4& l, const double4& r) { return math_impl::store(_mm256_sub_pd(math_impl::load(l), math_impl::load(r))); }
+    inline double4 operator*(const double4& l, const double4& r) { return math_impl::store(_mm256_mul_pd(math_impl::load(l), math_impl::load(r))); }
+    inline double4 operator*(const double4& l, double r) { return math_impl::store(_mm256_mul_pd(math_impl::load(l), _mm256_set1_pd(r))); }
+    inline double4 operator*(double l, const double4& r) { return r * l; }
+
+    inline double dot(const double4& l, const double4& r)
+    {
+        __m256d product = _mm256_mul_pd(math_impl::load(l), math_impl::load(r));
+        __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(product), _mm256_extractf128_pd(product, 1));
+        sum = _mm_add_sd(sum, _mm_unpackhi_pd(sum, sum));
+        return _mm_cvtsd_f64(sum);
+    }
+#endif
+}